@@ -0,0 +1,95 @@
+// bench/ExclusionBench.cpp
+// Matching cost per library filename for an ExclusionPolicy with thousands of rules,
+// next to the old approach of building every std::regex inside the loop.
+//
+//   exclusion_bench [rules-per-kind] [regex-rules]
+#include "ExclusionPolicy.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    std::string libraryName(std::mt19937& rng, std::size_t id) {
+        static const char* stems[] = { "Qt5", "boost_", "grpc", "absl_", "icu", "gtk-", "ssl", "z", "png", "vendor" };
+        static const char* tails[] = { ".so", ".so.1", ".so.5.15.2", ".so.1.83.0", ".so.3" };
+        return std::string("lib") + stems[rng() % 10] + std::to_string(id) + tails[rng() % 5];
+    }
+
+    template <typename F>
+    double nanosPerCall(std::size_t calls, F&& body) {
+        const auto start = Clock::now();
+        body();
+        const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+        return elapsed.count() / static_cast<double>(calls);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const std::size_t perKind = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    const std::size_t regexCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 256;
+    std::mt19937 rng(42);
+
+    ExclusionPolicy policy;
+    policy.addPlatformDefaults();
+    std::vector<std::string> literals, regexes;
+    for (std::size_t i = 0; i < perKind; ++i) {
+        literals.push_back(libraryName(rng, i));
+        policy.add(ExclusionKind::Literal, literals.back(), "bench");
+        policy.add(ExclusionKind::Glob, "lib" + std::string(1, char('a' + i % 26)) + std::to_string(i) + "*.so*", "bench");
+        policy.add(ExclusionKind::Prefix, "/opt/vendor" + std::to_string(i) + "/lib", "bench");
+    }
+    for (std::size_t i = 0; i < regexCount; ++i) {
+        // Half start with literal text and land in a prefix bucket; half have to be tried on every name.
+        regexes.push_back(i % 2 == 0 ? "libr" + std::to_string(i) + "_[a-z]+\\.so(\\..*)?"
+                                     : "(lib)?(foo|bar)" + std::to_string(i) + "[0-9]*\\.so(\\..*)?");
+        policy.add(ExclusionKind::Regex, regexes.back(), "bench");
+    }
+
+    const auto compileStart = Clock::now();
+    policy.compile();
+    const std::chrono::duration<double, std::milli> compileMs = Clock::now() - compileStart;
+
+    // A quarter of the probes are excluded, the rest fall through every matcher.
+    std::vector<std::string> names;
+    std::vector<std::string> paths;
+    for (std::size_t i = 0; i < 20000; ++i) {
+        std::string name = i % 4 == 0 ? literals[rng() % literals.size()] : libraryName(rng, perKind + i);
+        paths.push_back((i % 8 == 0 ? "/opt/vendor" + std::to_string(rng() % perKind) + "/lib/" : "/usr/local/lib/") + name);
+        names.push_back(std::move(name));
+    }
+
+    std::size_t excluded = 0;
+    const double nameNs = nanosPerCall(names.size(), [&] {
+        for (const auto& name : names) excluded += policy.matchName(name) != nullptr;
+    });
+    const double pathNs = nanosPerCall(paths.size(), [&] {
+        for (const auto& path : paths) excluded += policy.matchPath(path) != nullptr;
+    });
+
+    // The previous code: a literal set lookup, then std::regex(pattern) per pattern per name.
+    const std::size_t naiveSamples = 20;
+    const double naiveNs = nanosPerCall(naiveSamples, [&] {
+        for (std::size_t i = 0; i < naiveSamples; ++i) {
+            for (const auto& pattern : regexes) {
+                if (std::regex_match(names[i], std::regex(pattern))) break;
+            }
+        }
+    });
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "Rules: " << policy.rules().size() << " (" << perKind << " each of literal, glob, prefix; "
+              << regexCount << " regex), compiled in " << compileMs.count() << " ms\n"
+              << "  matchName:            " << nameNs << " ns/name\n"
+              << "  matchPath:            " << pathNs << " ns/path\n"
+              << "  per-call std::regex:  " << naiveNs << " ns/name (regex rules only)\n"
+              << "  (" << excluded << " exclusions)\n";
+    return 0;
+}
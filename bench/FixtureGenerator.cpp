@@ -0,0 +1,190 @@
+// bench/FixtureGenerator.cpp
+#include "FixtureGenerator.hpp"
+#include "Process.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    const char* kStampName = "fixture.shape";
+
+    void writeFile(const std::filesystem::path& file, const std::string& contents) {
+        std::ofstream out(file, std::ios::binary);
+        out << contents;
+        if (!out) {
+            throw std::runtime_error("Could not write " + file.string());
+        }
+    }
+
+    std::string compiler() {
+        const char* cc = std::getenv("CC");
+        return cc && *cc ? cc : "cc";
+    }
+
+    void check(const std::vector<std::string>& command, const CommandResult& result) {
+        if (result.exitStatus != 0) {
+            throw std::runtime_error("Fixture build failed: " + Process::describe(command) + "\n" + result.errorOutput);
+        }
+    }
+
+    // Runs every command at once, bounded by the runner, and fails on the first error.
+    void runAll(ProcessRunner& runner, std::vector<std::vector<std::string>> commands) {
+        std::vector<std::future<CommandResult>> pending;
+        pending.reserve(commands.size());
+        for (const auto& command : commands) {
+            pending.push_back(runner.submit(command));
+        }
+        for (std::size_t i = 0; i < pending.size(); ++i) {
+            check(commands[i], pending[i].get());
+        }
+    }
+}
+
+std::string FixtureShape::key() const {
+    std::ostringstream out;
+    out << "n" << libraries << "-d" << depth << "-f" << fanout << "-s" << sharing << "-c" << cycles
+        << "-p" << payloadBytes << "-r" << extraRunpath << "-m" << mismatch << "-seed" << seed;
+    return out.str();
+}
+
+std::vector<FixtureGenerator::Library> FixtureGenerator::plan() const {
+    const std::size_t count = std::max<std::size_t>(1, m_shape.libraries);
+    std::size_t depth = m_shape.depth;
+    if (depth == 0) {
+        depth = std::max<std::size_t>(2, static_cast<std::size_t>(std::log10(static_cast<double>(count))) + 2);
+    }
+    depth = std::min(depth, count);
+
+    std::mt19937 rng(m_shape.seed);
+    std::vector<Library> libraries;
+    std::vector<std::vector<std::size_t>> layers(depth);
+    for (std::size_t i = 0; i < count; ++i) {
+        const std::size_t layer = i * depth / count;
+        const std::string stem = "libg" + std::to_string(i);
+        const bool mismatched = std::uniform_real_distribution<double>(0, 1)(rng) < m_shape.mismatch;
+        libraries.push_back({ layer, stem + ".so.1", mismatched ? stem + ".so.1." + std::to_string(i % 7) + ".0" : stem + ".so.1", {} });
+        layers[layer].push_back(i);
+    }
+
+    // The first `pool` libraries of the next layer are the candidates; higher sharing
+    // shrinks the pool, so more libraries converge on the same dependencies (diamonds).
+    for (std::size_t layer = 0; layer + 1 < depth; ++layer) {
+        const auto& next = layers[layer + 1];
+        const std::size_t fanout = std::min(m_shape.fanout, next.size());
+        const std::size_t pool = std::max<std::size_t>(
+            fanout, static_cast<std::size_t>(std::lround(next.size() * (1.0 - m_shape.sharing))));
+        for (std::size_t n = 0; n < layers[layer].size(); ++n) {
+            Library& library = libraries[layers[layer][n]];
+            for (std::size_t k = 0; k < fanout; ++k) {
+                library.needed.push_back(next[(n * fanout + k) % std::min(pool, next.size())]);
+            }
+            std::sort(library.needed.begin(), library.needed.end());
+            library.needed.erase(std::unique(library.needed.begin(), library.needed.end()), library.needed.end());
+        }
+    }
+
+    for (std::size_t c = 0; c < m_shape.cycles && depth > 1; ++c) {
+        const std::size_t from = std::uniform_int_distribution<std::size_t>(1, depth - 1)(rng);
+        const std::size_t to = std::uniform_int_distribution<std::size_t>(0, from - 1)(rng);
+        const std::size_t a = layers[from][rng() % layers[from].size()];
+        const std::size_t b = layers[to][rng() % layers[to].size()];
+        if (std::find(libraries[a].needed.begin(), libraries[a].needed.end(), b) == libraries[a].needed.end()) {
+            libraries[a].needed.push_back(b);
+        }
+    }
+    return libraries;
+}
+
+std::filesystem::path FixtureGenerator::generate(const std::filesystem::path& root, unsigned jobs) {
+    const std::filesystem::path top = root / "libroot.so";
+    {
+        std::ifstream stamp(root / kStampName);
+        std::string key;
+        if (std::getline(stamp, key) && key == m_shape.key() && std::filesystem::exists(top)) {
+            return top;
+        }
+    }
+
+    std::filesystem::remove_all(root);
+    const std::filesystem::path build = root / "build";
+    const std::filesystem::path stubs = build / "stubs";
+    std::filesystem::create_directories(stubs);
+
+    const std::vector<Library> libraries = plan();
+    std::size_t depth = 0;
+    for (const auto& library : libraries) {
+        depth = std::max(depth, library.layer + 1);
+    }
+    for (std::size_t layer = 0; layer < depth; ++layer) {
+        std::filesystem::create_directories(root / "lib" / ("L" + std::to_string(layer)));
+    }
+
+    // One payload object sized as requested, and one empty object for the stubs.
+    writeFile(build / "payload.c", "__attribute__((used)) const char relocator_payload["
+              + std::to_string(std::max<std::size_t>(1, m_shape.payloadBytes)) + "] = { 1 };\n"
+              "int relocator_fixture(void) { return relocator_payload[0]; }\n");
+    writeFile(build / "empty.c", "int relocator_fixture_stub;\n");
+
+    ProcessRunner runner(jobs);
+    const std::string cc = compiler();
+    runAll(runner, {
+        { cc, "-O0", "-fPIC", "-c", (build / "payload.c").string(), "-o", (build / "payload.o").string() },
+        { cc, "-O0", "-fPIC", "-c", (build / "empty.c").string(), "-o", (build / "empty.o").string() },
+    });
+
+    // Pass 1: stubs that only carry a soname, so pass 2 can link in any order.
+    std::vector<std::vector<std::string>> commands;
+    for (const auto& library : libraries) {
+        commands.push_back({ cc, "-shared", "-o", (stubs / library.soname).string(), (build / "empty.o").string(),
+                             "-Wl,-soname," + library.soname });
+    }
+    runAll(runner, std::move(commands));
+
+    // Every library searches the missing directories first, then each layer.
+    std::string runpath;
+    for (std::size_t i = 0; i < m_shape.extraRunpath; ++i) {
+        runpath += "$ORIGIN/../missing" + std::to_string(i) + ":";
+    }
+    for (std::size_t layer = 0; layer < depth; ++layer) {
+        runpath += "$ORIGIN/../L" + std::to_string(layer) + (layer + 1 < depth ? ":" : "");
+    }
+
+    // Pass 2: the real libraries, and the root library on top.
+    commands.clear();
+    auto linkNeeded = [&](std::vector<std::string>& command, const std::vector<std::size_t>& needed) {
+        command.insert(command.end(), { "-Wl,--no-as-needed", "-L" + stubs.string() });
+        for (std::size_t dep : needed) {
+            command.push_back("-l:" + libraries[dep].soname);
+        }
+    };
+    for (const auto& library : libraries) {
+        const std::filesystem::path dir = root / "lib" / ("L" + std::to_string(library.layer));
+        std::vector<std::string> command{ cc, "-shared", "-o", (dir / library.filename).string(),
+                                          (build / "payload.o").string(), "-Wl,-soname," + library.soname,
+                                          "-Wl,--enable-new-dtags", "-Wl,-rpath," + runpath };
+        linkNeeded(command, library.needed);
+        commands.push_back(std::move(command));
+        if (library.filename != library.soname) {
+            std::filesystem::create_symlink(library.filename, dir / library.soname);
+        }
+    }
+    std::vector<std::size_t> firstLayer;
+    for (std::size_t i = 0; i < libraries.size() && libraries[i].layer == 0; ++i) {
+        firstLayer.push_back(i);
+    }
+    std::vector<std::string> command{ cc, "-shared", "-o", top.string(), (build / "payload.o").string(),
+                                      "-Wl,-soname,libroot.so", "-Wl,--enable-new-dtags", "-Wl,-rpath,$ORIGIN/lib/L0" };
+    linkNeeded(command, firstLayer);
+    commands.push_back(std::move(command));
+    runAll(runner, std::move(commands));
+
+    std::filesystem::remove_all(build);
+    writeFile(root / kStampName, m_shape.key() + "\n");
+    return top;
+}
@@ -0,0 +1,70 @@
+// bench/FixtureGenerator.hpp
+#ifndef RELOCATOR_FIXTUREGENERATOR_HPP
+#define RELOCATOR_FIXTUREGENERATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * @struct FixtureShape
+ * @brief The shape of a synthetic dependency graph.
+ *
+ * Libraries are arranged in layers; each one needs `fanout` libraries of the next
+ * layer down, and a root library needs every library of the first layer.
+ */
+struct FixtureShape {
+    std::size_t libraries = 100;
+    std::size_t depth = 0;            // Layers; 0 picks one from the library count
+    std::size_t fanout = 3;           // DT_NEEDED entries per library into the next layer
+    double sharing = 0.5;             // 0 = dependencies spread over the whole next layer, 1 = all share the same few
+    std::size_t cycles = 0;           // Extra edges from a deeper layer back to a shallower one
+    std::size_t payloadBytes = 16 * 1024;
+    std::size_t extraRunpath = 8;     // Non-existent RUNPATH entries searched before the real ones
+    double mismatch = 0.25;           // Fraction of libraries whose file is libX.so.1.2.3 with a libX.so.1 symlink
+    std::uint32_t seed = 1;
+
+    /**
+     * A short, stable string naming the shape; fixtures are cached under it.
+     */
+    std::string key() const;
+};
+
+/**
+ * @class FixtureGenerator
+ * @brief Builds a synthetic tree of shared libraries with the local C compiler.
+ *
+ * The compiler is $CC, or "cc" if unset. Every library is linked from the same payload
+ * object, so generating thousands costs one link each rather than one compile each.
+ * Libraries are first linked as empty stubs carrying only their soname, then for real
+ * against the stubs, so cycles need no special ordering. Layout:
+ *   <root>/libroot.so        the root, the input to bundle
+ *   <root>/lib/L<n>/...      the libraries of layer n
+ */
+class FixtureGenerator {
+public:
+    explicit FixtureGenerator(FixtureShape shape) : m_shape(std::move(shape)) {}
+
+    /**
+     * Generates the fixture under root unless one of the same shape is already there.
+     * @return The root library to bundle.
+     * @throws std::runtime_error if the compiler or linker fails.
+     */
+    std::filesystem::path generate(const std::filesystem::path& root, unsigned jobs = 0);
+
+private:
+    struct Library {
+        std::size_t layer;
+        std::string soname;
+        std::string filename;
+        std::vector<std::size_t> needed;
+    };
+
+    std::vector<Library> plan() const;
+
+    FixtureShape m_shape;
+};
+
+#endif //RELOCATOR_FIXTUREGENERATOR_HPP
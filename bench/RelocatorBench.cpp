@@ -0,0 +1,154 @@
+// bench/RelocatorBench.cpp
+// Runs the relocator against generated dependency trees and reports the time of each
+// phase and the peak RSS, for a cold run (empty output and scan cache) and a warm,
+// incremental rerun.
+//
+//   relocator_bench --sizes 10,100,1000,10000
+//   relocator_bench --generate-only --sizes 500 --cycles 20 --work /tmp/fixtures
+#include "FixtureGenerator.hpp"
+#include "Process.hpp"
+
+#include "CLI/CLI.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef RELOCATOR_BINARY
+#define RELOCATOR_BINARY "relocator"
+#endif
+
+namespace {
+    struct Sample {
+        double totalSeconds = 0;
+        std::map<std::string, double> phaseSeconds;
+        std::uint64_t files = 0;    // Reached from the root; sharing can leave some libraries unused
+        std::uint64_t peakRssBytes = 0;
+    };
+
+    // Pulls a number out of the first "key": value after pos.
+    double numberAfter(const std::string& json, std::size_t pos, const std::string& key) {
+        pos = json.find("\"" + key + "\": ", pos);
+        return pos == std::string::npos ? 0.0 : std::stod(json.substr(pos + key.size() + 4));
+    }
+
+    // Pulls "name" and "wallSeconds" out of each phase of a --stats-json report.
+    std::map<std::string, double> phaseTimes(const std::string& json) {
+        std::map<std::string, double> times;
+        std::size_t pos = json.find("\"phases\"");
+        const std::string nameKey = "\"name\": \"";
+        const std::string wallKey = "\"wallSeconds\": ";
+        while (pos != std::string::npos && (pos = json.find(nameKey, pos)) != std::string::npos) {
+            pos += nameKey.size();
+            const std::string name = json.substr(pos, json.find('"', pos) - pos);
+            pos = json.find(wallKey, pos);
+            if (pos == std::string::npos) break;
+            times[name] = std::stod(json.substr(pos + wallKey.size()));
+        }
+        return times;
+    }
+
+    Sample runRelocator(const std::string& relocator, const std::filesystem::path& input,
+                        const std::filesystem::path& work, const std::vector<std::string>& extraArgs) {
+        const std::filesystem::path statsFile = work / "stats.json";
+        std::vector<std::string> command{ relocator, "-i", input.string(), "-o", (work / "out").string(),
+                                          "--scan-cache-dir", (work / "cache").string(),
+                                          "--stats-json", statsFile.string() };
+        command.insert(command.end(), extraArgs.begin(), extraArgs.end());
+        CommandResult result = Process::run(command);
+        if (result.exitStatus != 0) {
+            throw std::runtime_error(Process::describe(command) + " failed:\n" + result.errorOutput);
+        }
+        std::ifstream in(statsFile);
+        const std::string json((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        Sample sample;
+        sample.totalSeconds = result.wallSeconds;
+        sample.phaseSeconds = phaseTimes(json);
+        sample.files = static_cast<std::uint64_t>(numberAfter(json, json.find("\"phases\""), "files"));
+        sample.peakRssBytes = result.peakRssBytes;
+        return sample;
+    }
+
+    void printRow(const std::string& label, std::size_t libraries, const Sample& sample) {
+        std::cout << std::left << std::setw(8) << libraries << std::setw(6) << label << std::right
+                  << std::setw(8) << sample.files << std::fixed << std::setprecision(3);
+        for (const char* phase : { "discover", "copy", "fixup", "verify" }) {
+            auto it = sample.phaseSeconds.find(phase);
+            std::cout << std::setw(10) << (it != sample.phaseSeconds.end() ? it->second : 0.0);
+        }
+        std::cout << std::setw(10) << sample.totalSeconds << std::setw(10) << std::setprecision(1)
+                  << sample.peakRssBytes / (1024.0 * 1024.0) << "\n" << std::defaultfloat;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    CLI::App app{"Benchmarks the relocator on synthetic shared-library trees."};
+
+    std::vector<std::size_t> sizes{ 10, 100, 1000 };
+    app.add_option("--sizes", sizes, "Library counts to generate and bundle")->delimiter(',');
+    FixtureShape shape;
+    app.add_option("--depth", shape.depth, "Layers in the graph (0 = from the library count)");
+    app.add_option("--fanout", shape.fanout, "Dependencies each library has in the next layer");
+    app.add_option("--sharing", shape.sharing, "0..1; how strongly dependencies converge on the same libraries")
+       ->check(CLI::Range(0.0, 1.0));
+    app.add_option("--cycles", shape.cycles, "Back edges from deeper layers to shallower ones");
+    app.add_option("--payload", shape.payloadBytes, "Bytes of data in each library");
+    app.add_option("--extra-runpath", shape.extraRunpath, "Non-existent RUNPATH entries before the real ones");
+    app.add_option("--mismatch", shape.mismatch, "0..1; fraction of libraries whose filename differs from the soname")
+       ->check(CLI::Range(0.0, 1.0));
+    app.add_option("--seed", shape.seed, "Seed for the cycle and mismatch choices");
+
+    std::filesystem::path work = std::filesystem::temp_directory_path() / "relocator-bench";
+    app.add_option("--work", work, "Directory for fixtures and outputs; fixtures are reused across runs");
+    std::string relocator = RELOCATOR_BINARY;
+    app.add_option("--relocator", relocator, "The relocator binary to measure");
+    unsigned jobs = 0;
+    app.add_option("--build-jobs", jobs, "Parallel compiler/linker processes (0 = one per CPU)");
+    bool generateOnly = false;
+    app.add_flag("--generate-only", generateOnly, "Only generate the fixtures and print their paths");
+    std::string relocatorArgs;
+    app.add_option("--relocator-args", relocatorArgs, "Extra arguments for every relocator run, e.g. \"-j 8\"");
+
+    CLI11_PARSE(app, argc, argv);
+    std::vector<std::string> extraArgs;
+    std::istringstream words(relocatorArgs);
+    for (std::string word; words >> word;) {
+        extraArgs.push_back(word);
+    }
+
+    try {
+        if (!generateOnly) {
+            std::cout << std::left << std::setw(8) << "libs" << std::setw(6) << "run" << std::right << std::setw(8) << "files";
+            for (const char* column : { "discover", "copy", "fixup", "verify", "total s", "RSS MiB" }) {
+                std::cout << std::setw(10) << column;
+            }
+            std::cout << "\n";
+        }
+        for (std::size_t size : sizes) {
+            shape.libraries = size;
+            const std::filesystem::path fixtureDir = work / shape.key();
+            const std::filesystem::path input = FixtureGenerator(shape).generate(fixtureDir / "fixture", jobs);
+            if (generateOnly) {
+                std::cout << input.string() << "\n";
+                continue;
+            }
+
+            // Cold: nothing bundled yet and nothing cached. Warm: the same run again.
+            std::filesystem::remove_all(fixtureDir / "out");
+            std::filesystem::remove_all(fixtureDir / "cache");
+            std::filesystem::create_directories(fixtureDir / "out");
+            printRow("cold", size, runRelocator(relocator, input, fixtureDir, extraArgs));
+            printRow("warm", size, runRelocator(relocator, input, fixtureDir, extraArgs));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
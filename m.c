@@ -0,0 +1,2 @@
+int a_fn(void);
+int main(void){return a_fn()-1;}
@@ -0,0 +1,234 @@
+// src/BundleManifest.cpp
+#include "BundleManifest.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+namespace {
+    constexpr const char* kHeader = "relocator-manifest 1";
+
+    // A word-at-a-time 64-bit hash; fast enough to hash a whole library tree on every run.
+    class Hasher {
+    public:
+        void update(const std::uint8_t* data, std::size_t size) {
+            m_length += size;
+            while (m_pendingSize == 0 && size >= sizeof(std::uint64_t)) {
+                std::uint64_t word;
+                std::memcpy(&word, data, sizeof(word));
+                mix(word);
+                data += sizeof(word);
+                size -= sizeof(word);
+            }
+            while (size > 0) {
+                const std::size_t take = std::min(size, sizeof(m_pending) - m_pendingSize);
+                std::memcpy(m_pending + m_pendingSize, data, take);
+                m_pendingSize += take;
+                data += take;
+                size -= take;
+                if (m_pendingSize == sizeof(m_pending)) {
+                    std::uint64_t word;
+                    std::memcpy(&word, m_pending, sizeof(word));
+                    mix(word);
+                    m_pendingSize = 0;
+                }
+            }
+        }
+
+        std::uint64_t finish() {
+            std::uint64_t word = 0;
+            std::memcpy(&word, m_pending, m_pendingSize);
+            mix(word ^ m_length);
+            std::uint64_t h = m_state;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            h ^= h >> 33;
+            return h;
+        }
+
+    private:
+        void mix(std::uint64_t word) {
+            word *= 0x87c37b91114253d5ULL;
+            word = (word << 31) | (word >> 33);
+            m_state ^= word * 0x4cf5ad432745937fULL;
+            m_state = ((m_state << 27) | (m_state >> 37)) * 5 + 0x52dce729;
+        }
+
+        std::uint64_t m_state = 0x9e3779b97f4a7c15ULL;
+        std::uint64_t m_length = 0;
+        std::uint8_t m_pending[8] = {};
+        std::size_t m_pendingSize = 0;
+    };
+
+    // Paths are stored one field per tab-separated column, so tabs, newlines and '%' are escaped.
+    std::string escape(const std::string& value) {
+        std::string out;
+        for (char c : value) {
+            switch (c) {
+                case '%':  out += "%25"; break;
+                case '\t': out += "%09"; break;
+                case '\n': out += "%0A"; break;
+                default:   out += c;
+            }
+        }
+        return out;
+    }
+
+    std::string unescape(const std::string& value) {
+        std::string out;
+        for (size_t i = 0; i < value.size(); ++i) {
+            if (value[i] == '%' && i + 2 < value.size()) {
+                out += static_cast<char>(std::stoul(value.substr(i + 1, 2), nullptr, 16));
+                i += 2;
+            } else {
+                out += value[i];
+            }
+        }
+        return out;
+    }
+
+    void writeIdentity(std::ostream& out, const FileIdentity& id) {
+        out << '\t' << id.device << '\t' << id.inode << '\t' << id.size << '\t' << id.mtimeNs;
+    }
+
+    bool readIdentity(std::istream& in, FileIdentity& id) {
+        return static_cast<bool>(in >> id.device >> id.inode >> id.size >> id.mtimeNs);
+    }
+}
+
+void BundleManifest::load(const std::filesystem::path& outputDir) {
+    std::ifstream in(outputDir / kFileName);
+    std::string line;
+    if (!in || !std::getline(in, line) || line != kHeader) {
+        return;
+    }
+
+    std::map<std::string, ManifestEntry> entries;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string name, source;
+        ManifestEntry entry;
+        if (!std::getline(fields, name, '\t') || !std::getline(fields, source, '\t')
+            || !readIdentity(fields, entry.sourceId)
+            || !(fields >> std::hex >> entry.contentHash >> entry.fixupHash >> std::dec)
+            || !readIdentity(fields, entry.outputId)) {
+            // A damaged manifest is ignored as a whole; the next run rebuilds everything.
+            return;
+        }
+        try {
+            entry.name = unescape(name);
+            entry.source = unescape(source);
+        } catch (const std::exception&) {
+            return;
+        }
+        entries[entry.name] = entry;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_previous = std::move(entries);
+}
+
+FileIdentity BundleManifest::identify(const std::filesystem::path& file) {
+    FileIdentity id;
+#if defined(_WIN32)
+    std::error_code ec;
+    id.size = std::filesystem::file_size(file, ec);
+    id.mtimeNs = std::filesystem::last_write_time(file, ec).time_since_epoch().count();
+#else
+    struct stat st{};
+    if (::stat(file.c_str(), &st) != 0) {
+        return id;
+    }
+    id.device = static_cast<std::uint64_t>(st.st_dev);
+    id.inode = static_cast<std::uint64_t>(st.st_ino);
+    id.size = static_cast<std::uint64_t>(st.st_size);
+#if defined(__APPLE__)
+    id.mtimeNs = static_cast<std::int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    id.mtimeNs = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+    return id;
+}
+
+std::uint64_t BundleManifest::hashFile(const std::filesystem::path& file) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Could not open file: " + file.string());
+    }
+    Hasher hasher;
+    std::vector<char> buffer(1 << 20);
+    while (in) {
+        in.read(buffer.data(), buffer.size());
+        hasher.update(reinterpret_cast<const std::uint8_t*>(buffer.data()), static_cast<std::size_t>(in.gcount()));
+    }
+    if (in.bad()) {
+        throw std::runtime_error("Could not read file: " + file.string());
+    }
+    return hasher.finish();
+}
+
+std::uint64_t BundleManifest::hashBytes(const void* data, std::size_t size) {
+    Hasher hasher;
+    hasher.update(static_cast<const std::uint8_t*>(data), size);
+    return hasher.finish();
+}
+
+std::optional<ManifestEntry> BundleManifest::find(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_previous.find(name);
+    if (it == m_previous.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void BundleManifest::record(const ManifestEntry& entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_current[entry.name] = entry;
+}
+
+std::vector<ManifestEntry> BundleManifest::stale() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<ManifestEntry> result;
+    for (const auto& [name, entry] : m_previous) {
+        if (!m_current.count(name)) {
+            result.push_back(entry);
+        }
+    }
+    return result;
+}
+
+void BundleManifest::save(const std::filesystem::path& outputDir) const {
+    const std::filesystem::path target = outputDir / kFileName;
+    std::filesystem::path temp = target;
+    temp += ".tmp";
+    {
+        std::ofstream out(temp, std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Could not write manifest: " + temp.string());
+        }
+        out << kHeader << '\n';
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& [name, entry] : m_current) {
+            out << escape(entry.name) << '\t' << escape(entry.source.string());
+            writeIdentity(out, entry.sourceId);
+            out << '\t' << std::hex << entry.contentHash << '\t' << entry.fixupHash << std::dec;
+            writeIdentity(out, entry.outputId);
+            out << '\n';
+        }
+        if (!out) {
+            throw std::runtime_error("Could not write manifest: " + temp.string());
+        }
+    }
+    std::filesystem::rename(temp, target);
+}
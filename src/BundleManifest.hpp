@@ -0,0 +1,92 @@
+// src/BundleManifest.hpp
+#ifndef RELOCATOR_BUNDLEMANIFEST_HPP
+#define RELOCATOR_BUNDLEMANIFEST_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @struct FileIdentity
+ * @brief The cheap-to-read facts that change whenever a file's contents are replaced.
+ */
+struct FileIdentity {
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+    std::uint64_t size = 0;
+    std::int64_t mtimeNs = 0;
+
+    bool operator==(const FileIdentity& other) const {
+        return device == other.device && inode == other.inode && size == other.size && mtimeNs == other.mtimeNs;
+    }
+    bool operator!=(const FileIdentity& other) const { return !(*this == other); }
+};
+
+/**
+ * @struct ManifestEntry
+ * @brief What the relocator put at one path in the output directory, and from what.
+ */
+struct ManifestEntry {
+    std::string name;                   // Filename inside the output directory
+    std::filesystem::path source;       // Canonical path of the original
+    FileIdentity sourceId;
+    std::uint64_t contentHash = 0;      // BundleManifest::hashFile of the original
+    std::uint64_t fixupHash = 0;        // Fingerprint of the edits applied to the copy
+    FileIdentity outputId;              // The bundled file as it was left
+};
+
+/**
+ * @class BundleManifest
+ * @brief Records each bundled file so later runs only redo entries whose inputs changed.
+ *
+ * The manifest is a tab-separated text file in the output directory. Entries from the
+ * previous run are looked up with find(); entries for this run are added with record()
+ * (thread-safe), and anything that was not recorded again is reported by stale().
+ */
+class BundleManifest {
+public:
+    static constexpr const char* kFileName = ".relocator-manifest";
+
+    /**
+     * Reads the previous run's manifest from outputDir. A missing or unreadable manifest
+     * leaves the previous run empty, so everything is rebuilt.
+     */
+    void load(const std::filesystem::path& outputDir);
+
+    /**
+     * @return The identity of a file, or an all-zero identity if it cannot be read.
+     */
+    static FileIdentity identify(const std::filesystem::path& file);
+
+    /**
+     * A fast non-cryptographic 64-bit hash of a file's contents.
+     * @throws std::runtime_error if the file cannot be read.
+     */
+    static std::uint64_t hashFile(const std::filesystem::path& file);
+
+    static std::uint64_t hashBytes(const void* data, std::size_t size);
+
+    std::optional<ManifestEntry> find(const std::string& name) const;
+    void record(const ManifestEntry& entry);
+
+    /**
+     * @return Entries from the previous run that were not recorded in this one.
+     */
+    std::vector<ManifestEntry> stale() const;
+
+    /**
+     * Atomically replaces the manifest in outputDir with the entries recorded in this run.
+     */
+    void save(const std::filesystem::path& outputDir) const;
+
+private:
+    std::map<std::string, ManifestEntry> m_previous;
+    std::map<std::string, ManifestEntry> m_current;
+    mutable std::mutex m_mutex;
+};
+
+#endif //RELOCATOR_BUNDLEMANIFEST_HPP
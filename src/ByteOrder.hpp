@@ -0,0 +1,76 @@
+// src/ByteOrder.hpp
+#ifndef RELOCATOR_BYTEORDER_HPP
+#define RELOCATOR_BYTEORDER_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+
+/**
+ * @namespace ByteOrder
+ * @brief Helpers for reading and writing fixed-width integers in a given byte order.
+ *
+ * Object file formats are parsed from raw bytes rather than by casting to
+ * structs, so that foreign-endian files can be handled on any host.
+ */
+namespace ByteOrder {
+
+    inline constexpr bool hostIsBigEndian() {
+#if defined(_MSC_VER)
+        return false;   // Every Windows target is little-endian
+#else
+        return __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+#endif
+    }
+
+    template <typename T>
+    inline T swap(T value) {
+        static_assert(std::is_integral<T>::value, "ByteOrder::swap requires an integral type");
+        if constexpr (sizeof(T) == 1) {
+            return value;
+#if defined(_MSC_VER)
+        } else if constexpr (sizeof(T) == 2) {
+            return static_cast<T>(_byteswap_ushort(static_cast<std::uint16_t>(value)));
+        } else if constexpr (sizeof(T) == 4) {
+            return static_cast<T>(_byteswap_ulong(static_cast<std::uint32_t>(value)));
+        } else {
+            return static_cast<T>(_byteswap_uint64(static_cast<std::uint64_t>(value)));
+        }
+#else
+        } else if constexpr (sizeof(T) == 2) {
+            return static_cast<T>(__builtin_bswap16(static_cast<std::uint16_t>(value)));
+        } else if constexpr (sizeof(T) == 4) {
+            return static_cast<T>(__builtin_bswap32(static_cast<std::uint32_t>(value)));
+        } else {
+            return static_cast<T>(__builtin_bswap64(static_cast<std::uint64_t>(value)));
+        }
+#endif
+    }
+
+    /**
+     * Loads a T from (possibly unaligned) memory stored with the given byte order.
+     */
+    template <typename T>
+    inline T load(const void* src, bool bigEndian) {
+        T value;
+        std::memcpy(&value, src, sizeof(T));
+        return bigEndian == hostIsBigEndian() ? value : swap(value);
+    }
+
+    /**
+     * Stores a T to (possibly unaligned) memory using the given byte order.
+     */
+    template <typename T>
+    inline void store(void* dst, T value, bool bigEndian) {
+        if (bigEndian != hostIsBigEndian()) {
+            value = swap(value);
+        }
+        std::memcpy(dst, &value, sizeof(T));
+    }
+
+} // namespace ByteOrder
+
+#endif //RELOCATOR_BYTEORDER_HPP
@@ -0,0 +1,58 @@
+// src/ConcurrentSet.hpp
+#ifndef RELOCATOR_CONCURRENTSET_HPP
+#define RELOCATOR_CONCURRENTSET_HPP
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+/**
+ * @class ConcurrentSet
+ * @brief A set of strings safe for concurrent insertion, sharded to keep lock contention low.
+ */
+class ConcurrentSet {
+public:
+    /**
+     * Inserts a key.
+     * @return true if this call inserted it, false if it was already present.
+     */
+    bool insert(const std::string& key) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.keys.insert(key).second;
+    }
+
+    bool contains(const std::string& key) const {
+        const Shard& shard = const_cast<ConcurrentSet*>(this)->shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.keys.count(key) != 0;
+    }
+
+    std::size_t size() const {
+        std::size_t total = 0;
+        for (const auto& shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.keys.size();
+        }
+        return total;
+    }
+
+private:
+    static constexpr std::size_t kShards = 64;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_set<std::string> keys;
+    };
+
+    Shard& shardFor(const std::string& key) {
+        return m_shards[std::hash<std::string>{}(key) % kShards];
+    }
+
+    std::array<Shard, kShards> m_shards;
+};
+
+#endif //RELOCATOR_CONCURRENTSET_HPP
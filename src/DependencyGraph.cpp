@@ -0,0 +1,337 @@
+// src/DependencyGraph.cpp
+#include "DependencyGraph.hpp"
+#include "Json.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <stdexcept>
+
+void DependencyGraph::markRoot(NodeId node) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (std::find(m_roots.begin(), m_roots.end(), node) == m_roots.end()) {
+        m_roots.push_back(node);
+    }
+}
+
+void DependencyGraph::mergeEdges(NodeId from, const std::vector<Edge>& edges) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_frozen.load(std::memory_order_relaxed)) {
+        throw std::logic_error("DependencyGraph: edges merged after freeze()");
+    }
+    if (m_pending.size() <= from) {
+        m_pending.resize(from + 1);
+    }
+    std::vector<Edge>& list = m_pending[from];
+    for (const Edge& edge : edges) {
+        const std::string& edgeName = m_names[edge.name];
+        auto it = std::lower_bound(list.begin(), list.end(), edgeName,
+                                   [&](const Edge& e, const std::string& n) { return m_names[e.name] < n; });
+        if (it == list.end() || it->name != edge.name) {
+            list.insert(it, edge);
+        } else if (m_paths[edge.target] < m_paths[it->target]) {
+            it->target = edge.target;
+        }
+    }
+}
+
+std::vector<DependencyGraph::Edge> DependencyGraph::edgesOf(NodeId node) const {
+    if (m_frozen.load(std::memory_order_acquire)) {
+        Range<Edge> range = dependencies(node);
+        return { range.begin(), range.end() };
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_frozen.load(std::memory_order_relaxed)) {
+        Range<Edge> range = dependencies(node);
+        return { range.begin(), range.end() };
+    }
+    return node < m_pending.size() ? m_pending[node] : std::vector<Edge>();
+}
+
+void DependencyGraph::freeze() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_frozen.load(std::memory_order_relaxed)) {
+        return;
+    }
+    const std::size_t count = m_paths.size();
+    if (count > std::numeric_limits<std::uint32_t>::max() - 1) {
+        throw std::runtime_error("Dependency graph has too many files");
+    }
+    m_pending.resize(count);
+
+    m_offsets.assign(count + 1, 0);
+    std::size_t edgeCount = 0;
+    for (NodeId node = 0; node < count; ++node) {
+        m_offsets[node] = static_cast<std::uint32_t>(edgeCount);
+        edgeCount += m_pending[node].size();
+    }
+    m_offsets[count] = static_cast<std::uint32_t>(edgeCount);
+    m_edges.clear();
+    m_edges.reserve(edgeCount);
+    for (auto& list : m_pending) {
+        m_edges.insert(m_edges.end(), list.begin(), list.end());
+    }
+    std::vector<std::vector<Edge>>().swap(m_pending);
+
+    // Reverse lists are filled in path order of the dependents, so they come out sorted.
+    m_reverseOffsets.assign(count + 1, 0);
+    for (const Edge& edge : m_edges) {
+        ++m_reverseOffsets[edge.target + 1];
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        m_reverseOffsets[i + 1] += m_reverseOffsets[i];
+    }
+    m_reverse.assign(edgeCount, 0);
+    std::vector<std::uint32_t> fill(m_reverseOffsets.begin(), m_reverseOffsets.end() - 1);
+    std::vector<NodeId> ordered(count);
+    for (NodeId node = 0; node < count; ++node) {
+        ordered[node] = node;
+    }
+    std::sort(ordered.begin(), ordered.end(), [&](NodeId a, NodeId b) { return m_paths[a] < m_paths[b]; });
+    for (NodeId node : ordered) {
+        for (std::uint32_t i = m_offsets[node]; i < m_offsets[node + 1]; ++i) {
+            const NodeId target = m_edges[i].target;
+            // A file listing the same library under two names still depends on it once.
+            if (fill[target] == m_reverseOffsets[target] || m_reverse[fill[target] - 1] != node) {
+                m_reverse[fill[target]++] = node;
+            }
+        }
+    }
+    // Compact away the slots left by duplicate (dependent, target) pairs.
+    std::size_t out = 0;
+    for (std::size_t node = 0; node < count; ++node) {
+        const std::uint32_t begin = m_reverseOffsets[node];
+        m_reverseOffsets[node] = static_cast<std::uint32_t>(out);
+        for (std::uint32_t i = begin; i < fill[node]; ++i) {
+            m_reverse[out++] = m_reverse[i];
+        }
+    }
+    m_reverseOffsets[count] = static_cast<std::uint32_t>(out);
+    m_reverse.resize(out);
+
+    m_isRoot.assign(count, 0);
+    for (NodeId root : m_roots) {
+        m_isRoot[root] = 1;
+    }
+    m_frozen.store(true, std::memory_order_release);
+}
+
+void DependencyGraph::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_paths.clear();
+    m_names.clear();
+    m_pending.clear();
+    m_roots.clear();
+    m_offsets.clear();
+    m_edges.clear();
+    m_reverseOffsets.clear();
+    m_reverse.clear();
+    m_isRoot.clear();
+    m_frozen.store(false);
+}
+
+bool DependencyGraph::isRoot(NodeId node) const {
+    if (m_frozen.load(std::memory_order_acquire)) {
+        return m_isRoot[node] != 0;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::find(m_roots.begin(), m_roots.end(), node) != m_roots.end();
+}
+
+std::vector<DependencyGraph::NodeId> DependencyGraph::roots() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_roots;
+}
+
+std::vector<DependencyGraph::NodeId> DependencyGraph::nodesByPath() const {
+    std::vector<NodeId> nodes(size());
+    for (NodeId node = 0; node < nodes.size(); ++node) {
+        nodes[node] = node;
+    }
+    std::sort(nodes.begin(), nodes.end(), [&](NodeId a, NodeId b) { return m_paths[a] < m_paths[b]; });
+    return nodes;
+}
+
+DependencyGraph::Range<DependencyGraph::Edge> DependencyGraph::dependencies(NodeId node) const {
+    if (!m_frozen.load(std::memory_order_acquire)) {
+        throw std::logic_error("DependencyGraph: dependencies() before freeze()");
+    }
+    return { m_edges.data() + m_offsets[node], m_edges.data() + m_offsets[node + 1] };
+}
+
+DependencyGraph::Range<DependencyGraph::NodeId> DependencyGraph::dependents(NodeId node) const {
+    if (!m_frozen.load(std::memory_order_acquire)) {
+        throw std::logic_error("DependencyGraph: dependents() before freeze()");
+    }
+    return { m_reverse.data() + m_reverseOffsets[node], m_reverse.data() + m_reverseOffsets[node + 1] };
+}
+
+std::vector<DependencyGraph::NodeId> DependencyGraph::topologicalOrder() const {
+    // Tarjan's algorithm, iteratively: it emits each strongly connected component only
+    // after every component it reaches, which is dependencies-first.
+    constexpr std::uint32_t kUnvisited = std::numeric_limits<std::uint32_t>::max();
+    const std::size_t count = size();
+    std::vector<std::uint32_t> index(count, kUnvisited), low(count, 0);
+    std::vector<char> onStack(count, 0);
+    std::vector<NodeId> stack, order;
+    order.reserve(count);
+    std::vector<std::pair<NodeId, std::uint32_t>> frames;   // (node, next edge to follow)
+    std::uint32_t nextIndex = 0;
+
+    for (NodeId start : nodesByPath()) {
+        if (index[start] != kUnvisited) {
+            continue;
+        }
+        frames.emplace_back(start, m_offsets[start]);
+        index[start] = low[start] = nextIndex++;
+        stack.push_back(start);
+        onStack[start] = 1;
+
+        while (!frames.empty()) {
+            auto& [node, edge] = frames.back();
+            if (edge < m_offsets[node + 1]) {
+                const NodeId target = m_edges[edge++].target;
+                if (index[target] == kUnvisited) {
+                    index[target] = low[target] = nextIndex++;
+                    stack.push_back(target);
+                    onStack[target] = 1;
+                    frames.emplace_back(target, m_offsets[target]);
+                } else if (onStack[target]) {
+                    low[node] = std::min(low[node], index[target]);
+                }
+                continue;
+            }
+
+            const NodeId finished = node;
+            frames.pop_back();
+            if (!frames.empty()) {
+                low[frames.back().first] = std::min(low[frames.back().first], low[finished]);
+            }
+            if (low[finished] == index[finished]) {
+                const std::size_t first = order.size();
+                NodeId member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack[member] = 0;
+                    order.push_back(member);
+                } while (member != finished);
+                std::sort(order.begin() + first, order.end(),
+                          [&](NodeId a, NodeId b) { return m_paths[a] < m_paths[b]; });
+            }
+        }
+    }
+    return order;
+}
+
+std::vector<DependencyGraph::NodeId> DependencyGraph::chainFromRoot(NodeId node) const {
+    // Breadth-first over the reverse edges, so the first root found is a closest one.
+    constexpr NodeId kNone = std::numeric_limits<NodeId>::max();
+    std::vector<NodeId> towardNode(size(), kNone);
+    std::deque<NodeId> queue{ node };
+    towardNode[node] = node;
+    while (!queue.empty()) {
+        NodeId current = queue.front();
+        queue.pop_front();
+        if (isRoot(current)) {
+            std::vector<NodeId> chain{ current };
+            while (current != node) {
+                current = towardNode[current];
+                chain.push_back(current);
+            }
+            return chain;
+        }
+        for (NodeId dependent : dependents(current)) {
+            if (towardNode[dependent] == kNone) {
+                towardNode[dependent] = current;
+                queue.push_back(dependent);
+            }
+        }
+    }
+    return {};
+}
+
+void DependencyGraph::explain(std::ostream& out, const std::string& query) const {
+    bool found = false;
+    for (NodeId node : nodesByPath()) {
+        bool matches = path(node).filename() == query;
+        for (NodeId dependent : dependents(node)) {
+            for (const auto& edge : dependencies(dependent)) {
+                matches |= edge.target == node && name(edge.name) == query;
+            }
+        }
+        if (!matches) {
+            continue;
+        }
+        found = true;
+        out << "\nWhy " << path(node) << " is bundled:\n";
+        if (isRoot(node)) {
+            out << "  It is an input.\n";
+        }
+        for (NodeId dependent : dependents(node)) {
+            out << "  Needed by " << path(dependent) << "\n";
+        }
+        const std::vector<NodeId> chain = chainFromRoot(node);
+        if (chain.size() > 1) {
+            out << "  Shortest chain: ";
+            for (size_t i = 0; i < chain.size(); ++i) {
+                out << (i ? " -> " : "") << path(chain[i]).filename().string();
+            }
+            out << "\n";
+        }
+    }
+    if (!found) {
+        out << "\n" << query << " is not in the bundle.\n";
+    }
+}
+
+void DependencyGraph::writeDot(std::ostream& out) const {
+    // DOT string literals follow the same escaping rules as JSON for everything we emit.
+    out << "digraph relocator {\n"
+        << "  rankdir=LR;\n"
+        << "  node [shape=box, fontname=\"Helvetica\"];\n";
+    for (NodeId node : nodesByPath()) {
+        out << "  n" << node << " [label=" << Json::quote(path(node).filename().string())
+            << ", tooltip=" << Json::quote(path(node).string()) << (isRoot(node) ? ", style=bold" : "") << "];\n";
+    }
+    for (NodeId node : nodesByPath()) {
+        for (const Edge& edge : dependencies(node)) {
+            out << "  n" << node << " -> n" << edge.target;
+            if (name(edge.name) != path(edge.target).filename().string()) {
+                out << " [label=" << Json::quote(name(edge.name)) << "]";
+            }
+            out << ";\n";
+        }
+    }
+    out << "}\n";
+}
+
+void DependencyGraph::writeJson(std::ostream& out) const {
+    const std::vector<NodeId> nodes = nodesByPath();
+    std::vector<std::uint32_t> position(nodes.size());
+    for (std::uint32_t i = 0; i < nodes.size(); ++i) {
+        position[nodes[i]] = i;
+    }
+
+    out << "{\n  \"version\": 1,\n  \"nodes\": [";
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        out << (i ? "," : "") << "\n    {\"path\": " << Json::quote(path(nodes[i]).string())
+            << ", \"root\": " << (isRoot(nodes[i]) ? "true" : "false")
+            << ", \"dependents\": " << dependents(nodes[i]).size() << "}";
+    }
+    out << "\n  ],\n  \"edges\": [";
+    bool first = true;
+    for (NodeId node : nodes) {
+        for (const Edge& edge : dependencies(node)) {
+            out << (first ? "" : ",") << "\n    {\"from\": " << position[node] << ", \"to\": " << position[edge.target]
+                << ", \"name\": " << Json::quote(name(edge.name)) << "}";
+            first = false;
+        }
+    }
+    out << "\n  ],\n  \"topologicalOrder\": [";
+    const std::vector<NodeId> order = topologicalOrder();
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        out << (i ? ", " : "") << position[order[i]];
+    }
+    out << "]\n}\n";
+}
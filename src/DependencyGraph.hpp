@@ -0,0 +1,250 @@
+// src/DependencyGraph.hpp
+#ifndef RELOCATOR_DEPENDENCYGRAPH_HPP
+#define RELOCATOR_DEPENDENCYGRAPH_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @class InternTable
+ * @brief Append-only storage that gives each distinct value a dense 32-bit id.
+ *
+ * Values live in chunks that double in size and never move, so operator[] needs no
+ * lock and may run while other threads intern. intern() and find() take a mutex.
+ */
+template <typename Value>
+class InternTable {
+public:
+    using Id = std::uint32_t;
+
+    InternTable() = default;
+    ~InternTable() { clear(); }
+    InternTable(const InternTable&) = delete;
+    InternTable& operator=(const InternTable&) = delete;
+
+    /**
+     * @return The value's id, and whether this call added it.
+     */
+    std::pair<Id, bool> intern(const Value& value) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_index.find(keyOf(value));
+        if (it != m_index.end()) {
+            return { it->second, false };
+        }
+        const Id id = m_size.load(std::memory_order_relaxed);
+        const auto [chunk, offset] = locate(id);
+        if (!m_chunks[chunk].load(std::memory_order_relaxed)) {
+            m_chunks[chunk].store(new Value[kFirstChunk << chunk], std::memory_order_release);
+        }
+        Value& slot = m_chunks[chunk].load(std::memory_order_relaxed)[offset];
+        slot = value;
+        m_index.emplace(keyOf(slot), id);
+        m_size.store(id + 1, std::memory_order_release);
+        return { id, true };
+    }
+
+    std::optional<Id> find(const Value& value) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_index.find(keyOf(value));
+        return it != m_index.end() ? std::optional<Id>(it->second) : std::nullopt;
+    }
+
+    /**
+     * @param id An id returned by intern(), possibly on another thread.
+     */
+    const Value& operator[](Id id) const {
+        const auto [chunk, offset] = locate(id);
+        return m_chunks[chunk].load(std::memory_order_acquire)[offset];
+    }
+
+    std::size_t size() const { return m_size.load(std::memory_order_acquire); }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_index.clear();
+        for (auto& chunk : m_chunks) {
+            delete[] chunk.exchange(nullptr);
+        }
+        m_size.store(0);
+    }
+
+private:
+    static constexpr std::size_t kFirstChunkBits = 10;
+    static constexpr std::size_t kFirstChunk = std::size_t(1) << kFirstChunkBits;
+    static constexpr std::size_t kChunks = 32 - kFirstChunkBits;   // Enough for every 32-bit id
+
+    // Chunk c holds ids [kFirstChunk * (2^c - 1), kFirstChunk * (2^(c+1) - 1)).
+    static std::pair<std::size_t, std::size_t> locate(Id id) {
+        const std::uint64_t biased = std::uint64_t(id) + kFirstChunk;
+        std::size_t bit = kFirstChunkBits;
+        while (biased >> (bit + 1)) {
+            ++bit;
+        }
+        return { bit - kFirstChunkBits, static_cast<std::size_t>(biased - (std::uint64_t(1) << bit)) };
+    }
+
+    static std::string_view keyOf(const std::string& value) { return value; }
+    static std::basic_string_view<std::filesystem::path::value_type> keyOf(const std::filesystem::path& value) {
+        return value.native();
+    }
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<decltype(keyOf(std::declval<const Value&>())), Id> m_index;   // Views into the chunks
+    std::array<std::atomic<Value*>, kChunks> m_chunks{};
+    std::atomic<Id> m_size{0};
+};
+
+/**
+ * @class DependencyGraph
+ * @brief The files of one bundle and the sonames (or install names) linking them.
+ *
+ * Paths and sonames are interned once; nodes and names are dense 32-bit ids. While
+ * discovery runs, threads add nodes and merge edges concurrently and may read any
+ * node's edges back. freeze() then packs the graph into flat CSR arrays, forward and
+ * reverse, for the queries and exports that need the whole graph.
+ */
+class DependencyGraph {
+public:
+    using NodeId = std::uint32_t;
+    using NameId = std::uint32_t;
+
+    struct Edge {
+        NameId name;      // The soname or install name the file asked for
+        NodeId target;    // The file it resolved to
+    };
+
+    /**
+     * A view of a contiguous run of a frozen graph's arrays.
+     */
+    template <typename T>
+    struct Range {
+        const T* first = nullptr;
+        const T* last = nullptr;
+        const T* begin() const { return first; }
+        const T* end() const { return last; }
+        std::size_t size() const { return static_cast<std::size_t>(last - first); }
+        bool empty() const { return first == last; }
+    };
+
+    DependencyGraph() = default;
+    DependencyGraph(const DependencyGraph&) = delete;
+    DependencyGraph& operator=(const DependencyGraph&) = delete;
+
+    // --- Building; all thread-safe ---
+
+    /**
+     * @return The node for file, adding it if needed. The path should be canonical.
+     */
+    NodeId addNode(const std::filesystem::path& file) { return m_paths.intern(file).first; }
+    NameId addName(const std::string& name) { return m_names.intern(name).first; }
+
+    /**
+     * Marks a node as one of the inputs the user asked to bundle.
+     */
+    void markRoot(NodeId node);
+
+    /**
+     * Merges edges into a node's list. When a name is already bound to a different
+     * file (different RPATH chains can disagree), the smaller path wins, so the result
+     * does not depend on which thread got there first.
+     */
+    void mergeEdges(NodeId from, const std::vector<Edge>& edges);
+
+    /**
+     * @return A copy of a node's edges, ordered by name. Safe during discovery.
+     */
+    std::vector<Edge> edgesOf(NodeId node) const;
+
+    /**
+     * Packs the edges into CSR arrays and builds the reverse adjacency. Call once
+     * discovery is finished; edgesOf() keeps working, and merging is no longer allowed.
+     */
+    void freeze();
+
+    /**
+     * Forgets everything, ready for another run.
+     */
+    void clear();
+
+    // --- Lookups; O(1), lock-free for ids already handed out ---
+
+    std::size_t size() const { return m_paths.size(); }
+    const std::filesystem::path& path(NodeId node) const { return m_paths[node]; }
+    const std::string& name(NameId name) const { return m_names[name]; }
+    std::optional<NodeId> find(const std::filesystem::path& file) const { return m_paths.find(file); }
+    bool isRoot(NodeId node) const;
+    std::vector<NodeId> roots() const;
+
+    /**
+     * @return Every node, ordered by path; the order to use wherever output must be stable across runs.
+     */
+    std::vector<NodeId> nodesByPath() const;
+
+    // --- Whole-graph queries; require freeze() ---
+
+    Range<Edge> dependencies(NodeId node) const;
+
+    /**
+     * @return The nodes that directly need this one.
+     */
+    Range<NodeId> dependents(NodeId node) const;
+
+    /**
+     * @return Every node, each after all of its dependencies. The members of a cycle
+     *         are kept together, in path order.
+     */
+    std::vector<NodeId> topologicalOrder() const;
+
+    /**
+     * Answers "why is this file bundled?".
+     * @return A shortest chain from a root to node, root first; empty if no root reaches it.
+     */
+    std::vector<NodeId> chainFromRoot(NodeId node) const;
+
+    /**
+     * Prints, for each file whose filename or requested name is query, who needs it
+     * directly and a shortest chain from a root.
+     */
+    void explain(std::ostream& out, const std::string& query) const;
+
+    /**
+     * Writes the graph for Graphviz: one box per file labelled with its filename,
+     * one arrow per edge labelled with the name it was loaded by. Roots are bold.
+     */
+    void writeDot(std::ostream& out) const;
+
+    /**
+     * Writes the graph as JSON (version 1): nodes ordered by path, edges by index into
+     * the node list, and the topological order.
+     */
+    void writeJson(std::ostream& out) const;
+
+private:
+    InternTable<std::filesystem::path> m_paths;
+    InternTable<std::string> m_names;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::vector<Edge>> m_pending;      // Indexed by node; emptied by freeze()
+    std::vector<NodeId> m_roots;
+    std::atomic<bool> m_frozen{false};
+
+    // CSR arrays, valid once frozen.
+    std::vector<std::uint32_t> m_offsets;          // size() + 1 entries into m_edges
+    std::vector<Edge> m_edges;
+    std::vector<std::uint32_t> m_reverseOffsets;   // size() + 1 entries into m_reverse
+    std::vector<NodeId> m_reverse;
+    std::vector<char> m_isRoot;
+};
+
+#endif //RELOCATOR_DEPENDENCYGRAPH_HPP
@@ -0,0 +1,117 @@
+// src/DependencyPruner.cpp
+#include "DependencyPruner.hpp"
+#include "ElfFile.hpp"
+#include "Wildcard.hpp"
+
+#include <algorithm>
+
+DependencyPruner::DependencyPruner(const std::vector<std::string>& keepPatterns)
+    : m_keep(builtInKeep()) {
+    m_keep.insert(m_keep.end(), keepPatterns.begin(), keepPatterns.end());
+}
+
+const std::vector<std::string>& DependencyPruner::builtInKeep() {
+    static const std::vector<std::string> patterns = {
+        "libpthread.so*",       // Before glibc 2.34, loading it switched libc to thread-safe paths
+        "libasan.so*", "libhwasan.so*", "liblsan.so*", "libtsan.so*", "libubsan.so*",
+        "libjemalloc.so*", "libtcmalloc*.so*", "libmimalloc.so*",   // Interpose on malloc for everyone
+        "libSegFault.so", "libmemusage.so", "libpcprofile.so",      // Work from their initializers
+    };
+    return patterns;
+}
+
+const std::string* DependencyPruner::keptBy(const std::string& name) const {
+    const std::string filename = std::filesystem::path(name).filename().string();
+    for (const auto& pattern : m_keep) {
+        if (Wildcard::match(pattern, filename)) {
+            return &pattern;
+        }
+    }
+    return nullptr;
+}
+
+bool DependencyPruner::unused(const std::filesystem::path& object, const std::string& soname,
+                              const std::filesystem::path& library,
+                              const std::vector<std::filesystem::path>& siblings) {
+    if (keptBy(soname) || keptBy(library.filename().string())) {
+        return false;
+    }
+    const auto user = symbolsOf(object);
+    const auto provider = symbolsOf(library);
+    if (!user->readable || !provider->readable || satisfies(*user, soname, *provider)) {
+        return false;
+    }
+    std::vector<std::shared_ptr<const Symbols>> others;
+    for (const auto& sibling : siblings) {
+        if (sibling == library) {
+            continue;
+        }
+        const auto other = symbolsOf(sibling);
+        if (!other->readable) {
+            return false;
+        }
+        others.push_back(other);
+        const bool loadsItItself = std::find(other->needed.begin(), other->needed.end(), soname) != other->needed.end()
+            || (!provider->soname.empty()
+                && std::find(other->needed.begin(), other->needed.end(), provider->soname) != other->needed.end());
+        if (!loadsItItself && satisfies(*other, provider->soname.empty() ? soname : provider->soname, *provider)) {
+            return false;
+        }
+    }
+    for (const auto& import : user->imports) {
+        if (import.weak || !import.versionFile.empty()) {
+            continue;
+        }
+        const bool elsewhere = std::any_of(others.begin(), others.end(),
+            [&](const auto& other) { return other->exports.count(import.name) > 0; });
+        if (!elsewhere) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DependencyPruner::satisfies(const Symbols& user, const std::string& soname, const Symbols& library) {
+    for (const auto& import : user.imports) {
+        if (!import.versionFile.empty()) {
+            if (import.versionFile == soname || import.versionFile == library.soname) {
+                return true;
+            }
+        } else if (library.exports.count(import.name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<const DependencyPruner::Symbols> DependencyPruner::symbolsOf(const std::filesystem::path& file) {
+    const std::string key = file.string();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_symbols.find(key);
+        if (it != m_symbols.end()) {
+            return it->second;
+        }
+    }
+
+    // Read outside the lock; if two threads race, the first result is kept.
+    auto symbols = std::make_shared<Symbols>();
+    try {
+        const ElfFile elf(file);
+        const ElfDynamicInfo info = elf.dynamicInfo();
+        symbols->soname = info.soname;
+        symbols->needed = info.needed;
+        for (auto& symbol : elf.dynamicSymbols()) {
+            if (symbol.defined) {
+                symbols->exports.insert(std::move(symbol.name));
+            } else {
+                symbols->imports.push_back({ std::move(symbol.name), std::move(symbol.versionFile), symbol.weak });
+            }
+        }
+        symbols->readable = true;
+    } catch (const std::exception&) {
+        // Unreadable; nothing is pruned on its account.
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_symbols.emplace(key, std::move(symbols)).first->second;
+}
@@ -0,0 +1,85 @@
+// src/DependencyPruner.hpp
+#ifndef RELOCATOR_DEPENDENCYPRUNER_HPP
+#define RELOCATOR_DEPENDENCYPRUNER_HPP
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @class DependencyPruner
+ * @brief Finds DT_NEEDED entries that satisfy none of the symbols an object imports.
+ *
+ * A needed library is in use if it exports a name the object imports without a
+ * version, or if the object imports any versioned symbol from it (a versioned import
+ * names its library, so it can bind nowhere else). Over-linked libraries pass neither
+ * test; the loader maps and initializes them for nothing.
+ *
+ * Symbols are not the only reason to load a library: initializers and interposition
+ * (malloc replacements, sanitizer runtimes, old libpthread) work without a single
+ * import. Such libraries are kept by name, through the built-in list and the caller's
+ * patterns. A library is also kept if it satisfies an import of another library the
+ * object needs that does not list it itself, since the object's entry is what loads it,
+ * and whenever the object imports a symbol none of its other dependencies export: that
+ * symbol may come from the library's own dependencies.
+ *
+ * Thread-safe; each file's symbols are read once.
+ */
+class DependencyPruner {
+public:
+    /**
+     * @param keepPatterns Shell patterns (see Wildcard::match) for library filenames that
+     *        are never pruned, on top of builtInKeep().
+     */
+    explicit DependencyPruner(const std::vector<std::string>& keepPatterns);
+
+    /**
+     * Libraries loaded for their side effects rather than their symbols.
+     */
+    static const std::vector<std::string>& builtInKeep();
+
+    /**
+     * The pattern that keeps a library whatever it exports, or nullptr.
+     * @param name A DT_NEEDED value or a filename.
+     */
+    const std::string* keptBy(const std::string& name) const;
+
+    /**
+     * Whether a DT_NEEDED entry satisfies nothing.
+     * @param object The object carrying the entry.
+     * @param soname The entry.
+     * @param library The file it resolved to.
+     * @param siblings The files all of the object's other DT_NEEDED entries resolved to,
+     *        including those that are not bundled.
+     * @return false if the library is in use, kept by a pattern, or any of the files cannot be read.
+     */
+    bool unused(const std::filesystem::path& object, const std::string& soname,
+                const std::filesystem::path& library, const std::vector<std::filesystem::path>& siblings);
+
+private:
+    struct Import {
+        std::string name;
+        std::string versionFile;    // The DT_NEEDED entry a versioned import names; empty if unversioned
+        bool weak = false;
+    };
+    struct Symbols {
+        bool readable = false;
+        std::string soname;
+        std::vector<std::string> needed;
+        std::vector<Import> imports;
+        std::unordered_set<std::string> exports;
+    };
+
+    std::shared_ptr<const Symbols> symbolsOf(const std::filesystem::path& file);
+    static bool satisfies(const Symbols& user, const std::string& soname, const Symbols& library);
+
+    std::vector<std::string> m_keep;
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<const Symbols>> m_symbols;   // By path
+};
+
+#endif //RELOCATOR_DEPENDENCYPRUNER_HPP
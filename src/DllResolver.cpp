@@ -0,0 +1,72 @@
+// src/DllResolver.cpp
+#include "DllResolver.hpp"
+#include "PeFile.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+DllResolver::DllResolver(const std::vector<std::string>& searchPaths)
+    : m_searchPaths(searchPaths.begin(), searchPaths.end()) {}
+
+std::string DllResolver::lowercase(std::string name) {
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return name;
+}
+
+std::optional<std::filesystem::path> DllResolver::resolve(const std::string& name, std::uint16_t machine,
+                                                          const std::filesystem::path& applicationDir,
+                                                          const std::filesystem::path& loaderDir) {
+    // Import names are Windows paths; only the filename is looked up.
+    const std::size_t slash = name.find_last_of("\\/");
+    const std::string key = lowercase(slash == std::string::npos ? name : name.substr(slash + 1));
+
+    std::vector<const std::filesystem::path*> directories{ &applicationDir, &loaderDir };
+    for (const auto& directory : m_searchPaths) {
+        directories.push_back(&directory);
+    }
+    for (const std::filesystem::path* directory : directories) {
+        const Listing& files = listing(*directory);
+        auto it = files.find(key);
+        if (it == files.end()) {
+            continue;
+        }
+        try {
+            if (PeFile(it->second).machine() != machine) {
+                continue;
+            }
+        } catch (const std::exception&) {
+            continue;
+        }
+        std::error_code ec;
+        std::filesystem::path resolved = std::filesystem::canonical(it->second, ec);
+        if (!ec) {
+            return resolved;
+        }
+    }
+    return std::nullopt;
+}
+
+const DllResolver::Listing& DllResolver::listing(const std::filesystem::path& directory) {
+    const std::string key = directory.string();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_listings.find(key);
+        if (it != m_listings.end()) {
+            return *it->second;
+        }
+    }
+
+    // Listed outside the lock; if two threads race, the first listing is kept.
+    auto files = std::make_unique<Listing>();
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code typeError;
+        if (it->is_regular_file(typeError)) {
+            files->emplace(lowercase(it->path().filename().string()), it->path());
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return *m_listings.emplace(key, std::move(files)).first->second;
+}
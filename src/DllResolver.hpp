@@ -0,0 +1,62 @@
+// src/DllResolver.hpp
+#ifndef RELOCATOR_DLLRESOLVER_HPP
+#define RELOCATOR_DLLRESOLVER_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class DllResolver
+ * @brief Locates DLLs the way the Windows loader does for an application, without Windows.
+ *
+ * Lookup order for an imported DLL name (the safe DLL search mode order, with the
+ * system directories left out because their DLLs are never bundled):
+ *   1. The application directory, i.e. that of the main executable
+ *   2. The directory of the DLL doing the import, as with LOAD_WITH_ALTERED_SEARCH_PATH
+ *   3. The user's additional search paths (-s), standing in for PATH
+ * Names are matched case-insensitively, as NTFS does, and a candidate built for
+ * another machine type is passed over. Each directory is listed once.
+ *
+ * resolve() may be called concurrently from several discovery threads.
+ */
+class DllResolver {
+public:
+    /**
+     * @param searchPaths Additional directories searched after the application's own.
+     */
+    explicit DllResolver(const std::vector<std::string>& searchPaths);
+
+    /**
+     * Resolves one imported DLL name.
+     * @param name The name as the import directory spells it; a directory part is ignored.
+     * @param machine The COFF machine type of the importing image.
+     * @param applicationDir The main executable's directory.
+     * @param loaderDir The importing image's directory.
+     * @return The canonical path of the DLL, or nothing if it cannot be found.
+     */
+    std::optional<std::filesystem::path> resolve(const std::string& name, std::uint16_t machine,
+                                                 const std::filesystem::path& applicationDir,
+                                                 const std::filesystem::path& loaderDir);
+
+    /**
+     * ASCII lowercase, which is how the loader compares DLL names.
+     */
+    static std::string lowercase(std::string name);
+
+private:
+    using Listing = std::unordered_map<std::string, std::filesystem::path>;   // Lowercase filename -> path
+
+    const Listing& listing(const std::filesystem::path& directory);
+
+    std::vector<std::filesystem::path> m_searchPaths;
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::unique_ptr<Listing>> m_listings;   // Never erased, so references stay valid
+};
+
+#endif //RELOCATOR_DLLRESOLVER_HPP
@@ -0,0 +1,555 @@
+// src/ElfFile.cpp
+#include "ElfFile.hpp"
+#include "ByteOrder.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include <elf.h>
+
+// Reads one field of an on-disk ELF structure in the file's byte order.
+#define ELF_FIELD(Struct, base, member) \
+    ByteOrder::load<decltype(Struct::member)>((base) + offsetof(Struct, member), m_bigEndian)
+
+ElfFile::ElfFile(const std::filesystem::path& path)
+    : m_path(path), m_file(std::make_unique<MappedFile>(path)) {
+    m_data = m_file->data();
+    m_size = m_file->size();
+    parseHeaders();
+    parseDynamic();
+}
+
+ElfFile::ElfFile(const std::uint8_t* data, std::size_t size, const std::filesystem::path& name)
+    : m_path(name), m_data(data), m_size(size) {
+    parseHeaders();
+    parseDynamic();
+}
+
+bool ElfFile::isElf(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[SELFMAG] = {};
+    if (!in.read(magic, SELFMAG)) {
+        return false;
+    }
+    return std::memcmp(magic, ELFMAG, SELFMAG) == 0;
+}
+
+std::string ElfFile::machineName(std::uint16_t machine) {
+    switch (machine) {
+        case EM_386:     return "i386";
+        case EM_X86_64:  return "x86_64";
+        case EM_ARM:     return "arm";
+        case EM_AARCH64: return "aarch64";
+        case EM_PPC:     return "ppc";
+        case EM_PPC64:   return "ppc64";
+        case EM_S390:    return "s390";
+        case EM_MIPS:    return "mips";
+        case EM_RISCV:   return "riscv";
+        default:         return "machine-" + std::to_string(machine);
+    }
+}
+
+std::string ElfFile::dynamicTagName(std::int64_t tag) {
+    switch (tag) {
+        case DT_NULL:        return "DT_NULL";
+        case DT_NEEDED:      return "DT_NEEDED";
+        case DT_STRTAB:      return "DT_STRTAB";
+        case DT_STRSZ:       return "DT_STRSZ";
+        case DT_SONAME:      return "DT_SONAME";
+        case DT_RPATH:       return "DT_RPATH";
+        case DT_RUNPATH:     return "DT_RUNPATH";
+        case DT_FLAGS_1:     return "DT_FLAGS_1";
+        case DT_VERNEED:     return "DT_VERNEED";
+        case DT_VERNEEDNUM:  return "DT_VERNEEDNUM";
+        default:             return "tag-" + std::to_string(tag);
+    }
+}
+
+void ElfFile::parseHeaders() {
+    const std::uint8_t* base = m_data;
+    if (m_size < EI_NIDENT || std::memcmp(base, ELFMAG, SELFMAG) != 0) {
+        throw std::runtime_error("Not an ELF file: " + m_path.string());
+    }
+
+    switch (base[EI_CLASS]) {
+        case ELFCLASS32: m_is64Bit = false; break;
+        case ELFCLASS64: m_is64Bit = true; break;
+        default: throw std::runtime_error("Unsupported ELF class in: " + m_path.string());
+    }
+    switch (base[EI_DATA]) {
+        case ELFDATA2LSB: m_bigEndian = false; break;
+        case ELFDATA2MSB: m_bigEndian = true; break;
+        default: throw std::runtime_error("Unsupported ELF byte order in: " + m_path.string());
+    }
+
+    std::uint64_t phoff, shoff;
+    std::uint32_t phnum, shnum, phentsize, shentsize;
+    if (m_is64Bit) {
+        if (!contains(0, sizeof(Elf64_Ehdr))) {
+            throw std::runtime_error("Truncated ELF header in: " + m_path.string());
+        }
+        m_type = ELF_FIELD(Elf64_Ehdr, base, e_type);
+        m_machine = ELF_FIELD(Elf64_Ehdr, base, e_machine);
+        phoff = ELF_FIELD(Elf64_Ehdr, base, e_phoff);
+        shoff = ELF_FIELD(Elf64_Ehdr, base, e_shoff);
+        phnum = ELF_FIELD(Elf64_Ehdr, base, e_phnum);
+        shnum = ELF_FIELD(Elf64_Ehdr, base, e_shnum);
+        phentsize = ELF_FIELD(Elf64_Ehdr, base, e_phentsize);
+        shentsize = ELF_FIELD(Elf64_Ehdr, base, e_shentsize);
+    } else {
+        if (!contains(0, sizeof(Elf32_Ehdr))) {
+            throw std::runtime_error("Truncated ELF header in: " + m_path.string());
+        }
+        m_type = ELF_FIELD(Elf32_Ehdr, base, e_type);
+        m_machine = ELF_FIELD(Elf32_Ehdr, base, e_machine);
+        phoff = ELF_FIELD(Elf32_Ehdr, base, e_phoff);
+        shoff = ELF_FIELD(Elf32_Ehdr, base, e_shoff);
+        phnum = ELF_FIELD(Elf32_Ehdr, base, e_phnum);
+        shnum = ELF_FIELD(Elf32_Ehdr, base, e_shnum);
+        phentsize = ELF_FIELD(Elf32_Ehdr, base, e_phentsize);
+        shentsize = ELF_FIELD(Elf32_Ehdr, base, e_shentsize);
+    }
+
+    const std::size_t expectedShentsize = m_is64Bit ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr);
+    const std::size_t expectedPhentsize = m_is64Bit ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr);
+
+    // --- Section headers (parsed first, since extended numbering lives in section 0) ---
+    if (shoff != 0 && shentsize == expectedShentsize) {
+        auto readSection = [&](std::uint64_t index) {
+            const std::uint64_t at = shoff + index * shentsize;
+            if (!contains(at, shentsize)) {
+                throw std::runtime_error("Section header out of bounds in: " + m_path.string());
+            }
+            const std::uint8_t* p = base + at;
+            ElfSectionHeader sh;
+            if (m_is64Bit) {
+                sh.name = ELF_FIELD(Elf64_Shdr, p, sh_name);
+                sh.type = ELF_FIELD(Elf64_Shdr, p, sh_type);
+                sh.flags = ELF_FIELD(Elf64_Shdr, p, sh_flags);
+                sh.addr = ELF_FIELD(Elf64_Shdr, p, sh_addr);
+                sh.offset = ELF_FIELD(Elf64_Shdr, p, sh_offset);
+                sh.size = ELF_FIELD(Elf64_Shdr, p, sh_size);
+                sh.link = ELF_FIELD(Elf64_Shdr, p, sh_link);
+                sh.info = ELF_FIELD(Elf64_Shdr, p, sh_info);
+                sh.addralign = ELF_FIELD(Elf64_Shdr, p, sh_addralign);
+                sh.entsize = ELF_FIELD(Elf64_Shdr, p, sh_entsize);
+            } else {
+                sh.name = ELF_FIELD(Elf32_Shdr, p, sh_name);
+                sh.type = ELF_FIELD(Elf32_Shdr, p, sh_type);
+                sh.flags = ELF_FIELD(Elf32_Shdr, p, sh_flags);
+                sh.addr = ELF_FIELD(Elf32_Shdr, p, sh_addr);
+                sh.offset = ELF_FIELD(Elf32_Shdr, p, sh_offset);
+                sh.size = ELF_FIELD(Elf32_Shdr, p, sh_size);
+                sh.link = ELF_FIELD(Elf32_Shdr, p, sh_link);
+                sh.info = ELF_FIELD(Elf32_Shdr, p, sh_info);
+                sh.addralign = ELF_FIELD(Elf32_Shdr, p, sh_addralign);
+                sh.entsize = ELF_FIELD(Elf32_Shdr, p, sh_entsize);
+            }
+            return sh;
+        };
+
+        ElfSectionHeader first = readSection(0);
+        std::uint64_t count = shnum;
+        if (count == 0) {
+            count = first.size;
+        }
+        if (phnum == PN_XNUM) {
+            phnum = first.info;
+        }
+        if (count > m_size / shentsize) {
+            throw std::runtime_error("Implausible section count in: " + m_path.string());
+        }
+        m_sectionHeaders.reserve(count);
+        m_sectionHeaders.push_back(first);
+        for (std::uint64_t i = 1; i < count; ++i) {
+            m_sectionHeaders.push_back(readSection(i));
+        }
+    }
+
+    // --- Program headers ---
+    if (phoff != 0 && phnum != 0) {
+        if (phentsize != expectedPhentsize || !contains(phoff, std::uint64_t(phnum) * phentsize)) {
+            throw std::runtime_error("Program headers out of bounds in: " + m_path.string());
+        }
+        m_programHeaders.reserve(phnum);
+        for (std::uint32_t i = 0; i < phnum; ++i) {
+            const std::uint8_t* p = base + phoff + std::uint64_t(i) * phentsize;
+            ElfProgramHeader ph;
+            if (m_is64Bit) {
+                ph.type = ELF_FIELD(Elf64_Phdr, p, p_type);
+                ph.flags = ELF_FIELD(Elf64_Phdr, p, p_flags);
+                ph.offset = ELF_FIELD(Elf64_Phdr, p, p_offset);
+                ph.vaddr = ELF_FIELD(Elf64_Phdr, p, p_vaddr);
+                ph.paddr = ELF_FIELD(Elf64_Phdr, p, p_paddr);
+                ph.filesz = ELF_FIELD(Elf64_Phdr, p, p_filesz);
+                ph.memsz = ELF_FIELD(Elf64_Phdr, p, p_memsz);
+                ph.align = ELF_FIELD(Elf64_Phdr, p, p_align);
+            } else {
+                ph.type = ELF_FIELD(Elf32_Phdr, p, p_type);
+                ph.flags = ELF_FIELD(Elf32_Phdr, p, p_flags);
+                ph.offset = ELF_FIELD(Elf32_Phdr, p, p_offset);
+                ph.vaddr = ELF_FIELD(Elf32_Phdr, p, p_vaddr);
+                ph.paddr = ELF_FIELD(Elf32_Phdr, p, p_paddr);
+                ph.filesz = ELF_FIELD(Elf32_Phdr, p, p_filesz);
+                ph.memsz = ELF_FIELD(Elf32_Phdr, p, p_memsz);
+                ph.align = ELF_FIELD(Elf32_Phdr, p, p_align);
+            }
+            if (ph.type == PT_DYNAMIC && m_dynamicIndex < 0) {
+                m_dynamicIndex = static_cast<int>(i);
+            }
+            m_programHeaders.push_back(ph);
+        }
+    }
+}
+
+void ElfFile::parseDynamic() {
+    if (m_dynamicIndex < 0) {
+        return;
+    }
+
+    const ElfProgramHeader& dyn = m_programHeaders[m_dynamicIndex];
+    if (!contains(dyn.offset, dyn.filesz)) {
+        throw std::runtime_error("PT_DYNAMIC out of bounds in: " + m_path.string());
+    }
+
+    const std::size_t entrySize = m_is64Bit ? sizeof(Elf64_Dyn) : sizeof(Elf32_Dyn);
+    const std::uint8_t* base = m_data + dyn.offset;
+    std::uint64_t strtabAddr = 0;
+    bool haveStrtab = false;
+
+    for (std::uint64_t at = 0; at + entrySize <= dyn.filesz; at += entrySize) {
+        ElfDynamicEntry entry;
+        if (m_is64Bit) {
+            entry.tag = ELF_FIELD(Elf64_Dyn, base + at, d_tag);
+            entry.val = ELF_FIELD(Elf64_Dyn, base + at, d_un.d_val);
+        } else {
+            entry.tag = ELF_FIELD(Elf32_Dyn, base + at, d_tag);
+            entry.val = ELF_FIELD(Elf32_Dyn, base + at, d_un.d_val);
+        }
+        m_dynamicEntries.push_back(entry);
+        if (entry.tag == DT_NULL) {
+            break;
+        }
+        if (entry.tag == DT_STRTAB) {
+            strtabAddr = entry.val;
+            haveStrtab = true;
+        } else if (entry.tag == DT_STRSZ) {
+            m_dynstrSize = entry.val;
+        }
+    }
+
+    if (haveStrtab) {
+        m_dynstrOffset = vaddrToOffset(strtabAddr);
+        if (!contains(m_dynstrOffset, m_dynstrSize)) {
+            throw std::runtime_error("DT_STRTAB out of bounds in: " + m_path.string());
+        }
+    }
+}
+
+std::uint64_t ElfFile::vaddrToOffset(std::uint64_t vaddr) const {
+    for (const auto& ph : m_programHeaders) {
+        if (ph.type == PT_LOAD && vaddr >= ph.vaddr && vaddr - ph.vaddr < ph.filesz) {
+            return ph.offset + (vaddr - ph.vaddr);
+        }
+    }
+    throw std::runtime_error("Address is not mapped from the file in: " + m_path.string());
+}
+
+std::string ElfFile::stringAt(std::uint64_t offset, std::uint64_t limit) const {
+    if (offset >= limit || limit > m_size) {
+        throw std::runtime_error("String offset out of bounds in: " + m_path.string());
+    }
+    const char* begin = reinterpret_cast<const char*>(m_data) + offset;
+    const void* nul = std::memchr(begin, '\0', limit - offset);
+    if (nul == nullptr) {
+        throw std::runtime_error("Unterminated string in: " + m_path.string());
+    }
+    return std::string(begin, static_cast<const char*>(nul));
+}
+
+std::string ElfFile::dynamicString(std::uint64_t index) const {
+    if (m_dynstrSize == 0) {
+        throw std::runtime_error("No dynamic string table in: " + m_path.string());
+    }
+    return stringAt(m_dynstrOffset + index, m_dynstrOffset + m_dynstrSize);
+}
+
+std::string ElfFile::interpreter() const {
+    for (const auto& ph : m_programHeaders) {
+        if (ph.type == PT_INTERP && ph.filesz > 0 && contains(ph.offset, ph.filesz)) {
+            return stringAt(ph.offset, ph.offset + ph.filesz);
+        }
+    }
+    return std::string();
+}
+
+std::string ElfFile::buildId() const {
+    static const char digits[] = "0123456789abcdef";
+    for (const auto& section : m_sectionHeaders) {
+        if (section.type != SHT_NOTE || !contains(section.offset, section.size)) {
+            continue;
+        }
+        const std::uint64_t align = section.addralign == 8 ? 8 : 4;
+        const std::uint8_t* note = m_data + section.offset;
+        for (std::uint64_t at = 0; at + 12 <= section.size;) {
+            const auto nameSize = ByteOrder::load<std::uint32_t>(note + at, m_bigEndian);
+            const auto descSize = ByteOrder::load<std::uint32_t>(note + at + 4, m_bigEndian);
+            const auto type = ByteOrder::load<std::uint32_t>(note + at + 8, m_bigEndian);
+            const std::uint64_t desc = at + 12 + (std::uint64_t(nameSize) + align - 1) / align * align;
+            if (desc + descSize > section.size) {
+                break;
+            }
+            if (type == NT_GNU_BUILD_ID && nameSize == 4 && std::memcmp(note + at + 12, "GNU", 4) == 0) {
+                std::string id;
+                for (std::uint32_t i = 0; i < descSize; ++i) {
+                    id += digits[note[desc + i] >> 4];
+                    id += digits[note[desc + i] & 0xF];
+                }
+                return id;
+            }
+            at = desc + (std::uint64_t(descSize) + align - 1) / align * align;
+        }
+    }
+    return std::string();
+}
+
+std::vector<ElfDynamicSymbol> ElfFile::dynamicSymbols() const {
+    std::uint64_t symtabAddr = 0, hashAddr = 0, gnuHashAddr = 0, versymAddr = 0;
+    std::uint64_t verneedAddr = 0, verneedCount = 0, verdefAddr = 0, verdefCount = 0;
+    for (const auto& entry : m_dynamicEntries) {
+        switch (entry.tag) {
+            case DT_SYMTAB:      symtabAddr = entry.val; break;
+            case DT_HASH:        hashAddr = entry.val; break;
+            case DT_GNU_HASH:    gnuHashAddr = entry.val; break;
+            case DT_VERSYM:      versymAddr = entry.val; break;
+            case DT_VERNEED:     verneedAddr = entry.val; break;
+            case DT_VERNEEDNUM:  verneedCount = entry.val; break;
+            case DT_VERDEF:      verdefAddr = entry.val; break;
+            case DT_VERDEFNUM:   verdefCount = entry.val; break;
+            default: break;
+        }
+    }
+    if (symtabAddr == 0 || m_dynstrSize == 0) {
+        return {};
+    }
+    const std::uint64_t symOffset = vaddrToOffset(symtabAddr);
+    const std::size_t symSize = m_is64Bit ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+    auto word = [this](std::uint64_t offset) {
+        if (!contains(offset, 4)) {
+            throw std::runtime_error("Symbol hash table out of bounds in: " + m_path.string());
+        }
+        return ByteOrder::load<std::uint32_t>(m_data + offset, m_bigEndian);
+    };
+
+    std::uint64_t count = 0;
+    for (const auto& sh : m_sectionHeaders) {
+        if (sh.type == SHT_DYNSYM && sh.entsize == symSize) {
+            count = sh.size / sh.entsize;
+        }
+    }
+    if (count == 0 && hashAddr != 0) {
+        count = word(vaddrToOffset(hashAddr) + 4);     // nchain
+    }
+    if (count == 0 && gnuHashAddr != 0) {
+        // No symbol count is stored: it is one past the last symbol of the longest-reaching chain.
+        const std::uint64_t table = vaddrToOffset(gnuHashAddr);
+        const std::uint32_t buckets = word(table);
+        const std::uint32_t firstHashed = word(table + 4);
+        const std::uint32_t bloomWords = word(table + 8);
+        const std::uint64_t bucketTable = table + 16 + std::uint64_t(bloomWords) * (m_is64Bit ? 8 : 4);
+        const std::uint64_t chainTable = bucketTable + std::uint64_t(buckets) * 4;
+        std::uint32_t last = 0;
+        for (std::uint32_t b = 0; b < buckets; ++b) {
+            last = std::max(last, word(bucketTable + std::uint64_t(b) * 4));
+        }
+        count = firstHashed;
+        if (last >= firstHashed) {
+            while (!(word(chainTable + std::uint64_t(last - firstHashed) * 4) & 1)) {
+                ++last;
+            }
+            count = std::uint64_t(last) + 1;
+        }
+    }
+    if (!contains(symOffset, count * symSize)) {
+        throw std::runtime_error("Dynamic symbols out of bounds in: " + m_path.string());
+    }
+
+    // Version indices name a version needed from a library (.gnu.version_r) or defined here (.gnu.version_d).
+    // The layouts are the same in both classes.
+    std::unordered_map<std::uint16_t, std::pair<std::string, std::string>> versions;   // Index -> (name, file)
+    if (verneedAddr != 0) {
+        std::uint64_t offset = vaddrToOffset(verneedAddr);
+        for (std::uint64_t n = 0; n < verneedCount && contains(offset, sizeof(Elf64_Verneed)); ++n) {
+            const std::uint8_t* vn = m_data + offset;
+            const std::string file = dynamicString(ELF_FIELD(Elf64_Verneed, vn, vn_file));
+            std::uint64_t auxOffset = offset + ELF_FIELD(Elf64_Verneed, vn, vn_aux);
+            for (std::uint16_t a = 0; a < ELF_FIELD(Elf64_Verneed, vn, vn_cnt) && contains(auxOffset, sizeof(Elf64_Vernaux)); ++a) {
+                const std::uint8_t* aux = m_data + auxOffset;
+                versions[ELF_FIELD(Elf64_Vernaux, aux, vna_other) & 0x7fff] = { dynamicString(ELF_FIELD(Elf64_Vernaux, aux, vna_name)), file };
+                const std::uint32_t next = ELF_FIELD(Elf64_Vernaux, aux, vna_next);
+                if (next == 0) break;
+                auxOffset += next;
+            }
+            const std::uint32_t next = ELF_FIELD(Elf64_Verneed, vn, vn_next);
+            if (next == 0) break;
+            offset += next;
+        }
+    }
+    if (verdefAddr != 0) {
+        std::uint64_t offset = vaddrToOffset(verdefAddr);
+        for (std::uint64_t n = 0; n < verdefCount && contains(offset, sizeof(Elf64_Verdef)); ++n) {
+            const std::uint8_t* vd = m_data + offset;
+            const std::uint64_t auxOffset = offset + ELF_FIELD(Elf64_Verdef, vd, vd_aux);
+            if (!(ELF_FIELD(Elf64_Verdef, vd, vd_flags) & VER_FLG_BASE) && contains(auxOffset, sizeof(Elf64_Verdaux))) {
+                versions[ELF_FIELD(Elf64_Verdef, vd, vd_ndx) & 0x7fff] = { dynamicString(ELF_FIELD(Elf64_Verdaux, m_data + auxOffset, vda_name)), "" };
+            }
+            const std::uint32_t next = ELF_FIELD(Elf64_Verdef, vd, vd_next);
+            if (next == 0) break;
+            offset += next;
+        }
+    }
+    const std::uint64_t versymOffset = versymAddr != 0 ? vaddrToOffset(versymAddr) : 0;
+    if (versymAddr != 0 && !contains(versymOffset, count * 2)) {
+        throw std::runtime_error("Symbol versions out of bounds in: " + m_path.string());
+    }
+
+    std::vector<ElfDynamicSymbol> symbols;
+    for (std::uint64_t i = 1; i < count; ++i) {
+        const std::uint8_t* p = m_data + symOffset + i * symSize;
+        std::uint32_t nameIndex;
+        std::uint8_t info;
+        std::uint16_t sectionIndex;
+        if (m_is64Bit) {
+            nameIndex = ELF_FIELD(Elf64_Sym, p, st_name);
+            info = ELF_FIELD(Elf64_Sym, p, st_info);
+            sectionIndex = ELF_FIELD(Elf64_Sym, p, st_shndx);
+        } else {
+            nameIndex = ELF_FIELD(Elf32_Sym, p, st_name);
+            info = ELF_FIELD(Elf32_Sym, p, st_info);
+            sectionIndex = ELF_FIELD(Elf32_Sym, p, st_shndx);
+        }
+        const unsigned binding = info >> 4;
+        if (binding == STB_LOCAL || nameIndex == 0) {
+            continue;
+        }
+        ElfDynamicSymbol symbol;
+        symbol.name = dynamicString(nameIndex);
+        symbol.defined = sectionIndex != SHN_UNDEF;
+        symbol.weak = binding == STB_WEAK;
+        if (versymAddr != 0) {
+            auto it = versions.find(ByteOrder::load<std::uint16_t>(m_data + versymOffset + i * 2, m_bigEndian) & 0x7fff);
+            if (it != versions.end()) {
+                symbol.version = it->second.first;
+                if (!symbol.defined) {
+                    symbol.versionFile = it->second.second;
+                }
+            }
+        }
+        symbols.push_back(std::move(symbol));
+    }
+    return symbols;
+}
+
+ElfRelocationCounts ElfFile::relocationCounts() const {
+    std::uint64_t rela = 0, relaSize = 0, rel = 0, relSize = 0, relr = 0, relrSize = 0;
+    std::uint64_t jmprel = 0, pltSize = 0, pltType = DT_RELA;
+    for (const auto& entry : m_dynamicEntries) {
+        switch (entry.tag) {
+            case DT_RELA:      rela = entry.val; break;
+            case DT_RELASZ:    relaSize = entry.val; break;
+            case DT_REL:       rel = entry.val; break;
+            case DT_RELSZ:     relSize = entry.val; break;
+            case 36:           relr = entry.val; break;        // DT_RELR
+            case 35:           relrSize = entry.val; break;    // DT_RELRSZ
+            case DT_JMPREL:    jmprel = entry.val; break;
+            case DT_PLTRELSZ:  pltSize = entry.val; break;
+            case DT_PLTREL:    pltType = entry.val; break;
+            default: break;
+        }
+    }
+    const std::size_t word = m_is64Bit ? 8 : 4;
+    const std::size_t relaEntry = m_is64Bit ? sizeof(Elf64_Rela) : sizeof(Elf32_Rela);
+    const std::size_t relEntry = m_is64Bit ? sizeof(Elf64_Rel) : sizeof(Elf32_Rel);
+    auto table = [this](std::uint64_t addr, std::uint64_t size) {
+        const std::uint64_t offset = vaddrToOffset(addr);
+        if (!contains(offset, size)) {
+            throw std::runtime_error("Relocation table out of bounds in: " + m_path.string());
+        }
+        return offset;
+    };
+
+    ElfRelocationCounts counts;
+    // r_info sits right after r_offset in both REL and RELA; symbol index 0 means no lookup.
+    auto scan = [&](std::uint64_t addr, std::uint64_t size, std::size_t entrySize, std::uint64_t& symbolic) {
+        const std::uint64_t offset = table(addr, size);
+        for (std::uint64_t p = offset; p + entrySize <= offset + size; p += entrySize) {
+            const std::uint64_t symbol = m_is64Bit
+                ? ByteOrder::load<std::uint64_t>(m_data + p + 8, m_bigEndian) >> 32
+                : ByteOrder::load<std::uint32_t>(m_data + p + 4, m_bigEndian) >> 8;
+            ++(symbol != 0 ? symbolic : counts.relative);
+        }
+    };
+    // Some linkers count .rela.plt into DT_RELASZ as well; it is only scanned once.
+    auto withoutPlt = [&](std::uint64_t addr, std::uint64_t size) {
+        return jmprel > addr && jmprel < addr + size ? jmprel - addr : size;
+    };
+    if (rela != 0) scan(rela, withoutPlt(rela, relaSize), relaEntry, counts.symbolic);
+    if (rel != 0) scan(rel, withoutPlt(rel, relSize), relEntry, counts.symbolic);
+    if (jmprel != 0) scan(jmprel, pltSize, pltType == DT_REL ? relEntry : relaEntry, counts.plt);
+
+    // DT_RELR: an even word is an address, each odd word a bitmap of up to 63 (or 31) more.
+    if (relr != 0) {
+        const std::uint64_t offset = table(relr, relrSize);
+        for (std::uint64_t p = offset; p + word <= offset + relrSize; p += word) {
+            std::uint64_t bits = m_is64Bit ? ByteOrder::load<std::uint64_t>(m_data + p, m_bigEndian)
+                                           : ByteOrder::load<std::uint32_t>(m_data + p, m_bigEndian);
+            if (!(bits & 1)) {
+                ++counts.relative;
+                continue;
+            }
+            for (bits >>= 1; bits != 0; bits &= bits - 1) {
+                ++counts.relative;
+            }
+        }
+    }
+    return counts;
+}
+
+ElfDynamicInfo ElfFile::dynamicInfo() const {
+    ElfDynamicInfo info;
+    info.is64Bit = m_is64Bit;
+    info.machine = m_machine;
+    info.isDynamic = m_dynamicIndex >= 0;
+
+    for (const auto& entry : m_dynamicEntries) {
+        switch (entry.tag) {
+            case DT_NEEDED:
+                info.needed.push_back(dynamicString(entry.val));
+                break;
+            case DT_SONAME:
+                info.soname = dynamicString(entry.val);
+                break;
+            case DT_RPATH:
+                info.rpath = dynamicString(entry.val);
+                info.hasRpath = true;
+                break;
+            case DT_RUNPATH:
+                info.runpath = dynamicString(entry.val);
+                info.hasRunpath = true;
+                break;
+            case DT_FLAGS_1:
+                info.flags1 = entry.val;
+                break;
+            default:
+                break;
+        }
+    }
+    return info;
+}
+
+#undef ELF_FIELD
@@ -0,0 +1,236 @@
+// src/ElfFile.hpp
+#ifndef RELOCATOR_ELFFILE_HPP
+#define RELOCATOR_ELFFILE_HPP
+
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @struct ElfProgramHeader
+ * @brief A program header, normalized to 64-bit fields in host byte order.
+ */
+struct ElfProgramHeader {
+    std::uint32_t type = 0;
+    std::uint32_t flags = 0;
+    std::uint64_t offset = 0;
+    std::uint64_t vaddr = 0;
+    std::uint64_t paddr = 0;
+    std::uint64_t filesz = 0;
+    std::uint64_t memsz = 0;
+    std::uint64_t align = 0;
+};
+
+/**
+ * @struct ElfSectionHeader
+ * @brief A section header, normalized to 64-bit fields in host byte order.
+ */
+struct ElfSectionHeader {
+    std::uint32_t name = 0;
+    std::uint32_t type = 0;
+    std::uint64_t flags = 0;
+    std::uint64_t addr = 0;
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+    std::uint32_t link = 0;
+    std::uint32_t info = 0;
+    std::uint64_t addralign = 0;
+    std::uint64_t entsize = 0;
+};
+
+/**
+ * @struct ElfDynamicEntry
+ * @brief One entry of the PT_DYNAMIC array.
+ */
+struct ElfDynamicEntry {
+    std::int64_t tag = 0;
+    std::uint64_t val = 0;
+};
+
+/**
+ * @struct ElfDynamicInfo
+ * @brief The loader-relevant metadata of an ELF object, as read from PT_DYNAMIC.
+ */
+struct ElfDynamicInfo {
+    bool is64Bit = false;
+    std::uint16_t machine = 0;
+    bool isDynamic = false;              // False for static executables and objects without PT_DYNAMIC
+    std::string soname;                  // DT_SONAME, empty if absent
+    std::vector<std::string> needed;     // DT_NEEDED, in file order
+    std::string rpath;                   // DT_RPATH, raw colon-separated string
+    std::string runpath;                 // DT_RUNPATH, raw colon-separated string
+    bool hasRpath = false;
+    bool hasRunpath = false;
+    std::uint64_t flags1 = 0;            // DT_FLAGS_1 (e.g. DF_1_NODEFLIB)
+};
+
+/**
+ * @struct ElfDynamicSymbol
+ * @brief A global or weak symbol of .dynsym, with its version resolved to a name.
+ */
+struct ElfDynamicSymbol {
+    std::string name;
+    std::string version;        // Empty if unversioned
+    std::string versionFile;    // For an undefined symbol, the DT_NEEDED entry its version must come from
+    bool defined = false;
+    bool weak = false;
+};
+
+/**
+ * @struct ElfRelocationCounts
+ * @brief How much work the loader has relocating an object, by the entries of its dynamic relocation tables.
+ */
+struct ElfRelocationCounts {
+    std::uint64_t relative = 0;    // Need only the load address (R_*_RELATIVE and DT_RELR)
+    std::uint64_t symbolic = 0;    // Need a symbol lookup, outside the PLT
+    std::uint64_t plt = 0;         // DT_JMPREL entries; looked up at startup only when binding immediately
+
+    std::uint64_t total() const { return relative + symbolic + plt; }
+};
+
+/**
+ * @class ElfFile
+ * @brief An in-process, read-only parser for ELF objects.
+ *
+ * The file is memory-mapped and its headers are decoded into host byte order,
+ * so 32/64-bit and little/big-endian objects can be inspected on any host.
+ * Nothing in the file is ever executed.
+ */
+class ElfFile {
+public:
+    /**
+     * Maps and parses an ELF file.
+     * @param path The file to parse.
+     * @throws std::runtime_error if the file cannot be read or is not a well-formed ELF object.
+     */
+    explicit ElfFile(const std::filesystem::path& path);
+
+    /**
+     * Parses an ELF image that is already in memory. The buffer is not copied
+     * and must outlive this object.
+     * @param data Start of the image.
+     * @param size Size of the image in bytes.
+     * @param name A name used in error messages.
+     * @throws std::runtime_error if the image is not a well-formed ELF object.
+     */
+    ElfFile(const std::uint8_t* data, std::size_t size, const std::filesystem::path& name);
+
+    /**
+     * Checks the ELF magic of a file without parsing the rest of it.
+     * @param path The file to check.
+     * @return true if the file starts with the ELF magic bytes.
+     */
+    static bool isElf(const std::filesystem::path& path);
+
+    /**
+     * Returns a readable name for an e_machine value (e.g. "x86_64").
+     */
+    static std::string machineName(std::uint16_t machine);
+
+    /**
+     * Returns the symbolic name of a dynamic tag (e.g. "DT_NEEDED").
+     */
+    static std::string dynamicTagName(std::int64_t tag);
+
+    const std::filesystem::path& path() const { return m_path; }
+    const std::uint8_t* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+    bool is64Bit() const { return m_is64Bit; }
+    bool isBigEndian() const { return m_bigEndian; }
+    std::uint16_t type() const { return m_type; }
+    std::uint16_t machine() const { return m_machine; }
+
+    const std::vector<ElfProgramHeader>& programHeaders() const { return m_programHeaders; }
+    const std::vector<ElfSectionHeader>& sectionHeaders() const { return m_sectionHeaders; }
+    const std::vector<ElfDynamicEntry>& dynamicEntries() const { return m_dynamicEntries; }
+
+    /**
+     * Index of the PT_DYNAMIC program header, or -1 if there is none.
+     */
+    int dynamicSegmentIndex() const { return m_dynamicIndex; }
+
+    /**
+     * File offset of the dynamic string table (DT_STRTAB), or 0 if there is none.
+     */
+    std::uint64_t dynamicStringTableOffset() const { return m_dynstrOffset; }
+    std::uint64_t dynamicStringTableSize() const { return m_dynstrSize; }
+
+    /**
+     * Translates a virtual address to a file offset using the PT_LOAD segments.
+     * @throws std::runtime_error if the address is not backed by file contents.
+     */
+    std::uint64_t vaddrToOffset(std::uint64_t vaddr) const;
+
+    /**
+     * Reads a string from the dynamic string table.
+     * @param index Offset of the string within DT_STRTAB.
+     * @throws std::runtime_error if the index is out of bounds.
+     */
+    std::string dynamicString(std::uint64_t index) const;
+
+    /**
+     * Reads a NUL-terminated string at an absolute file offset, bounded by `limit`.
+     */
+    std::string stringAt(std::uint64_t offset, std::uint64_t limit) const;
+
+    /**
+     * Extracts DT_NEEDED, DT_SONAME, DT_RPATH and DT_RUNPATH.
+     */
+    ElfDynamicInfo dynamicInfo() const;
+
+    /**
+     * The program interpreter named by PT_INTERP (e.g. "/lib64/ld-linux-x86-64.so.2"),
+     * or an empty string for shared libraries and static executables.
+     */
+    std::string interpreter() const;
+
+    /**
+     * The NT_GNU_BUILD_ID note in lowercase hex, or an empty string if the file has none.
+     */
+    std::string buildId() const;
+
+    /**
+     * Reads the dynamic symbol table. Its size is taken from the SHT_DYNSYM section
+     * header, or else from DT_HASH or DT_GNU_HASH, so stripped section headers are fine.
+     * Local symbols are left out.
+     * @throws std::runtime_error if the table or its version information is out of bounds.
+     */
+    std::vector<ElfDynamicSymbol> dynamicSymbols() const;
+
+    /**
+     * Counts the entries of DT_RELA, DT_REL, DT_RELR and DT_JMPREL.
+     * @throws std::runtime_error if a table is out of bounds.
+     */
+    ElfRelocationCounts relocationCounts() const;
+
+private:
+    void parseHeaders();
+    void parseDynamic();
+    bool contains(std::uint64_t offset, std::uint64_t length) const {
+        return offset <= m_size && length <= m_size - offset;
+    }
+
+    std::filesystem::path m_path;
+    std::unique_ptr<MappedFile> m_file;      // Null when parsing a caller-owned buffer
+    const std::uint8_t* m_data = nullptr;
+    std::size_t m_size = 0;
+
+    bool m_is64Bit = false;
+    bool m_bigEndian = false;
+    std::uint16_t m_type = 0;
+    std::uint16_t m_machine = 0;
+
+    std::vector<ElfProgramHeader> m_programHeaders;
+    std::vector<ElfSectionHeader> m_sectionHeaders;
+    std::vector<ElfDynamicEntry> m_dynamicEntries;
+    int m_dynamicIndex = -1;
+    std::uint64_t m_dynstrOffset = 0;
+    std::uint64_t m_dynstrSize = 0;
+};
+
+#endif //RELOCATOR_ELFFILE_HPP
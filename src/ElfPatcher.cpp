@@ -0,0 +1,729 @@
+// src/ElfPatcher.cpp
+#include "ElfPatcher.hpp"
+#include "ByteOrder.hpp"
+#include "ElfFile.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <elf.h>
+
+// Reads or writes one field of an on-disk ELF structure in the file's byte order.
+#define ELF_FIELD(Struct, base, member) \
+    ByteOrder::load<decltype(Struct::member)>((base) + offsetof(Struct, member), m_bigEndian)
+#define ELF_STORE(Struct, base, member, value) \
+    ByteOrder::store<decltype(Struct::member)>((base) + offsetof(Struct, member), \
+                                               static_cast<decltype(Struct::member)>(value), m_bigEndian)
+
+namespace {
+
+    bool isStringTag(std::int64_t tag) {
+        switch (tag) {
+            case DT_NEEDED: case DT_SONAME: case DT_RPATH: case DT_RUNPATH:
+            case DT_AUXILIARY: case DT_FILTER: case DT_CONFIG: case DT_DEPAUDIT: case DT_AUDIT:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    std::uint64_t alignUp(std::uint64_t value, std::uint64_t alignment) {
+        return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+    }
+
+    std::string hex(std::uint64_t value) {
+        std::ostringstream out;
+        out << "0x" << std::hex << value;
+        return out.str();
+    }
+
+    /**
+     * A string that one or more .dynstr references must be pointed at.
+     */
+    struct StringEdit {
+        std::string newValue;
+        bool hasOld = false;
+        std::uint64_t oldOffset = 0;
+        std::uint64_t newOffset = 0;
+        std::vector<std::size_t> dynIndices;        // Dynamic entries to retarget
+        std::vector<std::uint64_t> verneedFields;   // File offsets of vn_file fields to retarget
+    };
+
+    /**
+     * Holds the state of one patch operation over an in-memory image.
+     */
+    class PatchJob {
+    public:
+        PatchJob(const std::vector<std::uint8_t>& source, std::vector<std::uint8_t>& image,
+                 const ElfPatchSpec& spec, const std::filesystem::path& name)
+            : m_source(source), m_image(image), m_spec(spec), m_name(name),
+              m_elf(source.data(), source.size(), name) {
+            m_bigEndian = m_elf.isBigEndian();
+            m_is64Bit = m_elf.is64Bit();
+            m_dynEntSize = m_is64Bit ? sizeof(Elf64_Dyn) : sizeof(Elf32_Dyn);
+            m_phEntSize = m_is64Bit ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr);
+        }
+
+        ElfPatchPlan run() {
+            m_plan.originalSize = m_image.size();
+            if (m_elf.dynamicSegmentIndex() < 0 || m_elf.dynamicStringTableSize() == 0) {
+                throw std::runtime_error("No dynamic section to patch in: " + m_name.string());
+            }
+
+            m_dynamic = m_elf.dynamicEntries();
+            while (!m_dynamic.empty() && m_dynamic.back().tag == DT_NULL) {
+                m_dynamic.pop_back();
+            }
+            m_strtabOffset = m_elf.dynamicStringTableOffset();
+            m_strtab.assign(reinterpret_cast<const char*>(m_source.data()) + m_strtabOffset,
+                            m_elf.dynamicStringTableSize());
+            m_originalStrtabSize = m_strtab.size();
+
+            collectEdits();
+            if (!m_edits.empty() || m_dynamicChanged) {
+                allocateStrings();
+                rebuildDynamic();
+                layout();
+            }
+
+            m_plan.newSize = m_image.size();
+            std::sort(m_plan.changes.begin(), m_plan.changes.end(),
+                      [](const ElfByteChange& a, const ElfByteChange& b) { return a.offset < b.offset; });
+            return m_plan;
+        }
+
+    private:
+        std::string str(std::uint64_t index) const {
+            return m_elf.dynamicString(index);
+        }
+
+        StringEdit& editFor(const std::string& newValue, bool hasOld, std::uint64_t oldOffset) {
+            for (auto& edit : m_edits) {
+                if (edit.newValue == newValue && edit.hasOld == hasOld && (!hasOld || edit.oldOffset == oldOffset)) {
+                    return edit;
+                }
+            }
+            StringEdit edit;
+            edit.newValue = newValue;
+            edit.hasOld = hasOld;
+            edit.oldOffset = oldOffset;
+            m_edits.push_back(edit);
+            return m_edits.back();
+        }
+
+        void collectEdits() {
+            int runpathIndex = -1;
+            int sonameIndex = -1;
+            std::vector<std::size_t> rpathIndices;
+
+            for (std::size_t i = 0; i < m_dynamic.size(); ++i) {
+                const ElfDynamicEntry& entry = m_dynamic[i];
+                if (entry.tag == DT_NEEDED && m_spec.neededRemovals.count(str(entry.val))) {
+                    m_removed.push_back(i);
+                    m_dynamicChanged = true;
+                } else if (entry.tag == DT_NEEDED) {
+                    auto it = m_spec.neededRenames.find(str(entry.val));
+                    if (it != m_spec.neededRenames.end() && it->second != it->first) {
+                        editFor(it->second, true, entry.val).dynIndices.push_back(i);
+                        describe(i, "DT_NEEDED '" + it->first + "' -> '" + it->second + "'");
+                    }
+                } else if (entry.tag == DT_SONAME && m_spec.soname) {
+                    sonameIndex = static_cast<int>(i);
+                    if (str(entry.val) != *m_spec.soname) {
+                        editFor(*m_spec.soname, true, entry.val).dynIndices.push_back(i);
+                        describe(i, "DT_SONAME -> '" + *m_spec.soname + "'");
+                    }
+                } else if (entry.tag == DT_RUNPATH && m_spec.runpath) {
+                    runpathIndex = static_cast<int>(i);
+                    if (str(entry.val) != *m_spec.runpath) {
+                        editFor(*m_spec.runpath, true, entry.val).dynIndices.push_back(i);
+                        describe(i, "DT_RUNPATH -> '" + *m_spec.runpath + "'");
+                    }
+                } else if (entry.tag == DT_RPATH && m_spec.runpath) {
+                    rpathIndices.push_back(i);
+                }
+            }
+
+            if (m_spec.runpath) {
+                if (runpathIndex < 0 && !rpathIndices.empty()) {
+                    // Convert the first DT_RPATH into the DT_RUNPATH, as patchelf --set-rpath does.
+                    std::size_t i = rpathIndices.front();
+                    rpathIndices.erase(rpathIndices.begin());
+                    m_dynamic[i].tag = DT_RUNPATH;
+                    m_dynamicChanged = true;
+                    describe(i, "DT_RPATH -> DT_RUNPATH '" + *m_spec.runpath + "'");
+                    if (str(m_dynamic[i].val) != *m_spec.runpath) {
+                        editFor(*m_spec.runpath, true, m_dynamic[i].val).dynIndices.push_back(i);
+                    }
+                } else if (runpathIndex < 0) {
+                    m_dynamic.push_back({DT_RUNPATH, 0});
+                    describe(m_dynamic.size() - 1, "add DT_RUNPATH '" + *m_spec.runpath + "'");
+                    editFor(*m_spec.runpath, false, 0).dynIndices.push_back(m_dynamic.size() - 1);
+                }
+                // A DT_RPATH is ignored once DT_RUNPATH exists, so the stale entries are dropped.
+                for (auto it = rpathIndices.rbegin(); it != rpathIndices.rend(); ++it) {
+                    m_removed.push_back(*it);
+                    m_dynamicChanged = true;
+                }
+            }
+
+            if (m_spec.soname && sonameIndex < 0) {
+                m_dynamic.push_back({DT_SONAME, 0});
+                describe(m_dynamic.size() - 1, "add DT_SONAME '" + *m_spec.soname + "'");
+                editFor(*m_spec.soname, false, 0).dynIndices.push_back(m_dynamic.size() - 1);
+            }
+
+            // Symbol versioning names the needed library by its DT_NEEDED string as well.
+            forEachVerneed([&](std::uint64_t fieldOffset, std::uint32_t fileName) {
+                auto it = m_spec.neededRenames.find(str(fileName));
+                if (it != m_spec.neededRenames.end() && it->second != it->first) {
+                    editFor(it->second, true, fileName).verneedFields.push_back(fieldOffset);
+                }
+            }, nullptr);
+        }
+
+        void describe(std::size_t dynIndex, const std::string& text) {
+            m_descriptions[dynIndex] += (m_descriptions[dynIndex].empty() ? "" : "; ") + text;
+        }
+
+        // Walks .gnu.version_r, reporting each vn_file field and each vna_name value.
+        template <typename FileFn, typename NameFn>
+        void forEachVerneed(FileFn onFile, NameFn onName) const {
+            std::uint64_t addr = 0, count = 0;
+            for (const auto& entry : m_dynamic) {
+                if (entry.tag == DT_VERNEED) addr = entry.val;
+                if (entry.tag == DT_VERNEEDNUM) count = entry.val;
+            }
+            if (addr == 0) {
+                return;
+            }
+            std::uint64_t offset = m_elf.vaddrToOffset(addr);
+            for (std::uint64_t n = 0; n < count; ++n) {
+                if (offset + sizeof(Elf64_Verneed) > m_source.size()) {
+                    throw std::runtime_error("Version needs out of bounds in: " + m_name.string());
+                }
+                const std::uint8_t* vn = m_source.data() + offset;
+                onFile(offset + offsetof(Elf64_Verneed, vn_file), ELF_FIELD(Elf64_Verneed, vn, vn_file));
+                if constexpr (!std::is_same<NameFn, std::nullptr_t>::value) {
+                    std::uint64_t auxOffset = offset + ELF_FIELD(Elf64_Verneed, vn, vn_aux);
+                    for (std::uint16_t a = 0; a < ELF_FIELD(Elf64_Verneed, vn, vn_cnt); ++a) {
+                        if (auxOffset + sizeof(Elf64_Vernaux) > m_source.size()) {
+                            throw std::runtime_error("Version needs out of bounds in: " + m_name.string());
+                        }
+                        const std::uint8_t* aux = m_source.data() + auxOffset;
+                        onName(ELF_FIELD(Elf64_Vernaux, aux, vna_name));
+                        const std::uint32_t next = ELF_FIELD(Elf64_Vernaux, aux, vna_next);
+                        if (next == 0) break;
+                        auxOffset += next;
+                    }
+                }
+                const std::uint32_t next = ELF_FIELD(Elf64_Verneed, vn, vn_next);
+                if (next == 0) break;
+                offset += next;
+            }
+        }
+
+        // Gathers every .dynstr reference, tagged with the edit that will retarget it (or -1).
+        // Returns false if the symbol table could not be enumerated.
+        bool collectReferences(std::vector<std::pair<std::uint64_t, int>>& refs) const {
+            auto editIndexOfDyn = [&](std::size_t i) {
+                for (std::size_t e = 0; e < m_edits.size(); ++e) {
+                    const auto& idx = m_edits[e].dynIndices;
+                    if (std::find(idx.begin(), idx.end(), i) != idx.end()) return static_cast<int>(e);
+                }
+                return -1;
+            };
+            for (std::size_t i = 0; i < m_dynamic.size(); ++i) {
+                if (isStringTag(m_dynamic[i].tag)
+                    && std::find(m_removed.begin(), m_removed.end(), i) == m_removed.end()) {
+                    int e = editIndexOfDyn(i);
+                    if (e >= 0 && !m_edits[e].hasOld) continue;
+                    refs.emplace_back(m_dynamic[i].val, e);
+                }
+            }
+
+            forEachVerneed([&](std::uint64_t fieldOffset, std::uint32_t fileName) {
+                int owner = -1;
+                for (std::size_t e = 0; e < m_edits.size(); ++e) {
+                    const auto& f = m_edits[e].verneedFields;
+                    if (std::find(f.begin(), f.end(), fieldOffset) != f.end()) owner = static_cast<int>(e);
+                }
+                refs.emplace_back(fileName, owner);
+            }, [&](std::uint32_t name) {
+                refs.emplace_back(name, -1);
+            });
+
+            // Version definitions.
+            std::uint64_t verdefAddr = 0, verdefCount = 0, hashAddr = 0;
+            for (const auto& entry : m_dynamic) {
+                if (entry.tag == DT_VERDEF) verdefAddr = entry.val;
+                if (entry.tag == DT_VERDEFNUM) verdefCount = entry.val;
+                if (entry.tag == DT_HASH) hashAddr = entry.val;
+            }
+            if (verdefAddr != 0) {
+                std::uint64_t offset = m_elf.vaddrToOffset(verdefAddr);
+                for (std::uint64_t n = 0; n < verdefCount && offset + sizeof(Elf64_Verdef) <= m_source.size(); ++n) {
+                    const std::uint8_t* vd = m_source.data() + offset;
+                    std::uint64_t auxOffset = offset + ELF_FIELD(Elf64_Verdef, vd, vd_aux);
+                    for (std::uint16_t a = 0; a < ELF_FIELD(Elf64_Verdef, vd, vd_cnt)
+                                              && auxOffset + sizeof(Elf64_Verdaux) <= m_source.size(); ++a) {
+                        const std::uint8_t* aux = m_source.data() + auxOffset;
+                        refs.emplace_back(ELF_FIELD(Elf64_Verdaux, aux, vda_name), -1);
+                        const std::uint32_t next = ELF_FIELD(Elf64_Verdaux, aux, vda_next);
+                        if (next == 0) break;
+                        auxOffset += next;
+                    }
+                    const std::uint32_t next = ELF_FIELD(Elf64_Verdef, vd, vd_next);
+                    if (next == 0) break;
+                    offset += next;
+                }
+            }
+
+            // Dynamic symbols, counted from the section header or, failing that, DT_HASH.
+            std::uint64_t symOffset = 0, symCount = 0;
+            for (const auto& sh : m_elf.sectionHeaders()) {
+                if (sh.type == SHT_DYNSYM && sh.entsize != 0) {
+                    symOffset = sh.offset;
+                    symCount = sh.size / sh.entsize;
+                }
+            }
+            if (symCount == 0 && hashAddr != 0) {
+                for (const auto& entry : m_dynamic) {
+                    if (entry.tag == DT_SYMTAB) symOffset = m_elf.vaddrToOffset(entry.val);
+                }
+                const std::uint64_t hashOffset = m_elf.vaddrToOffset(hashAddr);
+                if (symOffset != 0 && hashOffset + 8 <= m_source.size()) {
+                    symCount = ByteOrder::load<std::uint32_t>(m_source.data() + hashOffset + 4, m_bigEndian);
+                }
+            }
+            if (symCount == 0) {
+                return false;
+            }
+            const std::size_t symSize = m_is64Bit ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+            if (symOffset + symCount * symSize > m_source.size()) {
+                return false;
+            }
+            for (std::uint64_t i = 0; i < symCount; ++i) {
+                refs.emplace_back(ByteOrder::load<std::uint32_t>(m_source.data() + symOffset + i * symSize, m_bigEndian), -1);
+            }
+            return true;
+        }
+
+        void allocateStrings() {
+            const std::string original = m_strtab;
+
+            // 1. Reuse an identical string (or a suffix of a longer one) already in .dynstr.
+            std::vector<std::pair<std::uint64_t, std::uint64_t>> pinned;
+            std::vector<bool> placed(m_edits.size(), false);
+            for (std::size_t e = 0; e < m_edits.size(); ++e) {
+                const std::string needle = m_edits[e].newValue + '\0';
+                std::size_t pos = original.find(needle);
+                if (pos != std::string::npos && !m_edits[e].newValue.empty()) {
+                    m_edits[e].newOffset = pos;
+                    placed[e] = true;
+                    pinned.emplace_back(pos, needle.size());
+                }
+            }
+
+            // 2. Overwrite the old string in place if nothing else points into it and the new one fits.
+            std::vector<std::pair<std::uint64_t, int>> refs;
+            const bool refsComplete = collectReferences(refs);
+            for (std::size_t e = 0; e < m_edits.size() && refsComplete; ++e) {
+                StringEdit& edit = m_edits[e];
+                if (placed[e] || !edit.hasOld) {
+                    continue;
+                }
+                const std::uint64_t oldLength = str(edit.oldOffset).size();
+                if (edit.newValue.size() > oldLength) {
+                    continue;
+                }
+                const std::uint64_t begin = edit.oldOffset, end = edit.oldOffset + oldLength + 1;
+                bool exclusive = std::none_of(refs.begin(), refs.end(), [&](const auto& ref) {
+                    return ref.first >= begin && ref.first < end && ref.second != static_cast<int>(e);
+                });
+                exclusive = exclusive && std::none_of(pinned.begin(), pinned.end(), [&](const auto& pin) {
+                    return pin.first < end && begin < pin.first + pin.second;
+                });
+                if (exclusive) {
+                    std::memset(&m_strtab[begin], 0, oldLength);
+                    std::memcpy(&m_strtab[begin], edit.newValue.data(), edit.newValue.size());
+                    edit.newOffset = begin;
+                    placed[e] = true;
+                    pinned.emplace_back(begin, oldLength + 1);
+                }
+            }
+
+            // 3. Append everything else.
+            for (std::size_t e = 0; e < m_edits.size(); ++e) {
+                if (placed[e]) {
+                    continue;
+                }
+                bool shared = false;
+                for (std::size_t prior = 0; prior < e; ++prior) {
+                    if (m_edits[prior].newValue == m_edits[e].newValue && m_edits[prior].newOffset >= m_originalStrtabSize) {
+                        m_edits[e].newOffset = m_edits[prior].newOffset;
+                        shared = true;
+                        break;
+                    }
+                }
+                if (!shared) {
+                    m_edits[e].newOffset = m_strtab.size();
+                    m_strtab += m_edits[e].newValue;
+                    m_strtab += '\0';
+                }
+            }
+        }
+
+        void rebuildDynamic() {
+            for (const auto& edit : m_edits) {
+                for (std::size_t i : edit.dynIndices) {
+                    m_dynamic[i].val = edit.newOffset;
+                }
+            }
+            std::vector<ElfDynamicEntry> rebuilt;
+            std::map<std::size_t, std::string> descriptions;
+            for (std::size_t i = 0; i < m_dynamic.size(); ++i) {
+                if (std::find(m_removed.begin(), m_removed.end(), i) != m_removed.end()) {
+                    continue;
+                }
+                if (m_descriptions.count(i)) {
+                    descriptions[rebuilt.size()] = m_descriptions[i];
+                }
+                rebuilt.push_back(m_dynamic[i]);
+            }
+            m_dynamic = std::move(rebuilt);
+            m_descriptions = std::move(descriptions);
+        }
+
+        void layout() {
+            const auto& phdrs = m_elf.programHeaders();
+            const ElfProgramHeader& dynPh = phdrs[m_elf.dynamicSegmentIndex()];
+            const std::uint64_t dynCapacity = dynPh.filesz / m_dynEntSize;
+            const std::uint64_t dynCount = m_dynamic.size() + 1;
+            const bool strtabGrew = m_strtab.size() > m_originalStrtabSize;
+            const bool moveDynamic = dynCount > dynCapacity;
+
+            // Version needs and removed-entry bookkeeping are written in place regardless of layout.
+            for (const auto& edit : m_edits) {
+                for (std::uint64_t field : edit.verneedFields) {
+                    std::uint8_t bytes[4];
+                    ByteOrder::store<std::uint32_t>(bytes, static_cast<std::uint32_t>(edit.newOffset), m_bigEndian);
+                    write(field, bytes, 4, "vn_file -> '" + edit.newValue + "'");
+                }
+            }
+
+            if (!strtabGrew && !moveDynamic) {
+                writeStrtabInPlace();
+                writeDynamic(dynPh.offset, dynCapacity);
+                return;
+            }
+
+            m_plan.relayout = true;
+
+            // Place a new PT_LOAD past everything that is mapped, keeping vaddr - offset equal to the
+            // first segment's so that the program headers are found the same way they always were.
+            std::uint64_t maxAlign = 0, vaddrEnd = 0, firstVaddr = 0, firstOffset = 0;
+            int lastLoad = -1, nullSlot = -1;
+            for (std::size_t i = 0; i < phdrs.size(); ++i) {
+                const auto& ph = phdrs[i];
+                if (ph.type == PT_LOAD) {
+                    if (lastLoad < 0) {
+                        firstVaddr = ph.vaddr;
+                        firstOffset = ph.offset;
+                    }
+                    lastLoad = static_cast<int>(i);
+                    maxAlign = std::max(maxAlign, ph.align);
+                    vaddrEnd = std::max(vaddrEnd, ph.vaddr + ph.memsz);
+                } else if (ph.type == PT_NULL && nullSlot < 0) {
+                    nullSlot = static_cast<int>(i);
+                }
+            }
+            if (lastLoad < 0) {
+                throw std::runtime_error("No PT_LOAD segment in: " + m_name.string());
+            }
+            const std::uint64_t pageAlign = std::clamp<std::uint64_t>(maxAlign, 0x1000, 0x10000);
+            const std::uint64_t delta = firstVaddr - firstOffset;
+            const std::uint64_t newOffset = alignUp(std::max<std::uint64_t>(m_image.size(), vaddrEnd - delta), pageAlign);
+            const std::uint64_t newVaddr = newOffset + delta;
+
+            std::vector<ElfProgramHeader> newPhdrs = phdrs;
+            const bool movePhdrs = nullSlot < 0;
+            std::uint64_t cursor = 0;
+            std::uint64_t phdrAt = 0;
+            if (movePhdrs) {
+                phdrAt = cursor;
+                cursor += (phdrs.size() + 1) * m_phEntSize;
+            }
+            const std::uint64_t strtabAt = cursor;
+            cursor += m_strtab.size();
+            std::uint64_t dynamicAt = 0;
+            if (moveDynamic) {
+                cursor = alignUp(cursor, m_is64Bit ? 8 : 4);
+                dynamicAt = cursor;
+                cursor += dynCount * m_dynEntSize;
+            }
+
+            ElfProgramHeader load;
+            load.type = PT_LOAD;
+            load.flags = PF_R | (moveDynamic ? PF_W : 0);
+            load.offset = newOffset;
+            load.vaddr = load.paddr = newVaddr;
+            load.filesz = load.memsz = cursor;
+            load.align = pageAlign;
+            // PT_LOADs must stay in ascending vaddr order, so the new one always follows the last;
+            // a spare PT_NULL anywhere in the table makes room for it by shifting what lies between.
+            newPhdrs.insert(newPhdrs.begin() + lastLoad + 1, load);
+            if (!movePhdrs) {
+                newPhdrs.erase(newPhdrs.begin() + nullSlot + (nullSlot > lastLoad ? 1 : 0));
+            }
+
+            for (auto& ph : newPhdrs) {
+                if (ph.type == PT_PHDR && movePhdrs) {
+                    ph.offset = newOffset + phdrAt;
+                    ph.vaddr = ph.paddr = newVaddr + phdrAt;
+                    ph.filesz = ph.memsz = newPhdrs.size() * m_phEntSize;
+                } else if (ph.type == PT_DYNAMIC && moveDynamic) {
+                    ph.offset = newOffset + dynamicAt;
+                    ph.vaddr = ph.paddr = newVaddr + dynamicAt;
+                    ph.filesz = ph.memsz = dynCount * m_dynEntSize;
+                }
+            }
+            if (newPhdrs.size() >= PN_XNUM) {
+                throw std::runtime_error("Too many program headers in: " + m_name.string());
+            }
+
+            for (auto& entry : m_dynamic) {
+                if (entry.tag == DT_STRTAB) entry.val = newVaddr + strtabAt;
+                if (entry.tag == DT_STRSZ) entry.val = m_strtab.size();
+            }
+
+            m_image.resize(newOffset + cursor, 0);
+            m_plan.changes.push_back({m_plan.originalSize, newOffset - m_plan.originalSize + cursor,
+                                      "new PT_LOAD at vaddr " + hex(newVaddr) + " (" + std::to_string(cursor) + " bytes)"});
+
+            if (movePhdrs) {
+                std::vector<std::uint8_t> table(newPhdrs.size() * m_phEntSize);
+                for (std::size_t i = 0; i < newPhdrs.size(); ++i) {
+                    storeProgramHeader(table.data() + i * m_phEntSize, newPhdrs[i]);
+                }
+                std::memcpy(m_image.data() + newOffset + phdrAt, table.data(), table.size());
+                std::uint8_t* ehdr = m_image.data();
+                if (m_is64Bit) {
+                    ELF_STORE(Elf64_Ehdr, ehdr, e_phoff, newOffset + phdrAt);
+                    ELF_STORE(Elf64_Ehdr, ehdr, e_phnum, newPhdrs.size());
+                } else {
+                    ELF_STORE(Elf32_Ehdr, ehdr, e_phoff, newOffset + phdrAt);
+                    ELF_STORE(Elf32_Ehdr, ehdr, e_phnum, newPhdrs.size());
+                }
+                m_plan.changes.push_back({0, m_is64Bit ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr),
+                                          "e_phoff -> " + hex(newOffset + phdrAt) + ", e_phnum -> " + std::to_string(newPhdrs.size())});
+            } else {
+                // A spare PT_NULL entry made room for the new segment, so the table stays where it is.
+                for (std::size_t i = 0; i < newPhdrs.size(); ++i) {
+                    std::vector<std::uint8_t> entry(m_phEntSize);
+                    storeProgramHeader(entry.data(), newPhdrs[i]);
+                    write(phdrTableOffset() + i * m_phEntSize, entry.data(), entry.size(),
+                          "program header " + std::to_string(i) + " (type " + hex(newPhdrs[i].type) + ")");
+                }
+            }
+
+            std::memcpy(m_image.data() + newOffset + strtabAt, m_strtab.data(), m_strtab.size());
+            updateSection(SHT_STRTAB, m_strtabOffset, newOffset + strtabAt, newVaddr + strtabAt, m_strtab.size());
+
+            if (moveDynamic) {
+                writeDynamic(newOffset + dynamicAt, dynCount);
+                updateSection(SHT_DYNAMIC, dynPh.offset, newOffset + dynamicAt, newVaddr + dynamicAt, dynCount * m_dynEntSize);
+            } else {
+                writeDynamic(dynPh.offset, dynCapacity);
+            }
+        }
+
+        std::uint64_t phdrTableOffset() const {
+            const std::uint8_t* ehdr = m_source.data();
+            return m_is64Bit ? ELF_FIELD(Elf64_Ehdr, ehdr, e_phoff) : ELF_FIELD(Elf32_Ehdr, ehdr, e_phoff);
+        }
+
+        void writeStrtabInPlace() {
+            const char* before = reinterpret_cast<const char*>(m_source.data()) + m_strtabOffset;
+            std::size_t i = 0;
+            while (i < m_strtab.size()) {
+                if (before[i] == m_strtab[i]) {
+                    ++i;
+                    continue;
+                }
+                std::size_t j = i;
+                while (j < m_strtab.size() && before[j] != m_strtab[j]) {
+                    ++j;
+                }
+                write(m_strtabOffset + i, m_strtab.data() + i, j - i, ".dynstr in place");
+                i = j;
+            }
+        }
+
+        void writeDynamic(std::uint64_t offset, std::uint64_t slots) {
+            for (std::uint64_t i = 0; i < slots; ++i) {
+                ElfDynamicEntry entry = i < m_dynamic.size() ? m_dynamic[i] : ElfDynamicEntry{DT_NULL, 0};
+                std::uint8_t bytes[sizeof(Elf64_Dyn)] = {};
+                std::uint8_t* p = bytes;
+                if (m_is64Bit) {
+                    ELF_STORE(Elf64_Dyn, p, d_tag, entry.tag);
+                    ELF_STORE(Elf64_Dyn, p, d_un.d_val, entry.val);
+                } else {
+                    ELF_STORE(Elf32_Dyn, p, d_tag, entry.tag);
+                    ELF_STORE(Elf32_Dyn, p, d_un.d_val, entry.val);
+                }
+                auto it = m_descriptions.find(i);
+                std::string what = it != m_descriptions.end()
+                    ? it->second
+                    : ElfFile::dynamicTagName(entry.tag) + " = " + hex(entry.val);
+                write(offset + i * m_dynEntSize, bytes, m_dynEntSize, what);
+            }
+        }
+
+        void storeProgramHeader(std::uint8_t* p, const ElfProgramHeader& ph) const {
+            if (m_is64Bit) {
+                ELF_STORE(Elf64_Phdr, p, p_type, ph.type);
+                ELF_STORE(Elf64_Phdr, p, p_flags, ph.flags);
+                ELF_STORE(Elf64_Phdr, p, p_offset, ph.offset);
+                ELF_STORE(Elf64_Phdr, p, p_vaddr, ph.vaddr);
+                ELF_STORE(Elf64_Phdr, p, p_paddr, ph.paddr);
+                ELF_STORE(Elf64_Phdr, p, p_filesz, ph.filesz);
+                ELF_STORE(Elf64_Phdr, p, p_memsz, ph.memsz);
+                ELF_STORE(Elf64_Phdr, p, p_align, ph.align);
+            } else {
+                ELF_STORE(Elf32_Phdr, p, p_type, ph.type);
+                ELF_STORE(Elf32_Phdr, p, p_flags, ph.flags);
+                ELF_STORE(Elf32_Phdr, p, p_offset, ph.offset);
+                ELF_STORE(Elf32_Phdr, p, p_vaddr, ph.vaddr);
+                ELF_STORE(Elf32_Phdr, p, p_paddr, ph.paddr);
+                ELF_STORE(Elf32_Phdr, p, p_filesz, ph.filesz);
+                ELF_STORE(Elf32_Phdr, p, p_memsz, ph.memsz);
+                ELF_STORE(Elf32_Phdr, p, p_align, ph.align);
+            }
+        }
+
+        // Points the section header describing a moved table at its new location.
+        void updateSection(std::uint32_t type, std::uint64_t oldOffset, std::uint64_t newOffset,
+                           std::uint64_t newAddr, std::uint64_t newSize) {
+            const auto& sections = m_elf.sectionHeaders();
+            const std::uint8_t* ehdr = m_source.data();
+            const std::uint64_t shoff = m_is64Bit ? ELF_FIELD(Elf64_Ehdr, ehdr, e_shoff) : ELF_FIELD(Elf32_Ehdr, ehdr, e_shoff);
+            const std::size_t shentsize = m_is64Bit ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr);
+            for (std::size_t i = 0; i < sections.size(); ++i) {
+                if (sections[i].type != type || sections[i].offset != oldOffset) {
+                    continue;
+                }
+                std::vector<std::uint8_t> bytes(m_image.begin() + shoff + i * shentsize,
+                                                m_image.begin() + shoff + (i + 1) * shentsize);
+                std::uint8_t* p = bytes.data();
+                if (m_is64Bit) {
+                    ELF_STORE(Elf64_Shdr, p, sh_offset, newOffset);
+                    ELF_STORE(Elf64_Shdr, p, sh_addr, newAddr);
+                    ELF_STORE(Elf64_Shdr, p, sh_size, newSize);
+                } else {
+                    ELF_STORE(Elf32_Shdr, p, sh_offset, newOffset);
+                    ELF_STORE(Elf32_Shdr, p, sh_addr, newAddr);
+                    ELF_STORE(Elf32_Shdr, p, sh_size, newSize);
+                }
+                write(shoff + i * shentsize, bytes.data(), bytes.size(),
+                      std::string(type == SHT_DYNAMIC ? ".dynamic" : ".dynstr") + " section header -> " + hex(newOffset));
+            }
+        }
+
+        // Copies bytes into the image, recording the change only if something actually differs.
+        void write(std::uint64_t offset, const void* bytes, std::size_t size, const std::string& what) {
+            if (offset + size > m_image.size()) {
+                throw std::runtime_error("Patch write out of bounds in: " + m_name.string());
+            }
+            if (std::memcmp(m_image.data() + offset, bytes, size) == 0) {
+                return;
+            }
+            std::memcpy(m_image.data() + offset, bytes, size);
+            if (offset < m_plan.originalSize) {
+                m_plan.changes.push_back({offset, size, what});
+            }
+        }
+
+        const std::vector<std::uint8_t>& m_source;    // Original bytes; the parser points into these
+        std::vector<std::uint8_t>& m_image;           // Patched bytes
+        const ElfPatchSpec& m_spec;
+        std::filesystem::path m_name;
+        ElfFile m_elf;
+        ElfPatchPlan m_plan;
+
+        bool m_bigEndian = false;
+        bool m_is64Bit = false;
+        std::size_t m_dynEntSize = 0;
+        std::size_t m_phEntSize = 0;
+
+        std::vector<ElfDynamicEntry> m_dynamic;
+        std::map<std::size_t, std::string> m_descriptions;
+        std::vector<std::size_t> m_removed;
+        bool m_dynamicChanged = false;
+
+        std::uint64_t m_strtabOffset = 0;
+        std::string m_strtab;
+        std::size_t m_originalStrtabSize = 0;
+        std::vector<StringEdit> m_edits;
+    };
+}
+
+ElfPatchPlan ElfPatcher::patch(std::vector<std::uint8_t>& image, const ElfPatchSpec& spec,
+                               const std::filesystem::path& name) {
+    // The parser keeps pointers into the original bytes, so edits go to a copy that may grow.
+    std::vector<std::uint8_t> working(image);
+    ElfPatchPlan plan = PatchJob(image, working, spec, name).run();
+    image.swap(working);
+    return plan;
+}
+
+static std::vector<std::uint8_t> readWholeFile(const std::filesystem::path& file) {
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("Could not open file: " + file.string());
+    }
+    std::vector<std::uint8_t> bytes(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0);
+    if (!bytes.empty() && !in.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) {
+        throw std::runtime_error("Could not read file: " + file.string());
+    }
+    return bytes;
+}
+
+ElfPatchPlan ElfPatcher::plan(const std::filesystem::path& file, const ElfPatchSpec& spec) {
+    std::vector<std::uint8_t> image = readWholeFile(file);
+    return patch(image, spec, file);
+}
+
+ElfPatchPlan ElfPatcher::apply(const std::filesystem::path& file, const ElfPatchSpec& spec) {
+    std::vector<std::uint8_t> image = readWholeFile(file);
+    ElfPatchPlan result = patch(image, spec, file);
+    if (!result.changed()) {
+        return result;
+    }
+
+    std::fstream out(file, std::ios::binary | std::ios::in | std::ios::out);
+    if (!out) {
+        throw std::runtime_error("Could not open file for writing: " + file.string());
+    }
+    if (result.relayout) {
+        out.write(reinterpret_cast<const char*>(image.data()), image.size());
+    } else {
+        // Same size: only the touched ranges need to go back to disk.
+        for (const auto& change : result.changes) {
+            out.seekp(change.offset);
+            out.write(reinterpret_cast<const char*>(image.data() + change.offset), change.size);
+        }
+    }
+    if (!out) {
+        throw std::runtime_error("Could not write file: " + file.string());
+    }
+    return result;
+}
+
+#undef ELF_FIELD
+#undef ELF_STORE
@@ -0,0 +1,83 @@
+// src/ElfPatcher.hpp
+#ifndef RELOCATOR_ELFPATCHER_HPP
+#define RELOCATOR_ELFPATCHER_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * @struct ElfPatchSpec
+ * @brief Every edit to apply to one ELF file.
+ */
+struct ElfPatchSpec {
+    std::optional<std::string> runpath;                  // New DT_RUNPATH; any DT_RPATH is dropped
+    std::map<std::string, std::string> neededRenames;    // Old DT_NEEDED value -> new value
+    std::optional<std::string> soname;                   // New DT_SONAME
+    std::set<std::string> neededRemovals;                // DT_NEEDED values to drop
+
+    bool empty() const { return !runpath && neededRenames.empty() && !soname && neededRemovals.empty(); }
+};
+
+/**
+ * @struct ElfByteChange
+ * @brief One contiguous range of bytes written by the patcher.
+ */
+struct ElfByteChange {
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+    std::string description;
+};
+
+/**
+ * @struct ElfPatchPlan
+ * @brief The exact byte-level effect of applying an ElfPatchSpec.
+ */
+struct ElfPatchPlan {
+    std::vector<ElfByteChange> changes;    // Sorted by offset
+    std::uint64_t originalSize = 0;
+    std::uint64_t newSize = 0;
+    bool relayout = false;                 // True if .dynstr (and possibly .dynamic) moved to a new PT_LOAD
+
+    bool changed() const { return !changes.empty(); }
+};
+
+/**
+ * @class ElfPatcher
+ * @brief Applies RUNPATH, DT_NEEDED and SONAME edits to an ELF file in a single pass.
+ *
+ * Strings are reused from .dynstr when an identical string (or suffix) already
+ * exists, overwritten in place when the old string is not shared and the new
+ * one fits, and otherwise appended to a copy of .dynstr placed in a new
+ * PT_LOAD segment at the end of the file. The dynamic section is only moved
+ * when it has no spare slot for an added entry.
+ */
+class ElfPatcher {
+public:
+    /**
+     * Computes the changes without touching the file.
+     * @throws std::runtime_error if the file is not a dynamic ELF object.
+     */
+    static ElfPatchPlan plan(const std::filesystem::path& file, const ElfPatchSpec& spec);
+
+    /**
+     * Reads the file once, applies all edits in memory and writes the result back once.
+     * @throws std::runtime_error on parse or I/O errors.
+     */
+    static ElfPatchPlan apply(const std::filesystem::path& file, const ElfPatchSpec& spec);
+
+    /**
+     * Applies all edits to an in-memory ELF image, growing it if needed.
+     * @param image The file contents; modified in place.
+     * @param spec The edits to apply.
+     * @param name A name used in error messages.
+     */
+    static ElfPatchPlan patch(std::vector<std::uint8_t>& image, const ElfPatchSpec& spec,
+                              const std::filesystem::path& name);
+};
+
+#endif //RELOCATOR_ELFPATCHER_HPP
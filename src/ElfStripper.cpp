@@ -0,0 +1,609 @@
+// src/ElfStripper.cpp
+#include "ElfStripper.hpp"
+#include "ByteOrder.hpp"
+#include "ElfFile.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include <elf.h>
+
+// Reads or writes one field of an on-disk ELF structure in the file's byte order.
+#define ELF_FIELD(Struct, base, member) \
+    ByteOrder::load<decltype(Struct::member)>((base) + offsetof(Struct, member), m_bigEndian)
+#define ELF_STORE(Struct, base, member, value) \
+    ByteOrder::store<decltype(Struct::member)>((base) + offsetof(Struct, member), \
+                                               static_cast<decltype(Struct::member)>(value), m_bigEndian)
+
+namespace {
+
+    std::uint64_t alignUp(std::uint64_t value, std::uint64_t alignment) {
+        return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+    }
+
+    bool startsWith(const std::string& s, const char* prefix) {
+        return s.rfind(prefix, 0) == 0;
+    }
+
+    // DWARF (plain or zlib-compressed), STABS and the gdb index; nothing the loader reads.
+    bool isDebugSection(const std::string& name) {
+        return startsWith(name, ".debug") || startsWith(name, ".zdebug") || startsWith(name, ".stab")
+            || name == ".gdb_index" || name == ".line";
+    }
+
+    /**
+     * The CRC-32 a .gnu_debuglink carries (the zlib polynomial).
+     */
+    class Crc32 {
+    public:
+        void update(const std::uint8_t* data, std::size_t size) {
+            static const std::array<std::uint32_t, 256> table = [] {
+                std::array<std::uint32_t, 256> entries{};
+                for (std::uint32_t i = 0; i < 256; ++i) {
+                    std::uint32_t c = i;
+                    for (int bit = 0; bit < 8; ++bit) {
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+                    entries[i] = c;
+                }
+                return entries;
+            }();
+            for (std::size_t i = 0; i < size; ++i) {
+                m_crc = table[(m_crc ^ data[i]) & 0xFF] ^ (m_crc >> 8);
+            }
+        }
+        std::uint32_t value() const { return ~m_crc; }
+
+    private:
+        std::uint32_t m_crc = 0xFFFFFFFFu;
+    };
+
+    /**
+     * An output written front to back in one pass, checksummed as it goes.
+     */
+    class OutputFile {
+    public:
+        explicit OutputFile(const std::filesystem::path& path) : m_path(path) {
+            // Unlinked first, so a hard link to the original is never written through.
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            m_out.open(path, std::ios::binary | std::ios::trunc);
+            if (!m_out) {
+                throw std::runtime_error("Could not create file: " + path.string());
+            }
+        }
+
+        void write(const void* data, std::size_t size) {
+            m_out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            m_crc.update(static_cast<const std::uint8_t*>(data), size);
+            m_offset += size;
+        }
+
+        // Zero-fills up to an aligned offset.
+        void padTo(std::uint64_t offset) {
+            static const std::uint8_t zeros[4096] = {};
+            while (m_offset < offset) {
+                write(zeros, static_cast<std::size_t>(std::min<std::uint64_t>(sizeof(zeros), offset - m_offset)));
+            }
+        }
+
+        void close() {
+            m_out.close();
+            if (!m_out) {
+                throw std::runtime_error("Could not write file: " + m_path.string());
+            }
+        }
+
+        std::uint64_t offset() const { return m_offset; }
+        std::uint32_t crc() const { return m_crc.value(); }
+
+    private:
+        std::filesystem::path m_path;
+        std::ofstream m_out;
+        std::uint64_t m_offset = 0;
+        Crc32 m_crc;
+    };
+
+    /**
+     * One section header of an output, and where its contents come from.
+     */
+    struct OutputSection {
+        ElfSectionHeader header;
+        std::uint64_t sourceOffset = 0;      // Contents in the original file, unless bytes is set
+        std::vector<std::uint8_t> bytes;     // Rewritten or added contents
+        bool rewritten = false;
+        bool inPlace = false;                // Inside the copied loaded part of the file; not moved
+    };
+
+    /**
+     * Holds the state of stripping one file.
+     */
+    class StripJob {
+    public:
+        StripJob(const ElfFile& elf, const StripSpec& spec)
+            : m_elf(elf), m_spec(spec), m_bigEndian(elf.isBigEndian()), m_is64Bit(elf.is64Bit()),
+              m_ehdrSize(m_is64Bit ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr)),
+              m_phentSize(m_is64Bit ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr)),
+              m_shentSize(m_is64Bit ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr)) {}
+
+        /**
+         * Decides which sections go.
+         * @return false if none do, or the file cannot be stripped without relinking it.
+         */
+        bool plan() {
+            const std::uint8_t* ehdr = m_elf.data();
+            const auto& sections = m_elf.sectionHeaders();
+            if ((m_elf.type() != ET_EXEC && m_elf.type() != ET_DYN) || sections.size() < 2) {
+                return false;
+            }
+            std::uint32_t shnum, phnum;
+            if (m_is64Bit) {
+                shnum = ELF_FIELD(Elf64_Ehdr, ehdr, e_shnum);
+                phnum = ELF_FIELD(Elf64_Ehdr, ehdr, e_phnum);
+                m_phoff = ELF_FIELD(Elf64_Ehdr, ehdr, e_phoff);
+                m_shstrndx = ELF_FIELD(Elf64_Ehdr, ehdr, e_shstrndx);
+            } else {
+                shnum = ELF_FIELD(Elf32_Ehdr, ehdr, e_shnum);
+                phnum = ELF_FIELD(Elf32_Ehdr, ehdr, e_phnum);
+                m_phoff = ELF_FIELD(Elf32_Ehdr, ehdr, e_phoff);
+                m_shstrndx = ELF_FIELD(Elf32_Ehdr, ehdr, e_shstrndx);
+            }
+            if (shnum == 0 || phnum == PN_XNUM || m_shstrndx == SHN_UNDEF || m_shstrndx >= sections.size()
+                || sections[m_shstrndx].type != SHT_STRTAB) {
+                return false;   // Extended numbering, or no section names to go by
+            }
+
+            const ElfSectionHeader& names = sections[m_shstrndx];
+            for (const auto& section : sections) {
+                if (section.type == SHT_GROUP || section.type == SHT_SYMTAB_SHNDX) {
+                    return false;
+                }
+                if (section.type != SHT_NOBITS && (section.offset > m_elf.size() || section.size > m_elf.size() - section.offset)) {
+                    throw std::runtime_error("Section data out of bounds in: " + m_elf.path().string());
+                }
+                m_names.push_back(section.name < names.size
+                                  ? m_elf.stringAt(names.offset + section.name, names.offset + names.size)
+                                  : std::string());
+            }
+
+            const std::size_t count = sections.size();
+            m_removed.assign(count, false);
+            std::size_t symtab = 0;
+            for (std::size_t i = 1; i < count; ++i) {
+                if (sections[i].flags & SHF_ALLOC) {
+                    continue;
+                }
+                if (isDebugSection(m_names[i])) {
+                    m_removed[i] = true;
+                } else if (sections[i].type == SHT_SYMTAB) {
+                    symtab = i;
+                    m_removed[i] = m_spec.mode == StripMode::All;
+                } else if (m_names[i] == ".gnu_debuglink" && !m_spec.debugFile.empty()) {
+                    m_removed[i] = true;    // Replaced by a link to the new debug file
+                }
+            }
+            // Relocations kept by --emit-relocs go with the section or symbol table they refer to.
+            for (std::size_t i = 1; i < count; ++i) {
+                const ElfSectionHeader& section = sections[i];
+                if ((section.type == SHT_REL || section.type == SHT_RELA) && !(section.flags & SHF_ALLOC)
+                    && ((section.info < count && m_removed[section.info]) || (section.link < count && m_removed[section.link]))) {
+                    m_removed[i] = true;
+                }
+            }
+            // .strtab goes with .symtab unless something else still names it.
+            if (symtab != 0 && m_removed[symtab]) {
+                const std::uint32_t strtab = sections[symtab].link;
+                bool used = strtab == 0 || strtab >= count || strtab == m_shstrndx || (sections[strtab].flags & SHF_ALLOC);
+                for (std::size_t i = 1; i < count && !used; ++i) {
+                    used = !m_removed[i] && i != strtab && sections[i].link == strtab;
+                }
+                if (!used) {
+                    m_removed[strtab] = true;
+                }
+            }
+
+            // Loaded sections keep their indices, so .dynsym stays valid without being rewritten.
+            std::size_t lastLoaded = 0;
+            for (std::size_t i = 1; i < count; ++i) {
+                if (sections[i].flags & SHF_ALLOC) {
+                    lastLoaded = i;
+                }
+            }
+            for (std::size_t i = 1; i <= lastLoaded; ++i) {
+                if (m_removed[i]) {
+                    return false;
+                }
+            }
+            // An old .gnu_debuglink alone is not worth a new debug file.
+            m_removedCount = static_cast<std::size_t>(std::count(m_removed.begin(), m_removed.end(), true));
+            for (std::size_t i = 1; i < count; ++i) {
+                if (m_removed[i] && m_names[i] == ".gnu_debuglink" && m_removedCount == 1) {
+                    return false;
+                }
+            }
+            if (m_removedCount == 0) {
+                return false;
+            }
+            m_newIndex.assign(count, SHN_UNDEF);
+            std::uint32_t next = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                if (!m_removed[i]) {
+                    m_newIndex[i] = next++;
+                }
+            }
+
+            // Everything up to the end of the last segment is copied as it is; so are the kept
+            // sections that start inside that range.
+            m_loadedEnd = std::max<std::uint64_t>(m_ehdrSize, m_phoff + std::uint64_t(phnum) * m_phentSize);
+            for (const auto& ph : m_elf.programHeaders()) {
+                m_loadedEnd = std::max(m_loadedEnd, ph.offset + ph.filesz);
+            }
+            std::vector<std::size_t> byOffset = sectionsByOffset();
+            for (std::size_t i : byOffset) {
+                const ElfSectionHeader& section = sections[i];
+                if (section.type != SHT_NOBITS
+                    && ((section.flags & SHF_ALLOC) || (!m_removed[i] && section.offset < m_loadedEnd))) {
+                    m_loadedEnd = std::max(m_loadedEnd, section.offset + section.size);
+                }
+            }
+            m_buildId = m_elf.buildId();
+            return true;
+        }
+
+        std::size_t removedCount() const { return m_removedCount; }
+        const std::string& buildId() const { return m_buildId; }
+
+        /**
+         * Writes every section, with the loaded ones as SHT_NOBITS placeholders, the way
+         * `objcopy --only-keep-debug` does. Notes stay, so the build ID can be matched.
+         */
+        void writeDebugFile(OutputFile& out) const {
+            const auto& sections = m_elf.sectionHeaders();
+            std::vector<OutputSection> outputs(sections.size());
+            for (std::size_t i = 0; i < sections.size(); ++i) {
+                outputs[i].header = sections[i];
+                outputs[i].sourceOffset = sections[i].offset;
+            }
+
+            const std::size_t phnum = m_elf.programHeaders().size();
+            std::uint64_t offset = m_ehdrSize + phnum * m_phentSize;
+            std::vector<std::size_t> order = sectionsByOffset();
+            for (std::size_t i : order) {
+                ElfSectionHeader& header = outputs[i].header;
+                if ((header.flags & SHF_ALLOC) && header.type != SHT_NOTE) {
+                    header.type = SHT_NOBITS;
+                }
+                if (header.type != SHT_NOBITS) {
+                    offset = alignUp(offset, header.addralign);
+                }
+                header.offset = offset;
+                if (header.type != SHT_NOBITS) {
+                    offset += header.size;
+                }
+            }
+            const std::uint64_t shoff = alignUp(offset, m_is64Bit ? 8 : 4);
+
+            // Segments keep their addresses but no contents, except for the headers and the notes.
+            const std::uint64_t headersEnd = m_ehdrSize + phnum * m_phentSize;
+            std::vector<std::uint8_t> phdrs(m_elf.data() + m_phoff, m_elf.data() + m_phoff + phnum * m_phentSize);
+            for (std::size_t n = 0; n < phnum; ++n) {
+                const ElfProgramHeader& ph = m_elf.programHeaders()[n];
+                std::uint64_t newOffset = ph.align > 1 ? ph.vaddr % ph.align : 0;
+                std::uint64_t newSize = 0;
+                if (ph.type == PT_PHDR) {
+                    newOffset = m_ehdrSize;
+                    newSize = phnum * m_phentSize;
+                } else if (ph.type == PT_LOAD && ph.offset == 0 && ph.filesz >= m_phoff + phnum * m_phentSize) {
+                    newOffset = 0;
+                    newSize = headersEnd;
+                } else if (ph.type == PT_NOTE) {
+                    std::uint64_t begin = UINT64_MAX, end = 0;
+                    for (std::size_t i = 0; i < sections.size(); ++i) {
+                        if (sections[i].type == SHT_NOTE && sections[i].offset >= ph.offset
+                            && sections[i].offset + sections[i].size <= ph.offset + ph.filesz) {
+                            begin = std::min(begin, outputs[i].header.offset);
+                            end = std::max(end, outputs[i].header.offset + outputs[i].header.size);
+                        }
+                    }
+                    if (begin < end) {
+                        newOffset = begin;
+                        newSize = end - begin;
+                    }
+                }
+                std::uint8_t* p = phdrs.data() + n * m_phentSize;
+                if (m_is64Bit) {
+                    ELF_STORE(Elf64_Phdr, p, p_offset, newOffset);
+                    ELF_STORE(Elf64_Phdr, p, p_filesz, newSize);
+                } else {
+                    ELF_STORE(Elf32_Phdr, p, p_offset, newOffset);
+                    ELF_STORE(Elf32_Phdr, p, p_filesz, newSize);
+                }
+            }
+
+            std::vector<std::uint8_t> ehdr(m_elf.data(), m_elf.data() + m_ehdrSize);
+            setSectionTable(ehdr, shoff, sections.size(), m_shstrndx);
+            std::uint8_t* e = ehdr.data();
+            if (m_is64Bit) {
+                ELF_STORE(Elf64_Ehdr, e, e_phoff, phnum ? m_ehdrSize : 0);
+            } else {
+                ELF_STORE(Elf32_Ehdr, e, e_phoff, phnum ? m_ehdrSize : 0);
+            }
+            out.write(ehdr.data(), ehdr.size());
+            out.write(phdrs.data(), phdrs.size());
+            for (std::size_t i : order) {
+                writeContents(out, outputs[i]);
+            }
+            writeSectionTable(out, shoff, outputs);
+        }
+
+        /**
+         * Writes the file without the removed sections. The loaded part is copied as it
+         * is; the kept sections behind it are packed, followed by a new .shstrtab, the
+         * .gnu_debuglink if there is a debug file, and the section header table.
+         */
+        void writeStripped(OutputFile& out, const std::string& debugLink, std::uint32_t debugCrc) const {
+            const auto& sections = m_elf.sectionHeaders();
+            std::vector<OutputSection> outputs;
+            std::string names(1, '\0');
+            auto addName = [&names](const std::string& name) {
+                if (name.empty()) {
+                    return std::uint32_t(0);
+                }
+                const auto offset = static_cast<std::uint32_t>(names.size());
+                names += name;
+                names += '\0';
+                return offset;
+            };
+
+            for (std::size_t i = 0; i < sections.size(); ++i) {
+                if (m_removed[i]) {
+                    continue;
+                }
+                OutputSection output;
+                output.header = sections[i];
+                output.sourceOffset = sections[i].offset;
+                output.header.name = addName(m_names[i]);
+                output.header.link = remap(output.header.link);
+                if (output.header.type == SHT_REL || output.header.type == SHT_RELA || (output.header.flags & SHF_INFO_LINK)) {
+                    output.header.info = remap(output.header.info);
+                }
+                output.inPlace = (sections[i].flags & SHF_ALLOC) || sections[i].offset < m_loadedEnd;
+                if (sections[i].type == SHT_SYMTAB && !output.inPlace) {
+                    output.bytes = remapSymbols(sections[i]);
+                    output.rewritten = true;
+                }
+                outputs.push_back(std::move(output));
+            }
+            if (!debugLink.empty()) {
+                // The debug file's name, NUL-padded to 4 bytes, then its CRC in the file's byte order.
+                OutputSection link;
+                link.header.name = addName(".gnu_debuglink");
+                link.header.type = SHT_PROGBITS;
+                link.header.addralign = 4;
+                link.bytes.assign(debugLink.begin(), debugLink.end());
+                link.bytes.resize(alignUp(debugLink.size() + 1, 4) + 4, 0);
+                ByteOrder::store<std::uint32_t>(link.bytes.data() + link.bytes.size() - 4, debugCrc, m_bigEndian);
+                link.rewritten = true;
+                link.sourceOffset = UINT64_MAX;     // Goes last
+                outputs.push_back(std::move(link));
+            }
+            OutputSection& shstrtab = outputs[m_newIndex[m_shstrndx]];
+            shstrtab.bytes.assign(names.begin(), names.end());
+            shstrtab.rewritten = true;
+            shstrtab.inPlace = false;
+
+            // Moved sections keep their relative order behind the loaded part.
+            std::vector<std::size_t> order(outputs.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&outputs](std::size_t a, std::size_t b) {
+                return outputs[a].sourceOffset < outputs[b].sourceOffset;
+            });
+            std::uint64_t offset = m_loadedEnd;
+            for (std::size_t i : order) {
+                OutputSection& output = outputs[i];
+                if (i == 0 || output.inPlace) {
+                    continue;
+                }
+                if (output.rewritten) {
+                    output.header.size = output.bytes.size();
+                }
+                if (output.header.type != SHT_NOBITS) {
+                    offset = alignUp(offset, output.header.addralign);
+                }
+                output.header.offset = offset;
+                if (output.header.type != SHT_NOBITS) {
+                    offset += output.header.size;
+                }
+            }
+            const std::uint64_t shoff = alignUp(offset, m_is64Bit ? 8 : 4);
+
+            std::vector<std::uint8_t> ehdr(m_elf.data(), m_elf.data() + m_ehdrSize);
+            setSectionTable(ehdr, shoff, outputs.size(), m_newIndex[m_shstrndx]);
+            out.write(ehdr.data(), ehdr.size());
+            out.write(m_elf.data() + m_ehdrSize, static_cast<std::size_t>(m_loadedEnd - m_ehdrSize));
+            for (std::size_t i : order) {
+                if (i != 0 && !outputs[i].inPlace) {
+                    writeContents(out, outputs[i]);
+                }
+            }
+            writeSectionTable(out, shoff, outputs);
+        }
+
+    private:
+        std::vector<std::size_t> sectionsByOffset() const {
+            const auto& sections = m_elf.sectionHeaders();
+            std::vector<std::size_t> order;
+            for (std::size_t i = 1; i < sections.size(); ++i) {
+                order.push_back(i);
+            }
+            std::stable_sort(order.begin(), order.end(), [&sections](std::size_t a, std::size_t b) {
+                return sections[a].offset < sections[b].offset;
+            });
+            return order;
+        }
+
+        std::uint32_t remap(std::uint32_t index) const {
+            return index < m_newIndex.size() ? m_newIndex[index] : index;
+        }
+
+        // Symbols of a removed section become undefined rather than being dropped, so that
+        // relocations kept by --emit-relocs still index the right symbols.
+        std::vector<std::uint8_t> remapSymbols(const ElfSectionHeader& symtab) const {
+            std::vector<std::uint8_t> bytes(m_elf.data() + symtab.offset, m_elf.data() + symtab.offset + symtab.size);
+            const std::size_t entSize = m_is64Bit ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+            for (std::size_t at = 0; at + entSize <= bytes.size(); at += entSize) {
+                std::uint8_t* p = bytes.data() + at;
+                const std::uint16_t index = m_is64Bit ? ELF_FIELD(Elf64_Sym, p, st_shndx) : ELF_FIELD(Elf32_Sym, p, st_shndx);
+                if (index == SHN_UNDEF || index >= SHN_LORESERVE) {
+                    continue;
+                }
+                const std::uint16_t mapped = index < m_newIndex.size() ? static_cast<std::uint16_t>(m_newIndex[index]) : SHN_UNDEF;
+                if (m_is64Bit) {
+                    ELF_STORE(Elf64_Sym, p, st_shndx, mapped);
+                } else {
+                    ELF_STORE(Elf32_Sym, p, st_shndx, mapped);
+                }
+            }
+            return bytes;
+        }
+
+        void setSectionTable(std::vector<std::uint8_t>& ehdr, std::uint64_t shoff, std::size_t shnum,
+                             std::uint32_t shstrndx) const {
+            std::uint8_t* e = ehdr.data();
+            if (m_is64Bit) {
+                ELF_STORE(Elf64_Ehdr, e, e_shoff, shoff);
+                ELF_STORE(Elf64_Ehdr, e, e_shnum, shnum);
+                ELF_STORE(Elf64_Ehdr, e, e_shstrndx, shstrndx);
+            } else {
+                ELF_STORE(Elf32_Ehdr, e, e_shoff, shoff);
+                ELF_STORE(Elf32_Ehdr, e, e_shnum, shnum);
+                ELF_STORE(Elf32_Ehdr, e, e_shstrndx, shstrndx);
+            }
+        }
+
+        void writeContents(OutputFile& out, const OutputSection& output) const {
+            if (output.header.type == SHT_NOBITS) {
+                return;
+            }
+            out.padTo(output.header.offset);
+            if (output.rewritten) {
+                out.write(output.bytes.data(), output.bytes.size());
+            } else {
+                out.write(m_elf.data() + output.sourceOffset, static_cast<std::size_t>(output.header.size));
+            }
+        }
+
+        void writeSectionTable(OutputFile& out, std::uint64_t shoff, const std::vector<OutputSection>& outputs) const {
+            out.padTo(shoff);
+            std::vector<std::uint8_t> table(outputs.size() * m_shentSize, 0);
+            for (std::size_t i = 0; i < outputs.size(); ++i) {
+                const ElfSectionHeader& sh = outputs[i].header;
+                std::uint8_t* p = table.data() + i * m_shentSize;
+                if (m_is64Bit) {
+                    ELF_STORE(Elf64_Shdr, p, sh_name, sh.name);
+                    ELF_STORE(Elf64_Shdr, p, sh_type, sh.type);
+                    ELF_STORE(Elf64_Shdr, p, sh_flags, sh.flags);
+                    ELF_STORE(Elf64_Shdr, p, sh_addr, sh.addr);
+                    ELF_STORE(Elf64_Shdr, p, sh_offset, sh.offset);
+                    ELF_STORE(Elf64_Shdr, p, sh_size, sh.size);
+                    ELF_STORE(Elf64_Shdr, p, sh_link, sh.link);
+                    ELF_STORE(Elf64_Shdr, p, sh_info, sh.info);
+                    ELF_STORE(Elf64_Shdr, p, sh_addralign, sh.addralign);
+                    ELF_STORE(Elf64_Shdr, p, sh_entsize, sh.entsize);
+                } else {
+                    ELF_STORE(Elf32_Shdr, p, sh_name, sh.name);
+                    ELF_STORE(Elf32_Shdr, p, sh_type, sh.type);
+                    ELF_STORE(Elf32_Shdr, p, sh_flags, sh.flags);
+                    ELF_STORE(Elf32_Shdr, p, sh_addr, sh.addr);
+                    ELF_STORE(Elf32_Shdr, p, sh_offset, sh.offset);
+                    ELF_STORE(Elf32_Shdr, p, sh_size, sh.size);
+                    ELF_STORE(Elf32_Shdr, p, sh_link, sh.link);
+                    ELF_STORE(Elf32_Shdr, p, sh_info, sh.info);
+                    ELF_STORE(Elf32_Shdr, p, sh_addralign, sh.addralign);
+                    ELF_STORE(Elf32_Shdr, p, sh_entsize, sh.entsize);
+                }
+            }
+            out.write(table.data(), table.size());
+        }
+
+        const ElfFile& m_elf;
+        const StripSpec& m_spec;
+        bool m_bigEndian;
+        bool m_is64Bit;
+        std::size_t m_ehdrSize;
+        std::size_t m_phentSize;
+        std::size_t m_shentSize;
+
+        std::uint64_t m_phoff = 0;
+        std::uint32_t m_shstrndx = 0;
+        std::vector<std::string> m_names;
+        std::vector<bool> m_removed;
+        std::vector<std::uint32_t> m_newIndex;   // SHN_UNDEF for removed sections
+        std::size_t m_removedCount = 0;
+        std::uint64_t m_loadedEnd = 0;           // End of the part copied as it is
+        std::string m_buildId;
+    };
+}
+
+std::optional<StripResult> ElfStripper::strip(const std::filesystem::path& source,
+                                              const std::filesystem::path& destination, const StripSpec& spec) {
+    if (spec.mode == StripMode::None) {
+        return std::nullopt;
+    }
+    const ElfFile elf(source);
+    StripJob job(elf, spec);
+    if (!job.plan()) {
+        return std::nullopt;
+    }
+
+    StripResult result;
+    result.originalSize = elf.size();
+    result.removedSections = job.removedCount();
+    result.buildId = job.buildId();
+    try {
+        // The debug file comes first: the stripped copy carries its CRC.
+        std::string debugLink;
+        std::uint32_t debugCrc = 0;
+        if (!spec.debugFile.empty()) {
+            std::filesystem::create_directories(spec.debugFile.parent_path());
+            OutputFile debug(spec.debugFile);
+            job.writeDebugFile(debug);
+            debug.close();
+            result.debugSize = debug.offset();
+            debugCrc = debug.crc();
+            debugLink = spec.debugLinkName.empty() ? spec.debugFile.filename().string() : spec.debugLinkName;
+
+            if (!spec.buildIdRoot.empty() && result.buildId.size() > 2) {
+                const std::filesystem::path byId = spec.buildIdRoot / ".build-id" / result.buildId.substr(0, 2)
+                                                 / (result.buildId.substr(2) + ".debug");
+                std::filesystem::create_directories(byId.parent_path());
+                std::error_code ec;
+                std::filesystem::remove(byId, ec);
+                std::filesystem::create_hard_link(spec.debugFile, byId, ec);
+                if (ec) {
+                    std::filesystem::copy_file(spec.debugFile, byId, std::filesystem::copy_options::overwrite_existing);
+                }
+            }
+        }
+
+        OutputFile out(destination);
+        job.writeStripped(out, debugLink, debugCrc);
+        out.close();
+        result.strippedSize = out.offset();
+        std::filesystem::permissions(destination, std::filesystem::status(source).permissions());
+    } catch (...) {
+        std::error_code ec;
+        std::filesystem::remove(destination, ec);
+        throw;
+    }
+    return result;
+}
+
+#undef ELF_FIELD
+#undef ELF_STORE
@@ -0,0 +1,63 @@
+// src/ElfStripper.hpp
+#ifndef RELOCATOR_ELFSTRIPPER_HPP
+#define RELOCATOR_ELFSTRIPPER_HPP
+
+#include "Relocator.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+/**
+ * @struct StripSpec
+ * @brief How one file is stripped.
+ */
+struct StripSpec {
+    StripMode mode = StripMode::Debug;
+    std::filesystem::path debugFile;     // Where the removed sections are kept; empty = discard them
+    std::filesystem::path buildIdRoot;   // With a debugFile, also link it as <root>/.build-id/xx/yyyy.debug
+    std::string debugLinkName;           // The name .gnu_debuglink carries; empty = debugFile's filename
+};
+
+/**
+ * @struct StripResult
+ * @brief What stripping one file wrote.
+ */
+struct StripResult {
+    std::uint64_t originalSize = 0;
+    std::uint64_t strippedSize = 0;
+    std::uint64_t debugSize = 0;         // 0 unless a debug file was written
+    std::size_t removedSections = 0;
+    std::string buildId;                 // NT_GNU_BUILD_ID in hex; empty if the file has none
+};
+
+/**
+ * @class ElfStripper
+ * @brief Writes a copy of an ELF executable or shared library without its debugging sections.
+ *
+ * Everything the loader maps is copied byte for byte; only the non-allocated sections
+ * behind it are laid out again, so the result needs no relocation and can still be
+ * patched by ElfPatcher. The source is read through a mapping and each output is
+ * written in one sequential pass, without running strip or objcopy.
+ *
+ * With a debug file, the removed sections are first written there in the layout of
+ * `objcopy --only-keep-debug`, and the stripped copy gets a .gnu_debuglink carrying
+ * that file's name and CRC. Debuggers find the file by the link, or by build ID when
+ * it is also linked under a .build-id directory.
+ */
+class ElfStripper {
+public:
+    /**
+     * Replaces destination with a stripped copy of source, preserving its permission bits.
+     * @return std::nullopt, having written nothing, if the file has nothing the mode removes,
+     *         or is laid out in a way that cannot be stripped without relinking it (relocatable
+     *         objects, section groups, extended section indices, or a removable section ahead
+     *         of a loaded one); copy such files as they are.
+     * @throws std::runtime_error if the source cannot be parsed or an output cannot be written.
+     */
+    static std::optional<StripResult> strip(const std::filesystem::path& source,
+                                             const std::filesystem::path& destination, const StripSpec& spec);
+};
+
+#endif //RELOCATOR_ELFSTRIPPER_HPP
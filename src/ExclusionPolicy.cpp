@@ -0,0 +1,348 @@
+// src/ExclusionPolicy.cpp
+#include "ExclusionPolicy.hpp"
+#include "Wildcard.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+    // Globs and regexes are bucketed by up to this many leading literal characters.
+    constexpr std::size_t kMaxKeyLength = 8;
+    // Alternatives per combined regex; keeps each automaton small enough for the backtracking matcher.
+    constexpr std::size_t kRegexGroupSize = 64;
+
+    const char* kindName(ExclusionKind kind) {
+        switch (kind) {
+            case ExclusionKind::Literal: return "literal";
+            case ExclusionKind::Glob:    return "glob";
+            case ExclusionKind::Prefix:  return "prefix";
+            case ExclusionKind::Regex:   return "regex";
+        }
+        return "?";
+    }
+
+    std::string normalizePrefix(std::string prefix) {
+        while (prefix.size() > 1 && prefix.back() == '/') {
+            prefix.pop_back();
+        }
+        return prefix;
+    }
+
+    // Renumbering capture groups would break a backreference, so such patterns stay on their own.
+    bool hasBackreference(const std::string& pattern) {
+        for (std::size_t i = 0; i + 1 < pattern.size(); ++i) {
+            if (pattern[i] == '\\') {
+                if (pattern[i + 1] >= '1' && pattern[i + 1] <= '9') return true;
+                ++i;
+            }
+        }
+        return false;
+    }
+
+    // The literal text every match of the regex starts with, or "" if there is none
+    // (e.g. a top-level '|' or a leading group).
+    std::string regexLiteralPrefix(const std::string& pattern) {
+        int depth = 0;
+        bool inClass = false;
+        for (std::size_t i = 0; i < pattern.size(); ++i) {
+            const char c = pattern[i];
+            if (c == '\\') {
+                ++i;
+            } else if (inClass) {
+                inClass = c != ']';
+            } else if (c == '[') {
+                inClass = true;
+            } else if (c == '(') {
+                ++depth;
+            } else if (c == ')') {
+                --depth;
+            } else if (c == '|' && depth == 0) {
+                return {};
+            }
+        }
+        std::string prefix;
+        std::size_t i = 0;
+        while (i < pattern.size() && prefix.size() < kMaxKeyLength
+               && std::string_view(".[]()*+?{}|^$\\").find(pattern[i]) == std::string_view::npos) {
+            prefix += pattern[i++];
+        }
+        // A quantifier makes the character before it optional.
+        if (!prefix.empty() && i < pattern.size() && (pattern[i] == '*' || pattern[i] == '?' || pattern[i] == '{')) {
+            prefix.pop_back();
+        }
+        return prefix;
+    }
+
+    // Looks up every bucket whose key is a prefix of name, up to the longest key.
+    template <typename Buckets, typename Visit>
+    void forEachPrefixBucket(const Buckets& buckets, std::size_t longestKey, const std::string& name, Visit&& visit) {
+        const std::size_t longest = std::min(longestKey, name.size());
+        for (std::size_t length = 0; length <= longest; ++length) {
+            auto bucket = buckets.find(name.substr(0, length));
+            if (bucket != buckets.end()) {
+                visit(bucket->second);
+            }
+        }
+    }
+}
+
+std::string ExclusionRule::describe() const {
+    return std::string(kindName(kind)) + " '" + pattern + "' (" + origin + ")";
+}
+
+void ExclusionPolicy::add(ExclusionKind kind, const std::string& pattern, const std::string& origin) {
+    if (m_compiled) {
+        throw std::logic_error("ExclusionPolicy::add called after compile()");
+    }
+    m_rules.push_back({ kind, kind == ExclusionKind::Prefix ? normalizePrefix(pattern) : pattern, origin });
+}
+
+void ExclusionPolicy::loadFile(const std::filesystem::path& file) {
+    std::ifstream in(file);
+    if (!in) {
+        throw std::runtime_error("Cannot read exclusion policy: " + file.string());
+    }
+    std::string line;
+    for (std::size_t number = 1; std::getline(in, line); ++number) {
+        std::istringstream fields(line);
+        std::string kind;
+        if (!(fields >> kind) || kind[0] == '#') {
+            continue;
+        }
+        std::string pattern;
+        std::getline(fields >> std::ws, pattern);
+        while (!pattern.empty() && (pattern.back() == '\r' || pattern.back() == ' ' || pattern.back() == '\t')) {
+            pattern.pop_back();
+        }
+        const std::string origin = file.filename().string() + ":" + std::to_string(number);
+        if (pattern.empty()) {
+            throw std::runtime_error(origin + ": missing pattern after '" + kind + "'");
+        }
+        if (kind == "literal") {
+            add(ExclusionKind::Literal, pattern, origin);
+        } else if (kind == "glob") {
+            add(ExclusionKind::Glob, pattern, origin);
+        } else if (kind == "prefix") {
+            add(ExclusionKind::Prefix, pattern, origin);
+        } else if (kind == "regex") {
+            add(ExclusionKind::Regex, pattern, origin);
+        } else {
+            throw std::runtime_error(origin + ": unknown rule kind '" + kind
+                                     + "' (expected literal, glob, prefix or regex)");
+        }
+    }
+}
+
+void ExclusionPolicy::addPlatformDefaults(TargetPlatform target) {
+    if (target == TargetPlatform::Host) {
+#if defined(__APPLE__)
+        target = TargetPlatform::MacOS;
+#elif defined(__linux__)
+        target = TargetPlatform::Linux;
+#elif defined(_WIN32)
+        target = TargetPlatform::Windows;
+#else
+        return;
+#endif
+    }
+    if (target == TargetPlatform::MacOS) {
+        // Install names under these directories live in the shared cache and are part of the OS.
+        add(ExclusionKind::Prefix, "/usr/lib", "built-in");
+        add(ExclusionKind::Prefix, "/System/Library", "built-in");
+    } else if (target == TargetPlatform::Linux) {
+        // Core C/C++ runtime and linker
+        for (const char* name : { "linux-vdso.so.1", "ld-linux-x86-64.so.2", "libc.so.6", "libdl.so.2",
+                                  "libm.so.6", "libpthread.so.0", "librt.so.1", "libgcc_s.so.1", "libstdc++.so.6",
+                                  "libresolv.so.2", "libcrypt.so.1" }) {
+            add(ExclusionKind::Literal, name, "built-in");
+        }
+    } else if (target == TargetPlatform::Windows) {
+        // API sets are virtual names the loader maps onto system DLLs; they never exist as files.
+        add(ExclusionKind::Glob, "api-ms-win-*", "built-in");
+        add(ExclusionKind::Glob, "ext-ms-*", "built-in");
+        // KnownDLLs are always loaded from System32, and the rest ship with every Windows since 10.
+        // Import names are matched lowercased against these.
+        for (const char* name : { "advapi32.dll", "clbcatq.dll", "combase.dll", "comdlg32.dll", "gdi32.dll",
+                                  "gdiplus.dll", "imagehlp.dll", "imm32.dll", "kernel32.dll", "msctf.dll",
+                                  "msvcrt.dll", "normaliz.dll", "nsi.dll", "ole32.dll", "oleaut32.dll",
+                                  "psapi.dll", "rpcrt4.dll", "sechost.dll", "setupapi.dll", "shcore.dll",
+                                  "shell32.dll", "shlwapi.dll", "user32.dll", "wldap32.dll", "ws2_32.dll",
+                                  "ntdll.dll", "kernelbase.dll", "ucrtbase.dll", "bcrypt.dll", "comctl32.dll",
+                                  "crypt32.dll", "dbghelp.dll", "dwmapi.dll", "dwrite.dll", "d2d1.dll", "d3d9.dll",
+                                  "d3d11.dll", "d3d12.dll", "dxgi.dll", "iphlpapi.dll", "mpr.dll", "netapi32.dll",
+                                  "opengl32.dll", "secur32.dll", "userenv.dll", "uxtheme.dll", "version.dll",
+                                  "winhttp.dll", "wininet.dll", "winmm.dll", "winspool.drv", "wtsapi32.dll" }) {
+            add(ExclusionKind::Literal, name, "built-in");
+        }
+    }
+}
+
+void ExclusionPolicy::compile() {
+    m_hits.reset(new std::atomic<std::uint64_t>[m_rules.size()]());
+
+    std::vector<std::size_t> pendingRegexes;
+    for (std::size_t i = 0; i < m_rules.size(); ++i) {
+        const ExclusionRule& rule = m_rules[i];
+        switch (rule.kind) {
+            case ExclusionKind::Literal:
+                m_literals.emplace(rule.pattern, i);
+                break;
+            case ExclusionKind::Prefix:
+                m_prefixes.emplace(rule.pattern, i);
+                break;
+            case ExclusionKind::Glob:
+                if (rule.pattern.find('/') != std::string::npos) {
+                    m_pathGlobs.push_back(i);
+                } else {
+                    const std::size_t literal = std::min(rule.pattern.find_first_of("*?["), rule.pattern.size());
+                    const std::string key = rule.pattern.substr(0, std::min(literal, kMaxKeyLength));
+                    m_nameGlobs[key].push_back(i);
+                    m_globKeyLength = std::max(m_globKeyLength, key.size());
+                }
+                break;
+            case ExclusionKind::Regex:
+                pendingRegexes.push_back(i);
+                break;
+        }
+    }
+
+    // Compile each regex alone first: it reports errors against the right rule and
+    // tells us how many groups it adds to the combined pattern.
+    struct PendingGroup {
+        RegexGroup group;
+        std::string alternation;
+        std::size_t nextGroup = 1;
+    };
+    std::unordered_map<std::string, PendingGroup> open;
+    auto finish = [&](const std::string& key, PendingGroup& pending) {
+        if (!pending.group.rules.empty()) {
+            pending.group.regex = std::regex(pending.alternation, std::regex::ECMAScript | std::regex::optimize);
+            m_regexes[key].push_back(std::move(pending.group));
+            m_regexKeyLength = std::max(m_regexKeyLength, key.size());
+        }
+        pending = PendingGroup();
+    };
+    for (std::size_t i : pendingRegexes) {
+        const ExclusionRule& rule = m_rules[i];
+        std::size_t marks = 0;
+        try {
+            marks = std::regex(rule.pattern, std::regex::ECMAScript).mark_count();
+        } catch (const std::regex_error& e) {
+            throw std::runtime_error("Invalid exclusion regex " + rule.describe() + ": " + e.what());
+        }
+        const std::string key = regexLiteralPrefix(rule.pattern);
+        PendingGroup& pending = open[key];
+        const bool alone = hasBackreference(rule.pattern);
+        if (alone || pending.group.rules.size() == kRegexGroupSize) {
+            finish(key, pending);
+        }
+        if (alone) {
+            pending.group.rules.emplace_back(0, i);
+            pending.alternation = rule.pattern;
+            finish(key, pending);
+            continue;
+        }
+        pending.alternation += (pending.group.rules.empty() ? "(" : "|(") + rule.pattern + ")";
+        pending.group.rules.emplace_back(pending.nextGroup, i);
+        pending.nextGroup += 1 + marks;
+    }
+    for (auto& [key, pending] : open) {
+        finish(key, pending);
+    }
+
+    m_compiled = true;
+}
+
+const ExclusionRule* ExclusionPolicy::hit(std::size_t rule, bool count) const {
+    if (count) {
+        m_hits[rule].fetch_add(1, std::memory_order_relaxed);
+    }
+    return &m_rules[rule];
+}
+
+const ExclusionRule* ExclusionPolicy::matchName(const std::string& filename, bool countHit) const {
+    if (auto it = m_literals.find(filename); it != m_literals.end()) {
+        return hit(it->second, countHit);
+    }
+
+    // Within a kind the earliest rule wins, so every candidate bucket is searched for
+    // its first match and the lowest index is kept.
+    std::size_t best = m_rules.size();
+    forEachPrefixBucket(m_nameGlobs, m_globKeyLength, filename, [&](const std::vector<std::size_t>& bucket) {
+        for (std::size_t rule : bucket) {
+            if (rule >= best) break;
+            if (Wildcard::match(m_rules[rule].pattern, filename)) {
+                best = rule;
+                break;
+            }
+        }
+    });
+    if (best < m_rules.size()) {
+        return hit(best, countHit);
+    }
+
+    std::smatch match;
+    forEachPrefixBucket(m_regexes, m_regexKeyLength, filename, [&](const std::vector<RegexGroup>& groups) {
+        for (const auto& group : groups) {
+            if (group.rules.front().second >= best) break;
+            if (!std::regex_match(filename, match, group.regex)) {
+                continue;
+            }
+            for (const auto& [index, rule] : group.rules) {
+                if (group.rules.size() == 1 || match[index].matched) {
+                    best = std::min(best, rule);
+                    break;
+                }
+            }
+            break;
+        }
+    });
+    return best < m_rules.size() ? hit(best, countHit) : nullptr;
+}
+
+const ExclusionRule* ExclusionPolicy::matchPath(const std::filesystem::path& path, bool countHit) const {
+    if (m_prefixes.empty() && m_pathGlobs.empty()) {
+        return nullptr;
+    }
+    const std::string text = path.generic_string();
+
+    if (!m_prefixes.empty()) {
+        // One lookup per ancestor: "/usr", "/usr/lib", ... up to the path itself.
+        std::size_t best = m_rules.size();
+        for (std::size_t slash = text.find('/'); ; slash = text.find('/', slash + 1)) {
+            const std::string ancestor = slash == 0 ? "/" : text.substr(0, slash);
+            if (auto it = m_prefixes.find(ancestor); it != m_prefixes.end()) {
+                best = std::min(best, it->second);
+            }
+            if (slash == std::string::npos) break;
+        }
+        if (best < m_rules.size()) {
+            return hit(best, countHit);
+        }
+    }
+
+    for (std::size_t rule : m_pathGlobs) {
+        if (Wildcard::match(m_rules[rule].pattern, text)) {
+            return hit(rule, countHit);
+        }
+    }
+    return nullptr;
+}
+
+void ExclusionPolicy::report(std::ostream& out) const {
+    bool header = false;
+    for (std::size_t i = 0; i < m_rules.size(); ++i) {
+        const std::uint64_t count = m_hits ? hits(i) : 0;
+        if (m_rules[i].origin == "built-in" && count == 0) {
+            continue;
+        }
+        if (!header) {
+            out << "Exclusion rule hits:\n";
+            header = true;
+        }
+        out << "  " << count << "\t" << m_rules[i].describe() << "\n";
+    }
+}
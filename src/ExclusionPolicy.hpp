@@ -0,0 +1,128 @@
+// src/ExclusionPolicy.hpp
+#ifndef RELOCATOR_EXCLUSIONPOLICY_HPP
+#define RELOCATOR_EXCLUSIONPOLICY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @enum TargetPlatform
+ * @brief The operating system a bundle is built for; Host means the one running the relocator.
+ */
+enum class TargetPlatform { Host, Linux, MacOS, Windows };
+
+enum class ExclusionKind {
+    Literal,    // Exact library filename, e.g. libc.so.6
+    Glob,       // Shell pattern; matched against the full path if it contains '/', else the filename
+    Prefix,     // Directory; excludes every library at or below it, e.g. /usr/lib
+    Regex       // ECMAScript regex matched against the whole filename
+};
+
+/**
+ * @struct ExclusionRule
+ * @brief One rule and where it came from, for log lines and the hit report.
+ */
+struct ExclusionRule {
+    ExclusionKind kind;
+    std::string pattern;
+    std::string origin;     // "built-in", "-e", "policy.txt:12", ...
+
+    std::string describe() const;
+};
+
+/**
+ * @class ExclusionPolicy
+ * @brief Decides which dependencies are left out of the bundle.
+ *
+ * Rules are added up front, then compile() builds the matchers once per run:
+ * - literals go into one hash table;
+ * - globs are bucketed by their literal prefix, so a name only tries the globs that
+ *   share its first characters;
+ * - prefixes are hashed by directory, and a path looks up each of its ancestors;
+ * - regexes are validated one by one, bucketed by the literal text every match must
+ *   start with, and each bucket is joined into alternations "(r1)|(r2)|..." whose
+ *   capture groups tell which rule matched.
+ * Matching is thread-safe and counts a hit on the rule that decided, so the report can
+ * show rules that never fire. When several rules match, the order is literal, glob and
+ * regex on the filename, then prefix and '/'-glob on the path; within a kind the first
+ * rule added wins.
+ */
+class ExclusionPolicy {
+public:
+    ExclusionPolicy() = default;
+    ExclusionPolicy(const ExclusionPolicy&) = delete;
+    ExclusionPolicy& operator=(const ExclusionPolicy&) = delete;
+
+    void add(ExclusionKind kind, const std::string& pattern, const std::string& origin);
+
+    /**
+     * Loads rules from a policy file: one "<kind> <pattern>" per line, where kind is
+     * literal, glob, prefix or regex. Blank lines and lines starting with '#' are ignored.
+     * @throws std::runtime_error if the file cannot be read or a line is malformed.
+     */
+    void loadFile(const std::filesystem::path& file);
+
+    /**
+     * Adds the system libraries a target platform never bundles.
+     */
+    void addPlatformDefaults(TargetPlatform target = TargetPlatform::Host);
+
+    /**
+     * Builds the matchers. Must be called after the last add() and before matching.
+     * @throws std::runtime_error naming the rule if a regex does not compile.
+     */
+    void compile();
+    bool compiled() const { return m_compiled; }
+
+    /**
+     * Checks rules that only need the filename, before the library is resolved.
+     * @param countHit Whether a match counts towards the report; false for lookups that are not bundling decisions.
+     * @return The deciding rule, or nullptr if the library is not excluded.
+     */
+    const ExclusionRule* matchName(const std::string& filename, bool countHit = true) const;
+
+    /**
+     * Checks rules that need the resolved location (prefixes and globs containing '/').
+     * @param countHit Whether a match counts towards the report.
+     * @return The deciding rule, or nullptr if the library is not excluded.
+     */
+    const ExclusionRule* matchPath(const std::filesystem::path& path, bool countHit = true) const;
+
+    const std::vector<ExclusionRule>& rules() const { return m_rules; }
+    std::uint64_t hits(std::size_t rule) const { return m_hits[rule].load(std::memory_order_relaxed); }
+
+    /**
+     * Prints every user rule with its hit count, and the built-in rules that were hit.
+     */
+    void report(std::ostream& out) const;
+
+private:
+    struct RegexGroup {
+        std::regex regex;
+        std::vector<std::pair<std::size_t, std::size_t>> rules;   // (capture group, rule index)
+    };
+
+    const ExclusionRule* hit(std::size_t rule, bool count) const;
+
+    std::vector<ExclusionRule> m_rules;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> m_hits;
+    bool m_compiled = false;
+
+    std::unordered_map<std::string, std::size_t> m_literals;
+    std::unordered_map<std::string, std::size_t> m_prefixes;
+    std::unordered_map<std::string, std::vector<std::size_t>> m_nameGlobs;   // Keyed by literal prefix
+    std::vector<std::size_t> m_pathGlobs;
+    std::unordered_map<std::string, std::vector<RegexGroup>> m_regexes;       // Keyed by literal prefix
+    std::size_t m_globKeyLength = 0;    // Longest key in m_nameGlobs
+    std::size_t m_regexKeyLength = 0;   // Longest key in m_regexes
+};
+
+#endif //RELOCATOR_EXCLUSIONPOLICY_HPP
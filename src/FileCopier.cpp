@@ -0,0 +1,245 @@
+// src/FileCopier.cpp
+#include "FileCopier.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#elif defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+
+namespace {
+    std::runtime_error copyError(const std::filesystem::path& source, const std::filesystem::path& destination,
+                                 const std::string& what, int error) {
+        return std::runtime_error("Could not copy " + source.string() + " to " + destination.string()
+                                  + ": " + what + ": " + std::strerror(error));
+    }
+
+#if !defined(_WIN32)
+    // Closes a descriptor on scope exit.
+    struct FileDescriptor {
+        int fd = -1;
+        explicit FileDescriptor(int value) : fd(value) {}
+        ~FileDescriptor() { if (fd >= 0) ::close(fd); }
+        FileDescriptor(const FileDescriptor&) = delete;
+        FileDescriptor& operator=(const FileDescriptor&) = delete;
+    };
+
+    // Errors that mean "this filesystem or kernel cannot do that", as opposed to a real I/O failure.
+    bool isUnsupported(int error) {
+        return error == EXDEV || error == ENOSYS || error == EINVAL || error == EOPNOTSUPP
+            || error == ENOTTY || error == EPERM || error == EBADF;
+    }
+
+    void plainCopy(int in, int out, std::uint64_t size, const std::filesystem::path& source,
+                   const std::filesystem::path& destination) {
+        std::vector<char> buffer(1 << 20);
+        std::uint64_t done = 0;
+        while (done < size) {
+            const ssize_t got = ::read(in, buffer.data(), buffer.size());
+            if (got < 0) {
+                if (errno == EINTR) continue;
+                throw copyError(source, destination, "read", errno);
+            }
+            if (got == 0) {
+                break;
+            }
+            for (ssize_t put = 0; put < got;) {
+                const ssize_t n = ::write(out, buffer.data() + put, got - put);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    throw copyError(source, destination, "write", errno);
+                }
+                put += n;
+            }
+            done += got;
+        }
+    }
+
+#if defined(__linux__)
+    // Returns false, having copied nothing, if the kernel cannot copy between these files.
+    bool rangeCopy(int in, int out, std::uint64_t size, const std::filesystem::path& source,
+                   const std::filesystem::path& destination) {
+        std::uint64_t done = 0;
+        while (done < size) {
+            const ssize_t n = ::copy_file_range(in, nullptr, out, nullptr, size - done, 0);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (done == 0 && isUnsupported(errno)) return false;
+                throw copyError(source, destination, "copy_file_range", errno);
+            }
+            if (n == 0) {
+                break;
+            }
+            done += n;
+        }
+        return true;
+    }
+#endif
+
+    CopyResult copyPosix(const std::filesystem::path& source, const std::filesystem::path& destination,
+                         CopyMode mode) {
+        struct stat st{};
+        if (::stat(source.c_str(), &st) != 0) {
+            throw copyError(source, destination, "stat", errno);
+        }
+        CopyResult result;
+        result.logicalBytes = static_cast<std::uint64_t>(st.st_size);
+
+        if (::unlink(destination.c_str()) != 0 && errno != ENOENT) {
+            throw copyError(source, destination, "unlink", errno);
+        }
+
+        if (mode == CopyMode::Hardlink) {
+            if (::link(source.c_str(), destination.c_str()) == 0) {
+                result.method = CopyMethod::Hardlink;
+                return result;
+            }
+            if (!isUnsupported(errno) && errno != EMLINK) {
+                throw copyError(source, destination, "link", errno);
+            }
+            mode = CopyMode::Auto;  // Different filesystem: fall back to the cheapest real copy.
+        }
+
+#if defined(__APPLE__)
+        if (mode == CopyMode::Auto || mode == CopyMode::Reflink) {
+            if (::clonefile(source.c_str(), destination.c_str(), 0) == 0) {
+                result.method = CopyMethod::Reflink;
+                return result;
+            }
+            if (mode == CopyMode::Reflink || !isUnsupported(errno)) {
+                throw copyError(source, destination, "clonefile", errno);
+            }
+        }
+#endif
+
+        FileDescriptor in(::open(source.c_str(), O_RDONLY | O_CLOEXEC));
+        if (in.fd < 0) {
+            throw copyError(source, destination, "open", errno);
+        }
+        FileDescriptor out(::open(destination.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR));
+        if (out.fd < 0) {
+            throw copyError(source, destination, "create", errno);
+        }
+
+        try {
+            bool done = false;
+#if defined(__linux__)
+            if (mode == CopyMode::Auto || mode == CopyMode::Reflink) {
+                if (::ioctl(out.fd, FICLONE, in.fd) == 0) {
+                    result.method = CopyMethod::Reflink;
+                    done = true;
+                } else if (mode == CopyMode::Reflink || !isUnsupported(errno)) {
+                    throw copyError(source, destination, "FICLONE", errno);
+                }
+            }
+            if (!done && (mode == CopyMode::Auto || mode == CopyMode::Range)) {
+                if (rangeCopy(in.fd, out.fd, result.logicalBytes, source, destination)) {
+                    result.method = CopyMethod::Range;
+                    result.bytesMoved = result.logicalBytes;
+                    done = true;
+                } else if (mode == CopyMode::Range) {
+                    throw copyError(source, destination, "copy_file_range", errno);
+                }
+            }
+#else
+            if (mode == CopyMode::Reflink || mode == CopyMode::Range) {
+                throw copyError(source, destination, "copy mode", EOPNOTSUPP);
+            }
+#endif
+            if (!done) {
+                plainCopy(in.fd, out.fd, result.logicalBytes, source, destination);
+                result.method = CopyMethod::Copy;
+                result.bytesMoved = result.logicalBytes;
+            }
+            if (::fchmod(out.fd, st.st_mode & 07777) != 0) {
+                throw copyError(source, destination, "chmod", errno);
+            }
+        } catch (...) {
+            ::unlink(destination.c_str());
+            throw;
+        }
+        return result;
+    }
+#endif
+}
+
+CopyMode FileCopier::parseMode(const std::string& name) {
+    if (name == "auto") return CopyMode::Auto;
+    if (name == "reflink") return CopyMode::Reflink;
+    if (name == "range") return CopyMode::Range;
+    if (name == "copy") return CopyMode::Copy;
+    if (name == "hardlink") return CopyMode::Hardlink;
+    throw std::runtime_error("Unknown copy mode: " + name);
+}
+
+const char* FileCopier::modeName(CopyMode mode) {
+    switch (mode) {
+        case CopyMode::Auto:     return "auto";
+        case CopyMode::Reflink:  return "reflink";
+        case CopyMode::Range:    return "range";
+        case CopyMode::Copy:     return "copy";
+        case CopyMode::Hardlink: return "hardlink";
+    }
+    return "auto";
+}
+
+const char* FileCopier::methodName(CopyMethod method) {
+    switch (method) {
+        case CopyMethod::Reflink:  return "reflinked";
+        case CopyMethod::Range:    return "copied in-kernel";
+        case CopyMethod::Copy:     return "copied";
+        case CopyMethod::Hardlink: return "hard-linked";
+    }
+    return "copied";
+}
+
+CopyResult FileCopier::copy(const std::filesystem::path& source, const std::filesystem::path& destination,
+                            CopyMode mode) {
+#if defined(_WIN32)
+    CopyResult result;
+    result.logicalBytes = std::filesystem::file_size(source);
+    std::filesystem::remove(destination);
+    if (mode == CopyMode::Hardlink) {
+        std::error_code ec;
+        std::filesystem::create_hard_link(source, destination, ec);
+        if (!ec) {
+            result.method = CopyMethod::Hardlink;
+            return result;
+        }
+    } else if (mode == CopyMode::Reflink || mode == CopyMode::Range) {
+        throw copyError(source, destination, "copy mode", EOPNOTSUPP);
+    }
+    std::filesystem::copy_file(source, destination);
+    result.method = CopyMethod::Copy;
+    result.bytesMoved = result.logicalBytes;
+    return result;
+#else
+    return copyPosix(source, destination, mode);
+#endif
+}
+
+std::uint64_t FileCopier::unshare(const std::filesystem::path& file) {
+    std::error_code ec;
+    if (std::filesystem::hard_link_count(file, ec) <= 1 || ec) {
+        return 0;
+    }
+    // Copy beside the file and rename over it, so the other links keep the original contents.
+    std::filesystem::path temp = file;
+    temp += ".relocator-unshare";
+    CopyResult result = copy(file, temp, CopyMode::Auto);
+    std::filesystem::rename(temp, file);
+    return result.bytesMoved;
+}
@@ -0,0 +1,68 @@
+// src/FileCopier.hpp
+#ifndef RELOCATOR_FILECOPIER_HPP
+#define RELOCATOR_FILECOPIER_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+/**
+ * @enum CopyMode
+ * @brief How bundled files are materialized in the output directory.
+ */
+enum class CopyMode {
+    Auto,       // Reflink, then in-kernel copy, then a plain copy
+    Reflink,    // Share extents with the source (FICLONE / clonefile); fail if unsupported
+    Range,      // In-kernel copy with copy_file_range; fail if unsupported
+    Copy,       // Read and write every byte
+    Hardlink    // Hard link to the source; patched files are unshared before they are written
+};
+
+/**
+ * @enum CopyMethod
+ * @brief The mechanism that actually produced a file.
+ */
+enum class CopyMethod { Reflink, Range, Copy, Hardlink };
+
+/**
+ * @struct CopyResult
+ * @brief What one copy did.
+ */
+struct CopyResult {
+    CopyMethod method = CopyMethod::Copy;
+    std::uint64_t logicalBytes = 0;    // Size of the file
+    std::uint64_t bytesMoved = 0;      // Bytes the kernel or this process actually had to copy
+};
+
+/**
+ * @class FileCopier
+ * @brief Copies files using the cheapest mechanism the filesystem supports.
+ */
+class FileCopier {
+public:
+    /**
+     * Parses a --copy-mode value ("auto", "reflink", "range", "copy" or "hardlink").
+     * @throws std::runtime_error on an unknown name.
+     */
+    static CopyMode parseMode(const std::string& name);
+    static const char* modeName(CopyMode mode);
+
+    static const char* methodName(CopyMethod method);
+
+    /**
+     * Replaces destination with a copy of source, preserving its permission bits.
+     * An existing destination is unlinked first, so a previous hard link is never written through.
+     * @throws std::runtime_error if the copy fails, or if a forced mode is unsupported.
+     */
+    static CopyResult copy(const std::filesystem::path& source, const std::filesystem::path& destination,
+                           CopyMode mode);
+
+    /**
+     * Gives a file its own inode if it is hard-linked, so writing to it cannot change the source.
+     * Reflinked files need nothing here: the filesystem unshares their extents on write.
+     * @return Bytes copied to break the link; 0 if the file was not shared.
+     */
+    static std::uint64_t unshare(const std::filesystem::path& file);
+};
+
+#endif //RELOCATOR_FILECOPIER_HPP
@@ -0,0 +1,112 @@
+// src/InputExpander.cpp
+#include "InputExpander.hpp"
+#include "Wildcard.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+
+namespace {
+    // Expands wildcards component by component, e.g. "plugins/*/lib*.so".
+    std::vector<std::filesystem::path> expandGlob(const std::filesystem::path& pattern) {
+        std::vector<std::filesystem::path> current{ pattern.has_root_path() ? pattern.root_path()
+                                                                             : std::filesystem::path() };
+        for (const auto& component : pattern.relative_path()) {
+            std::vector<std::filesystem::path> next;
+            const std::string name = component.string();
+            for (const auto& base : current) {
+                if (!Wildcard::hasWildcard(name)) {
+                    next.push_back(base / component);
+                    continue;
+                }
+                std::error_code ec;
+                const std::filesystem::path dir = base.empty() ? std::filesystem::path(".") : base;
+                for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+                    const std::string candidate = entry.path().filename().string();
+                    // As in the shell, a wildcard does not match a leading dot.
+                    if (candidate[0] == '.' && name[0] != '.') {
+                        continue;
+                    }
+                    if (Wildcard::match(name, candidate)) {
+                        next.push_back(base / candidate);
+                    }
+                }
+            }
+            current.swap(next);
+        }
+
+        std::vector<std::filesystem::path> matches;
+        for (const auto& path : current) {
+            std::error_code ec;
+            if (std::filesystem::exists(path, ec)) {
+                matches.push_back(path);
+            }
+        }
+        std::sort(matches.begin(), matches.end());
+        return matches;
+    }
+}
+
+bool InputExpander::looksLikeObject(const std::filesystem::path& file) {
+    std::ifstream in(file, std::ios::binary);
+    unsigned char magic[4] = {};
+    if (!in.read(reinterpret_cast<char*>(magic), sizeof(magic))) {
+        return false;
+    }
+    const std::uint32_t be = (std::uint32_t(magic[0]) << 24) | (magic[1] << 16) | (magic[2] << 8) | magic[3];
+    const std::uint32_t le = (std::uint32_t(magic[3]) << 24) | (magic[2] << 16) | (magic[1] << 8) | magic[0];
+    auto isMachO = [](std::uint32_t m) {
+        return m == 0xfeedface || m == 0xfeedfacf || m == 0xcafebabe || m == 0xcafebabf;
+    };
+    return be == 0x7f454c46                 // "\x7fELF"
+        || isMachO(be) || isMachO(le)
+        || (magic[0] == 'M' && magic[1] == 'Z');
+}
+
+std::vector<BundleInput> InputExpander::expand(const std::vector<std::string>& arguments) {
+    std::vector<BundleInput> inputs;
+    std::set<std::filesystem::path> seen;
+    auto add = [&](const std::filesystem::path& file, const std::filesystem::path& bundlePath) {
+        if (seen.insert(std::filesystem::canonical(file)).second) {
+            inputs.push_back({ file, bundlePath });
+        }
+    };
+
+    for (const auto& argument : arguments) {
+        std::vector<std::filesystem::path> matches;
+        const bool isGlob = Wildcard::hasWildcard(argument) && !std::filesystem::exists(argument);
+        if (isGlob) {
+            matches = expandGlob(argument);
+        } else if (std::filesystem::exists(argument)) {
+            matches.emplace_back(argument);
+        }
+        if (matches.empty()) {
+            throw std::runtime_error("Input does not exist or matches nothing: " + argument);
+        }
+
+        for (const auto& match : matches) {
+            if (std::filesystem::is_directory(match)) {
+                // Keep the folder's own name so plugins land in e.g. <output>/plugins/...
+                std::filesystem::path base = match.lexically_normal();
+                if (!base.has_filename()) {
+                    base = base.parent_path();
+                }
+                std::vector<std::filesystem::path> files;
+                for (const auto& entry : std::filesystem::recursive_directory_iterator(base)) {
+                    if (entry.is_regular_file() && !entry.is_symlink() && looksLikeObject(entry.path())) {
+                        files.push_back(entry.path());
+                    }
+                }
+                std::sort(files.begin(), files.end());
+                for (const auto& file : files) {
+                    add(file, base.filename() / file.lexically_relative(base));
+                }
+            } else if (!isGlob || looksLikeObject(match)) {
+                add(match, match.filename());
+            }
+        }
+    }
+    return inputs;
+}
@@ -0,0 +1,37 @@
+// src/InputExpander.hpp
+#ifndef RELOCATOR_INPUTEXPANDER_HPP
+#define RELOCATOR_INPUTEXPANDER_HPP
+
+#include "Relocator.hpp"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * @class InputExpander
+ * @brief Turns the -i arguments into the list of root objects to bundle.
+ *
+ * Each argument may be a file, a directory or a glob:
+ * - a file is bundled at the top of the output directory;
+ * - a directory is searched recursively for executables and libraries, which keep
+ *   their layout under a directory of the same name (plugins/platforms/libqxcb.so);
+ * - a glob ('*', '?' and '[...]' in any path component) is expanded in-process, so it
+ *   also works when quoted; each match is then treated as a file or directory.
+ * Files found through a directory or glob are only kept if they look like an object
+ * file (ELF, Mach-O or PE). Roots are de-duplicated by canonical path.
+ */
+class InputExpander {
+public:
+    /**
+     * @throws std::runtime_error if an argument matches nothing.
+     */
+    static std::vector<BundleInput> expand(const std::vector<std::string>& arguments);
+
+    /**
+     * @return True if the file starts with an ELF, Mach-O or PE signature.
+     */
+    static bool looksLikeObject(const std::filesystem::path& file);
+};
+
+#endif //RELOCATOR_INPUTEXPANDER_HPP
@@ -0,0 +1,34 @@
+// src/Json.hpp
+#ifndef RELOCATOR_JSON_HPP
+#define RELOCATOR_JSON_HPP
+
+#include <cstdio>
+#include <string>
+
+namespace Json {
+    /**
+     * @return value as a quoted JSON string literal.
+     */
+    inline std::string quote(const std::string& value) {
+        std::string out = "\"";
+        for (unsigned char c : value) {
+            switch (c) {
+                case '"':  out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (c < 0x20) {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        out += escaped;
+                    } else {
+                        out += static_cast<char>(c);
+                    }
+            }
+        }
+        return out + "\"";
+    }
+}
+
+#endif //RELOCATOR_JSON_HPP
@@ -0,0 +1,105 @@
+// src/LdSoCache.cpp
+#include "LdSoCache.hpp"
+#include "ByteOrder.hpp"
+#include "MappedFile.hpp"
+
+#include <cstring>
+
+namespace {
+    // Layout constants from glibc's sysdeps/generic/dl-cache.h.
+    constexpr char kOldMagic[] = "ld.so-1.7.0";
+    constexpr std::size_t kOldMagicLen = sizeof(kOldMagic) - 1;
+    constexpr std::size_t kOldHeaderSize = 12 + 4;         // magic (padded) + nlibs
+    constexpr std::size_t kOldEntrySize = 12;              // flags, key, value
+
+    constexpr char kNewMagic[] = "glibc-ld.so.cache1.1";
+    constexpr std::size_t kNewMagicLen = sizeof(kNewMagic) - 1;
+    constexpr std::size_t kNewHeaderSize = 48;
+    constexpr std::size_t kNewEntrySize = 24;              // flags, key, value, osversion, hwcap
+
+    constexpr std::int32_t kFlagTypeMask = 0x00ff;
+    constexpr std::int32_t kFlagElf = 0x0001;
+    constexpr std::int32_t kFlagElfLibc6 = 0x0003;
+
+    template <typename T>
+    T field(const std::uint8_t* p, std::size_t offset) {
+        return ByteOrder::load<T>(p + offset, ByteOrder::hostIsBigEndian());
+    }
+}
+
+LdSoCache LdSoCache::load(const std::filesystem::path& path) {
+    LdSoCache cache;
+
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) {
+        return cache;
+    }
+
+    try {
+        MappedFile file(path);
+        const std::uint8_t* data = file.data();
+        std::size_t offset = 0;
+
+        // Skip a legacy table if the file starts with one.
+        if (file.contains(0, kOldHeaderSize) && std::memcmp(data, kOldMagic, kOldMagicLen) == 0) {
+            std::uint32_t oldCount = field<std::uint32_t>(data, 12);
+            offset = kOldHeaderSize + std::size_t(oldCount) * kOldEntrySize;
+            offset = (offset + 7) & ~std::size_t(7);
+        }
+
+        if (!file.contains(offset, kNewHeaderSize) || std::memcmp(data + offset, kNewMagic, kNewMagicLen) != 0) {
+            return cache;
+        }
+
+        // String offsets in the new format are relative to the start of its header.
+        const std::uint8_t* header = data + offset;
+        const std::size_t available = file.size() - offset;
+        const std::uint32_t count = field<std::uint32_t>(header, 20);
+        if (std::uint64_t(count) * kNewEntrySize > available - kNewHeaderSize) {
+            return cache;
+        }
+
+        auto stringAt = [&](std::uint32_t at) -> std::string {
+            if (at >= available) {
+                return {};
+            }
+            const char* begin = reinterpret_cast<const char*>(header) + at;
+            const void* nul = std::memchr(begin, '\0', available - at);
+            return nul ? std::string(begin, static_cast<const char*>(nul)) : std::string();
+        };
+
+        cache.m_index.reserve(count);
+        for (std::uint32_t i = 0; i < count; ++i) {
+            const std::uint8_t* entry = header + kNewHeaderSize + std::size_t(i) * kNewEntrySize;
+            const std::int32_t flags = field<std::int32_t>(entry, 0);
+            const std::int32_t type = flags & kFlagTypeMask;
+            if (type != kFlagElf && type != kFlagElfLibc6) {
+                continue;
+            }
+
+            std::string key = stringAt(field<std::uint32_t>(entry, 4));
+            std::string value = stringAt(field<std::uint32_t>(entry, 8));
+            if (key.empty() || value.empty()) {
+                continue;
+            }
+
+            LdSoCacheEntry record;
+            record.flags = flags;
+            record.hwcap = field<std::uint64_t>(entry, 16);
+            record.path = std::move(value);
+            cache.m_index[key].push_back(std::move(record));
+            ++cache.m_entryCount;
+        }
+    } catch (const std::exception&) {
+        // An unreadable cache behaves like no cache at all.
+        return LdSoCache();
+    }
+
+    return cache;
+}
+
+const std::vector<LdSoCacheEntry>& LdSoCache::lookup(const std::string& soname) const {
+    static const std::vector<LdSoCacheEntry> empty;
+    auto it = m_index.find(soname);
+    return it == m_index.end() ? empty : it->second;
+}
@@ -0,0 +1,54 @@
+// src/LdSoCache.hpp
+#ifndef RELOCATOR_LDSOCACHE_HPP
+#define RELOCATOR_LDSOCACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @struct LdSoCacheEntry
+ * @brief One library record from /etc/ld.so.cache.
+ */
+struct LdSoCacheEntry {
+    std::int32_t flags = 0;       // FLAG_ELF_LIBC6 | architecture bits, as written by ldconfig
+    std::uint64_t hwcap = 0;      // Non-zero for hwcap-specific (optimized) variants
+    std::filesystem::path path;
+};
+
+/**
+ * @class LdSoCache
+ * @brief A parsed, indexed copy of the binary ld.so.cache written by ldconfig.
+ *
+ * Only the "glibc-ld.so.cache1.1" format is read. It may appear on its own
+ * (glibc >= 2.32) or appended to a legacy "ld.so-1.7.0" table, in which case
+ * the legacy part is skipped.
+ */
+class LdSoCache {
+public:
+    static constexpr const char* kDefaultPath = "/etc/ld.so.cache";
+
+    LdSoCache() = default;
+
+    /**
+     * Loads and indexes a cache file. A missing or unreadable cache yields
+     * an empty cache, as it does for the dynamic loader.
+     * @param path Location of the cache file.
+     */
+    static LdSoCache load(const std::filesystem::path& path = kDefaultPath);
+
+    /**
+     * Returns every entry for a soname, in cache order.
+     */
+    const std::vector<LdSoCacheEntry>& lookup(const std::string& soname) const;
+
+    std::size_t size() const { return m_entryCount; }
+
+private:
+    std::unordered_map<std::string, std::vector<LdSoCacheEntry>> m_index;
+    std::size_t m_entryCount = 0;
+};
+
+#endif //RELOCATOR_LDSOCACHE_HPP
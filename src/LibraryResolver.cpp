@@ -0,0 +1,307 @@
+// src/LibraryResolver.cpp
+#include "LibraryResolver.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
+
+#include <elf.h>
+
+namespace {
+    // Debian-style multiarch tuple for a machine, e.g. "x86_64-linux-gnu".
+    std::string multiarchTuple(std::uint16_t machine) {
+        switch (machine) {
+            case EM_386:     return "i386-linux-gnu";
+            case EM_ARM:     return "arm-linux-gnueabihf";
+            default:         return ElfFile::machineName(machine) + "-linux-gnu";
+        }
+    }
+
+    // The value ld.so substitutes for $PLATFORM (AT_PLATFORM).
+    std::string platformName(std::uint16_t machine) {
+        switch (machine) {
+            case EM_386:     return "i686";
+            case EM_ARM:     return "v7l";
+            default:         return ElfFile::machineName(machine);
+        }
+    }
+
+    // The value ld.so substitutes for $LIB, which depends on how glibc was configured.
+    std::string libDirName(bool is64Bit, std::uint16_t machine) {
+        std::error_code ec;
+        const std::string multiarch = "lib/" + multiarchTuple(machine);
+        if (std::filesystem::is_directory("/" + multiarch, ec)) {
+            return multiarch;
+        }
+        if (is64Bit && std::filesystem::is_directory("/lib64", ec)) {
+            return "lib64";
+        }
+        return "lib";
+    }
+
+    // The legacy hwcap subdirectories ld.so searched before glibc 2.37 on the common targets.
+    // Nested combinations (e.g. tls/x86_64) are not looked for.
+    const char* const kLegacyHwcapDirs[] = { "avx512_1", "haswell", "xeon_phi", "x86_64", "i686", "i586", "tls" };
+
+    bool isIdentifierChar(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    // Replaces "${NAME}" and "$NAME" the way glibc's _dl_dst_substitute does: the unbraced
+    // form only counts when no identifier character follows, so "$LIBFOO" is left alone.
+    void replaceToken(std::string& entry, const std::string& name, const std::string& value) {
+        size_t pos = 0;
+        while ((pos = entry.find('$', pos)) != std::string::npos) {
+            size_t length = 0;
+            if (entry.compare(pos + 1, name.size() + 2, "{" + name + "}") == 0) {
+                length = name.size() + 3;
+            } else if (entry.compare(pos + 1, name.size(), name) == 0
+                       && (pos + 1 + name.size() == entry.size() || !isIdentifierChar(entry[pos + 1 + name.size()]))) {
+                length = name.size() + 1;
+            }
+            if (length == 0) {
+                ++pos;
+                continue;
+            }
+            entry.replace(pos, length, value);
+            pos += value.size();
+        }
+    }
+}
+
+LibraryResolver::LibraryResolver(std::vector<std::string> userSearchPaths,
+                                 const std::filesystem::path& cachePath)
+    : m_cache(LdSoCache::load(cachePath)) {
+    for (const auto& dir : userSearchPaths) {
+        m_userSearchPaths.emplace_back(dir);
+    }
+
+    if (const char* env = std::getenv("LD_LIBRARY_PATH")) {
+        std::istringstream stream(env);
+        std::string entry;
+        while (std::getline(stream, entry, ':')) {
+            // $ORIGIN here is relative to the program at run time and says nothing about the build host.
+            if (!entry.empty() && entry.find("ORIGIN") == std::string::npos) {
+                m_ldLibraryPath.emplace_back(entry);
+            }
+        }
+    }
+}
+
+std::vector<std::filesystem::path> LibraryResolver::expandSearchPath(const std::string& value,
+                                                                     const std::filesystem::path& origin,
+                                                                     bool is64Bit,
+                                                                     std::uint16_t machine) {
+    std::vector<std::filesystem::path> dirs;
+    std::istringstream stream(value);
+    std::string entry;
+    while (std::getline(stream, entry, ':')) {
+        if (entry.empty()) {
+            continue;
+        }
+        replaceToken(entry, "ORIGIN", origin.string());
+        if (entry.find('$') != std::string::npos) {
+            replaceToken(entry, "LIB", libDirName(is64Bit, machine));
+            replaceToken(entry, "PLATFORM", platformName(machine));
+        }
+        dirs.emplace_back(entry);
+    }
+    return dirs;
+}
+
+LibrarySearchContext LibraryResolver::contextFor(const std::filesystem::path& objectPath,
+                                                 const ElfDynamicInfo& info,
+                                                 const std::vector<std::filesystem::path>& inheritedRpath) const {
+    LibrarySearchContext context;
+    context.is64Bit = info.is64Bit;
+    context.machine = info.machine;
+    context.noDefaultLib = (info.flags1 & DF_1_NODEFLIB) != 0;
+
+    const std::filesystem::path origin = objectPath.parent_path();
+    if (!info.hasRunpath) {
+        context.rpathDirs = expandSearchPath(info.rpath, origin, info.is64Bit, info.machine);
+        context.rpathDirs.insert(context.rpathDirs.end(), inheritedRpath.begin(), inheritedRpath.end());
+    }
+    context.runpathDirs = expandSearchPath(info.runpath, origin, info.is64Bit, info.machine);
+
+    std::ostringstream key;
+    key << (context.is64Bit ? 64 : 32) << '/' << context.machine << '/' << context.noDefaultLib;
+    for (const auto& dir : context.rpathDirs) {
+        key << '\x1f' << dir.string();
+    }
+    key << '\x1e';
+    for (const auto& dir : context.runpathDirs) {
+        key << '\x1f' << dir.string();
+    }
+    context.key = key.str();
+    return context;
+}
+
+std::filesystem::path LibraryResolver::resolve(const std::string& soname, const LibrarySearchContext& context) {
+    const std::string memoKey = context.key + '\x1d' + soname;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto it = m_resolved.find(memoKey);
+        if (it != m_resolved.end()) {
+            return it->second;
+        }
+    }
+
+    // Two threads may race to search for the same soname; both find the same answer.
+    std::filesystem::path result = search(soname, context);
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_resolved.emplace(memoKey, result);
+    return result;
+}
+
+std::filesystem::path LibraryResolver::search(const std::string& soname, const LibrarySearchContext& context) {
+    if (soname.find('/') != std::string::npos) {
+        return isCompatible(soname, context) ? std::filesystem::path(soname) : std::filesystem::path();
+    }
+
+    auto searchDirs = [&](const std::vector<std::filesystem::path>& dirs) -> std::filesystem::path {
+        for (const auto& dir : dirs) {
+            std::filesystem::path candidate = dir / soname;
+            if (isCompatible(candidate, context)) {
+                return candidate;
+            }
+        }
+        return {};
+    };
+
+    std::filesystem::path found;
+    if (!(found = searchDirs(context.rpathDirs)).empty()) return found;
+    if (!(found = searchDirs(m_ldLibraryPath)).empty()) return found;
+    if (!(found = searchDirs(context.runpathDirs)).empty()) return found;
+    if (!(found = searchDirs(m_userSearchPaths)).empty()) return found;
+
+    if (context.noDefaultLib) {
+        return {};
+    }
+
+    // Prefer the baseline entry over hwcap-specific variants of the same soname.
+    const auto& entries = m_cache.lookup(soname);
+    for (bool baselineOnly : {true, false}) {
+        for (const auto& entry : entries) {
+            if ((!baselineOnly || entry.hwcap == 0) && isCompatible(entry.path, context)) {
+                return entry.path;
+            }
+        }
+    }
+
+    std::vector<std::filesystem::path> defaults;
+    const std::string multiarch = multiarchTuple(context.machine);
+    defaults.emplace_back("/lib/" + multiarch);
+    defaults.emplace_back("/usr/lib/" + multiarch);
+    if (context.is64Bit) {
+        defaults.emplace_back("/lib64");
+        defaults.emplace_back("/usr/lib64");
+    }
+    defaults.emplace_back("/lib");
+    defaults.emplace_back("/usr/lib");
+    return searchDirs(defaults);
+}
+
+std::vector<LibraryVariant> LibraryResolver::variantsOf(const std::filesystem::path& library, const std::string& soname,
+                                                       const LibrarySearchContext& context) {
+    std::vector<LibraryVariant> variants;
+    auto add = [&](const std::filesystem::path& subdirectory, const std::filesystem::path& path, bool legacy) {
+        const bool known = std::any_of(variants.begin(), variants.end(),
+                                       [&](const LibraryVariant& v) { return v.subdirectory == subdirectory; });
+        if (!known && isCompatible(path, context)) {
+            variants.push_back({ subdirectory, path, legacy });
+        }
+    };
+
+    const std::filesystem::path dir = library.parent_path();
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(dir / "glibc-hwcaps", ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->is_directory(ec)) {
+            add(std::filesystem::path("glibc-hwcaps") / it->path().filename(), it->path() / soname, false);
+        }
+    }
+    for (const char* name : kLegacyHwcapDirs) {
+        add(name, dir / name / soname, true);
+    }
+
+    // The cache knows variants in directories ldconfig scanned, which is where the baseline came from if it has it too.
+    const auto& entries = m_cache.lookup(soname);
+    const bool fromCache = std::any_of(entries.begin(), entries.end(), [&](const LdSoCacheEntry& entry) {
+        return entry.hwcap == 0 && std::filesystem::equivalent(entry.path, library, ec);
+    });
+    for (const auto& entry : entries) {
+        if (!fromCache || entry.hwcap == 0) {
+            continue;
+        }
+        const std::filesystem::path parent = entry.path.parent_path();
+        if (parent.parent_path().filename() == "glibc-hwcaps") {
+            add(std::filesystem::path("glibc-hwcaps") / parent.filename(), entry.path, false);
+        } else {
+            add(parent.filename(), entry.path, true);
+        }
+    }
+
+    std::sort(variants.begin(), variants.end(),
+              [](const LibraryVariant& a, const LibraryVariant& b) { return a.subdirectory < b.subdirectory; });
+    return variants;
+}
+
+void LibraryResolver::refresh() {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    std::unordered_set<std::string> changed;
+    for (auto& [directory, recorded] : m_directories) {
+        std::error_code ec;
+        const auto current = std::filesystem::last_write_time(directory, ec);
+        if (current != recorded) {
+            changed.insert(directory);
+            recorded = current;
+        }
+    }
+    if (changed.empty()) {
+        return;
+    }
+    for (auto it = m_candidates.begin(); it != m_candidates.end();) {
+        if (changed.count(std::filesystem::path(it->first).parent_path().string())) {
+            it = m_candidates.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_resolved.clear();
+}
+
+bool LibraryResolver::isCompatible(const std::filesystem::path& candidate, const LibrarySearchContext& context) {
+    CandidateInfo info{false, 0};
+    bool known = false;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto it = m_candidates.find(candidate.string());
+        if (it != m_candidates.end()) {
+            info = it->second;
+            known = true;
+        }
+    }
+    if (!known) {
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(candidate, ec) && ElfFile::isElf(candidate)) {
+            try {
+                ElfFile elf(candidate);
+                info = CandidateInfo{elf.is64Bit(), elf.machine()};
+            } catch (const std::exception&) {
+                // Malformed objects are skipped, just as the loader would.
+            }
+        }
+        const std::string directory = candidate.parent_path().string();
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_candidates.emplace(candidate.string(), info);
+        if (!m_directories.count(directory)) {
+            m_directories.emplace(directory, std::filesystem::last_write_time(directory, ec));
+        }
+    }
+    return info.machine != 0
+        && info.is64Bit == context.is64Bit
+        && info.machine == context.machine;
+}
@@ -0,0 +1,131 @@
+// src/LibraryResolver.hpp
+#ifndef RELOCATOR_LIBRARYRESOLVER_HPP
+#define RELOCATOR_LIBRARYRESOLVER_HPP
+
+#include "ElfFile.hpp"
+#include "LdSoCache.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @struct LibrarySearchContext
+ * @brief Everything about a requesting object that influences how its DT_NEEDED entries are found.
+ *
+ * Two objects with equal contexts resolve every soname identically, which is
+ * what makes per-context memoization sound.
+ */
+struct LibrarySearchContext {
+    bool is64Bit = false;
+    std::uint16_t machine = 0;
+    bool noDefaultLib = false;                         // DF_1_NODEFLIB: skip ld.so.cache and default dirs
+    std::vector<std::filesystem::path> rpathDirs;      // Own DT_RPATH followed by the loaders' (empty if DT_RUNPATH is set)
+    std::vector<std::filesystem::path> runpathDirs;    // Own DT_RUNPATH, never inherited
+    std::string key;                                   // Memoization key derived from the fields above
+};
+
+/**
+ * @struct LibraryVariant
+ * @brief A CPU-specific build of a library, which ld.so loads instead of it where the CPU allows.
+ */
+struct LibraryVariant {
+    std::filesystem::path subdirectory;    // Relative to the baseline's directory, e.g. "glibc-hwcaps/x86-64-v3"
+    std::filesystem::path path;            // Where it was found
+    bool legacy = false;                   // A legacy hwcap directory, which glibc 2.37 and later no longer search
+};
+
+/**
+ * @class LibraryResolver
+ * @brief Locates shared libraries the way glibc's ld.so does, without running it.
+ *
+ * Lookup order for a soname without a slash:
+ *   1. DT_RPATH of the requester and its loaders (only if the requester has no DT_RUNPATH)
+ *   2. LD_LIBRARY_PATH
+ *   3. DT_RUNPATH of the requester
+ *   4. The user's additional search paths (-s)
+ *   5. /etc/ld.so.cache (parsed once per resolver)
+ *   6. The default system library directories
+ * $ORIGIN, $LIB and $PLATFORM are expanded in RPATH/RUNPATH entries.
+ *
+ * ld.so looks in each of these directories' glibc-hwcaps subdirectories first, for the
+ * levels the CPU supports. resolve() always answers with the baseline library, which
+ * every CPU can load; variantsOf() lists the optimized builds next to it.
+ *
+ * resolve() may be called concurrently from several discovery threads.
+ */
+class LibraryResolver {
+public:
+    /**
+     * @param userSearchPaths Additional directories searched after DT_RUNPATH.
+     * @param cachePath Location of the ld.so cache to consult.
+     */
+    explicit LibraryResolver(std::vector<std::string> userSearchPaths,
+                             const std::filesystem::path& cachePath = LdSoCache::kDefaultPath);
+
+    /**
+     * Builds the search context for an object.
+     * @param objectPath Canonical path of the requesting object (used for $ORIGIN).
+     * @param info The object's dynamic metadata.
+     * @param inheritedRpath RPATH directories contributed by the chain of objects that loaded it.
+     */
+    LibrarySearchContext contextFor(const std::filesystem::path& objectPath,
+                                    const ElfDynamicInfo& info,
+                                    const std::vector<std::filesystem::path>& inheritedRpath = {}) const;
+
+    /**
+     * Resolves one DT_NEEDED entry. Results are memoized per (soname, context).
+     * @return The library's path, or an empty path if it cannot be found.
+     */
+    std::filesystem::path resolve(const std::string& soname, const LibrarySearchContext& context);
+
+    /**
+     * Finds the optimized variants of a resolved library: the same name in the glibc-hwcaps
+     * subdirectories of its directory, in the legacy hwcap subdirectories (one level deep),
+     * and, for a library found through ld.so.cache, the cache's hwcap entries. Variants built
+     * for another class or machine are skipped.
+     * @param library A path returned by resolve(), in the directory it was found in.
+     * @param soname The name it was resolved under.
+     * @return The variants, ordered by subdirectory.
+     */
+    std::vector<LibraryVariant> variantsOf(const std::filesystem::path& library, const std::string& soname,
+                                           const LibrarySearchContext& context);
+
+    /**
+     * Prepares a long-lived resolver for another run: forgets every candidate in a
+     * directory whose modification time changed (a library was added, removed or
+     * replaced there) and, if any did, every memoized resolution.
+     */
+    void refresh();
+
+    /**
+     * Splits a colon-separated search path and expands dynamic string tokens.
+     */
+    static std::vector<std::filesystem::path> expandSearchPath(const std::string& value,
+                                                               const std::filesystem::path& origin,
+                                                               bool is64Bit,
+                                                               std::uint16_t machine);
+
+private:
+    std::filesystem::path search(const std::string& soname, const LibrarySearchContext& context);
+    bool isCompatible(const std::filesystem::path& candidate, const LibrarySearchContext& context);
+
+    std::vector<std::filesystem::path> m_userSearchPaths;
+    std::vector<std::filesystem::path> m_ldLibraryPath;
+    LdSoCache m_cache;
+
+    mutable std::shared_mutex m_mutex;     // Guards m_resolved and m_candidates
+    std::unordered_map<std::string, std::filesystem::path> m_resolved;
+
+    // Class/machine of every candidate inspected so far; machine 0 marks a non-ELF file.
+    struct CandidateInfo { bool is64Bit; std::uint16_t machine; };
+    std::unordered_map<std::string, CandidateInfo> m_candidates;
+
+    // Modification time of each directory a candidate was inspected in, as of the first inspection.
+    std::unordered_map<std::string, std::filesystem::file_time_type> m_directories;
+};
+
+#endif //RELOCATOR_LIBRARYRESOLVER_HPP
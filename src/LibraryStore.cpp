@@ -0,0 +1,84 @@
+// src/LibraryStore.cpp
+#include "LibraryStore.hpp"
+#include "Sha256.hpp"
+
+#include <stdexcept>
+#include <system_error>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+LibraryStore::LibraryStore(const std::filesystem::path& root) : m_root(root) {
+    std::error_code ec;
+    std::filesystem::create_directories(m_root, ec);
+    if (ec) {
+        throw std::runtime_error("Cannot create the store " + m_root.string() + ": " + ec.message());
+    }
+}
+
+std::filesystem::path LibraryStore::entryFor(const std::string& sourceDigest, const std::string& edits,
+                                             const std::string& filename) const {
+    Sha256 hasher;
+    hasher.update(sourceDigest.data(), sourceDigest.size());
+    hasher.update("", 1);
+    hasher.update(edits.data(), edits.size());
+    const std::string key = Sha256::hex(hasher.finish());
+    return m_root / key.substr(0, 2) / (key + "-" + filename);
+}
+
+std::filesystem::path LibraryStore::debugFileOf(const std::filesystem::path& entry) {
+    std::filesystem::path debugFile = entry;
+    debugFile += ".debug";
+    return debugFile;
+}
+
+namespace {
+
+void makeReadOnly(const std::filesystem::path& file) {
+    std::filesystem::permissions(file, std::filesystem::perms::owner_write | std::filesystem::perms::group_write
+                                     | std::filesystem::perms::others_write, std::filesystem::perm_options::remove);
+}
+
+} // namespace
+
+bool LibraryStore::ensure(const std::filesystem::path& entry,
+                          const std::function<void(const std::filesystem::path&)>& produce) {
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(entry, ec)) {
+        return false;
+    }
+    std::filesystem::create_directories(entry.parent_path(), ec);
+    if (ec) {
+        throw std::runtime_error("Cannot create " + entry.parent_path().string() + ": " + ec.message());
+    }
+
+    // Unique per process and call, so concurrent producers of one entry never share a file;
+    // whichever renames last wins, with the same bytes.
+    const std::filesystem::path temp = entry.parent_path()
+        / (".tmp-" + std::to_string(getpid()) + "-" + std::to_string(m_nextTemp++) + "-" + entry.filename().string());
+    const std::filesystem::path tempDebug = debugFileOf(temp);
+    try {
+        produce(temp);
+        makeReadOnly(temp);
+        // The debug file goes first: once the entry exists, others reuse it and expect it
+        // to be complete.
+        if (std::filesystem::is_regular_file(tempDebug, ec)) {
+            makeReadOnly(tempDebug);
+            std::filesystem::rename(tempDebug, debugFileOf(entry));
+        }
+        std::filesystem::rename(temp, entry);
+    } catch (...) {
+        std::filesystem::remove(temp, ec);
+        std::filesystem::remove(tempDebug, ec);
+        throw;
+    }
+    return true;
+}
+
+CopyResult LibraryStore::link(const std::filesystem::path& entry, const std::filesystem::path& destination) {
+    return FileCopier::copy(entry, destination, CopyMode::Hardlink);
+}
@@ -0,0 +1,78 @@
+// src/LibraryStore.hpp
+#ifndef RELOCATOR_LIBRARYSTORE_HPP
+#define RELOCATOR_LIBRARYSTORE_HPP
+
+#include "FileCopier.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+
+/**
+ * @class LibraryStore
+ * @brief A content-addressed directory of finished bundle files, shared by many bundles.
+ *
+ * A file is stored under the SHA-256 of its source's contents and a description of the
+ * edits applied to it, so two bundles that patch the same library the same way (the
+ * usual case, with RUNPATHs relative to $ORIGIN) share one stored copy and each get a
+ * hard link to it. The store outlives any one build, so the key is a cryptographic
+ * digest: a collision would hand one bundle another's library without anyone noticing.
+ * Entries are laid out as <root>/<2 hex>/<key>-<filename>.
+ *
+ * An entry may carry a debug file, split from it when it was produced, at
+ * debugFileOf(entry). It is stored and published together with the entry, so every
+ * bundle that links the entry can link its debug file too.
+ *
+ * Entries are written under a temporary name and renamed into place, so processes
+ * sharing a store never see a partial file, and are made read-only: a bundle must never
+ * write through its link. The relocator unshares a linked file before patching it again.
+ */
+class LibraryStore {
+public:
+    /**
+     * @param root The store directory; created if missing.
+     * @throws std::runtime_error if it cannot be created.
+     */
+    explicit LibraryStore(const std::filesystem::path& root);
+
+    /**
+     * The path of an entry, whether or not it exists yet.
+     * @param sourceDigest Sha256::hashFile of the source.
+     * @param edits Everything that decides how the source is rewritten; entries differ whenever it does.
+     * @param filename The bundled filename, to keep entries recognizable.
+     */
+    std::filesystem::path entryFor(const std::string& sourceDigest, const std::string& edits,
+                                   const std::string& filename) const;
+
+    /**
+     * Where the debug file split from an entry (or from the temporary file produce() is
+     * given) lives.
+     */
+    static std::filesystem::path debugFileOf(const std::filesystem::path& entry);
+
+    /**
+     * Makes sure an entry exists, producing it if it does not.
+     * @param entry A path from entryFor().
+     * @param produce Writes the finished file to the path it is given, and optionally its
+     *                debug file to debugFileOf() that path.
+     * @return true if this call produced the entry, false if it was already stored.
+     * @throws Whatever produce throws, or std::runtime_error if the entry cannot be moved into place.
+     */
+    bool ensure(const std::filesystem::path& entry, const std::function<void(const std::filesystem::path&)>& produce);
+
+    /**
+     * Replaces destination with a hard link to an entry, or the cheapest copy where the
+     * two are on different filesystems.
+     */
+    static CopyResult link(const std::filesystem::path& entry, const std::filesystem::path& destination);
+
+    const std::filesystem::path& root() const { return m_root; }
+
+private:
+    std::filesystem::path m_root;
+    std::atomic<std::uint64_t> m_nextTemp{0};
+};
+
+#endif //RELOCATOR_LIBRARYSTORE_HPP
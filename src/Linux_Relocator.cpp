@@ -1,177 +1,1389 @@
 // src/Linux_Relocator.cpp
 #include "Linux_Relocator.hpp"
-#include "Process.hpp"
+#include "BundleManifest.hpp"
+#include "ConcurrentSet.hpp"
+#include "DependencyGraph.hpp"
+#include "DependencyPruner.hpp"
+#include "ElfFile.hpp"
+#include "ElfPatcher.hpp"
+#include "ElfStripper.hpp"
+#include "FileCopier.hpp"
+#include "LibraryResolver.hpp"
+#include "LibraryStore.hpp"
+#include "LoadProfiler.hpp"
+#include "LoadVerifier.hpp"
+#include "MappedFile.hpp"
+#include "PipelineStage.hpp"
+#include "ScanCache.hpp"
+#include "Sha256.hpp"
+#include "TarWriter.hpp"
+#include "WorkStealingPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iomanip>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <set>
-#include <map>
-#include <regex>
-#include <dlfcn.h>
-#include <cstdlib>
+#include <shared_mutex>
+#include <memory>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
 #include <algorithm>
 
-// Helper function to trim strings
-static std::string trim(const std::string& s) {
-    size_t first = s.find_first_not_of(" \t\n\r");
-    if (std::string::npos == first) {
-        return s;
+#include <elf.h>
+
+Linux_RelocatorCache::~Linux_RelocatorCache() = default;
+
+std::shared_ptr<LibraryResolver> Linux_RelocatorCache::resolverFor(const std::vector<std::string>& searchPaths) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::error_code ec;
+    const auto ldSoCacheTime = std::filesystem::last_write_time(LdSoCache::kDefaultPath, ec);
+    if (ldSoCacheTime != m_ldSoCacheTime) {
+        m_resolvers.clear();
+        m_ldSoCacheTime = ldSoCacheTime;
+    }
+    std::shared_ptr<LibraryResolver>& resolver = m_resolvers[searchPaths];
+    if (!resolver) {
+        resolver = std::make_shared<LibraryResolver>(searchPaths);
+    } else {
+        resolver->refresh();
+    }
+    return resolver;
+}
+
+ScanCache* Linux_RelocatorCache::scanCache(const RelocatorOptions& options) {
+    if (!options.scanCache) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_scanCacheOpened) {
+        m_scanCacheOpened = true;
+        std::filesystem::path cacheDir = options.scanCacheDir.empty() ? ScanCache::defaultDirectory()
+                                                                      : options.scanCacheDir;
+        if (!cacheDir.empty()) {
+            m_scanCache = std::make_unique<ScanCache>(cacheDir, options.scanCacheMaxBytes);
+        }
+    }
+    return m_scanCache.get();
+}
+
+Linux_Relocator::Linux_Relocator(const RelocatorOptions& options, std::shared_ptr<RelocatorCache> cache)
+    : Relocator(options, std::move(cache)) {
+    if (!std::dynamic_pointer_cast<Linux_RelocatorCache>(m_cache)) {
+        m_cache = std::make_shared<Linux_RelocatorCache>();
     }
-    size_t last = s.find_last_not_of(" \t\n\r");
-    return s.substr(first, (last - first + 1));
 }
 
+// One bundleDependencies call: the state every step shares, and the steps themselves.
+// Discovery (stage 1) feeds the copy, fixup and verify stages (2-4), which run while it
+// is still going; an archive is written, stale files removed and the bundle load-checked
+// and profiled once they have drained.
+class Linux_Relocator::Run {
+public:
+    Run(Linux_Relocator& relocator, const std::vector<BundleInput>& inputs, const std::filesystem::path& outputDir,
+        const std::vector<std::string>& searchPaths, const ExclusionPolicy& exclusions);
+
+    void execute();
+
+private:
+    using NodeId = DependencyGraph::NodeId;
+
+    // Each pending file carries the DT_RPATH directories inherited from the objects that loaded it.
+    struct PendingFile {
+        NodeId node;
+        std::vector<std::filesystem::path> inheritedRpath;
+    };
+
+    // CPU-optimized variants go into the same glibc-hwcaps subdirectory beside their baseline, under
+    // its bundled filename, so the loader finds them through the RUNPATH that finds the baseline.
+    struct VariantPlacement {
+        NodeId baseline;
+        std::filesystem::path subdirectory;
+    };
+
+    // A file can be patched once its copy has landed and its edges are final. Edges are final
+    // as soon as a file is discovered unless it inherits DT_RPATH from its loaders, in which case
+    // a later visit through another chain may still change them; those wait for discovery to end.
+    struct FileState {
+        bool copied = false;
+        bool final = false;
+        bool reused = false;                 // The bundled copy from the previous run was kept
+        bool upToDate = false;               // ... and needed no new fixups either
+        FileIdentity sourceId;
+        std::optional<uint64_t> contentHash;
+    };
+
+    // All edits for one file, and what they are compared by.
+    struct Fixups {
+        ElfPatchSpec spec;
+        std::string storeEdits;              // Names the store entry; empty for files that are not ELF
+        uint64_t hash = 0;                   // ManifestEntry::fixupHash
+    };
+
+    struct Materialized {
+        CopyResult copy;
+        bool stripped = false;
+    };
+
+    struct ArchiveMember {
+        std::vector<std::uint8_t> bytes;
+        unsigned mode = 0644;
+        bool readable = false;
+        std::string log;
+    };
+
+    std::string warning(const std::string& message) { return m_relocator.warning(message); }
+    void print(const std::ostringstream& log);
+
+    // Stage 1: discovery
+    void discover();
+    void visit(const PendingFile& pending);
+    std::optional<ElfDynamicInfo> readDynamicInfo(NodeId node, std::ostringstream& log);
+    std::optional<std::vector<std::filesystem::path>> pruneCandidates(const ElfDynamicInfo& info,
+                                                                      const LibrarySearchContext& context);
+    bool pruneIfUnused(NodeId node, const std::string& soname, const std::filesystem::path& library, size_t index,
+                       const std::vector<std::filesystem::path>& neededPaths, std::ostringstream& log);
+    void addVariants(NodeId baseline, const std::filesystem::path& path, const std::string& soname,
+                     const LibrarySearchContext& context, std::vector<PendingFile>& children, std::ostringstream& log);
+    void reportDiscovery();
+    void reportUnused();
+
+    // Where each file goes, and what it is patched to find there
+    std::filesystem::path locationOf(NodeId node);
+    std::string runpathFor(NodeId node);
+    FileState stateOf(NodeId node);
+    std::map<std::string, std::filesystem::path> unusedOf(NodeId node);
+
+    // Stages 2-4: copy, fix up and check each file as soon as it is ready
+    void markReady(NodeId node, bool copied, bool final);
+    void copyFile(NodeId node);
+    void fixupFile(NodeId node);
+    void verifyFile(NodeId node);
+    Fixups fixupsFor(NodeId node);
+    bool keepPreviousCopy(NodeId node, ManifestEntry& entry, std::ostringstream& log);
+    bool linkFromStore(NodeId node, const Fixups& fixups, bool isElf, ManifestEntry& entry, std::ostringstream& log);
+    void linkStoredDebugFile(NodeId node, const std::filesystem::path& stored);
+    bool patchCopy(NodeId node, const ElfPatchSpec& spec, ManifestEntry& entry, std::ostringstream& log);
+    Materialized materialize(NodeId node, const std::filesystem::path& originalPath, const std::filesystem::path& newPath,
+                             std::ostringstream& log, bool storeEntry = false);
+    void checkStructure(const ElfFile& elf, NodeId node, std::ostringstream& log);
+
+    // Once the stages have drained
+    void writeArchive();
+    ArchiveMember archiveMember(NodeId node);
+    void removeStaleFiles();
+    void printSummary(double totalSeconds, double discoverySeconds);
+    void checkLoading();
+    void profileLoading();
+    std::vector<std::filesystem::path> loadOrder(NodeId root);
+    void printLoadProfile(const LoadProfile& profile, size_t objects);
+
+    Linux_Relocator& m_relocator;
+    const RelocatorOptions& m_options;
+    const bool m_dryRun;
+    std::ostream& m_log;
+    std::ostream& m_errorLog;
+    DependencyGraph& m_graph;
+    BundleResult& m_result;
+    const std::vector<BundleInput>& m_inputs;
+    const std::filesystem::path& m_outputDir;
+    const ExclusionPolicy& m_exclusions;
+    PhaseStats& m_discoverStats;
+    PhaseStats& m_copyStats;
+    PhaseStats& m_fixupStats;
+    PhaseStats& m_verifyStats;
+    std::mutex m_logMutex;
+
+    // The resolver's memo and the parsed metadata of system libraries outlive this run:
+    // the cache may be shared with other runs, even concurrent ones, and the scan cache
+    // is also shared across processes.
+    std::shared_ptr<LibraryResolver> m_resolver;
+    ScanCache* m_scanCache;
+    std::atomic<uint64_t> m_scanCacheHits{0};
+    std::atomic<uint64_t> m_scanCacheMisses{0};
+
+    // A file reached through different RPATH chains may resolve differently, so visits are
+    // keyed by (path, chain). Its dynamic section is still parsed only once, in readDynamicInfo.
+    std::mutex m_infoMutex;
+    std::unordered_map<NodeId, std::shared_future<std::optional<ElfDynamicInfo>>> m_parsedFiles;
+    ConcurrentSet m_visited;
+    ConcurrentSet m_queuedForCopy;
+    ConcurrentSet m_variantsSearched;
+    std::optional<DependencyPruner> m_pruner;
+
+    // Roots keep the place in the bundle they were given; every dependency goes to the top level.
+    std::unordered_map<NodeId, std::filesystem::path> m_rootPlacement;
+    std::vector<NodeId> m_roots;
+    std::shared_mutex m_variantMutex;
+    std::unordered_map<NodeId, VariantPlacement> m_variantPlacement;
+
+    // An output ending in .tar is written as one archive, with nothing staged on disk: the
+    // copy and fixup stages only settle each file's edits, and the files go from their sources
+    // through the patcher into the archive once the whole set is known.
+    const bool m_archive;
+    std::mutex m_archiveMutex;
+    std::unordered_map<NodeId, ElfPatchSpec> m_archiveSpecs;
+
+    // The previous run's manifest lets unchanged files skip both copy and fixup. An archive
+    // is written afresh each time.
+    BundleManifest m_manifest;
+
+    // With a store, each finished file is written once into it and the bundle links to it;
+    // the copy stage only hashes the source, which with the edits names the store entry.
+    std::optional<LibraryStore> m_store;
+    std::atomic<size_t> m_storeWrites{0};
+    std::atomic<size_t> m_storeLinks{0};
+    std::atomic<uint64_t> m_storeSharedBytes{0};
+
+    std::mutex m_stateMutex;
+    std::unordered_map<NodeId, FileState> m_fileStates;
+
+    // DT_NEEDED entries the pruner found unused, per object, with the library each resolved to.
+    std::mutex m_unusedMutex;
+    std::unordered_map<NodeId, std::map<std::string, std::filesystem::path>> m_unusedNeeded;
+
+    // Stripping happens while copying, so what is patched and test-loaded is the stripped copy.
+    const StripMode m_stripMode;
+    const char* m_stripName;
+    std::atomic<size_t> m_strippedFiles{0};
+    std::atomic<uint64_t> m_strippedBytes{0};
+    std::atomic<uint64_t> m_debugBytes{0};
+
+    std::atomic<size_t> m_verifyFailures{0};
+    std::atomic<size_t> m_upToDate{0};
+    std::atomic<uint64_t> m_logicalBytes{0};
+    std::atomic<uint64_t> m_movedBytes{0};
+    std::atomic<size_t> m_methodCounts[4] = {};
+
+    // The workers start as soon as these are built, so they come after everything they use.
+    // Stages are declared downstream-first so each one outlives the stage feeding it.
+    WorkStealingPool m_pool;
+    PipelineStage<NodeId> m_verifyStage;
+    PipelineStage<NodeId> m_fixupStage;
+    PipelineStage<NodeId> m_copyStage;
+};
+
 void Linux_Relocator::bundleDependencies(
-    const std::filesystem::path& inputFile,
+    const std::vector<BundleInput>& inputs,
     const std::filesystem::path& outputDir,
     const std::vector<std::string>& searchPaths,
-    const std::vector<std::string>& literalExclusions,
-    const std::vector<std::string>& regexExclusions) {
+    const ExclusionPolicy& exclusions) {
+
+    m_log << "\n=== Starting Linux Relocation ===\n";
+    beginRun();
+    Run(*this, inputs, outputDir, searchPaths, exclusions).execute();
+    m_stats.finish();
+}
+
+Linux_Relocator::Run::Run(Linux_Relocator& relocator, const std::vector<BundleInput>& inputs,
+                          const std::filesystem::path& outputDir, const std::vector<std::string>& searchPaths,
+                          const ExclusionPolicy& exclusions)
+    : m_relocator(relocator), m_options(relocator.m_options), m_dryRun(relocator.m_dryRun), m_log(relocator.m_log),
+      m_errorLog(relocator.m_errorLog), m_graph(relocator.m_graph), m_result(relocator.m_result), m_inputs(inputs),
+      m_outputDir(outputDir), m_exclusions(exclusions),
+      m_discoverStats(relocator.m_stats.phase(Phase::Discover)), m_copyStats(relocator.m_stats.phase(Phase::Copy)),
+      m_fixupStats(relocator.m_stats.phase(Phase::Fixup)), m_verifyStats(relocator.m_stats.phase(Phase::Verify)),
+      m_resolver(static_cast<Linux_RelocatorCache&>(*relocator.m_cache).resolverFor(searchPaths)),
+      m_scanCache(static_cast<Linux_RelocatorCache&>(*relocator.m_cache).scanCache(m_options)),
+      m_archive(TarWriter::isArchivePath(outputDir)),
+      m_stripMode(m_options.strip == StripMode::None && !m_options.splitDebugDir.empty() ? StripMode::Debug : m_options.strip),
+      m_stripName(m_stripMode == StripMode::All ? "all" : "debug"),
+      m_pool(m_options.jobs),
+      m_verifyStage("verify", m_options.fixupJobs, m_options.queueDepth, [this](NodeId& node) { verifyFile(node); }),
+      m_fixupStage("fixup", m_options.fixupJobs, m_options.queueDepth, [this](NodeId& node) { fixupFile(node); }),
+      m_copyStage("copy", m_options.copyJobs, m_options.queueDepth, [this](NodeId& node) { copyFile(node); }) {
+    if (m_options.pruneUnused != PruneMode::Off) {
+        m_pruner.emplace(m_options.keepNeeded);
+    }
+    for (const auto& input : inputs) {
+        const NodeId root = m_graph.addNode(std::filesystem::canonical(input.file));
+        if (m_rootPlacement.emplace(root, input.bundlePath).second) {
+            m_graph.markRoot(root);
+            m_roots.push_back(root);
+        }
+    }
+    if (!m_archive) {
+        m_manifest.load(outputDir);
+    }
+    if (!m_options.storeDir.empty()) {
+        if (m_archive) {
+            throw std::runtime_error("A library store links files into a bundle directory and cannot be combined with an archive output ("
+                                     + outputDir.string() + ")");
+        }
+        m_store.emplace(m_options.storeDir);
+    }
+    if (m_archive && m_stripMode != StripMode::None) {
+        throw std::runtime_error("Stripping writes its output through files and cannot be combined with an archive output ("
+                                 + outputDir.string() + ")");
+    }
+}
 
-    std::cout << "\n=== Starting Linux Relocation ===\n";
+void Linux_Relocator::Run::execute() {
+    const auto started = std::chrono::steady_clock::now();
+    discover();
+    const double discoverySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    reportDiscovery();
 
-    std::map<std::filesystem::path, std::map<std::string, std::filesystem::path>> dependencyGraph;
-    std::vector<std::filesystem::path> filesToProcess = { std::filesystem::canonical(inputFile) };
+    // Release the files whose edges could still change while discovery was running.
+    for (NodeId node = 0; node < m_graph.size(); ++node) {
+        markReady(node, false, true);
+    }
+    m_copyStage.close();
+    m_copyStage.join();
+    m_fixupStage.close();
+    m_fixupStage.join();
+    m_verifyStage.close();
+    m_verifyStage.join();
 
-    const std::set<std::string> system_libs_to_ignore = {
-        // Core C/C++ runtime and linker
-        "linux-vdso.so.1", "ld-linux-x86-64.so.2", "libc.so.6", "libdl.so.2",
-        "libm.so.6", "libpthread.so.0", "librt.so.1", "libgcc_s.so.1", "libstdc++.so.6",
-        "libresolv.so.2", "libcrypt.so.1"
-    };
+    if (m_archive) {
+        writeArchive();
+    }
+    removeStaleFiles();
+    if (!m_dryRun && !m_archive) {
+        m_manifest.save(m_outputDir);
+    }
+    const double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    printSummary(totalSeconds, discoverySeconds);
+    for (NodeId node : m_graph.nodesByPath()) {
+        m_result.files.push_back({ m_graph.path(node), locationOf(node), m_graph.isRoot(node), m_fileStates[node].upToDate });
+    }
+
+    checkLoading();
+    if (m_options.profileLoadRuns > 0 && !m_roots.empty()) {
+        profileLoading();
+    }
+}
 
-    // Combine the user's literal exclusions into the main set for fast lookup
-    std::set<std::string> allExclusions = system_libs_to_ignore;
-    allExclusions.insert(literalExclusions.begin(), literalExclusions.end());
+void Linux_Relocator::Run::print(const std::ostringstream& log) {
+    std::lock_guard<std::mutex> lock(m_logMutex);
+    m_log << log.str() << std::flush;
+}
 
-    const std::regex ldd_regex(R"(^\s*([^ \t]+)\s*=>\s*(.+)\s*\(|(.+)\s*\(.+\))");
+// --- Stage 1: discovery ---
 
-    std::cout << "Phase 1: Discovering all dependencies..." << std::endl;
-    while (!filesToProcess.empty()) {
-        std::filesystem::path currentFile = filesToProcess.back();
-        filesToProcess.pop_back();
+void Linux_Relocator::Run::discover() {
+    m_log << "Phase 1: Discovering all dependencies";
+    if (m_pool.size() > 1) {
+        m_log << " using " << m_pool.size() << " threads";
+    }
+    m_log << ", " << (m_dryRun ? "planning to copy and relocate" : "copying and relocating")
+              << " each file as it is found..." << std::endl;
+    for (NodeId node : m_roots) {
+        PendingFile root{ node, {} };
+        m_pool.submit([this, root] { visit(root); });
+    }
+    m_pool.wait();
+    m_graph.freeze();
+}
 
-        if (dependencyGraph.count(currentFile)) {
-            continue;
+void Linux_Relocator::Run::visit(const PendingFile& pending) {
+    const std::filesystem::path& currentFile = m_graph.path(pending.node);
+    PhaseStats::Scope timing(m_discoverStats, currentFile.string());
+
+    // Each file's messages are buffered and printed together so threads do not interleave lines.
+    std::ostringstream parseLog;
+    std::optional<ElfDynamicInfo> info = readDynamicInfo(pending.node, parseLog);
+
+    // With DT_RUNPATH the inherited chain is ignored, so one visit per file is enough.
+    const bool chainIndependent = !info || info->hasRunpath;
+    std::string visitKey = currentFile.string();
+    if (!chainIndependent) {
+        for (const auto& dir : pending.inheritedRpath) {
+            visitKey += '\0' + dir.string();
         }
+    }
+    if (!m_visited.insert(visitKey)) {
+        timing.discard();
+        return;
+    }
 
-        std::cout << "  Processing: " << currentFile << std::endl;
-        dependencyGraph[currentFile] = {};
-
-        std::string lddCmd = "ldd \"" + currentFile.string() + "\"";
-        CommandResult result = Process::exec(lddCmd);
-
-        std::istringstream stream(result.output);
-        std::string line;
-
-        while (std::getline(stream, line)) {
-            line = trim(line);
-            std::smatch match;
-            if (std::regex_search(line, match, ldd_regex)) {
-                std::string soname = trim(match[1].str());
-                std::string depPathStr = trim(match[2].str());
-
-                if (depPathStr.empty()) { depPathStr = soname; }
-                if (depPathStr.empty() || depPathStr == "not a dynamic executable") { continue; }
-
-                std::filesystem::path depPath(depPathStr);
-                std::string filename = depPath.filename().string();
-
-                // Check against combined exclusion list
-                bool shouldIgnore = false;
-                if(allExclusions.count(filename)) {
-                    shouldIgnore = true;
-                } else {
-                    // NEW: Check against user-provided regex patterns
-                    for (const auto& pattern : regexExclusions) {
-                        if (std::regex_match(filename, std::regex(pattern))) {
-                            shouldIgnore = true;
-                            break;
-                        }
-                    }
-                }
+    std::ostringstream log;
+    log << "  Processing: " << currentFile << "\n" << parseLog.str();
+    if (m_queuedForCopy.insert(currentFile.string())) {
+        m_copyStage.push(pending.node);
+    }
 
-                if(shouldIgnore) {
-                    std::cout << "    --> Ignoring library: " << filename << std::endl;
-                    continue;
-                }
+    std::vector<DependencyGraph::Edge> edges;
+    std::vector<PendingFile> children;
+
+    if (info) {
+        LibrarySearchContext context = m_resolver->contextFor(currentFile, *info, pending.inheritedRpath);
+        const std::optional<std::vector<std::filesystem::path>> neededPaths = pruneCandidates(*info, context);
+
+        for (size_t i = 0; i < info->needed.size(); ++i) {
+            const std::string& soname = info->needed[i];
+            std::string filename = std::filesystem::path(soname).filename().string();
+
+            if (const ExclusionRule* rule = m_exclusions.matchName(filename)) {
+                log << "    --> Ignoring library: " << filename << " [" << rule->describe() << "]\n";
+                continue;
+            }
+
+            std::filesystem::path depPath = m_resolver->resolve(soname, context);
+            if (depPath.empty()) {
+                log << "  " << warning("Could not find dependency " + soname + " of " + currentFile.string()) << "\n";
+                continue;
+            }
+            auto canonicalDepPath = std::filesystem::canonical(depPath);
+            const ExclusionRule* rule = m_exclusions.matchPath(depPath);
+            if (!rule && canonicalDepPath != depPath) {
+                rule = m_exclusions.matchPath(canonicalDepPath);
+            }
+            if (rule) {
+                log << "    --> Ignoring library: " << depPath.string() << " [" << rule->describe() << "]\n";
+                continue;
+            }
+            if (neededPaths && pruneIfUnused(pending.node, soname, canonicalDepPath, i, *neededPaths, log)) {
+                continue;
+            }
+            const NodeId dep = m_graph.addNode(canonicalDepPath);
+            edges.push_back({ m_graph.addName(soname), dep });
+            children.push_back({ dep, context.rpathDirs });
+
+            if (m_options.hwcapVariants && m_variantsSearched.insert(canonicalDepPath.string())) {
+                addVariants(dep, depPath, soname, context, children, log);
+            }
+        }
+    }
 
-                if (std::filesystem::exists(depPath)) {
-                    auto canonicalDepPath = std::filesystem::canonical(depPath);
-                    dependencyGraph[currentFile][soname] = canonicalDepPath;
-                    filesToProcess.push_back(canonicalDepPath);
-                } else {
-                    std::cerr << "  Warning: Could not find dependency: " << depPathStr << std::endl;
+    m_graph.mergeEdges(pending.node, edges);
+    print(log);
+
+    if (chainIndependent) {
+        markReady(pending.node, false, true);
+    }
+    for (auto& child : children) {
+        m_pool.submit([this, child] { visit(child); });
+    }
+}
+
+std::optional<ElfDynamicInfo> Linux_Relocator::Run::readDynamicInfo(NodeId node, std::ostringstream& log) {
+    std::promise<std::optional<ElfDynamicInfo>> promise;
+    std::shared_future<std::optional<ElfDynamicInfo>> future;
+    bool owner = false;
+    {
+        std::lock_guard<std::mutex> lock(m_infoMutex);
+        auto it = m_parsedFiles.find(node);
+        if (it == m_parsedFiles.end()) {
+            future = promise.get_future().share();
+            m_parsedFiles.emplace(node, future);
+            owner = true;
+        } else {
+            future = it->second;
+        }
+    }
+    if (owner) {
+        const std::filesystem::path& file = m_graph.path(node);
+        const FileIdentity identity = BundleManifest::identify(file);
+        std::optional<ElfDynamicInfo> info;
+        if (m_scanCache) {
+            info = m_scanCache->lookup(file, identity);
+            ++(info ? m_scanCacheHits : m_scanCacheMisses);
+        }
+        if (info) {
+            // Only parsed ELF objects are ever cached.
+        } else if (!ElfFile::isElf(file)) {
+            log << "  " << warning("Not an ELF file, no dependencies read: " + file.string()) << "\n";
+        } else {
+            try {
+                m_discoverStats.addBytesRead(identity.size);
+                info = ElfFile(file).dynamicInfo();
+                if (m_scanCache) {
+                    m_scanCache->insert(file, identity, *info);
                 }
+            } catch (const std::exception& e) {
+                log << "  " << warning("Could not read dynamic section of " + file.string() + ": " + e.what()) << "\n";
             }
         }
+        promise.set_value(info);
     }
+    return future.get();
+}
 
-    std::cout << "\n--- Dependency Analysis Complete ---" << std::endl;
-    std::cout << "Found " << dependencyGraph.size() << " total files to process.\n\n";
+// Pruning judges each entry against all the others, excluded ones included, so every entry
+// must resolve before any can be judged.
+std::optional<std::vector<std::filesystem::path>> Linux_Relocator::Run::pruneCandidates(
+    const ElfDynamicInfo& info, const LibrarySearchContext& context) {
+    if (!m_pruner) {
+        return std::nullopt;
+    }
+    std::vector<std::filesystem::path> neededPaths;
+    for (const auto& soname : info.needed) {
+        std::filesystem::path path = m_resolver->resolve(soname, context);
+        std::error_code ec;
+        path = path.empty() ? path : std::filesystem::canonical(path, ec);
+        if (path.empty() || ec) {
+            return std::nullopt;
+        }
+        neededPaths.push_back(path);
+    }
+    return neededPaths;
+}
+
+// Records an entry none of the object's imports resolve to. Returns true if it is dropped,
+// so it gets no edge and is not bundled for this object.
+bool Linux_Relocator::Run::pruneIfUnused(NodeId node, const std::string& soname, const std::filesystem::path& library,
+                                         size_t index, const std::vector<std::filesystem::path>& neededPaths,
+                                         std::ostringstream& log) {
+    std::vector<std::filesystem::path> siblings = neededPaths;
+    siblings.erase(siblings.begin() + static_cast<std::ptrdiff_t>(index));
+    if (!m_pruner->unused(m_graph.path(node), soname, library, siblings)) {
+        return false;
+    }
+    const bool drop = m_options.pruneUnused == PruneMode::Drop;
+    log << "    --> " << (drop ? "Dropping" : "Unused") << " dependency: " << soname
+        << " (none of its symbols are used)\n";
+    std::lock_guard<std::mutex> lock(m_unusedMutex);
+    m_unusedNeeded[node].emplace(soname, library);
+    return drop;
+}
+
+// The variants are bundled whole, with dependencies of their own; the loader on the
+// deployed machine picks the best one its CPU supports.
+void Linux_Relocator::Run::addVariants(NodeId baseline, const std::filesystem::path& path, const std::string& soname,
+                                       const LibrarySearchContext& context, std::vector<PendingFile>& children,
+                                       std::ostringstream& log) {
+    const std::filesystem::path& baselinePath = m_graph.path(baseline);
+    for (const auto& variant : m_resolver->variantsOf(path, soname, context)) {
+        std::error_code ec;
+        const std::filesystem::path variantPath = std::filesystem::canonical(variant.path, ec);
+        if (ec || variantPath == baselinePath || m_exclusions.matchPath(variant.path)) {
+            continue;
+        }
+        const NodeId variantNode = m_graph.addNode(variantPath);
+        if (m_rootPlacement.count(variantNode)) {
+            continue;
+        }
+        {
+            std::unique_lock<std::shared_mutex> lock(m_variantMutex);
+            if (!m_variantPlacement.emplace(variantNode, VariantPlacement{ baseline, variant.subdirectory }).second) {
+                continue;
+            }
+        }
+        log << "    --> Optimized variant: " << (variant.subdirectory / soname).generic_string()
+            << (variant.legacy ? " (legacy hwcap directory; glibc 2.37 and later ignore it)" : "") << "\n";
+        children.push_back({ variantNode, context.rpathDirs });
+    }
+}
+
+void Linux_Relocator::Run::reportDiscovery() {
+    m_log << "\n--- Dependency Analysis Complete ---" << std::endl;
+    m_log << "Found " << m_graph.size() << " total files to process";
+    if (m_inputs.size() > 1) {
+        m_log << " for " << m_inputs.size() << " inputs";
+    }
+    m_log << ".\n";
+    if (!m_variantPlacement.empty()) {
+        m_log << m_variantPlacement.size() << " of them are CPU-optimized variants, bundled in hwcap subdirectories beside their baselines.\n";
+    }
+    if (!m_unusedNeeded.empty()) {
+        reportUnused();
+    }
+    if (m_scanCache) {
+        m_log << "Scan cache: " << m_scanCacheHits << " hits, " << m_scanCacheMisses << " misses.\n";
+        m_discoverStats.addCacheLookups(m_scanCacheHits, m_scanCacheMisses);
+        m_scanCache->flush();
+    }
+    m_log << "\n";
+}
+
+void Linux_Relocator::Run::reportUnused() {
+    // An entry counts as dropped only if no visit kept it through another RPATH chain.
+    size_t dropped = 0;
+    for (const auto& [node, entries] : m_unusedNeeded) {
+        const auto& edges = m_graph.edgesOf(node);
+        for (const auto& [soname, library] : entries) {
+            const bool kept = std::any_of(edges.begin(), edges.end(),
+                [&](const DependencyGraph::Edge& edge) { return m_graph.name(edge.name) == soname; });
+            const bool drop = m_options.pruneUnused == PruneMode::Drop && !kept;
+            dropped += drop ? 1 : 0;
+            m_result.unused.push_back({ m_graph.path(node), soname, library, drop });
+        }
+    }
+    std::sort(m_result.unused.begin(), m_result.unused.end(), [](const auto& a, const auto& b) {
+        return std::tie(a.object, a.soname) < std::tie(b.object, b.soname);
+    });
+    m_log << m_result.unused.size() << " DT_NEEDED entries satisfy none of their objects' imports";
+    if (m_options.pruneUnused == PruneMode::Drop) {
+        m_log << "; " << dropped << (m_dryRun ? " would be" : " are") << " dropped";
+    }
+    m_log << ".\n";
+}
+
+// --- Where each file goes ---
+
+std::filesystem::path Linux_Relocator::Run::locationOf(NodeId node) {
+    auto it = m_rootPlacement.find(node);
+    if (it != m_rootPlacement.end()) {
+        return it->second;
+    }
+    std::shared_lock<std::shared_mutex> lock(m_variantMutex);
+    auto variant = m_variantPlacement.find(node);
+    if (variant == m_variantPlacement.end()) {
+        return m_graph.path(node).filename();
+    }
+    auto root = m_rootPlacement.find(variant->second.baseline);
+    const std::filesystem::path baseline = root != m_rootPlacement.end() ? root->second
+                                         : m_graph.path(variant->second.baseline).filename();
+    return baseline.parent_path() / variant->second.subdirectory / baseline.filename();
+}
+
+// RUNPATH lists, relative to $ORIGIN, each directory that holds one of the file's dependencies.
+std::string Linux_Relocator::Run::runpathFor(NodeId node) {
+    const std::filesystem::path self = locationOf(node).parent_path();
+    std::vector<std::string> dirs;
+    for (const auto& edge : m_graph.edgesOf(node)) {
+        const std::filesystem::path relative = locationOf(edge.target).parent_path().lexically_relative(self);
+        std::string dir = "$ORIGIN";
+        if (!relative.empty() && relative != ".") {
+            dir += "/" + relative.generic_string();
+        }
+        if (std::find(dirs.begin(), dirs.end(), dir) == dirs.end()) {
+            dirs.push_back(dir);
+        }
+    }
+    std::string runpath;
+    for (const auto& dir : dirs) {
+        runpath += (runpath.empty() ? "" : ":") + dir;
+    }
+    return runpath.empty() ? std::string("$ORIGIN") : runpath;
+}
+
+Linux_Relocator::Run::FileState Linux_Relocator::Run::stateOf(NodeId node) {
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    return m_fileStates[node];
+}
+
+std::map<std::string, std::filesystem::path> Linux_Relocator::Run::unusedOf(NodeId node) {
+    std::lock_guard<std::mutex> lock(m_unusedMutex);
+    auto it = m_unusedNeeded.find(node);
+    return it == m_unusedNeeded.end() ? std::map<std::string, std::filesystem::path>() : it->second;
+}
 
-    // --- Phase 2: Copy all discovered files to the output directory ---
-    std::cout << "Phase 2: " << (m_dryRun ? "Planning to copy" : "Copying") << " dependencies to output directory..." << std::endl;
-    for (const auto& [originalPath, dependencies] : dependencyGraph) {
-        std::filesystem::path newPath = outputDir / originalPath.filename();
+// --- Stages 2-4: copy, fix up and check each file as soon as it is ready ---
 
-        std::cout << "  " << (m_dryRun ? "Would copy" : "Copying") << " " << originalPath.filename() << " to " << newPath << std::endl;
+void Linux_Relocator::Run::markReady(NodeId node, bool copied, bool final) {
+    bool ready = false;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        FileState& state = m_fileStates[node];
+        const bool wasReady = state.copied && state.final;
+        state.copied |= copied;
+        state.final |= final;
+        ready = !wasReady && state.copied && state.final;
+    }
+    if (ready) {
+        m_fixupStage.push(node);
+    }
+}
+
+void Linux_Relocator::Run::copyFile(NodeId node) {
+    if (m_archive) {
+        markReady(node, true, false);
+        return;
+    }
+    const std::filesystem::path& originalPath = m_graph.path(node);
+    std::filesystem::path newPath = m_outputDir / locationOf(node);
+    PhaseStats::Scope timing(m_copyStats, originalPath.string());
+    const FileIdentity sourceId = BundleManifest::identify(originalPath);
+
+    // The previous copy is kept if it is untouched and came from the same bytes. A changed
+    // identity alone (e.g. a reinstalled but identical library) costs a hash, not a copy.
+    std::optional<uint64_t> contentHash;
+    bool reused = false;
+    std::optional<ManifestEntry> previous = m_manifest.find(locationOf(node).generic_string());
+    if (previous && previous->source == originalPath && previous->outputId.size != 0
+        && previous->outputId == BundleManifest::identify(newPath)) {
+        if (previous->sourceId == sourceId) {
+            contentHash = previous->contentHash;
+        } else {
+            contentHash = BundleManifest::hashFile(originalPath);
+            m_copyStats.addBytesRead(sourceId.size);
+        }
+        reused = (*contentHash == previous->contentHash);
+    }
+
+    if (!reused && m_store && !m_dryRun) {
+        // The fixup stage makes or finds the finished file in the store.
+        if (!contentHash) {
+            contentHash = BundleManifest::hashFile(originalPath);
+            m_copyStats.addBytesRead(sourceId.size);
+        }
+        m_copyStage.addBytes(sourceId.size);
+    } else if (!reused) {
+        std::ostringstream log;
+        log << "  " << (m_dryRun ? "Would copy" : "Copying") << " " << originalPath.filename() << " to " << newPath;
+        if (m_dryRun) {
+            if (m_stripMode != StripMode::None && ElfFile::isElf(originalPath)) {
+                log << " (stripping " << m_stripName << ")";
+            }
+            m_copyStage.addBytes(std::filesystem::file_size(originalPath));
+        } else {
+            std::filesystem::create_directories(newPath.parent_path());
+            const Materialized copied = materialize(node, originalPath, newPath, log);
+            const CopyResult& result = copied.copy;
+            m_copyStage.addBytes(result.logicalBytes);
+            m_logicalBytes += result.logicalBytes;
+            m_movedBytes += result.bytesMoved;
+            if (!copied.stripped) {
+                ++m_methodCounts[static_cast<size_t>(result.method)];
+            }
+            m_copyStats.addBytesCopied(result.logicalBytes);
+            m_copyStats.addBytesWritten(result.bytesMoved);
+            if (!contentHash) {
+                contentHash = BundleManifest::hashFile(originalPath);
+                m_copyStats.addBytesRead(sourceId.size);
+            }
+        }
+        log << "\n";
+        print(log);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        FileState& state = m_fileStates[node];
+        state.reused = reused;
+        state.sourceId = sourceId;
+        state.contentHash = contentHash;
+    }
+    markReady(node, true, false);
+}
+
+void Linux_Relocator::Run::fixupFile(NodeId node) {
+    const std::filesystem::path& originalPath = m_graph.path(node);
+    std::filesystem::path newPath = m_outputDir / locationOf(node);
+    PhaseStats::Scope timing(m_fixupStats, newPath.string());
+    const bool isElf = ElfFile::isElf(originalPath);
+
+    const Fixups fixups = fixupsFor(node);
+    if (m_archive) {
+        std::lock_guard<std::mutex> lock(m_archiveMutex);
+        m_archiveSpecs[node] = fixups.spec;
+        return;
+    }
+
+    ManifestEntry entry;
+    entry.name = locationOf(node).generic_string();
+    entry.source = originalPath;
+    entry.fixupHash = isElf ? fixups.hash : 0;
+    const FileState state = stateOf(node);
+    entry.sourceId = state.sourceId;
+    entry.contentHash = state.contentHash.value_or(0);
+
+    std::ostringstream log;
+    if (state.reused && keepPreviousCopy(node, entry, log)) {
+        return;
+    }
+
+    if (m_store && !m_dryRun) {
+        const bool linked = linkFromStore(node, fixups, isElf, entry, log);
+        print(log);
+        if (linked && isElf) {
+            m_verifyStage.push(node);
+        }
+        return;
+    }
+    log << "  Fixing up " << newPath.filename() << "...\n";
+
+    if (!isElf) {
+        log << "    Not an ELF file, skipping.\n";
+        print(log);
         if (!m_dryRun) {
-            std::filesystem::copy_file(originalPath, newPath, std::filesystem::copy_options::overwrite_existing);
+            entry.outputId = BundleManifest::identify(newPath);
+            m_manifest.record(entry);
         }
+        return;
     }
 
-    // --- Phase 3: Fixup the copied libraries with 'patchelf' ---
-    std::cout << "\nPhase 3: " << (m_dryRun ? "Planning to relocate" : "Relocating") << " library paths for all bundled files..." << std::endl;
-    for (const auto& [originalPath, dependencies] : dependencyGraph) {
-        std::filesystem::path newPath = outputDir / originalPath.filename();
-        std::cout << "  Fixing up " << newPath.filename() << "..." << std::endl;
+    const bool patched = patchCopy(node, fixups.spec, entry, log);
+    print(log);
+    if (patched) {
+        m_verifyStage.push(node);
+    }
+}
 
-        // Step 3a: Set the RPATH to '$ORIGIN' so it looks in its own directory.
-        std::string rpathCmd = "patchelf --set-rpath '$ORIGIN' \"" + newPath.string() + "\"";
+// All edits for a file are collected and applied in one read/modify/write:
+// RUNPATH becomes relative to '$ORIGIN' so it looks inside the bundle, and every
+// bundled dependency is renamed to the filename it was copied under.
+Linux_Relocator::Run::Fixups Linux_Relocator::Run::fixupsFor(NodeId node) {
+    Fixups fixups;
+    ElfPatchSpec& spec = fixups.spec;
+    spec.runpath = runpathFor(node);
+    std::string edits = *spec.runpath;
+    for (const auto& edge : m_graph.edgesOf(node)) {
+        const std::string& soname = m_graph.name(edge.name);
+        spec.neededRenames[soname] = locationOf(edge.target).filename().string();
+        edits += '\0' + soname + '\0' + spec.neededRenames[soname];
+    }
+    // A dropped entry that another visit still resolved keeps its edge, and stays.
+    for (const auto& unused : unusedOf(node)) {
+        if (m_options.pruneUnused == PruneMode::Drop && !spec.neededRenames.count(unused.first)) {
+            spec.neededRemovals.insert(unused.first);
+            edits += std::string("\0-", 2) + unused.first;
+        }
+    }
+    // A copy stripped another way is not the same copy. Where its debug file goes only
+    // matters to this bundle, so the store's key leaves the directory out.
+    if (m_stripMode != StripMode::None) {
+        edits += std::string("\0strip=", 7) + m_stripName + (m_options.splitDebugDir.empty() ? "" : "+split");
+    }
+    fixups.storeEdits = ElfFile::isElf(m_graph.path(node)) ? edits : std::string();
+    if (!m_options.splitDebugDir.empty()) {
+        edits += '\0' + m_options.splitDebugDir.string();
+    }
+    fixups.hash = BundleManifest::hashBytes(edits.data(), edits.size());
+    return fixups;
+}
+
+// The copy kept from the previous run is up to date if its edits are; otherwise it is
+// replaced by a fresh copy of the original. Returns true if there is nothing left to do.
+bool Linux_Relocator::Run::keepPreviousCopy(NodeId node, ManifestEntry& entry, std::ostringstream& log) {
+    std::optional<ManifestEntry> previous = m_manifest.find(entry.name);
+    if (previous && previous->fixupHash == entry.fixupHash) {
+        entry.outputId = previous->outputId;
+        m_manifest.record(entry);
+        ++m_upToDate;
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_fileStates[node].upToDate = true;
+        return true;
+    }
+    // The kept copy carries the old edits; start again from the original.
+    const std::filesystem::path newPath = m_outputDir / locationOf(node);
+    log << "  " << (m_dryRun ? "Would re-copy " : m_store ? "Re-linking " : "Re-copying ") << newPath.filename()
+        << " because its fixups changed";
+    if (!m_dryRun && !m_store) {
+        const CopyResult result = materialize(node, m_graph.path(node), newPath, log).copy;
+        m_movedBytes += result.bytesMoved;
+        m_fixupStats.addBytesCopied(result.logicalBytes);
+        m_fixupStats.addBytesWritten(result.bytesMoved);
+    }
+    log << ".\n";
+    return false;
+}
+
+// Makes or finds the finished file in the store and links the bundle to it. Returns true
+// if the bundle now has it.
+bool Linux_Relocator::Run::linkFromStore(NodeId node, const Fixups& fixups, bool isElf, ManifestEntry& entry,
+                                         std::ostringstream& log) {
+    const std::filesystem::path& originalPath = m_graph.path(node);
+    const std::filesystem::path newPath = m_outputDir / locationOf(node);
+    try {
+        const std::filesystem::path stored = m_store->entryFor(Sha256::hashFile(originalPath), fixups.storeEdits,
+                                                               newPath.filename().string());
+        m_fixupStats.addBytesRead(entry.sourceId.size);
+        std::ostringstream storeLog;
+        const bool produced = m_store->ensure(stored, [&](const std::filesystem::path& temp) {
+            storeLog << "  Storing " << newPath.filename() << " as " << stored.filename();
+            const CopyResult copied = materialize(node, originalPath, temp, storeLog, true).copy;
+            storeLog << "\n";
+            // A hard-linked copy is the original itself, and store entries are patched in place.
+            const uint64_t unshared = FileCopier::unshare(temp);
+            m_movedBytes += copied.bytesMoved + unshared;
+            m_fixupStats.addBytesWritten(copied.bytesMoved + unshared);
+            if (!isElf) {
+                return;
+            }
+            std::filesystem::permissions(temp, std::filesystem::perms::owner_write, std::filesystem::perm_options::add);
+            const ElfPatchPlan plan = ElfPatcher::apply(temp, fixups.spec);
+            for (const auto& change : plan.changes) {
+                storeLog << "    Wrote " << change.size << " bytes at offset 0x" << std::hex << change.offset << std::dec
+                         << ": " << change.description << "\n";
+            }
+            m_fixupStage.addBytes(plan.newSize);
+            m_fixupStats.addBytesRead(plan.originalSize);
+        });
+        if (produced) {
+            ++m_storeWrites;
+            log << storeLog.str();
+        } else {
+            ++m_storeLinks;
+            m_storeSharedBytes += std::filesystem::file_size(stored);
+            log << "  Linking " << newPath.filename() << " to the stored " << stored.filename();
+        }
+        std::filesystem::create_directories(newPath.parent_path());
+        const CopyResult result = LibraryStore::link(stored, newPath);
+        if (!produced) {
+            log << " (" << FileCopier::methodName(result.method) << ").\n";
+        }
+        linkStoredDebugFile(node, stored);
+        m_logicalBytes += result.logicalBytes;
+        m_movedBytes += result.bytesMoved;
+        ++m_methodCounts[static_cast<size_t>(result.method)];
+        m_fixupStats.addBytesWritten(result.bytesMoved);
+        entry.outputId = BundleManifest::identify(newPath);
+        m_manifest.record(entry);
+        return true;
+    } catch (const std::exception& e) {
+        log << "  " << warning("Could not store " + newPath.filename().string() + ": " + e.what()) << "\n";
+        return false;
+    }
+}
+
+// Every bundle linking a stored file gets its debug file, by name and by build ID, not
+// just the run that produced the entry.
+void Linux_Relocator::Run::linkStoredDebugFile(NodeId node, const std::filesystem::path& stored) {
+    const std::filesystem::path storedDebug = LibraryStore::debugFileOf(stored);
+    if (m_options.splitDebugDir.empty() || !std::filesystem::is_regular_file(storedDebug)) {
+        return;
+    }
+    std::filesystem::path debugFile = m_options.splitDebugDir / locationOf(node);
+    debugFile += ".debug";
+    std::filesystem::create_directories(debugFile.parent_path());
+    LibraryStore::link(storedDebug, debugFile);
+    const std::string buildId = ElfFile(stored).buildId();
+    if (buildId.size() > 2) {
+        const std::filesystem::path byId = m_options.splitDebugDir / ".build-id" / buildId.substr(0, 2)
+                                         / (buildId.substr(2) + ".debug");
+        std::filesystem::create_directories(byId.parent_path());
+        LibraryStore::link(storedDebug, byId);
+    }
+}
 
-        std::cout << "    " << rpathCmd << std::endl;
+// Applies the edits to the bundled copy, or plans them in a dry run. Returns true if the
+// copy was written, and so needs checking.
+bool Linux_Relocator::Run::patchCopy(NodeId node, const ElfPatchSpec& spec, ManifestEntry& entry,
+                                     std::ostringstream& log) {
+    const std::filesystem::path& originalPath = m_graph.path(node);
+    const std::filesystem::path newPath = m_outputDir / locationOf(node);
+    bool patched = false;
+    try {
+        ElfPatchPlan plan;
+        if (m_dryRun) {
+            // The copy does not exist yet, but it would be byte-identical to the original.
+            plan = ElfPatcher::plan(originalPath, spec);
+        } else if (m_options.copyMode == CopyMode::Hardlink && !(plan = ElfPatcher::plan(newPath, spec)).changed()) {
+            // Nothing to write, so the bundled file can stay a hard link to the original.
+        } else {
+            // Never write through a hard link into the original.
+            const uint64_t unshared = FileCopier::unshare(newPath);
+            m_movedBytes += unshared;
+            m_fixupStats.addBytesWritten(unshared);
+            std::filesystem::permissions(newPath, std::filesystem::perms::owner_write, std::filesystem::perm_options::add);
+            plan = ElfPatcher::apply(newPath, spec);
+            patched = true;
+        }
+
+        if (!plan.changed()) {
+            log << "    Already relocatable, no changes.\n";
+        }
+        uint64_t written = 0;
+        for (const auto& change : plan.changes) {
+            log << "    " << (m_dryRun ? "Would write " : "Wrote ") << change.size << " bytes at offset 0x"
+                << std::hex << change.offset << std::dec << ": " << change.description << "\n";
+            written += change.size;
+        }
+        m_fixupStage.addBytes(plan.relayout ? plan.newSize : written);
+        m_fixupStats.addBytesRead(plan.originalSize);
+        if (patched) {
+            m_fixupStats.addBytesWritten(plan.relayout ? plan.newSize : written);
+        }
         if (!m_dryRun) {
-            Process::exec(rpathCmd);
+            entry.outputId = BundleManifest::identify(newPath);
+            m_manifest.record(entry);
+        }
+    } catch (const std::exception& e) {
+        log << "    " << warning("Could not relocate " + newPath.filename().string() + ": " + e.what()) << "\n";
+    }
+    return patched;
+}
+
+// Copies a file into place, stripping it on the way where the options ask for it. A store
+// entry keeps its debug file beside it, for linkStoredDebugFile to publish.
+Linux_Relocator::Run::Materialized Linux_Relocator::Run::materialize(NodeId node, const std::filesystem::path& originalPath,
+                                                                     const std::filesystem::path& newPath,
+                                                                     std::ostringstream& log, bool storeEntry) {
+    Materialized result;
+    if (m_stripMode != StripMode::None && ElfFile::isElf(originalPath)) {
+        StripSpec spec;
+        spec.mode = m_stripMode;
+        if (!m_options.splitDebugDir.empty() && storeEntry) {
+            spec.debugFile = LibraryStore::debugFileOf(newPath);
+            spec.debugLinkName = locationOf(node).filename().string() + ".debug";
+        } else if (!m_options.splitDebugDir.empty()) {
+            spec.debugFile = m_options.splitDebugDir / locationOf(node);
+            spec.debugFile += ".debug";
+            spec.buildIdRoot = m_options.splitDebugDir;
+        }
+        try {
+            if (std::optional<StripResult> stripped = ElfStripper::strip(originalPath, newPath, spec)) {
+                log << " (stripped " << std::fixed << std::setprecision(1) << stripped->originalSize / (1024.0 * 1024.0)
+                    << " -> " << stripped->strippedSize / (1024.0 * 1024.0) << " MiB)" << std::defaultfloat;
+                ++m_strippedFiles;
+                m_strippedBytes += stripped->originalSize - stripped->strippedSize;
+                m_debugBytes += stripped->debugSize;
+                result.copy.method = CopyMethod::Copy;
+                result.copy.logicalBytes = stripped->strippedSize;
+                result.copy.bytesMoved = stripped->strippedSize + stripped->debugSize;
+                result.stripped = true;
+                return result;
+            }
+        } catch (const std::exception& e) {
+            log << "\n  " << warning("Could not strip " + originalPath.string() + ", copying it whole: " + e.what());
+        }
+    }
+    result.copy = FileCopier::copy(originalPath, newPath, m_options.copyMode);
+    log << " (" << FileCopier::methodName(result.copy.method) << ")";
+    return result;
+}
+
+void Linux_Relocator::Run::verifyFile(NodeId node) {
+    std::filesystem::path newPath = m_outputDir / locationOf(node);
+    PhaseStats::Scope timing(m_verifyStats, newPath.string());
+    std::ostringstream log;
+    try {
+        ElfFile elf(newPath);
+        checkStructure(elf, node, log);
+        m_verifyStage.addBytes(elf.size());
+        m_verifyStats.addBytesRead(elf.size());
+    } catch (const std::exception& e) {
+        log << "  " << warning("Could not verify " + newPath.filename().string() + ": " + e.what()) << "\n";
+    }
+    if (log.tellp() > 0) {
+        ++m_verifyFailures;
+        print(log);
+    }
+}
+
+// The structural check of a patched file: its RUNPATH and DT_NEEDED must be what the fixup asked for.
+void Linux_Relocator::Run::checkStructure(const ElfFile& elf, NodeId node, std::ostringstream& log) {
+    const std::string name = locationOf(node).filename().string();
+    ElfDynamicInfo info = elf.dynamicInfo();
+    const std::string runpath = runpathFor(node);
+    if (info.runpath != runpath || info.hasRpath) {
+        log << "  " << warning(name + " does not have RUNPATH '" + runpath + "' after relocation.") << "\n";
+    }
+    for (const auto& edge : m_graph.edgesOf(node)) {
+        const std::string expected = locationOf(edge.target).filename().string();
+        if (std::find(info.needed.begin(), info.needed.end(), expected) == info.needed.end()) {
+            log << "  " << warning(name + " does not reference " + expected + ".") << "\n";
         }
+    }
+}
+
+// --- Once the stages have drained ---
 
-        // Step 3b: For each of its dependencies that we also bundled,
-        // replace the absolute path with just the filename.
-        for (const auto& [soname, depOriginalPath] : dependencies) {
-            std::string newDepName = depOriginalPath.filename().string();
+// Archive output: patch each file in memory and stream it into the tar, in name order.
+void Linux_Relocator::Run::writeArchive() {
+    std::vector<NodeId> members;
+    for (NodeId node = 0; node < m_graph.size(); ++node) {
+        members.push_back(node);
+    }
+    std::sort(members.begin(), members.end(), [&](NodeId a, NodeId b) {
+        return locationOf(a).generic_string() < locationOf(b).generic_string();
+    });
+    m_log << (m_dryRun ? "Would write " : "Writing ") << members.size() << " files to " << m_outputDir << "..." << std::endl;
+    if (m_dryRun) {
+        return;
+    }
 
-            // This is the crucial command that rewrites the dependency entries.
-            std::string replaceCmd = "patchelf --replace-needed \"" + soname + "\" \"" + newDepName + "\" \"" + newPath.string() + "\"";
+    // Members are produced in parallel but written in order, with at most `window` files in memory.
+    const size_t window = std::max<size_t>(1, m_options.fixupJobs ? m_options.fixupJobs : std::thread::hardware_concurrency());
+    std::filesystem::create_directories(m_outputDir.parent_path().empty() ? "." : m_outputDir.parent_path());
+    TarWriter tar(m_outputDir);
+    std::set<std::string> directories;
+    for (NodeId node : members) {
+        for (auto dir = locationOf(node).parent_path(); !dir.empty(); dir = dir.parent_path()) {
+            directories.insert(dir.generic_string());
+        }
+    }
+    for (const auto& dir : directories) {
+        tar.addDirectory(dir);
+    }
+    std::deque<std::future<ArchiveMember>> inFlight;
+    size_t next = 0;
+    size_t archivedFiles = 0;
+    for (NodeId node : members) {
+        while (next < members.size() && inFlight.size() < window) {
+            inFlight.push_back(std::async(std::launch::async, &Run::archiveMember, this, members[next++]));
+        }
+        ArchiveMember member = inFlight.front().get();
+        inFlight.pop_front();
+        {
+            std::lock_guard<std::mutex> lock(m_logMutex);
+            m_log << member.log << std::flush;
+        }
+        if (!member.readable) {
+            continue;
+        }
+        PhaseStats::Scope timing(m_copyStats, locationOf(node).string());
+        const uint64_t before = tar.size();
+        tar.addFile(locationOf(node).generic_string(), member.mode, member.bytes.data(), member.bytes.size());
+        m_copyStats.addBytesWritten(tar.size() - before);
+        m_logicalBytes += member.bytes.size();
+        m_movedBytes += tar.size() - before;
+        ++archivedFiles;
+    }
+    tar.finish();
+    m_log << "Wrote " << archivedFiles << " files to " << m_outputDir << " (" << std::fixed << std::setprecision(1)
+          << tar.size() / (1024.0 * 1024.0) << " MiB).\n" << std::defaultfloat;
+}
 
-            std::cout << "    " << replaceCmd << std::endl;
-            if(!m_dryRun) {
-                Process::exec(replaceCmd);
+// Reads one file, patches it in memory and checks the result, for writeArchive.
+Linux_Relocator::Run::ArchiveMember Linux_Relocator::Run::archiveMember(NodeId node) {
+    ArchiveMember member;
+    const std::filesystem::path& originalPath = m_graph.path(node);
+    const std::string name = locationOf(node).filename().string();
+    PhaseStats::Scope timing(m_fixupStats, originalPath.string());
+    std::ostringstream log;
+    try {
+        {
+            MappedFile source(originalPath);
+            member.bytes.assign(source.data(), source.data() + source.size());
+        }
+        member.mode = static_cast<unsigned>(std::filesystem::status(originalPath).permissions()
+                                            & std::filesystem::perms::all);
+        member.readable = true;
+        m_fixupStats.addBytesRead(member.bytes.size());
+    } catch (const std::exception& e) {
+        log << "  " << warning("Could not read " + originalPath.string() + ", leaving it out of the archive: " + e.what()) << "\n";
+    }
+    const bool isElf = member.bytes.size() >= 4 && std::equal(member.bytes.begin(), member.bytes.begin() + 4, ELFMAG);
+    if (member.readable && isElf) {
+        log << "  Fixing up " << name << " in memory...\n";
+        try {
+            const ElfPatchPlan plan = ElfPatcher::patch(member.bytes, m_archiveSpecs.at(node), originalPath);
+            if (!plan.changed()) {
+                log << "    Already relocatable, no changes.\n";
+            }
+            for (const auto& change : plan.changes) {
+                log << "    Wrote " << change.size << " bytes at offset 0x" << std::hex << change.offset << std::dec
+                    << ": " << change.description << "\n";
             }
+            std::ostringstream problems;
+            checkStructure(ElfFile(member.bytes.data(), member.bytes.size(), locationOf(node)), node, problems);
+            if (problems.tellp() > 0) {
+                ++m_verifyFailures;
+                log << problems.str();
+            }
+        } catch (const std::exception& e) {
+            log << "    " << warning("Could not relocate " + name + ": " + e.what()) << "\n";
+        }
+    }
+    member.log = log.str();
+    return member;
+}
+
+// Anything the previous run bundled that this run did not produce is removed.
+void Linux_Relocator::Run::removeStaleFiles() {
+    std::set<std::string> bundledNames;
+    for (NodeId node = 0; node < m_graph.size(); ++node) {
+        bundledNames.insert(locationOf(node).generic_string());
+    }
+    for (const auto& entry : m_manifest.stale()) {
+        if (bundledNames.count(entry.name)) {
+            continue;   // Still bundled, but failed to relocate; leave it to be retried.
+        }
+        m_log << "  " << (m_dryRun ? "Would remove" : "Removing") << " stale file " << entry.name << std::endl;
+        m_result.removed.push_back(entry.name);
+        if (!m_dryRun) {
+            std::error_code ec;
+            std::filesystem::remove(m_outputDir / entry.name, ec);
         }
     }
+}
 
-    // --- Phase 4: Verify the relocated library ---
-    std::cout << "\nPhase 4: " << (m_dryRun ? "Planning to verify" : "Verifying") << " bundled library..." << std::endl;
+void Linux_Relocator::Run::printSummary(double totalSeconds, double discoverySeconds) {
+    m_log << "\nPipeline throughput (" << std::fixed << std::setprecision(3) << totalSeconds
+              << " s end to end, discovery " << discoverySeconds << " s):\n" << std::defaultfloat;
+    m_copyStage.stats().print(m_log);
+    m_fixupStage.stats().print(m_log);
+    m_verifyStage.stats().print(m_log);
+    if (m_upToDate > 0) {
+        m_log << "  " << m_upToDate << " of " << m_graph.size() << " files were already up to date.\n";
+    }
     if (!m_dryRun) {
-        auto canonicalInputPath = std::filesystem::canonical(inputFile);
-        std::filesystem::path primaryLibInBundle = outputDir / canonicalInputPath.filename();
+        m_log << "  " << std::fixed << std::setprecision(1) << m_logicalBytes / (1024.0 * 1024.0) << " MiB bundled, "
+                  << m_movedBytes / (1024.0 * 1024.0) << " MiB actually copied" << std::defaultfloat;
+        const char* separator = " (";
+        for (CopyMethod method : {CopyMethod::Reflink, CopyMethod::Range, CopyMethod::Copy, CopyMethod::Hardlink}) {
+            if (size_t count = m_methodCounts[static_cast<size_t>(method)]) {
+                m_log << separator << count << " " << FileCopier::methodName(method);
+                separator = ", ";
+            }
+        }
+        if (m_strippedFiles > 0) {
+            m_log << separator << m_strippedFiles << " stripped";
+            separator = ", ";
+        }
+        m_log << (*separator == ',' ? ")" : "") << "\n";
+        if (m_strippedFiles > 0) {
+            m_log << "  Stripping (" << m_stripName << ") left out " << std::fixed << std::setprecision(1)
+                  << m_strippedBytes / (1024.0 * 1024.0) << " MiB" << std::defaultfloat;
+            if (!m_options.splitDebugDir.empty()) {
+                m_log << "; " << std::fixed << std::setprecision(1) << m_debugBytes / (1024.0 * 1024.0)
+                      << " MiB of debug files written to " << m_options.splitDebugDir << std::defaultfloat;
+            }
+            m_log << ".\n";
+        }
+        if (m_store) {
+            m_log << "  Store " << m_options.storeDir << ": " << m_storeWrites << " new entries, " << m_storeLinks
+                  << " files linked to existing ones (" << std::fixed << std::setprecision(1)
+                  << m_storeSharedBytes / (1024.0 * 1024.0) << " MiB not written again).\n" << std::defaultfloat;
+        }
+    }
+    if (m_verifyFailures > 0) {
+        m_errorLog << "  Warning: " << m_verifyFailures << " bundled file(s) failed the structural check." << std::endl;
+    }
+}
 
-        std::cout << "  Attempting to dynamically load: " << primaryLibInBundle << std::endl;
+// --- Phase 4: Test-load every bundled object ---
+void Linux_Relocator::Run::checkLoading() {
+    m_log << "\nPhase 4: " << (m_dryRun ? "Planning to verify" : "Verifying") << " bundled objects..." << std::endl;
+    if (m_archive && m_options.loadCheck) {
+        m_log << "  Skipped: the bundle is an archive; extract it to test-load it." << std::endl;
+        return;
+    }
+    if (!m_options.loadCheck) {
+        m_log << "  Skipped: the load check is disabled." << std::endl;
+        return;
+    }
+    if (m_dryRun) {
+        m_log << "  Would trace every bundled object with its dynamic loader (ld.so --list) in a clean environment." << std::endl;
+        return;
+    }
 
-        setenv("LD_DEBUG", "libs", 1);
-        setenv("LD_LIBRARY_PATH", outputDir.c_str(), 1);
+    std::vector<std::filesystem::path> objects;
+    for (const auto& file : m_result.files) {
+        objects.push_back(file.bundlePath);
+    }
+    m_log << "  Tracing each object with its dynamic loader in a clean child process..." << std::endl;
+    LoadVerifier verifier(m_outputDir, m_exclusions);
+    m_result.loadChecks = verifier.verify(objects, m_options.fixupJobs, m_relocator.m_stats.phase(Phase::LoadCheck));
+    m_result.loadChecked = true;
 
-        void* handle = dlopen(primaryLibInBundle.c_str(), RTLD_LAZY);
-        if (!handle) {
-            std::cerr << "\n  VERIFICATION FAILED: dlopen reported an error:\n  " << dlerror() << std::endl;
-        } else {
-            std::cout << "\n  Verification SUCCESS: Library loaded successfully." << std::endl;
-            dlclose(handle);
+    size_t failures = 0;
+    for (const auto& check : m_result.loadChecks) {
+        if (check.passed) {
+            continue;
+        }
+        ++failures;
+        std::string problem;
+        if (!check.missing.empty()) {
+            problem += "missing";
+            for (const auto& name : check.missing) problem += " " + name;
+        }
+        if (!check.outside.empty()) {
+            problem += std::string(problem.empty() ? "" : "; ") + "resolves outside the bundle:";
+            for (const auto& path : check.outside) problem += " " + path.string();
         }
+        if (!check.error.empty()) {
+            problem += (problem.empty() ? "" : "; ") + check.error;
+        }
+        m_errorLog << "  " << warning("VERIFICATION FAILED for " + check.bundlePath.string() + ": " + problem) << std::endl;
+    }
+    const size_t skipped = objects.size() - m_result.loadChecks.size();
+    if (failures > 0) {
+        m_result.loadError = std::to_string(failures) + " of " + std::to_string(m_result.loadChecks.size())
+                           + " bundled objects did not load from the bundle alone.";
+        m_errorLog << "\n  " << m_result.loadError << std::endl;
+    } else {
+        m_log << "\n  Verification SUCCESS: all " << m_result.loadChecks.size()
+              << " objects load from the bundle alone." << std::endl;
+    }
+    if (skipped > 0) {
+        m_log << "  " << skipped << " file(s) skipped: not dynamically linked, or no loader for their machine on this host."
+              << std::endl;
+    }
+}
 
-        unsetenv("LD_DEBUG");
-        unsetenv("LD_LIBRARY_PATH");
+// --- Phase 5: Time how the first input loads from the bundle ---
+void Linux_Relocator::Run::profileLoading() {
+    const NodeId root = m_roots.front();
+    m_log << "\nPhase 5: " << (m_dryRun ? "Planning to profile" : "Profiling") << " how " << locationOf(root)
+          << " loads (" << m_options.profileLoadRuns << " runs)..." << std::endl;
+    const std::vector<std::filesystem::path> order = loadOrder(root);
+
+    if (m_archive) {
+        m_log << "  Skipped: the bundle is an archive; extract it to profile it." << std::endl;
+    } else if (m_dryRun) {
+        m_log << "  Would load " << order.size() << " objects one at a time in a clean child process." << std::endl;
+    } else if (order.empty()) {
+        m_log << "  Skipped: nothing in it can be loaded on its own." << std::endl;
     } else {
-        std::cout << "  Would set LD_DEBUG=libs and LD_LIBRARY_PATH, then test loading the main library with dlopen." << std::endl;
+        m_result.loadProfile = LoadProfiler(m_outputDir).profile(order, m_options.profileLoadRuns);
+        m_result.loadProfiled = true;
+        const LoadProfile& profile = m_result.loadProfile;
+        if (!profile.error.empty()) {
+            m_errorLog << "  " << warning("Could not profile loading: " + profile.error) << std::endl;
+        }
+        if (profile.runs > 0) {
+            printLoadProfile(profile, order.size());
+        }
     }
 }
 
+// Everything an object needs is loaded before it; an executable cannot be loaded at all.
+std::vector<std::filesystem::path> Linux_Relocator::Run::loadOrder(NodeId root) {
+    // Depth-first and post-order, iteratively: a chain of thousands of libraries must not
+    // overflow the stack.
+    struct Frame {
+        NodeId node;
+        std::vector<DependencyGraph::Edge> edges;
+        size_t next = 0;     // The next edge to follow
+    };
+    std::vector<std::filesystem::path> order;
+    std::vector<char> seen(m_graph.size(), 0);
+    std::vector<Frame> frames;
+    seen[root] = 1;
+    frames.push_back({ root, m_graph.edgesOf(root) });
+    while (!frames.empty()) {
+        Frame& frame = frames.back();
+        if (frame.next < frame.edges.size()) {
+            const NodeId target = frame.edges[frame.next++].target;
+            if (!seen[target]) {
+                seen[target] = 1;
+                frames.push_back({ target, m_graph.edgesOf(target) });
+            }
+            continue;
+        }
+        const NodeId node = frame.node;
+        frames.pop_back();
+        try {
+            const ElfFile elf(m_dryRun || m_archive ? m_graph.path(node) : m_outputDir / locationOf(node));
+            if (elf.type() == ET_DYN && !(elf.dynamicInfo().flags1 & DF_1_PIE)) {
+                order.push_back(locationOf(node));
+            }
+        } catch (const std::exception&) {
+            // Not ELF, or not bundled; nothing to load.
+        }
+    }
+    return order;
+}
+
+void Linux_Relocator::Run::printLoadProfile(const LoadProfile& profile, size_t objects) {
+    auto ms = [](double seconds) {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(2) << seconds * 1000;
+        return text.str();
+    };
+    m_log << "  Loaded " << objects << " objects in " << ms(profile.seconds) << " ms (median of "
+          << profile.runs << "): mapping " << ms(profile.mapSeconds) << " ms, relocation "
+          << ms(profile.relocateSeconds) << " ms, constructors " << ms(profile.initSeconds) << " ms.\n";
+    if (profile.loaderRelocations > 0) {
+        m_log << "  ld.so resolved " << profile.loaderRelocations << " symbol references, "
+              << profile.loaderCachedLookups << " of them from its lookup cache.\n";
+    }
+    m_log << "  " << std::right << std::setw(9) << "total ms" << std::setw(9) << "map" << std::setw(9) << "reloc"
+          << std::setw(9) << "init" << std::setw(10) << "relocs" << std::setw(10) << "lookups" << "  object\n";
+    for (const auto& library : profile.libraries) {
+        m_log << "  " << std::setw(9) << ms(library.seconds) << std::setw(9) << ms(library.mapSeconds)
+              << std::setw(9) << ms(library.relocateSeconds)
+              << std::setw(9) << (library.split ? ms(library.initSeconds) : "-")
+              << std::setw(10) << library.relocations << std::setw(10) << library.symbolLookups
+              << "  " << library.bundlePath.string();
+        if (!library.alsoLoaded.empty()) {
+            m_log << " (with";
+            for (const auto& name : library.alsoLoaded) m_log << " " << name;
+            m_log << ")";
+        }
+        m_log << "\n";
+    }
+    m_log << std::flush;
+}
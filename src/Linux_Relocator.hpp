@@ -4,16 +4,61 @@
 
 #include "Relocator.hpp"
 
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class LibraryResolver;
+class ScanCache;
+
+/**
+ * @class Linux_RelocatorCache
+ * @brief Library resolvers and parsed ELF metadata shared by Linux relocators.
+ *
+ * There is one resolver per list of user search paths. Each run refreshes the one it
+ * uses, and all of them are dropped when /etc/ld.so.cache changes. Parsed metadata is
+ * kept by the ScanCache, which checks each file's identity on every lookup.
+ */
+class Linux_RelocatorCache : public RelocatorCache {
+public:
+    ~Linux_RelocatorCache() override;
+
+    /**
+     * @return A resolver for these search paths, revalidated for a new run. Thread-safe.
+     */
+    std::shared_ptr<LibraryResolver> resolverFor(const std::vector<std::string>& searchPaths);
+
+    /**
+     * @return The scan cache, created from the first options that enable it; nullptr if
+     *         these options disable it. Thread-safe.
+     */
+    ScanCache* scanCache(const RelocatorOptions& options);
+
+private:
+    std::mutex m_mutex;
+    std::map<std::vector<std::string>, std::shared_ptr<LibraryResolver>> m_resolvers;
+    std::filesystem::file_time_type m_ldSoCacheTime{};
+    std::unique_ptr<ScanCache> m_scanCache;
+    bool m_scanCacheOpened = false;
+};
+
 class Linux_Relocator : public Relocator {
 public:
-    using Relocator::Relocator;
+    explicit Linux_Relocator(const RelocatorOptions& options, std::shared_ptr<RelocatorCache> cache = nullptr);
+
     void bundleDependencies(
-        const std::filesystem::path& inputFile,
+        const std::vector<BundleInput>& inputs,
         const std::filesystem::path& outputDir,
         const std::vector<std::string>& searchPaths,
-        const std::vector<std::string>& literalExclusions,
-        const std::vector<std::string>& regexExclusions
+        const ExclusionPolicy& exclusions
     ) override;
+
+private:
+    // The state and steps of one bundleDependencies call, in Linux_Relocator.cpp.
+    class Run;
 };
 
 #endif //RELOCATOR_LINUX_RELOCATOR_HPP
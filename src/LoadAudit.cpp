@@ -0,0 +1,125 @@
+// src/LoadAudit.cpp
+// relocator-loadaudit: the LD_AUDIT module relocator-loadprobe runs under (see LoadProfiler).
+//
+// It timestamps the loader's own milestones on CLOCK_MONOTONIC and writes them to
+// stdout, interleaved with the probe's events:
+//   O <ns> <id> <name>   an object was mapped (la_objopen)
+//   C <ns>               every object of the current load is mapped; relocation starts
+//   S <id> <binds> <first ns> <last ns>
+//                        written as each object closes at exit: the PLT bindings made
+//                        on its behalf, and when the first and last happened
+// Under LD_BIND_NOW the loader binds an object's PLT last while relocating it, so its
+// last binding marks the end of its relocation and the start of its constructors.
+//
+// An audit module runs in a namespace of its own, before the program's libc is ready;
+// it keeps to fixed-size tables and write(2).
+#include <link.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+constexpr unsigned kMaxObjects = 8192;
+
+struct ObjectStats {
+    std::uint64_t binds = 0;
+    std::uint64_t firstBind = 0;
+    std::uint64_t lastBind = 0;
+};
+ObjectStats g_objects[kMaxObjects];
+unsigned g_objectCount = 0;
+
+std::uint64_t now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return std::uint64_t(ts.tv_sec) * 1000000000u + std::uint64_t(ts.tv_nsec);
+}
+
+void emit(const char* text, std::size_t length) {
+    while (length > 0) {
+        const ssize_t n = write(STDOUT_FILENO, text, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        text += n;
+        length -= static_cast<std::size_t>(n);
+    }
+}
+
+std::uintptr_t bindFrom(const std::uintptr_t* refcook) {
+    const std::uintptr_t id = *refcook;
+    if (id < g_objectCount) {
+        ObjectStats& stats = g_objects[id];
+        stats.lastBind = now();
+        if (stats.binds++ == 0) {
+            stats.firstBind = stats.lastBind;
+        }
+    }
+    return id;
+}
+
+} // namespace
+
+extern "C" {
+
+unsigned int la_version(unsigned int version) {
+    return version < LAV_CURRENT ? version : LAV_CURRENT;
+}
+
+unsigned int la_objopen(struct link_map* map, Lmid_t, std::uintptr_t* cookie) {
+    const std::uint64_t opened = now();
+    const unsigned id = g_objectCount < kMaxObjects ? g_objectCount++ : kMaxObjects;
+    *cookie = id;
+    char line[64];
+    const int n = std::snprintf(line, sizeof(line), "O %llu %u ", static_cast<unsigned long long>(opened), id);
+    emit(line, static_cast<std::size_t>(n));
+    emit(map->l_name, std::strlen(map->l_name));
+    emit("\n", 1);
+    return LA_FLG_BINDFROM | LA_FLG_BINDTO;
+}
+
+void la_activity(std::uintptr_t*, unsigned int flag) {
+    if (flag == LA_ACT_CONSISTENT) {
+        char line[32];
+        const int n = std::snprintf(line, sizeof(line), "C %llu\n", static_cast<unsigned long long>(now()));
+        emit(line, static_cast<std::size_t>(n));
+    }
+}
+
+#if __ELF_NATIVE_CLASS == 64
+std::uintptr_t la_symbind64(Elf64_Sym* sym, unsigned int, std::uintptr_t* refcook, std::uintptr_t*,
+                            unsigned int*, const char*) {
+    bindFrom(refcook);
+    return sym->st_value;
+}
+#else
+std::uintptr_t la_symbind32(Elf32_Sym* sym, unsigned int, std::uintptr_t* refcook, std::uintptr_t*,
+                            unsigned int*, const char*) {
+    bindFrom(refcook);
+    return sym->st_value;
+}
+#endif
+
+unsigned int la_objclose(std::uintptr_t* cookie) {
+    const std::uintptr_t id = *cookie;
+    if (id < g_objectCount && g_objects[id].binds > 0) {
+        const ObjectStats& stats = g_objects[id];
+        char line[96];
+        const int n = std::snprintf(line, sizeof(line), "S %u %llu %llu %llu\n", static_cast<unsigned>(id),
+                                    static_cast<unsigned long long>(stats.binds),
+                                    static_cast<unsigned long long>(stats.firstBind),
+                                    static_cast<unsigned long long>(stats.lastBind));
+        emit(line, static_cast<std::size_t>(n));
+    }
+    return 0;
+}
+
+} // extern "C"
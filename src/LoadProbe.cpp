@@ -0,0 +1,73 @@
+// src/LoadProbe.cpp
+// relocator-loadprobe: loads bundled objects one by one for LoadProfiler, in a process of its own.
+//
+// Usage: relocator-loadprobe <object>...
+// Each object is dlopen()ed with RTLD_NOW | RTLD_GLOBAL, in the order given, and timed
+// on CLOCK_MONOTONIC. Run under LD_AUDIT with relocator-loadaudit, whose events land
+// on the same stdout in the same order:
+//   L <ns> <object>    about to load it
+//   D <ns>             loaded, constructors included
+//   E <message>        dlopen failed; the probe stops with status 1
+//
+// The probe links nothing but libc and writes with write(2), so the only objects in
+// the process are the loader's, libc and what the bundle brings in.
+#include <dlfcn.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+std::uint64_t now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return std::uint64_t(ts.tv_sec) * 1000000000u + std::uint64_t(ts.tv_nsec);
+}
+
+void emit(const char* text, std::size_t length) {
+    while (length > 0) {
+        const ssize_t n = write(STDOUT_FILENO, text, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        text += n;
+        length -= static_cast<std::size_t>(n);
+    }
+}
+
+void emitEvent(char kind, std::uint64_t time, const char* text) {
+    char line[64];
+    const int n = std::snprintf(line, sizeof(line), "%c %llu%s", kind, static_cast<unsigned long long>(time),
+                                text ? " " : "\n");
+    emit(line, static_cast<std::size_t>(n));
+    if (text) {
+        emit(text, std::strlen(text));
+        emit("\n", 1);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        emitEvent('L', now(), argv[i]);
+        void* handle = dlopen(argv[i], RTLD_NOW | RTLD_GLOBAL);
+        const std::uint64_t loaded = now();
+        if (handle == nullptr) {
+            const char* error = dlerror();
+            emit("E ", 2);
+            emit(error, std::strlen(error));
+            emit("\n", 1);
+            return 1;
+        }
+        emitEvent('D', loaded, nullptr);
+    }
+    return 0;
+}
@@ -0,0 +1,248 @@
+// src/LoadProfiler.cpp
+#include "LoadProfiler.hpp"
+#include "ElfFile.hpp"
+#include "Process.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+#include <unistd.h>
+
+namespace {
+
+// Loading is what is measured, so a run that takes this long is stuck in a constructor.
+constexpr Process::Timeout kRunTimeout = std::chrono::seconds(60);
+
+struct StepTiming {
+    double mapSeconds = 0;
+    double relocateSeconds = 0;
+    double initSeconds = 0;
+    bool split = false;
+    std::vector<std::string> alsoLoaded;
+
+    double seconds() const { return mapSeconds + relocateSeconds + initSeconds; }
+};
+
+double median(std::vector<double> values) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    const std::size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+double seconds(std::uint64_t from, std::uint64_t to) {
+    return to > from ? (to - from) / 1e9 : 0;
+}
+
+// The value after the colon of an LD_DEBUG=statistics line such as
+// "  12345:	final number of relocations: 3229".
+std::uint64_t statistic(const std::string& output, const std::string& label) {
+    std::size_t at = output.find(label + ":");
+    if (at == std::string::npos) {
+        return 0;
+    }
+    at += label.size() + 1;
+    return std::strtoull(output.c_str() + at, nullptr, 10);
+}
+
+} // namespace
+
+LoadProfiler::LoadProfiler(const std::filesystem::path& bundleDir)
+    : m_bundleDir(std::filesystem::weakly_canonical(bundleDir)) {}
+
+std::filesystem::path LoadProfiler::findHelper(const std::string& name) {
+    std::vector<std::filesystem::path> dirs;
+    std::error_code ec;
+    const std::filesystem::path self = std::filesystem::read_symlink("/proc/self/exe", ec);
+    if (!ec) {
+        dirs.push_back(self.parent_path());
+        dirs.push_back(self.parent_path().parent_path() / "libexec" / "relocator");
+    }
+#ifdef RELOCATOR_LIBEXEC_DIR
+    dirs.emplace_back(RELOCATOR_LIBEXEC_DIR);
+#endif
+    for (const auto& dir : dirs) {
+        const std::filesystem::path candidate = dir / name;
+        if (access(candidate.c_str(), R_OK) == 0) {
+            return candidate;
+        }
+    }
+    return std::filesystem::path();
+}
+
+LoadProfile LoadProfiler::profile(const std::vector<std::filesystem::path>& order, unsigned runs) const {
+    LoadProfile profile;
+    const std::filesystem::path probe = findHelper("relocator-loadprobe");
+    const std::filesystem::path audit = findHelper("relocator-loadaudit.so");
+    if (probe.empty() || audit.empty()) {
+        profile.error = "relocator-loadprobe and relocator-loadaudit.so must be installed with the relocator";
+        return profile;
+    }
+
+    std::vector<std::string> argv{ probe.string() };
+    std::map<std::string, std::size_t> stepOf;     // Absolute path -> index into order
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        argv.push_back((m_bundleDir / order[i]).string());
+        stepOf.emplace(argv.back(), i);
+    }
+    // The audit module's events would interleave with a program's own output, but the probe has none.
+    const Process::Environment environment{ "LD_AUDIT=" + audit.string(), "LD_BIND_NOW=1", "LD_DEBUG=statistics" };
+
+    std::vector<std::vector<StepTiming>> timings;   // Per run, per step
+    for (unsigned run = 0; run < runs; ++run) {
+        const CommandResult result = Process::run(argv, kRunTimeout, environment);
+
+        // Each step runs from its 'L' to its 'D'; the objects it opened and their bindings tell its phases apart.
+        struct Step {
+            std::uint64_t started = 0, mapped = 0, done = 0;
+            std::vector<unsigned> objects;
+        };
+        std::vector<Step> steps;
+        std::map<unsigned, std::string> names;
+        std::map<unsigned, std::uint64_t> lastBind;
+        std::istringstream lines(result.output);
+        for (std::string line; std::getline(lines, line);) {
+            if (line.size() < 2) {
+                continue;
+            }
+            std::istringstream fields(line.substr(2));
+            std::uint64_t time = 0;
+            switch (line[0]) {
+                case 'L':
+                    fields >> time;
+                    steps.push_back({ time, 0, 0, {} });
+                    break;
+                case 'O': {
+                    unsigned id = 0;
+                    fields >> time >> id;
+                    std::string name;
+                    std::getline(fields >> std::ws, name);
+                    names[id] = name;
+                    if (!steps.empty() && steps.back().done == 0) {
+                        steps.back().objects.push_back(id);
+                    }
+                    break;
+                }
+                case 'C':
+                    fields >> time;
+                    if (!steps.empty() && steps.back().done == 0 && steps.back().mapped == 0) {
+                        steps.back().mapped = time;
+                    }
+                    break;
+                case 'D':
+                    fields >> time;
+                    if (!steps.empty()) {
+                        steps.back().done = time;
+                    }
+                    break;
+                case 'S': {
+                    unsigned id = 0;
+                    std::uint64_t binds = 0, first = 0;
+                    fields >> id >> binds >> first >> time;
+                    lastBind[id] = time;
+                    break;
+                }
+                case 'E':
+                    profile.error = "Could not load " + (steps.empty() ? std::string("the bundle") : order[steps.size() - 1].string())
+                                  + ": " + line.substr(2);
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (profile.error.empty() && (result.timedOut || result.exitStatus != 0 || steps.size() != order.size())) {
+            profile.error = result.timedOut ? "The probe did not finish within " + std::to_string(kRunTimeout.count() / 1000) + " s"
+                          : "The probe exited with status " + std::to_string(result.exitStatus);
+        }
+        if (!profile.error.empty()) {
+            break;
+        }
+        if (run == 0) {
+            profile.loaderRelocations = statistic(result.errorOutput, "final number of relocations");
+            profile.loaderCachedLookups = statistic(result.errorOutput, "final number of relocations from cache");
+        }
+
+        std::vector<StepTiming> runTimings;
+        for (const auto& step : steps) {
+            StepTiming timing;
+            // No new objects means no activity: it was already loaded, and there is nothing to map.
+            const std::uint64_t mapped = step.mapped != 0 ? step.mapped : step.started;
+            timing.mapSeconds = seconds(step.started, mapped);
+            // The PLT is bound last, so the step's last binding ends its relocation.
+            std::uint64_t relocated = 0;
+            for (unsigned id : step.objects) {
+                auto it = lastBind.find(id);
+                if (it != lastBind.end() && it->second >= mapped && it->second <= step.done) {
+                    relocated = std::max(relocated, it->second);
+                }
+                const std::filesystem::path name = names[id];
+                if (!stepOf.count(name.string())) {
+                    timing.alsoLoaded.push_back(name.filename().string());
+                }
+            }
+            timing.split = relocated != 0;
+            timing.relocateSeconds = seconds(mapped, timing.split ? relocated : step.done);
+            timing.initSeconds = timing.split ? seconds(relocated, step.done) : 0;
+            runTimings.push_back(std::move(timing));
+        }
+        timings.push_back(std::move(runTimings));
+    }
+    profile.runs = static_cast<unsigned>(timings.size());
+    if (timings.empty()) {
+        return profile;
+    }
+
+    std::vector<double> totals, maps, relocations, inits;
+    for (const auto& run : timings) {
+        double total = 0, map = 0, relocate = 0, init = 0;
+        for (const auto& step : run) {
+            total += step.seconds();
+            map += step.mapSeconds;
+            relocate += step.relocateSeconds;
+            init += step.initSeconds;
+        }
+        totals.push_back(total);
+        maps.push_back(map);
+        relocations.push_back(relocate);
+        inits.push_back(init);
+    }
+    profile.seconds = median(totals);
+    profile.mapSeconds = median(maps);
+    profile.relocateSeconds = median(relocations);
+    profile.initSeconds = median(inits);
+
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        LibraryLoadTime library;
+        library.bundlePath = order[i];
+        std::vector<double> total, map, relocate, init;
+        for (const auto& run : timings) {
+            total.push_back(run[i].seconds());
+            map.push_back(run[i].mapSeconds);
+            relocate.push_back(run[i].relocateSeconds);
+            init.push_back(run[i].initSeconds);
+        }
+        library.seconds = median(total);
+        library.mapSeconds = median(map);
+        library.relocateSeconds = median(relocate);
+        library.initSeconds = median(init);
+        library.split = timings.front()[i].split;
+        library.alsoLoaded = timings.front()[i].alsoLoaded;
+        try {
+            const ElfRelocationCounts counts = ElfFile(m_bundleDir / order[i]).relocationCounts();
+            library.relocations = counts.total();
+            library.symbolLookups = counts.symbolic + counts.plt;
+        } catch (const std::exception&) {
+            // It loaded, so it is readable; a malformed table only costs the counts.
+        }
+        profile.libraries.push_back(std::move(library));
+    }
+    std::stable_sort(profile.libraries.begin(), profile.libraries.end(),
+                     [](const LibraryLoadTime& a, const LibraryLoadTime& b) { return a.seconds > b.seconds; });
+    return profile;
+}
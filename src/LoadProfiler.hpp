@@ -0,0 +1,53 @@
+// src/LoadProfiler.hpp
+#ifndef RELOCATOR_LOADPROFILER_HPP
+#define RELOCATOR_LOADPROFILER_HPP
+
+#include "Relocator.hpp"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * @class LoadProfiler
+ * @brief Times how a Linux bundle loads, object by object, in a clean child process.
+ *
+ * relocator-loadprobe dlopen()s the objects one at a time with an empty environment,
+ * each after everything it needs, so each one's time is its own: mapping it, relocating
+ * it and running its constructors. The probe runs under the relocator-loadaudit
+ * LD_AUDIT module, which timestamps the loader's milestones in between, with
+ * LD_BIND_NOW so the PLT is bound up front as well, and with LD_DEBUG=statistics for the
+ * loader's own relocation counts. Relocation and symbol lookup counts per object are
+ * read from the files.
+ *
+ * Auditing every binding slows relocation down a little, so the phases are best compared
+ * with each other; an executable cannot be dlopen()ed, so it is left out and its
+ * libraries are loaded instead.
+ */
+class LoadProfiler {
+public:
+    /**
+     * @param bundleDir The output directory the objects were bundled into.
+     */
+    explicit LoadProfiler(const std::filesystem::path& bundleDir);
+
+    /**
+     * Finds a helper program installed with the relocator: next to the running executable,
+     * in ../libexec/relocator from there, or in the directory it was installed to.
+     * @return An empty path if it is in none of them.
+     */
+    static std::filesystem::path findHelper(const std::string& name);
+
+    /**
+     * Loads the objects in the order given, the given number of times, one run after the other.
+     * @param order Bundle-relative paths; each after everything it needs from the bundle.
+     * @param runs How many times to load them; the medians are reported.
+     * @return The profile; its error says why it is incomplete, if it is.
+     */
+    LoadProfile profile(const std::vector<std::filesystem::path>& order, unsigned runs) const;
+
+private:
+    std::filesystem::path m_bundleDir;      // Canonical
+};
+
+#endif //RELOCATOR_LOADPROFILER_HPP
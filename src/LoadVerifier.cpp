@@ -0,0 +1,228 @@
+// src/LoadVerifier.cpp
+#include "LoadVerifier.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <optional>
+#include <set>
+#include <sstream>
+
+#include <elf.h>
+
+namespace {
+
+// A library that pulls in a whole framework still traces in well under a second.
+constexpr Process::Timeout kTraceTimeout = std::chrono::seconds(30);
+
+// Where glibc installs its loader for each ABI. Only these are ever run: an object's
+// PT_INTERP is a string from the file, so it chooses among them and never names a program.
+struct KnownLoader {
+    std::uint16_t machine;
+    bool is64Bit;
+    bool bigEndian;
+    const char* path;
+};
+constexpr KnownLoader kKnownLoaders[] = {
+    { EM_X86_64,  true,  false, "/lib64/ld-linux-x86-64.so.2" },
+    { EM_X86_64,  true,  false, "/lib/x86_64-linux-gnu/ld-linux-x86-64.so.2" },
+    { EM_X86_64,  false, false, "/libx32/ld-linux-x32.so.2" },
+    { EM_386,     false, false, "/lib/ld-linux.so.2" },
+    { EM_AARCH64, true,  false, "/lib/ld-linux-aarch64.so.1" },
+    { EM_AARCH64, true,  true,  "/lib/ld-linux-aarch64_be.so.1" },
+    { EM_ARM,     false, false, "/lib/ld-linux-armhf.so.3" },
+    { EM_ARM,     false, false, "/lib/ld-linux.so.3" },
+    { EM_PPC64,   true,  true,  "/lib64/ld64.so.1" },
+    { EM_PPC64,   true,  false, "/lib64/ld64.so.2" },
+    { EM_S390,    true,  true,  "/lib/ld64.so.1" },
+    { 243,        true,  false, "/lib/ld-linux-riscv64-lp64d.so.1" },   // EM_RISCV
+    { 243,        true,  false, "/lib/ld-linux-riscv64-lp64.so.1" },
+};
+
+std::string trim(const std::string& s) {
+    const std::size_t first = s.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return std::string();
+    }
+    return s.substr(first, s.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+} // namespace
+
+LoadVerifier::LoadVerifier(const std::filesystem::path& bundleDir, const ExclusionPolicy& allowed)
+    : m_bundleDir(std::filesystem::weakly_canonical(bundleDir)), m_allowed(allowed) {}
+
+std::filesystem::path LoadVerifier::loaderFor(const ElfFile& file) {
+    const std::filesystem::path interpreter = std::filesystem::path(file.interpreter()).lexically_normal();
+    std::filesystem::path installed;
+    for (const KnownLoader& known : kKnownLoaders) {
+        if (known.machine != file.machine() || known.is64Bit != file.is64Bit() || known.bigEndian != file.isBigEndian()) {
+            continue;
+        }
+        std::error_code ec;
+        if (!std::filesystem::is_regular_file(known.path, ec)) {
+            continue;
+        }
+        if (interpreter == known.path) {
+            return known.path;
+        }
+        if (installed.empty()) {
+            installed = known.path;
+        }
+    }
+    return installed;
+}
+
+std::vector<LoadCheck> LoadVerifier::verify(const std::vector<std::filesystem::path>& bundlePaths, unsigned jobs,
+                                            PhaseStats& stats) {
+    std::vector<std::optional<LoadCheck>> checks(bundlePaths.size());
+    {
+        ProcessRunner runner(jobs);
+        for (std::size_t i = 0; i < bundlePaths.size(); ++i) {
+            const std::filesystem::path object = m_bundleDir / bundlePaths[i];
+            std::filesystem::path loader;
+            try {
+                if (!ElfFile::isElf(object)) {
+                    continue;
+                }
+                const ElfFile elf(object);
+                if (elf.dynamicSegmentIndex() < 0) {
+                    continue;
+                }
+                loader = loaderFor(elf);
+            } catch (const std::exception&) {
+                continue;
+            }
+            if (loader.empty()) {
+                continue;
+            }
+            // An empty environment: the object must stand on its RUNPATH alone.
+            runner.submit({ loader.string(), "--list", object.string() },
+                [this, &checks, &stats, &bundlePaths, i](CommandResult trace) {
+                    const auto end = PhaseStats::Clock::now();
+                    const auto wall = std::chrono::duration_cast<PhaseStats::Clock::duration>(
+                        std::chrono::duration<double>(trace.wallSeconds));
+                    stats.record((m_bundleDir / bundlePaths[i]).string(), end - wall, end, 0);
+                    stats.addSubprocess(trace.wallSeconds, trace.cpuSeconds);
+                    try {
+                        checks[i] = classify(bundlePaths[i], trace);
+                    } catch (const std::exception& e) {
+                        checks[i] = LoadCheck{ bundlePaths[i], false, {}, {}, e.what() };
+                    }
+                },
+                kTraceTimeout, Process::Environment());
+        }
+    }
+
+    std::vector<LoadCheck> results;
+    for (auto& check : checks) {
+        if (check) {
+            results.push_back(std::move(*check));
+        }
+    }
+    return results;
+}
+
+LoadCheck LoadVerifier::classify(const std::filesystem::path& bundlePath, const CommandResult& trace) {
+    LoadCheck check;
+    check.bundlePath = bundlePath;
+
+    // "\tlibfoo.so.1 => /path/libfoo.so.1 (0x...)" or "\tlibfoo.so.1 => not found"; the vDSO
+    // and the loader itself are listed without an arrow.
+    std::map<std::string, std::string> outside;    // Soname -> path, for libraries found outside the bundle
+    std::istringstream lines(trace.output);
+    for (std::string line; std::getline(lines, line);) {
+        const std::size_t arrow = line.find(" => ");
+        if (arrow == std::string::npos) {
+            continue;
+        }
+        const std::string name = trim(line.substr(0, arrow));
+        std::string path = trim(line.substr(arrow + 4));
+        if (path.rfind("not found", 0) == 0) {
+            check.missing.push_back(name);
+            continue;
+        }
+        const std::size_t address = path.rfind(" (0x");
+        if (address != std::string::npos) {
+            path.erase(address);
+        }
+        if (!insideBundle(path)) {
+            outside.emplace(name, path);
+        }
+    }
+    // A direct dependency that cannot be found aborts the trace before anything is listed.
+    const std::string prefix = "error while loading shared libraries: ";
+    const std::size_t failed = trace.errorOutput.find(prefix);
+    if (failed != std::string::npos) {
+        const std::size_t start = failed + prefix.size();
+        const std::size_t end = trace.errorOutput.find(": cannot open shared object file", start);
+        if (end != std::string::npos) {
+            check.missing.push_back(trace.errorOutput.substr(start, end - start));
+        }
+    }
+    if (trace.timedOut) {
+        check.error = "The loader did not finish within " + std::to_string(kTraceTimeout.count() / 1000) + " s";
+    } else if (trace.exitStatus != 0 && check.missing.empty()) {
+        check.error = trim(trace.errorOutput);
+        if (check.error.empty()) {
+            check.error = "The loader exited with status " + std::to_string(trace.exitStatus);
+        }
+    }
+
+    // A library outside the bundle is fine if the exclusions allow it, and so is everything
+    // it needs in turn; those were never ours to bundle.
+    std::set<std::string> allowed;
+    std::deque<std::string> pending;
+    for (const auto& [name, path] : outside) {
+        if (m_allowed.matchName(std::filesystem::path(name).filename().string(), false)
+            || m_allowed.matchPath(path, false)
+            || m_allowed.matchPath(std::filesystem::weakly_canonical(path), false)) {
+            allowed.insert(name);
+            pending.push_back(path);
+        }
+    }
+    while (!pending.empty()) {
+        const std::string path = pending.front();
+        pending.pop_front();
+        for (const auto& needed : neededOf(path)) {
+            auto it = outside.find(needed);
+            if (it != outside.end() && allowed.insert(needed).second) {
+                pending.push_back(it->second);
+            }
+        }
+    }
+    for (const auto& [name, path] : outside) {
+        if (!allowed.count(name)) {
+            check.outside.push_back(path);
+        }
+    }
+
+    check.passed = check.missing.empty() && check.outside.empty() && check.error.empty();
+    return check;
+}
+
+bool LoadVerifier::insideBundle(const std::filesystem::path& path) const {
+    std::error_code ec;
+    const std::filesystem::path resolved = std::filesystem::weakly_canonical(path, ec);
+    const std::filesystem::path relative = (ec ? path : resolved).lexically_relative(m_bundleDir);
+    return !relative.empty() && *relative.begin() != "..";
+}
+
+std::vector<std::string> LoadVerifier::neededOf(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(m_neededMutex);
+        auto it = m_needed.find(path);
+        if (it != m_needed.end()) {
+            return it->second;
+        }
+    }
+    std::vector<std::string> needed;
+    try {
+        needed = ElfFile(path).dynamicInfo().needed;
+    } catch (const std::exception&) {
+        // Unreadable; nothing it needs is allowed on its account.
+    }
+    std::lock_guard<std::mutex> lock(m_neededMutex);
+    return m_needed.emplace(path, std::move(needed)).first->second;
+}
@@ -0,0 +1,68 @@
+// src/LoadVerifier.hpp
+#ifndef RELOCATOR_LOADVERIFIER_HPP
+#define RELOCATOR_LOADVERIFIER_HPP
+
+#include "ElfFile.hpp"
+#include "ExclusionPolicy.hpp"
+#include "Process.hpp"
+#include "Relocator.hpp"
+#include "RunStats.hpp"
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class LoadVerifier
+ * @brief Test-loads every object of a Linux bundle, each in its own child process.
+ *
+ * An object is handed to its dynamic loader in trace mode ("ld.so --list", which is
+ * what ldd runs) with an empty environment, so LD_LIBRARY_PATH and LD_PRELOAD cannot
+ * paper over a broken RUNPATH, and nothing is loaded into the relocator itself. The
+ * loader resolves the object's whole closure but runs none of its code.
+ *
+ * Every library must then resolve inside the bundle, unless an exclusion rule allows
+ * it or it is only needed by libraries that are allowed (libc's own dependencies, say).
+ */
+class LoadVerifier {
+public:
+    /**
+     * @param bundleDir The output directory the objects were bundled into.
+     * @param allowed The run's exclusions; a library they match may resolve outside the bundle.
+     */
+    LoadVerifier(const std::filesystem::path& bundleDir, const ExclusionPolicy& allowed);
+
+    /**
+     * The loader that can trace an object, from a fixed table of where glibc installs the
+     * loader for each machine, class and byte order. The object's PT_INTERP only picks
+     * between the table's entries for its ABI; a path from the file is never run as such.
+     * @return An empty path if no loader for the object's ABI is installed on this host.
+     */
+    static std::filesystem::path loaderFor(const ElfFile& file);
+
+    /**
+     * Checks the objects in parallel.
+     * @param bundlePaths The objects, relative to the bundle directory.
+     * @param jobs Children allowed to run at the same time; 0 means one per hardware thread.
+     * @param stats Receives each child's wall and CPU time; the load-check phase, since the
+     *              pipeline's verify stage already counts every file once.
+     * @return One result per object checked, in the order given. Objects that are not
+     *         dynamically linked ELF files, or have no loader on this host, are left out.
+     */
+    std::vector<LoadCheck> verify(const std::vector<std::filesystem::path>& bundlePaths, unsigned jobs,
+                                  PhaseStats& stats);
+
+private:
+    LoadCheck classify(const std::filesystem::path& bundlePath, const CommandResult& trace);
+    bool insideBundle(const std::filesystem::path& path) const;
+    std::vector<std::string> neededOf(const std::string& path);
+
+    std::filesystem::path m_bundleDir;      // Canonical
+    const ExclusionPolicy& m_allowed;
+    std::mutex m_neededMutex;
+    std::unordered_map<std::string, std::vector<std::string>> m_needed;   // DT_NEEDED of libraries outside the bundle
+};
+
+#endif //RELOCATOR_LOADVERIFIER_HPP
@@ -1,15 +1,28 @@
 // src/MacOS_Relocator.cpp
 #include "MacOS_Relocator.hpp"
+#include "BundleManifest.hpp"
+#include "ConcurrentSet.hpp"
+#include "DependencyGraph.hpp"
+#include "FileCopier.hpp"
+#include "MachOFile.hpp"
+#include "MachOPatcher.hpp"
 #include "Process.hpp"
+#include "WorkStealingPool.hpp"
 #include <iostream>
 #include <sstream>
 #include <set>
-#include <map>
-#include <regex> // For regex matching
+#include <optional>
+#include <unordered_map>
+#include <functional>
+#include <future>
+#include <mutex>
+#if defined(__APPLE__)
 #include <dlfcn.h>
+#endif
 #include <cstdlib>
 #include <algorithm>
 
+#if defined(__APPLE__)
 // Helper function to trim strings
 static std::string trim(const std::string& s) {
     size_t first = s.find_first_not_of(" \t\n\r");
@@ -19,188 +32,374 @@ static std::string trim(const std::string& s) {
     size_t last = s.find_last_not_of(" \t\n\r");
     return s.substr(first, (last - first + 1));
 }
+#endif
 
 void MacOS_Relocator::bundleDependencies(
-    const std::filesystem::path& inputFile,
+    const std::vector<BundleInput>& inputs,
     const std::filesystem::path& outputDir,
     const std::vector<std::string>& searchPaths,
-    const std::vector<std::string>& literalExclusions,
-    const std::vector<std::string>& regexExclusions) {
-
-    std::cout << "\n=== Starting macOS Relocation ===\n";
-
-    std::set<std::filesystem::path> filesToBundle;
-    std::vector<std::filesystem::path> filesToProcess = { std::filesystem::canonical(inputFile) };
-
-    // Create a set from the literal exclusions for fast lookups
-    const std::set<std::string> exclusionSet(literalExclusions.begin(), literalExclusions.end());
-
-    std::cout << "Phase 1: Discovering all dependencies..." << std::endl;
-    while (!filesToProcess.empty()) {
-        std::filesystem::path currentFile = filesToProcess.back();
-        filesToProcess.pop_back();
-
-        if (filesToBundle.count(currentFile)) {
-            continue;
+    const ExclusionPolicy& exclusions) {
+
+    m_log << "\n=== Starting macOS Relocation ===\n";
+    beginRun();
+    PhaseStats& discoverStats = m_stats.phase(Phase::Discover);
+    PhaseStats& copyStats = m_stats.phase(Phase::Copy);
+    PhaseStats& fixupStats = m_stats.phase(Phase::Fixup);
+
+    // Edges are labelled with the install name exactly as the load command spells it,
+    // which is what the fixup has to rename later.
+    using NodeId = DependencyGraph::NodeId;
+    DependencyGraph& graph = m_graph;
+
+    // Each pending file carries the expanded LC_RPATHs of the files that loaded it.
+    struct PendingFile {
+        NodeId node;
+        std::vector<std::filesystem::path> inheritedRpaths;
+    };
+
+    // @executable_path is the main executable's directory; a bundle of libraries uses the primary input's.
+    std::filesystem::path executableDir = std::filesystem::canonical(inputs.front().file).parent_path();
+    for (const auto& input : inputs) {
+        const MachOFile file(input.file);
+        if (file.slices().front().fileType == MachO::kExecute) {
+            executableDir = std::filesystem::canonical(input.file).parent_path();
+            break;
+        }
+    }
+    // The search paths play the part of DYLD_FALLBACK_LIBRARY_PATH.
+    const std::vector<std::filesystem::path> fallbackDirs(searchPaths.begin(), searchPaths.end());
+
+    ConcurrentSet visited;
+    std::mutex logMutex;
+    WorkStealingPool pool(m_options.jobs);
+
+    std::function<void(const PendingFile&)> visit = [&](const PendingFile& pending) {
+        const std::filesystem::path& currentFile = graph.path(pending.node);
+        PhaseStats::Scope timing(discoverStats, currentFile.string());
+        const MachOFile file(currentFile);
+        const std::vector<MachODylib> dylibs = file.dylibs();
+
+        // Only @rpath names depend on the chain of loaders, so other files are visited once.
+        const bool chainIndependent = std::none_of(dylibs.begin(), dylibs.end(), [](const MachODylib& dylib) {
+            return dylib.name.rfind("@rpath/", 0) == 0;
+        });
+        std::string visitKey = currentFile.string();
+        if (!chainIndependent) {
+            for (const auto& dir : pending.inheritedRpaths) {
+                visitKey += '\0' + dir.string();
+            }
+        }
+        if (!visited.insert(visitKey)) {
+            timing.discard();
+            return;
         }
 
-        std::cout << "  Processing: " << currentFile << std::endl;
-        filesToBundle.insert(currentFile);
+        // Each file's messages are buffered and printed together so threads do not interleave lines.
+        std::ostringstream log, warnings;
+        log << "  Processing: " << currentFile << "\n";
 
-        std::string otoolCmd = "otool -L \"" + currentFile.string() + "\"";
-        CommandResult result = Process::exec(otoolCmd);
-        if (result.exitStatus != 0) {
-            throw std::runtime_error("otool failed for " + currentFile.string());
+        // dyld searches the loader's own rpaths first, then those of the files that loaded it.
+        MachOSearchContext context{ currentFile.parent_path(), executableDir, {} };
+        for (const auto& rpath : file.rpaths()) {
+            context.rpaths.push_back(MachOFile::expand(rpath, context));
         }
+        context.rpaths.insert(context.rpaths.end(), pending.inheritedRpaths.begin(), pending.inheritedRpaths.end());
 
-        std::istringstream stream(result.output);
-        std::string line;
-        std::getline(stream, line);
+        std::vector<PendingFile> children;
+        std::vector<DependencyGraph::Edge> edges;
+        for (const auto& dylib : dylibs) {
+            const std::string& installName = dylib.name;
+            const std::string filename = std::filesystem::path(installName).filename().string();
 
-        while (std::getline(stream, line)) {
-            std::string depPathStr = trim(line);
-            depPathStr = depPathStr.substr(0, depPathStr.find(" ("));
-
-            if (depPathStr.rfind("/usr/lib/", 0) == 0 || depPathStr.rfind("/System/Library/", 0) == 0) {
-                continue;
+            const ExclusionRule* rule = exclusions.matchName(filename);
+            if (!rule && installName.front() == '/') {
+                rule = exclusions.matchPath(installName);
             }
-
-            std::filesystem::path depPath(depPathStr);
-            std::string filename = depPath.filename().string();
-
-            // Check literal exclusion list
-            if (exclusionSet.count(filename)) {
-                std::cout << "    --> Ignoring user-excluded library: " << filename << std::endl;
-                continue;
+            std::optional<std::filesystem::path> depPath;
+            if (!rule) {
+                depPath = MachOFile::resolve(installName, context, fallbackDirs);
+                if (depPath) {
+                    rule = exclusions.matchPath(*depPath);
+                }
             }
-
-            // NEW: Check regex exclusion list
-            bool excludedByRegex = false;
-            for (const auto& pattern : regexExclusions) {
-                if (std::regex_match(filename, std::regex(pattern))) {
-                    excludedByRegex = true;
-                    std::cout << "    --> Ignoring user-excluded regex pattern '" << pattern << "': " << filename << std::endl;
-                    break;
+            if (rule) {
+                // The OS libraries are skipped on every file; only user rules are worth a line.
+                if (rule->origin != "built-in") {
+                    log << "    --> Ignoring library: " << installName << " [" << rule->describe() << "]\n";
                 }
+                continue;
             }
-            if (excludedByRegex) {
+            if (!depPath) {
+                if (dylib.weak()) {
+                    log << "    --> Weak library not found, the loader will skip it too: " << installName << "\n";
+                } else {
+                    warnings << "  " << warning("Could not find dependency " + installName + " of " + currentFile.string()) << "\n";
+                }
                 continue;
             }
 
-            if (depPathStr.rfind("@rpath", 0) == 0) {
-                 std::cerr << "  Warning: @rpath dependency found. Resolution not yet implemented: " << depPathStr << std::endl;
-                 continue;
-            }
+            const NodeId dep = graph.addNode(*depPath);
+            edges.push_back({ graph.addName(installName), dep });
+            children.push_back({ dep, context.rpaths });
+        }
 
-            if (std::filesystem::exists(depPath)) {
-                filesToProcess.push_back(std::filesystem::canonical(depPath));
-            } else {
-                std::cerr << "  Warning: Could not find dependency: " << depPathStr << std::endl;
-            }
+        graph.mergeEdges(pending.node, edges);
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            m_log << log.str() << std::flush;
+            m_errorLog << warnings.str() << std::flush;
+        }
+
+        for (auto& child : children) {
+            pool.submit([&visit, child] { visit(child); });
+        }
+    };
+
+    m_log << "Phase 1: Discovering all dependencies";
+    if (pool.size() > 1) {
+        m_log << " using " << pool.size() << " threads";
+    }
+    m_log << "..." << std::endl;
+    // Roots keep the place in the bundle they were given; every dependency goes to the top level.
+    std::unordered_map<NodeId, std::filesystem::path> rootPlacement;
+    for (const auto& input : inputs) {
+        const NodeId root = graph.addNode(std::filesystem::canonical(input.file));
+        if (rootPlacement.emplace(root, input.bundlePath).second) {
+            graph.markRoot(root);
+            PendingFile pending{ root, {} };
+            pool.submit([&visit, pending] { visit(pending); });
         }
     }
-    std::cout << "\n--- Dependency Analysis Complete ---" << std::endl;
-    std::cout << "Found " << filesToBundle.size() << " total files to process.\n\n";
+    pool.wait();
+    graph.freeze();
+    m_log << "\n--- Dependency Analysis Complete ---" << std::endl;
+    m_log << "Found " << graph.size() << " total files to process.\n\n";
 
     // --- Phase 2: Copy all discovered files to the output directory ---
-    std::cout << "Phase 2: " << (m_dryRun ? "Planning to copy" : "Copying") << " dependencies to output directory..." << std::endl;
-    std::map<std::filesystem::path, std::filesystem::path> oldToNewPathMap;
-
-    for (const auto& originalPath : filesToBundle) {
-        std::filesystem::path destination = outputDir / originalPath.filename();
-        oldToNewPathMap[originalPath] = destination;
+    m_log << "Phase 2: " << (m_dryRun ? "Planning to copy" : "Copying") << " dependencies to output directory..." << std::endl;
+    // Files are handled in path order so the fixup fingerprint below is stable across runs.
+    const std::vector<NodeId> filesToBundle = graph.nodesByPath();
+    std::vector<std::filesystem::path> destinations(graph.size());
+    uint64_t logicalBytes = 0;
+    uint64_t movedBytes = 0;
+
+    // install_name_tool edits depend on where every bundled file ends up, so one
+    // fingerprint of the whole mapping decides whether kept copies need fixing again.
+    BundleManifest manifest;
+    manifest.load(outputDir);
+    std::string mapping;
+    for (NodeId node : filesToBundle) {
+        const std::filesystem::path& originalPath = graph.path(node);
+        auto placed = rootPlacement.find(node);
+        destinations[node] = outputDir / (placed != rootPlacement.end() ? placed->second : originalPath.filename());
+        mapping += originalPath.string() + '\0' + destinations[node].string() + '\0';
+    }
+    const uint64_t fixupHash = BundleManifest::hashBytes(mapping.data(), mapping.size());
+    std::vector<ManifestEntry> entries(graph.size());
+    std::vector<char> upToDate(graph.size(), 0);
+    size_t upToDateCount = 0;
+
+    for (NodeId node : filesToBundle) {
+        const std::filesystem::path& originalPath = graph.path(node);
+        const std::filesystem::path& destination = destinations[node];
+        PhaseStats::Scope timing(copyStats, originalPath.string());
+
+        ManifestEntry& entry = entries[node];
+        entry.name = destination.lexically_relative(outputDir).generic_string();
+        entry.source = originalPath;
+        entry.sourceId = BundleManifest::identify(originalPath);
+        entry.fixupHash = fixupHash;
+        std::optional<ManifestEntry> previous = manifest.find(entry.name);
+        if (previous && previous->source == originalPath && previous->outputId.size != 0
+            && previous->outputId == BundleManifest::identify(destination)) {
+            if (previous->sourceId == entry.sourceId) {
+                entry.contentHash = previous->contentHash;
+            } else {
+                entry.contentHash = BundleManifest::hashFile(originalPath);
+                copyStats.addBytesRead(entry.sourceId.size);
+            }
+            if (entry.contentHash == previous->contentHash && previous->fixupHash == fixupHash) {
+                entry.outputId = previous->outputId;
+                upToDate[node] = 1;
+                ++upToDateCount;
+                continue;
+            }
+        }
 
         bool shouldCopy = true;
         // In a dry run, we don't check for equivalency since the destination doesn't exist.
         if (!m_dryRun && std::filesystem::exists(destination)) {
             try {
                 if (std::filesystem::canonical(originalPath) == std::filesystem::canonical(destination)) {
-                    std::cout << "  Skipping copy for file already in destination: " << originalPath.filename() << std::endl;
+                    m_log << "  Skipping copy for file already in destination: " << originalPath.filename() << std::endl;
                     shouldCopy = false;
                 }
             } catch (const std::filesystem::filesystem_error& e) {
-                std::cout << "  Could not check equivalency for " << destination << ", will overwrite." << std::endl;
+                m_log << "  Could not check equivalency for " << destination << ", will overwrite." << std::endl;
             }
         }
 
         if (shouldCopy) {
-            std::cout << "  " << (m_dryRun ? "Would copy" : "Copying") << " " << originalPath.filename() << " to " << destination << std::endl;
+            m_log << "  " << (m_dryRun ? "Would copy" : "Copying") << " " << originalPath.filename() << " to " << destination;
             if (!m_dryRun) {
-                std::filesystem::copy_file(originalPath, destination, std::filesystem::copy_options::overwrite_existing);
+                std::filesystem::create_directories(destination.parent_path());
+                CopyResult copied = FileCopier::copy(originalPath, destination, m_options.copyMode);
+                m_log << " (" << FileCopier::methodName(copied.method) << ")";
+                logicalBytes += copied.logicalBytes;
+                movedBytes += copied.bytesMoved;
+                copyStats.addBytesCopied(copied.logicalBytes);
+                copyStats.addBytesWritten(copied.bytesMoved);
+                entry.contentHash = BundleManifest::hashFile(originalPath);
+                copyStats.addBytesRead(entry.sourceId.size);
             }
+            m_log << std::endl;
         }
     }
 
     // --- Phase 3: Fixup the copied libraries ---
-    std::cout << "\nPhase 3: " << (m_dryRun ? "Planning to relocate" : "Relocating") << " library paths for all bundled files..." << std::endl;
-    for (const auto& [originalPath, newPath] : oldToNewPathMap) {
+    // Each file's load commands are rewritten in one in-process pass, and files are
+    // patched side by side.
+    m_log << "\nPhase 3: " << (m_dryRun ? "Planning to relocate" : "Relocating") << " library paths for all bundled files..." << std::endl;
+    std::vector<std::filesystem::path> needSigning;
+    {
+        WorkStealingPool fixupPool(m_options.fixupJobs);
+        for (NodeId node : filesToBundle) {
+            const std::filesystem::path& newPath = destinations[node];
+            if (upToDate[node]) {
+                continue;
+            }
 
-        std::cout << "  Fixing up " << newPath.filename() << "..." << std::endl;
+            // The library's own ID becomes relocatable with @loader_path, and its dependencies
+            // point at our bundled copies.
+            MachOPatchSpec spec;
+            spec.installName = "@loader_path/" + newPath.filename().string();
+            for (const auto& edge : graph.dependencies(node)) {
+                spec.dylibRenames[graph.name(edge.name)] = "@loader_path/"
+                    + destinations[edge.target].lexically_relative(newPath.parent_path()).generic_string();
+            }
+            m_log << "  Fixing up " << newPath.filename() << "..." << std::endl;
+            for (const auto& [from, to] : spec.dylibRenames) {
+                if (from != to) {
+                    m_log << "    " << from << " -> " << to << std::endl;
+                }
+            }
 
-        // Step 3a: Change the library's own ID to be relocatable using @loader_path
-        std::string newId = "@loader_path/" + newPath.filename().string();
-        std::string idCmd = "install_name_tool -id \"" + newId + "\" \"" + newPath.string() + "\"";
-        std::cout << "    " << idCmd << std::endl;
-        if (!m_dryRun) {
-            std::filesystem::permissions(newPath, std::filesystem::perms::owner_write, std::filesystem::perm_options::add);
-            Process::exec(idCmd);
-        }
-
-        // Step 3b: Find its original dependencies and change their paths to point to our new bundled copies.
-        std::string otoolCmd = "otool -L \"" + originalPath.string() + "\"";
-        CommandResult result = Process::exec(otoolCmd);
-        std::istringstream stream(result.output);
-        std::string line;
-        std::getline(stream, line); // skip self
-
-        while (std::getline(stream, line)) {
-            std::string oldDepPathStr = trim(line);
-            oldDepPathStr = oldDepPathStr.substr(0, oldDepPathStr.find(" ("));
-
-            std::filesystem::path oldDepPath(oldDepPathStr);
-            if (std::filesystem::exists(oldDepPath)) {
-                auto canonicalDepPath = std::filesystem::canonical(oldDepPath);
-
-                // Check if this dependency is one we have bundled
-                if (oldToNewPathMap.count(canonicalDepPath)) {
-                    std::filesystem::path newDepPath = oldToNewPathMap.at(canonicalDepPath);
-                    // FIX: Correctly use the 'newDepPath' variable here instead of the non-existent 'newDep'
-                    std::string newDepRpath = "@loader_path/" + newDepPath.filename().string();
-
-                    // IMPORTANT: Run 'change' on the *new* file, not the original.
-                    std::string changeCmd = "install_name_tool -change \"" + oldDepPathStr + "\" \"" + newDepRpath + "\" \"" + newPath.string() + "\"";
-                    std::cout << "    " << changeCmd << std::endl;
-                    if (!m_dryRun) {
-                        Process::exec(changeCmd);
+            if (!m_dryRun) {
+                fixupPool.submit([&, newPath, spec] {
+                    PhaseStats::Scope timing(fixupStats, newPath.string());
+                    // The patch edits in place; never let it write through a hard link into the original.
+                    const uint64_t unshared = FileCopier::unshare(newPath);
+                    fixupStats.addBytesWritten(unshared);
+                    std::filesystem::permissions(newPath, std::filesystem::perms::owner_write, std::filesystem::perm_options::add);
+                    const MachOPatchPlan plan = MachOPatcher::apply(newPath, spec);
+                    std::lock_guard<std::mutex> lock(logMutex);
+                    movedBytes += unshared;
+                    if (plan.signatureInvalidated) {
+                        needSigning.push_back(newPath);
                     }
-                }
+                });
+            }
+        }
+        fixupPool.wait();
+    }
+    std::sort(needSigning.begin(), needSigning.end());
+
+    // Rewritten load commands void a code signature, and Apple silicon refuses to load
+    // unsigned code, so edited files get an ad-hoc signature like install_name_tool gives them.
+    if (!needSigning.empty()) {
+#if defined(__APPLE__)
+        ProcessRunner runner(m_options.fixupJobs);
+        std::vector<std::pair<std::filesystem::path, std::future<CommandResult>>> signings;
+        for (const auto& file : needSigning) {
+            signings.emplace_back(file, runner.submit({ "codesign", "--force", "--sign", "-", file.string() }));
+        }
+        for (auto& [file, pending] : signings) {
+            CommandResult result = pending.get();
+            fixupStats.addSubprocess(result.wallSeconds, result.cpuSeconds);
+            if (result.exitStatus != 0) {
+                throw std::runtime_error("codesign failed for " + file.string() + ": " + trim(result.errorOutput));
             }
         }
+        m_log << "  Re-signed " << needSigning.size() << " file(s) ad hoc." << std::endl;
+#else
+        m_errorLog << "  " << warning(std::to_string(needSigning.size()) + " bundled file(s) had code signatures that the "
+                                      "fixup invalidated; re-sign them on macOS (codesign --force --sign -) before shipping.")
+                   << std::endl;
+#endif
     }
 
-    // --- Phase 4: Verify the relocated library ---
-    std::cout << "\nPhase 4: " << (m_dryRun ? "Planning to verify" : "Verifying") << " bundled library..." << std::endl;
+    if (upToDateCount > 0) {
+        m_log << "  " << upToDateCount << " of " << graph.size() << " files were already up to date." << std::endl;
+    }
     if (!m_dryRun) {
-        auto canonicalInputPath = std::filesystem::canonical(inputFile);
-        if (oldToNewPathMap.count(canonicalInputPath)) {
-            std::filesystem::path primaryLibInBundle = oldToNewPathMap.at(canonicalInputPath);
-            std::cout << "  Attempting to dynamically load: " << primaryLibInBundle << std::endl;
+        for (NodeId node : filesToBundle) {
+            if (!upToDate[node]) {
+                entries[node].outputId = BundleManifest::identify(destinations[node]);
+            }
+            manifest.record(entries[node]);
+        }
+    }
+    for (NodeId node : filesToBundle) {
+        m_result.files.push_back({ graph.path(node), destinations[node].lexically_relative(outputDir),
+                                   graph.isRoot(node), upToDate[node] != 0 });
+    }
+    std::set<std::string> bundledNames;
+    for (const auto& destination : destinations) {
+        bundledNames.insert(destination.lexically_relative(outputDir).generic_string());
+    }
+    for (const auto& entry : manifest.stale()) {
+        if (bundledNames.count(entry.name)) {
+            continue;
+        }
+        m_log << "  " << (m_dryRun ? "Would remove" : "Removing") << " stale file " << entry.name << std::endl;
+        m_result.removed.push_back(entry.name);
+        if (!m_dryRun) {
+            std::error_code ec;
+            std::filesystem::remove(outputDir / entry.name, ec);
+        }
+    }
+    if (!m_dryRun) {
+        manifest.save(outputDir);
+        m_log << "  " << logicalBytes / (1024 * 1024) << " MiB bundled, "
+                  << movedBytes / (1024 * 1024) << " MiB actually copied." << std::endl;
+    }
+
+    // --- Phase 4: Verify the relocated library ---
+    m_log << "\nPhase 4: " << (m_dryRun ? "Planning to verify" : "Verifying") << " bundled library..." << std::endl;
+    if (!m_dryRun && m_options.loadCheck) {
+#if defined(__APPLE__)
+        PhaseStats& loadStats = m_stats.phase(Phase::LoadCheck);
+        std::optional<NodeId> primary = graph.find(std::filesystem::canonical(inputs.front().file));
+        if (primary) {
+            const std::filesystem::path& primaryLibInBundle = destinations[*primary];
+            m_log << "  Attempting to dynamically load: " << primaryLibInBundle << std::endl;
+            PhaseStats::Scope timing(loadStats, primaryLibInBundle.string());
 
             setenv("DYLD_PRINT_LIBRARIES", "1", 1);
 
             void* handle = dlopen(primaryLibInBundle.c_str(), RTLD_LAZY);
+            m_result.loadChecked = true;
             if (!handle) {
-                std::cerr << "\n  VERIFICATION FAILED: dlopen reported an error:\n  " << dlerror() << std::endl;
+                m_result.loadError = dlerror();
+                m_errorLog << "\n  VERIFICATION FAILED: dlopen reported an error:\n  " << m_result.loadError << std::endl;
             } else {
-                std::cout << "\n  Verification SUCCESS: Library loaded successfully." << std::endl;
+                m_log << "\n  Verification SUCCESS: Library loaded successfully." << std::endl;
                 dlclose(handle);
             }
 
             unsetenv("DYLD_PRINT_LIBRARIES");
         } else {
-            std::cerr << "\n  VERIFICATION FAILED: Could not find primary library in the bundle map." << std::endl;
+            m_result.loadChecked = true;
+            m_result.loadError = "The primary library is not in the bundle.";
+            m_errorLog << "\n  VERIFICATION FAILED: Could not find primary library in the bundle map." << std::endl;
         }
+#else
+        m_log << "  Skipped: macOS binaries cannot be loaded on this host." << std::endl;
+#endif
+    } else if (!m_options.loadCheck) {
+        m_log << "  Skipped: the load check is disabled." << std::endl;
     } else {
-        std::cout << "  Would set DYLD_PRINT_LIBRARIES=1 and test loading the main library with dlopen." << std::endl;
+        m_log << "  Would set DYLD_PRINT_LIBRARIES=1 and test loading the main library with dlopen." << std::endl;
     }
+    m_stats.finish();
 }
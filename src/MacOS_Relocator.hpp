@@ -9,11 +9,10 @@ public:
     using Relocator::Relocator; // Inherit constructor
 
     void bundleDependencies(
-        const std::filesystem::path& inputFile,
+        const std::vector<BundleInput>& inputs,
         const std::filesystem::path& outputDir,
         const std::vector<std::string>& searchPaths,
-        const std::vector<std::string>& literalExclusions,
-        const std::vector<std::string>& regexExclusions
+        const ExclusionPolicy& exclusions
     ) override;
 };
 
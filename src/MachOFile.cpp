@@ -0,0 +1,283 @@
+// src/MachOFile.cpp
+#include "MachOFile.hpp"
+#include "ByteOrder.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+
+// Java class files also start with 0xcafebabe, but their "count" is a class file version of 45 or more.
+constexpr std::uint32_t kMaxFatArchs = 30;
+
+// Section types whose data takes no room in the file.
+bool isZeroFill(std::uint32_t sectionFlags) {
+    const std::uint32_t type = sectionFlags & 0xff;
+    return type == 0x1 || type == 0xc || type == 0x12;   // S_ZEROFILL, S_GB_ZEROFILL, S_THREAD_LOCAL_ZEROFILL
+}
+
+bool startsWith(const std::string& s, const char* prefix) {
+    return s.rfind(prefix, 0) == 0;
+}
+
+} // namespace
+
+MachOFile::MachOFile(const std::filesystem::path& path)
+    : m_path(path), m_file(std::make_unique<MappedFile>(path)) {
+    m_data = m_file->data();
+    m_size = m_file->size();
+    parse();
+}
+
+MachOFile::MachOFile(const std::uint8_t* data, std::size_t size, const std::filesystem::path& name)
+    : m_path(name), m_data(data), m_size(size) {
+    parse();
+}
+
+bool MachOFile::isMachO(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::uint8_t header[8] = {};
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        return false;
+    }
+    const std::uint32_t magic = ByteOrder::load<std::uint32_t>(header, false);
+    if (magic == MachO::kMagic32 || magic == MachO::kMagic64
+        || magic == ByteOrder::swap(MachO::kMagic32) || magic == ByteOrder::swap(MachO::kMagic64)) {
+        return true;
+    }
+    const std::uint32_t fatMagic = ByteOrder::load<std::uint32_t>(header, true);
+    const std::uint32_t archs = ByteOrder::load<std::uint32_t>(header + 4, true);
+    return (fatMagic == MachO::kFatMagic || fatMagic == MachO::kFatMagic64) && archs > 0 && archs <= kMaxFatArchs;
+}
+
+std::string MachOFile::cpuName(std::int32_t cpuType) {
+    switch (static_cast<std::uint32_t>(cpuType)) {
+        case 7:           return "i386";
+        case 0x01000007:  return "x86_64";
+        case 12:          return "arm";
+        case 0x0100000c:  return "arm64";
+        case 0x0200000c:  return "arm64_32";
+        case 18:          return "ppc";
+        case 0x01000012:  return "ppc64";
+        default:          return "cpu-" + std::to_string(cpuType);
+    }
+}
+
+void MachOFile::parse() {
+    if (m_size < 8) {
+        throw std::runtime_error("Not a Mach-O file: " + m_path.string());
+    }
+    const std::uint32_t fatMagic = ByteOrder::load<std::uint32_t>(m_data, true);
+    if (fatMagic != MachO::kFatMagic && fatMagic != MachO::kFatMagic64) {
+        m_slices.push_back(parseSlice(0, m_size));
+        return;
+    }
+
+    // The universal header and its table are big-endian whatever the slices are.
+    const bool wide = fatMagic == MachO::kFatMagic64;
+    const std::uint32_t count = ByteOrder::load<std::uint32_t>(m_data + 4, true);
+    const std::uint64_t entrySize = wide ? 32 : 20;
+    if (count == 0 || count > kMaxFatArchs || !contains(8, count * entrySize)) {
+        throw std::runtime_error("Not a Mach-O file: " + m_path.string());
+    }
+    m_universal = true;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        const std::uint8_t* entry = m_data + 8 + i * entrySize;
+        const std::uint64_t offset = wide ? ByteOrder::load<std::uint64_t>(entry + 8, true)
+                                          : ByteOrder::load<std::uint32_t>(entry + 8, true);
+        const std::uint64_t size = wide ? ByteOrder::load<std::uint64_t>(entry + 16, true)
+                                        : ByteOrder::load<std::uint32_t>(entry + 12, true);
+        if (!contains(offset, size)) {
+            throw std::runtime_error("Universal slice " + std::to_string(i) + " lies outside " + m_path.string());
+        }
+        m_slices.push_back(parseSlice(offset, size));
+    }
+}
+
+MachOSlice MachOFile::parseSlice(std::uint64_t offset, std::uint64_t size) const {
+    MachOSlice slice;
+    slice.offset = offset;
+    slice.size = size;
+    if (size < 28) {
+        throw std::runtime_error("Truncated Mach-O header in: " + m_path.string());
+    }
+    const std::uint8_t* base = m_data + offset;
+    const std::uint32_t magic = ByteOrder::load<std::uint32_t>(base, false);
+    if (magic == MachO::kMagic64 || magic == MachO::kMagic32) {
+        slice.bigEndian = false;
+    } else if (magic == ByteOrder::swap(MachO::kMagic64) || magic == ByteOrder::swap(MachO::kMagic32)) {
+        slice.bigEndian = true;
+    } else {
+        throw std::runtime_error("Not a Mach-O file: " + m_path.string());
+    }
+    slice.is64Bit = magic == MachO::kMagic64 || magic == ByteOrder::swap(MachO::kMagic64);
+
+    auto u32 = [&](std::uint64_t at) { return ByteOrder::load<std::uint32_t>(m_data + at, slice.bigEndian); };
+    auto u64 = [&](std::uint64_t at) { return ByteOrder::load<std::uint64_t>(m_data + at, slice.bigEndian); };
+
+    slice.cpuType = static_cast<std::int32_t>(u32(offset + 4));
+    slice.cpuSubtype = static_cast<std::int32_t>(u32(offset + 8));
+    slice.fileType = u32(offset + 12);
+    const std::uint32_t count = u32(offset + 16);
+    slice.sizeOfCommands = u32(offset + 20);
+    slice.headerSize = slice.is64Bit ? 32 : 28;
+    if (slice.headerSize + std::uint64_t(slice.sizeOfCommands) > size) {
+        throw std::runtime_error("Load commands run past the end of: " + m_path.string());
+    }
+
+    // The load commands may grow into the gap before the first byte of section data.
+    std::uint64_t firstData = size;
+    std::uint64_t at = offset + slice.headerSize;
+    const std::uint64_t end = at + slice.sizeOfCommands;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        if (end - at < 8) {
+            throw std::runtime_error("Truncated load command " + std::to_string(i) + " in: " + m_path.string());
+        }
+        MachOLoadCommand command{ u32(at), u32(at + 4), at };
+        if (command.size < 8 || command.size > end - at) {
+            throw std::runtime_error("Malformed load command " + std::to_string(i) + " in: " + m_path.string());
+        }
+        slice.commands.push_back(command);
+
+        if (command.cmd == MachO::kSegment64 || command.cmd == MachO::kSegment) {
+            const bool wide = command.cmd == MachO::kSegment64;
+            const std::uint64_t headerSize = wide ? 72 : 56;
+            const std::uint64_t sectionSize = wide ? 80 : 68;
+            if (command.size < headerSize) {
+                throw std::runtime_error("Malformed segment command in: " + m_path.string());
+            }
+            const std::uint64_t fileOffset = wide ? u64(at + 40) : u32(at + 32);
+            const std::uint64_t fileSize = wide ? u64(at + 48) : u32(at + 36);
+            const std::uint32_t sections = u32(at + (wide ? 64 : 48));
+            if (headerSize + sections * sectionSize > command.size) {
+                throw std::runtime_error("Malformed segment command in: " + m_path.string());
+            }
+            if (fileOffset > 0 && fileSize > 0) {
+                firstData = std::min(firstData, fileOffset);
+            }
+            for (std::uint32_t s = 0; s < sections; ++s) {
+                const std::uint64_t section = at + headerSize + s * sectionSize;
+                const std::uint32_t dataOffset = u32(section + (wide ? 48 : 40));
+                const std::uint32_t flags = u32(section + (wide ? 64 : 56));
+                if (dataOffset > 0 && !isZeroFill(flags)) {
+                    firstData = std::min<std::uint64_t>(firstData, dataOffset);
+                }
+            }
+        } else if (command.cmd == MachO::kIdDylib) {
+            slice.installName = commandString(slice, command, 8);
+        } else if (MachO::isDylibLoad(command.cmd)) {
+            slice.dylibs.push_back({ commandString(slice, command, 8), command.cmd });
+        } else if (command.cmd == MachO::kRpath) {
+            slice.rpaths.push_back(commandString(slice, command, 8));
+        } else if (command.cmd == MachO::kCodeSignature) {
+            slice.hasCodeSignature = true;
+        }
+        at += command.size;
+    }
+    slice.commandSpace = firstData > slice.headerSize ? firstData - slice.headerSize : 0;
+    return slice;
+}
+
+std::string MachOFile::commandString(const MachOSlice& slice, const MachOLoadCommand& command,
+                                     std::uint32_t field) const {
+    if (command.size < field + 4) {
+        throw std::runtime_error("Malformed string in a load command of: " + m_path.string());
+    }
+    const std::uint32_t start = ByteOrder::load<std::uint32_t>(m_data + command.offset + field, slice.bigEndian);
+    if (start < field + 4 || start >= command.size) {
+        throw std::runtime_error("Malformed string in a load command of: " + m_path.string());
+    }
+    const char* first = reinterpret_cast<const char*>(m_data + command.offset + start);
+    const char* last = reinterpret_cast<const char*>(m_data + command.offset + command.size);
+    return std::string(first, std::find(first, last, '\0'));
+}
+
+std::optional<std::string> MachOFile::installName() const {
+    for (const auto& slice : m_slices) {
+        if (slice.installName) {
+            return slice.installName;
+        }
+    }
+    return std::nullopt;
+}
+
+std::vector<MachODylib> MachOFile::dylibs() const {
+    std::vector<MachODylib> result;
+    std::unordered_set<std::string> seen;
+    for (const auto& slice : m_slices) {
+        for (const auto& dylib : slice.dylibs) {
+            if (seen.insert(dylib.name).second) {
+                result.push_back(dylib);
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<std::string> MachOFile::rpaths() const {
+    std::vector<std::string> result;
+    std::unordered_set<std::string> seen;
+    for (const auto& slice : m_slices) {
+        for (const auto& rpath : slice.rpaths) {
+            if (seen.insert(rpath).second) {
+                result.push_back(rpath);
+            }
+        }
+    }
+    return result;
+}
+
+std::filesystem::path MachOFile::expand(const std::string& path, const MachOSearchContext& context) {
+    for (const auto& [token, directory] : { std::make_pair("@loader_path", &context.loaderDir),
+                                            std::make_pair("@executable_path", &context.executableDir) }) {
+        if (startsWith(path, token)) {
+            const std::string rest = path.substr(std::char_traits<char>::length(token));
+            return (*directory / std::filesystem::path(rest).relative_path()).lexically_normal();
+        }
+    }
+    return path;
+}
+
+std::optional<std::filesystem::path> MachOFile::resolve(const std::string& installName,
+                                                         const MachOSearchContext& context,
+                                                         const std::vector<std::filesystem::path>& fallbackDirs) {
+    auto existing = [](const std::filesystem::path& candidate) -> std::optional<std::filesystem::path> {
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(candidate, ec)) {
+            std::filesystem::path resolved = std::filesystem::canonical(candidate, ec);
+            if (!ec) {
+                return resolved;
+            }
+        }
+        return std::nullopt;
+    };
+
+    std::filesystem::path rest(installName);
+    if (startsWith(installName, "@rpath/")) {
+        rest = installName.substr(7);
+        for (const auto& rpath : context.rpaths) {
+            if (auto found = existing(rpath / rest)) {
+                return found;
+            }
+        }
+    } else if (auto found = existing(expand(installName, context))) {
+        return found;
+    }
+
+    // Frameworks are looked up by their "Name.framework/..." tail, plain libraries by filename.
+    const std::string tail = rest.generic_string();
+    const std::size_t framework = tail.rfind(".framework/");
+    std::filesystem::path fallback = rest.filename();
+    if (framework != std::string::npos) {
+        const std::size_t slash = tail.rfind('/', framework);
+        fallback = tail.substr(slash == std::string::npos ? 0 : slash + 1);
+    }
+    for (const auto& directory : fallbackDirs) {
+        if (auto found = existing(directory / fallback)) {
+            return found;
+        }
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,189 @@
+// src/MachOFile.hpp
+#ifndef RELOCATOR_MACHOFILE_HPP
+#define RELOCATOR_MACHOFILE_HPP
+
+#include "MappedFile.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @namespace MachO
+ * @brief The Mach-O constants the parser and patcher need, so neither depends on <mach-o/loader.h>.
+ */
+namespace MachO {
+    constexpr std::uint32_t kMagic32 = 0xfeedface;
+    constexpr std::uint32_t kMagic64 = 0xfeedfacf;
+    constexpr std::uint32_t kFatMagic = 0xcafebabe;      // Always stored big-endian
+    constexpr std::uint32_t kFatMagic64 = 0xcafebabf;
+
+    constexpr std::uint32_t kExecute = 0x2;              // MH_EXECUTE
+    constexpr std::uint32_t kDylib = 0x6;                // MH_DYLIB
+    constexpr std::uint32_t kBundle = 0x8;               // MH_BUNDLE
+
+    constexpr std::uint32_t kReqDyld = 0x80000000;
+    constexpr std::uint32_t kSegment = 0x1;
+    constexpr std::uint32_t kLoadDylib = 0xc;
+    constexpr std::uint32_t kIdDylib = 0xd;
+    constexpr std::uint32_t kSegment64 = 0x19;
+    constexpr std::uint32_t kLoadWeakDylib = 0x18 | kReqDyld;
+    constexpr std::uint32_t kRpath = 0x1c | kReqDyld;
+    constexpr std::uint32_t kCodeSignature = 0x1d;
+    constexpr std::uint32_t kReexportDylib = 0x1f | kReqDyld;
+    constexpr std::uint32_t kLazyLoadDylib = 0x20;
+    constexpr std::uint32_t kLoadUpwardDylib = 0x23 | kReqDyld;
+
+    /**
+     * @return true for the load commands that name a library to load.
+     */
+    inline bool isDylibLoad(std::uint32_t cmd) {
+        return cmd == kLoadDylib || cmd == kLoadWeakDylib || cmd == kReexportDylib
+            || cmd == kLazyLoadDylib || cmd == kLoadUpwardDylib;
+    }
+} // namespace MachO
+
+/**
+ * @struct MachOLoadCommand
+ * @brief Where one load command sits and what it is.
+ */
+struct MachOLoadCommand {
+    std::uint32_t cmd = 0;
+    std::uint32_t size = 0;
+    std::uint64_t offset = 0;    // From the start of the file, not of the slice
+};
+
+/**
+ * @struct MachODylib
+ * @brief A library named by LC_LOAD_DYLIB or one of its variants.
+ */
+struct MachODylib {
+    std::string name;            // The install name, e.g. "@rpath/libfoo.1.dylib"
+    std::uint32_t cmd = 0;
+    bool weak() const { return cmd == MachO::kLoadWeakDylib; }
+};
+
+/**
+ * @struct MachOSlice
+ * @brief One architecture of a (possibly universal) Mach-O file, decoded into host byte order.
+ */
+struct MachOSlice {
+    std::uint64_t offset = 0;    // Of the mach_header within the file
+    std::uint64_t size = 0;
+    bool is64Bit = false;
+    bool bigEndian = false;
+    std::int32_t cpuType = 0;
+    std::int32_t cpuSubtype = 0;
+    std::uint32_t fileType = 0;
+    std::uint32_t headerSize = 0;             // 28 or 32
+    std::uint32_t sizeOfCommands = 0;
+    std::uint64_t commandSpace = 0;           // Bytes from the end of the header to the first section's data
+    std::vector<MachOLoadCommand> commands;
+    std::optional<std::string> installName;   // LC_ID_DYLIB
+    std::vector<MachODylib> dylibs;           // In load order
+    std::vector<std::string> rpaths;          // LC_RPATH, unexpanded, in order
+    bool hasCodeSignature = false;
+};
+
+/**
+ * @struct MachOSearchContext
+ * @brief What dyld knows when it resolves an install name.
+ */
+struct MachOSearchContext {
+    std::filesystem::path loaderDir;              // Directory of the file with the load command (@loader_path)
+    std::filesystem::path executableDir;          // Directory of the main executable (@executable_path)
+    std::vector<std::filesystem::path> rpaths;    // Expanded LC_RPATHs of the load chain, the loader's own first
+};
+
+/**
+ * @class MachOFile
+ * @brief An in-process, read-only parser for thin and universal Mach-O files.
+ *
+ * Like ElfFile, the file is memory-mapped and decoded field by field, so Mach-O
+ * objects of any byte order can be inspected on any host, including Linux.
+ */
+class MachOFile {
+public:
+    /**
+     * Maps and parses a Mach-O file.
+     * @throws std::runtime_error if the file cannot be read or is not a well-formed Mach-O file.
+     */
+    explicit MachOFile(const std::filesystem::path& path);
+
+    /**
+     * Parses an image already in memory. The buffer is not copied and must outlive this object.
+     * @param name A name used in error messages.
+     */
+    MachOFile(const std::uint8_t* data, std::size_t size, const std::filesystem::path& name);
+
+    /**
+     * Checks the thin or universal magic of a file without parsing the rest of it.
+     */
+    static bool isMachO(const std::filesystem::path& path);
+
+    /**
+     * Returns a readable name for a CPU type (e.g. "arm64").
+     */
+    static std::string cpuName(std::int32_t cpuType);
+
+    /**
+     * Expands a leading @loader_path or @executable_path, as dyld does for LC_RPATH entries.
+     * @return The path unchanged if it starts with neither.
+     */
+    static std::filesystem::path expand(const std::string& path, const MachOSearchContext& context);
+
+    /**
+     * Resolves an install name the way dyld does: @rpath against each rpath in turn,
+     * @loader_path and @executable_path against their directories, and absolute names as
+     * they are. When that finds nothing, the filename is looked for in fallbackDirs, as
+     * with DYLD_FALLBACK_LIBRARY_PATH.
+     * @return The canonical path of the library, or nothing if it cannot be found.
+     */
+    static std::optional<std::filesystem::path> resolve(const std::string& installName,
+                                                        const MachOSearchContext& context,
+                                                        const std::vector<std::filesystem::path>& fallbackDirs);
+
+    const std::filesystem::path& path() const { return m_path; }
+    const std::uint8_t* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+    bool isUniversal() const { return m_universal; }
+    const std::vector<MachOSlice>& slices() const { return m_slices; }
+
+    /**
+     * The install name of the first slice that has one.
+     */
+    std::optional<std::string> installName() const;
+
+    /**
+     * Every library the slices load, each name once, in the first slice's order.
+     */
+    std::vector<MachODylib> dylibs() const;
+
+    /**
+     * Every LC_RPATH of the slices, each once, in the first slice's order.
+     */
+    std::vector<std::string> rpaths() const;
+
+private:
+    void parse();
+    MachOSlice parseSlice(std::uint64_t offset, std::uint64_t size) const;
+    std::string commandString(const MachOSlice& slice, const MachOLoadCommand& command, std::uint32_t field) const;
+    bool contains(std::uint64_t offset, std::uint64_t length) const {
+        return offset <= m_size && length <= m_size - offset;
+    }
+
+    std::filesystem::path m_path;
+    std::unique_ptr<MappedFile> m_file;      // Null when parsing a caller-owned buffer
+    const std::uint8_t* m_data = nullptr;
+    std::size_t m_size = 0;
+
+    bool m_universal = false;
+    std::vector<MachOSlice> m_slices;
+};
+
+#endif //RELOCATOR_MACHOFILE_HPP
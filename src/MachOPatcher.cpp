@@ -0,0 +1,135 @@
+// src/MachOPatcher.cpp
+#include "MachOPatcher.hpp"
+#include "ByteOrder.hpp"
+#include "MachOFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::uint32_t kDylibCommandSize = 24;   // cmd, cmdsize, name offset, timestamp, current and compatibility version
+constexpr std::uint32_t kRpathCommandSize = 12;   // cmd, cmdsize, path offset
+
+// Appends one load command carrying a string, padded as the slice requires.
+void appendStringCommand(std::vector<std::uint8_t>& block, const MachOSlice& slice, std::uint32_t cmd,
+                         const std::uint8_t* fixedFields, std::uint32_t headerSize, const std::string& text) {
+    const std::uint32_t align = slice.is64Bit ? 8 : 4;
+    const std::uint32_t size = (headerSize + static_cast<std::uint32_t>(text.size()) + 1 + align - 1) & ~(align - 1);
+    const std::size_t at = block.size();
+    block.resize(at + size, 0);
+    ByteOrder::store<std::uint32_t>(&block[at], cmd, slice.bigEndian);
+    ByteOrder::store<std::uint32_t>(&block[at + 4], size, slice.bigEndian);
+    ByteOrder::store<std::uint32_t>(&block[at + 8], headerSize, slice.bigEndian);
+    if (headerSize > 12) {
+        std::memcpy(&block[at + 12], fixedFields, headerSize - 12);
+    }
+    std::memcpy(&block[at + headerSize], text.data(), text.size());
+}
+
+} // namespace
+
+MachOPatchPlan MachOPatcher::patch(std::vector<std::uint8_t>& image, const MachOPatchSpec& spec,
+                                   const std::filesystem::path& name) {
+    MachOPatchPlan plan;
+    if (spec.empty()) {
+        return plan;
+    }
+    // The parsed slices only record offsets and copies of the strings, so the image can be edited underneath.
+    const MachOFile file(image.data(), image.size(), name);
+
+    for (const MachOSlice& slice : file.slices()) {
+        const bool replaceRpaths = spec.rpaths && *spec.rpaths != slice.rpaths;
+        bool changed = replaceRpaths;
+        std::vector<std::uint8_t> block;
+        block.reserve(slice.sizeOfCommands + 256);
+        std::uint32_t count = 0;
+        std::size_t dylib = 0;
+
+        for (const MachOLoadCommand& command : slice.commands) {
+            const std::uint8_t* raw = image.data() + command.offset;
+            std::optional<std::string> rename;
+            if (command.cmd == MachO::kIdDylib && spec.installName && *spec.installName != *slice.installName) {
+                rename = spec.installName;
+            } else if (MachO::isDylibLoad(command.cmd)) {
+                auto it = spec.dylibRenames.find(slice.dylibs[dylib++].name);
+                if (it != spec.dylibRenames.end() && it->second != slice.dylibs[dylib - 1].name) {
+                    rename = it->second;
+                }
+            } else if (command.cmd == MachO::kRpath && replaceRpaths) {
+                continue;
+            }
+
+            if (rename) {
+                appendStringCommand(block, slice, command.cmd, raw + 12, kDylibCommandSize, *rename);
+                changed = true;
+            } else {
+                block.insert(block.end(), raw, raw + command.size);
+            }
+            ++count;
+        }
+        if (replaceRpaths) {
+            for (const auto& rpath : *spec.rpaths) {
+                appendStringCommand(block, slice, MachO::kRpath, nullptr, kRpathCommandSize, rpath);
+                ++count;
+            }
+        }
+        if (!changed) {
+            continue;
+        }
+
+        if (block.size() > slice.commandSpace) {
+            throw std::runtime_error("No room for the new load commands of " + name.string() + " ("
+                                     + MachOFile::cpuName(slice.cpuType) + "): they need " + std::to_string(block.size())
+                                     + " bytes and " + std::to_string(slice.commandSpace)
+                                     + " are free. Relink it with -headerpad_max_install_names.");
+        }
+        std::uint8_t* header = image.data() + slice.offset;
+        ByteOrder::store<std::uint32_t>(header + 16, count, slice.bigEndian);
+        ByteOrder::store<std::uint32_t>(header + 20, static_cast<std::uint32_t>(block.size()), slice.bigEndian);
+        std::uint8_t* commands = header + slice.headerSize;
+        std::memcpy(commands, block.data(), block.size());
+        // Clear what is left of the old commands, so the padding is zeros again.
+        if (block.size() < slice.sizeOfCommands) {
+            std::memset(commands + block.size(), 0, slice.sizeOfCommands - block.size());
+        }
+
+        plan.changes.emplace_back(slice.offset + 16, 8);
+        plan.changes.emplace_back(slice.offset + slice.headerSize,
+                                  std::max<std::uint64_t>(block.size(), slice.sizeOfCommands));
+        plan.signatureInvalidated |= slice.hasCodeSignature;
+    }
+    return plan;
+}
+
+MachOPatchPlan MachOPatcher::apply(const std::filesystem::path& file, const MachOPatchSpec& spec) {
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("Could not open file: " + file.string());
+    }
+    std::vector<std::uint8_t> image(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0);
+    if (!image.empty() && !in.read(reinterpret_cast<char*>(image.data()), image.size())) {
+        throw std::runtime_error("Could not read file: " + file.string());
+    }
+    in.close();
+
+    MachOPatchPlan plan = patch(image, spec, file);
+    if (!plan.changed()) {
+        return plan;
+    }
+    std::fstream out(file, std::ios::binary | std::ios::in | std::ios::out);
+    if (!out) {
+        throw std::runtime_error("Could not open file for writing: " + file.string());
+    }
+    for (const auto& [offset, size] : plan.changes) {
+        out.seekp(offset);
+        out.write(reinterpret_cast<const char*>(image.data() + offset), size);
+    }
+    if (!out) {
+        throw std::runtime_error("Could not write file: " + file.string());
+    }
+    return plan;
+}
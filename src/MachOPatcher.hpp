@@ -0,0 +1,60 @@
+// src/MachOPatcher.hpp
+#ifndef RELOCATOR_MACHOPATCHER_HPP
+#define RELOCATOR_MACHOPATCHER_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @struct MachOPatchSpec
+ * @brief Every edit to apply to one Mach-O file; what install_name_tool's -id, -change and rpath flags do.
+ */
+struct MachOPatchSpec {
+    std::optional<std::string> installName;              // New LC_ID_DYLIB; ignored for files without one
+    std::map<std::string, std::string> dylibRenames;     // Old install name -> new, for every kind of LC_LOAD_DYLIB
+    std::optional<std::vector<std::string>> rpaths;      // Replaces every LC_RPATH, in this order
+
+    bool empty() const { return !installName && dylibRenames.empty() && !rpaths; }
+};
+
+/**
+ * @struct MachOPatchPlan
+ * @brief What applying a MachOPatchSpec changed.
+ */
+struct MachOPatchPlan {
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> changes;   // (offset, size) of each rewritten range
+    bool signatureInvalidated = false;    // A changed slice carries LC_CODE_SIGNATURE, which no longer matches
+
+    bool changed() const { return !changes.empty(); }
+};
+
+/**
+ * @class MachOPatcher
+ * @brief Rewrites the load commands of thin and universal Mach-O files in place.
+ *
+ * Each slice's load commands are rebuilt with the new strings and written back over
+ * the old ones. They may grow into the padding the linker leaves before the first
+ * section; the file never changes size. Nothing outside the load commands is
+ * touched, so a code signature is left in place but no longer valid.
+ */
+class MachOPatcher {
+public:
+    /**
+     * Reads the file once, applies the edits to every slice and writes the changed ranges back.
+     * @throws std::runtime_error if the file is not Mach-O or a slice has no room for its new load commands.
+     */
+    static MachOPatchPlan apply(const std::filesystem::path& file, const MachOPatchSpec& spec);
+
+    /**
+     * Applies the edits to an in-memory image.
+     * @param name A name used in error messages.
+     */
+    static MachOPatchPlan patch(std::vector<std::uint8_t>& image, const MachOPatchSpec& spec,
+                                const std::filesystem::path& name);
+};
+
+#endif //RELOCATOR_MACHOPATCHER_HPP
@@ -0,0 +1,114 @@
+// src/MappedFile.hpp
+#ifndef RELOCATOR_MAPPEDFILE_HPP
+#define RELOCATOR_MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @class MappedFile
+ * @brief A read-only, memory-mapped view of a file on disk.
+ *
+ * The mapping is released when the object is destroyed. Empty files are
+ * represented by a null data pointer and a size of zero.
+ */
+class MappedFile {
+public:
+    /**
+     * Maps the given file into memory for reading.
+     * @param path The file to map.
+     * @throws std::runtime_error if the file cannot be opened or mapped.
+     */
+    explicit MappedFile(const std::filesystem::path& path) {
+#if defined(_WIN32)
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Could not open file: " + path.string());
+        }
+        LARGE_INTEGER size{};
+        if (!GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            throw std::runtime_error("Could not stat file: " + path.string());
+        }
+        m_size = static_cast<std::size_t>(size.QuadPart);
+        if (m_size > 0) {
+            // The view keeps the mapping alive, so neither handle is needed once it exists.
+            HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            void* addr = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (mapping) {
+                CloseHandle(mapping);
+            }
+            if (!addr) {
+                CloseHandle(file);
+                throw std::runtime_error("MapViewOfFile() failed for file: " + path.string());
+            }
+            m_data = static_cast<const std::uint8_t*>(addr);
+        }
+        CloseHandle(file);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open file: " + path.string());
+        }
+
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Could not stat file: " + path.string());
+        }
+
+        m_size = static_cast<std::size_t>(st.st_size);
+        if (m_size > 0) {
+            void* addr = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("mmap() failed for file: " + path.string());
+            }
+            m_data = static_cast<const std::uint8_t*>(addr);
+        }
+        ::close(fd);
+#endif
+    }
+
+    ~MappedFile() {
+        if (m_data != nullptr) {
+#if defined(_WIN32)
+            UnmapViewOfFile(m_data);
+#else
+            ::munmap(const_cast<std::uint8_t*>(m_data), m_size);
+#endif
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const std::uint8_t* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+    /**
+     * Checks whether the range [offset, offset + length) lies inside the mapping.
+     */
+    bool contains(std::uint64_t offset, std::uint64_t length) const {
+        return offset <= m_size && length <= m_size - offset;
+    }
+
+private:
+    const std::uint8_t* m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+#endif //RELOCATOR_MAPPEDFILE_HPP
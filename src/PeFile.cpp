@@ -0,0 +1,195 @@
+// src/PeFile.cpp
+#include "PeFile.hpp"
+#include "ByteOrder.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+// Bounds for malformed images: Windows itself refuses more sections than this, and no
+// real image imports anywhere near as many DLLs.
+constexpr std::uint16_t kMaxSections = 96;
+constexpr std::size_t kMaxImports = 4096;
+constexpr std::size_t kMaxNameLength = 260;     // MAX_PATH
+
+constexpr std::uint32_t kImportDescriptorSize = 20;
+constexpr std::uint32_t kDelayDescriptorSize = 32;
+constexpr std::uint32_t kSectionHeaderSize = 40;
+
+std::uint16_t u16(const std::uint8_t* at) { return ByteOrder::load<std::uint16_t>(at, false); }
+std::uint32_t u32(const std::uint8_t* at) { return ByteOrder::load<std::uint32_t>(at, false); }
+std::uint64_t u64(const std::uint8_t* at) { return ByteOrder::load<std::uint64_t>(at, false); }
+
+bool equalsIgnoreCase(const std::string& a, const std::string& b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+} // namespace
+
+PeFile::PeFile(const std::filesystem::path& path)
+    : m_path(path), m_file(std::make_unique<MappedFile>(path)) {
+    m_data = m_file->data();
+    m_size = m_file->size();
+    parse();
+}
+
+PeFile::PeFile(const std::uint8_t* data, std::size_t size, const std::filesystem::path& name)
+    : m_path(name), m_data(data), m_size(size) {
+    parse();
+}
+
+bool PeFile::isPe(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::uint8_t dos[64] = {};
+    if (!in.read(reinterpret_cast<char*>(dos), sizeof(dos)) || u16(dos) != Pe::kDosMagic) {
+        return false;
+    }
+    std::uint8_t signature[4] = {};
+    in.seekg(u32(dos + 0x3c));
+    return in.read(reinterpret_cast<char*>(signature), sizeof(signature)) && u32(signature) == Pe::kSignature;
+}
+
+std::string PeFile::machineName(std::uint16_t machine) {
+    switch (machine) {
+        case 0x014c: return "x86";
+        case 0x8664: return "x64";
+        case 0xaa64: return "arm64";
+        case 0x01c4: return "arm";
+        case 0xa641: return "arm64ec";
+        default:     return "machine-" + std::to_string(machine);
+    }
+}
+
+void PeFile::parse() {
+    if (m_size < 64 || u16(m_data) != Pe::kDosMagic) {
+        throw std::runtime_error("Not a PE file: " + m_path.string());
+    }
+    const std::uint64_t peOffset = u32(m_data + 0x3c);
+    if (!contains(peOffset, 24) || u32(m_data + peOffset) != Pe::kSignature) {
+        throw std::runtime_error("Not a PE file: " + m_path.string());
+    }
+
+    // The COFF file header follows the signature; the optional header follows that.
+    const std::uint8_t* coff = m_data + peOffset + 4;
+    m_machine = u16(coff);
+    const std::uint16_t sectionCount = u16(coff + 2);
+    const std::uint16_t optionalSize = u16(coff + 16);
+    m_characteristics = u16(coff + 18);
+    const std::uint64_t optionalOffset = peOffset + 24;
+    if (sectionCount > kMaxSections || !contains(optionalOffset, optionalSize)
+        || !contains(optionalOffset + optionalSize, std::uint64_t(sectionCount) * kSectionHeaderSize)) {
+        throw std::runtime_error("Malformed PE headers in: " + m_path.string());
+    }
+
+    const std::uint8_t* optional = m_data + optionalOffset;
+    if (optionalSize < 2) {
+        throw std::runtime_error("Object files have no imports to read: " + m_path.string());
+    }
+    const std::uint16_t magic = u16(optional);
+    if (magic != Pe::kOptionalMagic32 && magic != Pe::kOptionalMagic64) {
+        throw std::runtime_error("Unknown optional header magic in: " + m_path.string());
+    }
+    m_is64Bit = magic == Pe::kOptionalMagic64;
+    const std::uint32_t directoriesAt = m_is64Bit ? 112 : 96;
+    if (optionalSize < directoriesAt) {
+        throw std::runtime_error("Truncated optional header in: " + m_path.string());
+    }
+    m_imageBase = m_is64Bit ? u64(optional + 24) : u32(optional + 28);
+    m_sizeOfHeaders = u32(optional + 60);
+    const std::uint32_t directoryCount = std::min<std::uint32_t>(u32(optional + directoriesAt - 4),
+                                                                 (optionalSize - directoriesAt) / 8);
+
+    const std::uint8_t* table = optional + optionalSize;
+    for (std::uint16_t i = 0; i < sectionCount; ++i) {
+        const std::uint8_t* header = table + i * kSectionHeaderSize;
+        m_sections.push_back({ u32(header + 12), u32(header + 8), u32(header + 20), u32(header + 16) });
+    }
+
+    auto directory = [&](std::uint32_t index) -> std::uint32_t {
+        return index < directoryCount ? u32(optional + directoriesAt + index * 8) : 0;
+    };
+    if (std::uint32_t rva = directory(Pe::kDirectoryImport)) {
+        readImports(rva);
+    }
+    if (std::uint32_t rva = directory(Pe::kDirectoryDelayImport)) {
+        readDelayImports(rva);
+    }
+}
+
+void PeFile::readImports(std::uint32_t rva) {
+    // The table ends with an all-zero descriptor; linkers do not agree on whether the
+    // directory size counts it, so only the terminator is trusted.
+    for (std::size_t i = 0; i < kMaxImports; ++i) {
+        std::optional<std::uint64_t> at = offsetOf(rva + std::uint64_t(i) * kImportDescriptorSize);
+        if (!at || !contains(*at, kImportDescriptorSize)) {
+            throw std::runtime_error("Import directory runs past the end of: " + m_path.string());
+        }
+        const std::uint8_t* descriptor = m_data + *at;
+        const std::uint32_t nameRva = u32(descriptor + 12);
+        if (nameRva == 0 && u32(descriptor + 16) == 0) {
+            return;
+        }
+        addImport(stringAt(nameRva), false);
+    }
+}
+
+void PeFile::readDelayImports(std::uint32_t rva) {
+    for (std::size_t i = 0; i < kMaxImports; ++i) {
+        std::optional<std::uint64_t> at = offsetOf(rva + std::uint64_t(i) * kDelayDescriptorSize);
+        if (!at || !contains(*at, kDelayDescriptorSize)) {
+            throw std::runtime_error("Delay-import directory runs past the end of: " + m_path.string());
+        }
+        const std::uint8_t* descriptor = m_data + *at;
+        const std::uint32_t attributes = u32(descriptor);
+        std::uint64_t nameRva = u32(descriptor + 4);
+        if (nameRva == 0) {
+            return;
+        }
+        // Descriptors from before Visual C++ 7 hold virtual addresses rather than RVAs.
+        if ((attributes & 1) == 0 && nameRva >= m_imageBase) {
+            nameRva -= m_imageBase;
+        }
+        addImport(stringAt(nameRva), true);
+    }
+}
+
+void PeFile::addImport(std::string name, bool delayed) {
+    auto same = [&](const PeImport& import) { return equalsIgnoreCase(import.name, name); };
+    if (std::none_of(m_imports.begin(), m_imports.end(), same)) {
+        m_imports.push_back({ std::move(name), delayed });
+    }
+}
+
+std::optional<std::uint64_t> PeFile::offsetOf(std::uint64_t rva) const {
+    if (rva < m_sizeOfHeaders) {
+        return rva;
+    }
+    for (const PeSection& section : m_sections) {
+        const std::uint64_t extent = std::max(section.virtualSize, section.rawSize);
+        if (rva >= section.virtualAddress && rva - section.virtualAddress < extent) {
+            const std::uint64_t delta = rva - section.virtualAddress;
+            // Past the raw data the section is zero-filled in memory and absent from the file.
+            return delta < section.rawSize ? std::optional<std::uint64_t>(section.rawOffset + delta) : std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string PeFile::stringAt(std::uint64_t rva) const {
+    std::optional<std::uint64_t> at = offsetOf(rva);
+    if (!at || *at >= m_size) {
+        throw std::runtime_error("Imported DLL name lies outside " + m_path.string());
+    }
+    const char* first = reinterpret_cast<const char*>(m_data + *at);
+    const char* last = first + std::min<std::uint64_t>(m_size - *at, kMaxNameLength);
+    const char* end = std::find(first, last, '\0');
+    if (end == last || end == first) {
+        throw std::runtime_error("Malformed imported DLL name in: " + m_path.string());
+    }
+    return std::string(first, end);
+}
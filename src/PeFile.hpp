@@ -0,0 +1,122 @@
+// src/PeFile.hpp
+#ifndef RELOCATOR_PEFILE_HPP
+#define RELOCATOR_PEFILE_HPP
+
+#include "MappedFile.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @namespace Pe
+ * @brief The PE/COFF constants the parser needs, so it does not depend on <windows.h>.
+ */
+namespace Pe {
+    constexpr std::uint16_t kDosMagic = 0x5a4d;          // "MZ"
+    constexpr std::uint32_t kSignature = 0x00004550;     // "PE\0\0"
+    constexpr std::uint16_t kOptionalMagic32 = 0x10b;    // PE32
+    constexpr std::uint16_t kOptionalMagic64 = 0x20b;    // PE32+
+
+    constexpr std::uint16_t kFileDll = 0x2000;           // IMAGE_FILE_DLL
+
+    constexpr std::uint32_t kDirectoryImport = 1;
+    constexpr std::uint32_t kDirectoryDelayImport = 13;
+} // namespace Pe
+
+/**
+ * @struct PeImport
+ * @brief A DLL named by the import or delay-import directory.
+ */
+struct PeImport {
+    std::string name;            // As the directory spells it, e.g. "KERNEL32.dll"
+    bool delayed = false;        // Loaded on first call rather than at startup
+};
+
+/**
+ * @struct PeSection
+ * @brief Where one section's data lies in memory and in the file.
+ */
+struct PeSection {
+    std::uint32_t virtualAddress = 0;
+    std::uint32_t virtualSize = 0;
+    std::uint32_t rawOffset = 0;
+    std::uint32_t rawSize = 0;
+};
+
+/**
+ * @class PeFile
+ * @brief An in-process, read-only parser for PE32 and PE32+ executables and DLLs.
+ *
+ * Like ElfFile and MachOFile, the file is memory-mapped and decoded field by field,
+ * so Windows binaries can be inspected on any host. Only what bundling needs is
+ * read: the headers, the section table and the names of imported DLLs.
+ */
+class PeFile {
+public:
+    /**
+     * Maps and parses a PE file.
+     * @throws std::runtime_error if the file cannot be read or is not a well-formed PE image.
+     */
+    explicit PeFile(const std::filesystem::path& path);
+
+    /**
+     * Parses an image already in memory. The buffer is not copied and must outlive this object.
+     * @param name A name used in error messages.
+     */
+    PeFile(const std::uint8_t* data, std::size_t size, const std::filesystem::path& name);
+
+    /**
+     * Checks the MZ and PE signatures of a file without parsing the rest of it.
+     */
+    static bool isPe(const std::filesystem::path& path);
+
+    /**
+     * Returns a readable name for a COFF machine type (e.g. "x64").
+     */
+    static std::string machineName(std::uint16_t machine);
+
+    const std::filesystem::path& path() const { return m_path; }
+    std::size_t size() const { return m_size; }
+
+    std::uint16_t machine() const { return m_machine; }
+    bool is64Bit() const { return m_is64Bit; }
+    bool isDll() const { return (m_characteristics & Pe::kFileDll) != 0; }
+    const std::vector<PeSection>& sections() const { return m_sections; }
+
+    /**
+     * Every DLL the image imports, each name once (compared case-insensitively):
+     * the import directory first, then the delay-import directory, in table order.
+     */
+    const std::vector<PeImport>& imports() const { return m_imports; }
+
+private:
+    void parse();
+    void readImports(std::uint32_t rva);
+    void readDelayImports(std::uint32_t rva);
+    void addImport(std::string name, bool delayed);
+    std::optional<std::uint64_t> offsetOf(std::uint64_t rva) const;
+    std::string stringAt(std::uint64_t rva) const;
+    bool contains(std::uint64_t offset, std::uint64_t length) const {
+        return offset <= m_size && length <= m_size - offset;
+    }
+
+    std::filesystem::path m_path;
+    std::unique_ptr<MappedFile> m_file;      // Null when parsing a caller-owned buffer
+    const std::uint8_t* m_data = nullptr;
+    std::size_t m_size = 0;
+
+    std::uint16_t m_machine = 0;
+    std::uint16_t m_characteristics = 0;
+    bool m_is64Bit = false;
+    std::uint64_t m_imageBase = 0;
+    std::uint32_t m_sizeOfHeaders = 0;
+    std::vector<PeSection> m_sections;
+    std::vector<PeImport> m_imports;
+};
+
+#endif //RELOCATOR_PEFILE_HPP
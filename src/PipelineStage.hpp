@@ -0,0 +1,193 @@
+// src/PipelineStage.hpp
+#ifndef RELOCATOR_PIPELINESTAGE_HPP
+#define RELOCATOR_PIPELINESTAGE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @struct StageStats
+ * @brief Throughput figures for one pipeline stage.
+ */
+struct StageStats {
+    std::string name;
+    unsigned workers = 0;
+    std::uint64_t items = 0;
+    std::uint64_t bytes = 0;
+    double busySeconds = 0;     // Sum of time spent inside the work function, across workers
+    double wallSeconds = 0;     // From the first item starting to the last item finishing
+
+    void print(std::ostream& out) const {
+        out << "  " << std::left << std::setw(8) << name << std::right
+            << items << " files";
+        if (bytes > 0) {
+            out << ", " << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0) << " MiB";
+        }
+        out << " in " << std::fixed << std::setprecision(3) << wallSeconds << " s";
+        if (wallSeconds > 0) {
+            out << " (" << std::setprecision(1) << items / wallSeconds << " files/s";
+            if (bytes > 0) {
+                out << ", " << bytes / (1024.0 * 1024.0) / wallSeconds << " MiB/s";
+            }
+            out << ", " << workers << (workers == 1 ? " worker " : " workers ") << std::setprecision(0)
+                << 100.0 * busySeconds / (wallSeconds * workers) << "% busy)";
+        }
+        out << std::defaultfloat << std::setprecision(6) << "\n";
+    }
+};
+
+/**
+ * @class PipelineStage
+ * @brief A bounded queue drained by its own pool of worker threads.
+ *
+ * push() blocks while the queue is full, so a slow stage applies backpressure
+ * to whatever feeds it. A failing item does not stop the stage; the first
+ * exception is kept and rethrown by join() once every item has been drained.
+ */
+template <typename T>
+class PipelineStage {
+public:
+    using Work = std::function<void(T&)>;
+
+    PipelineStage(std::string name, unsigned workers, std::size_t capacity, Work work)
+        : m_work(std::move(work)), m_capacity(std::max<std::size_t>(1, capacity)) {
+        if (workers == 0) {
+            workers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        m_stats.name = std::move(name);
+        m_stats.workers = workers;
+        for (unsigned i = 0; i < workers; ++i) {
+            m_threads.emplace_back([this] { run(); });
+        }
+    }
+
+    ~PipelineStage() {
+        close();
+        for (auto& thread : m_threads) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+    }
+
+    PipelineStage(const PipelineStage&) = delete;
+    PipelineStage& operator=(const PipelineStage&) = delete;
+
+    /**
+     * Queues an item, blocking while the stage is at capacity.
+     */
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this] { return m_queue.size() < m_capacity; });
+        m_queue.push_back(std::move(item));
+        m_notEmpty.notify_one();
+    }
+
+    /**
+     * Signals that no more items will be pushed.
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+    }
+
+    /**
+     * Waits for the workers to drain the queue after close().
+     * @throws The first exception thrown by the work function.
+     */
+    void join() {
+        for (auto& thread : m_threads) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+        if (m_error) {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+    /**
+     * Adds to the stage's byte counter; call from inside the work function.
+     */
+    void addBytes(std::uint64_t bytes) {
+        m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    StageStats stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        StageStats stats = m_stats;
+        stats.bytes = m_bytes.load();
+        if (stats.items > 0) {
+            stats.wallSeconds = std::chrono::duration<double>(m_lastEnd - m_firstStart).count();
+        }
+        return stats;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void run() {
+        for (;;) {
+            T item;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_notEmpty.wait(lock, [this] { return m_closed || !m_queue.empty(); });
+                if (m_queue.empty()) {
+                    return;
+                }
+                item = std::move(m_queue.front());
+                m_queue.pop_front();
+                m_notFull.notify_one();
+            }
+
+            const auto start = Clock::now();
+            try {
+                m_work(item);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_error) {
+                    m_error = std::current_exception();
+                }
+            }
+            const auto end = Clock::now();
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stats.items++ == 0 || start < m_firstStart) {
+                m_firstStart = start;
+            }
+            m_lastEnd = std::max(m_lastEnd, end);
+            m_stats.busySeconds += std::chrono::duration<double>(end - start).count();
+        }
+    }
+
+    Work m_work;
+    const std::size_t m_capacity;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::deque<T> m_queue;
+    bool m_closed = false;
+    std::exception_ptr m_error;
+
+    std::vector<std::thread> m_threads;
+    StageStats m_stats;
+    std::atomic<std::uint64_t> m_bytes{0};
+    Clock::time_point m_firstStart{};
+    Clock::time_point m_lastEnd{};
+};
+
+#endif //RELOCATOR_PIPELINESTAGE_HPP
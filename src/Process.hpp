@@ -1,66 +1,333 @@
 #ifndef RELOCATOR_PROCESS_HPP
 #define RELOCATOR_PROCESS_HPP
 
-#include <string>
-#include <vector>
-#include <iostream>
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
 
 /**
  * @struct CommandResult
- * @brief Holds the output and exit status of an executed shell command.
+ * @brief Holds the output and exit status of an executed command.
  */
 struct CommandResult {
-    std::string output;
-    int exitStatus;
+    std::string output;         // stdout, without its trailing newline
+    std::string errorOutput;    // stderr
+    int exitStatus = 0;         // Exit code, or 128 + signal number if the child was killed
+    bool timedOut = false;
+    double wallSeconds = 0;     // From spawn to exit
+    double cpuSeconds = 0;      // User plus system time of the child, where the platform reports it
+    std::uint64_t peakRssBytes = 0;
 };
 
 /**
  * @class Process
- * @brief A utility class for executing external shell commands.
+ * @brief Runs external tools directly from an argument vector, without a shell.
+ *
+ * Arguments are passed to the child as-is, so paths containing spaces, quotes or '$'
+ * need no escaping. stdout and stderr are captured separately and stdin is /dev/null.
  */
 class Process {
 public:
+    using Timeout = std::chrono::milliseconds;
+    using Environment = std::vector<std::string>;   // "NAME=value" entries
+
+    /**
+     * Runs a program and waits for it to exit. The program is looked up in PATH.
+     * @param argv The program followed by its arguments.
+     * @param timeout Kill the child after this long; zero waits forever.
+     * @param environment The child's whole environment; nothing means it inherits ours.
+     * @throws std::runtime_error if the program cannot be started, and always on Windows.
+     */
+    static CommandResult run(const std::vector<std::string>& argv, Timeout timeout = Timeout::zero(),
+                             const std::optional<Environment>& environment = std::nullopt) {
+        if (argv.empty()) {
+            throw std::invalid_argument("Process::run called without a program");
+        }
+        CommandResult result = spawnAndWait(argv, timeout, environment);
+        // Trim trailing newline if it exists
+        if (!result.output.empty() && result.output.back() == '\n') {
+            result.output.pop_back();
+        }
+        return result;
+    }
+
     /**
-     * Executes a system command and captures its standard output.
-     * @param command The command string to execute.
-     * @return A CommandResult struct containing the output and exit status.
-     * @throws std::runtime_error if popen() fails.
+     * Formats an argument vector for log lines, quoting only where a shell would need it.
      */
-    static CommandResult exec(const std::string& command) {
-        int exitcode = 0;
-        std::string result;
-        std::array<char, 128> buffer{};
+    static std::string describe(const std::vector<std::string>& argv) {
+        std::string line;
+        for (const auto& arg : argv) {
+            if (!line.empty()) line += ' ';
+            if (!arg.empty() && arg.find_first_of(" \t\"'$\\`") == std::string::npos) {
+                line += arg;
+                continue;
+            }
+            line += '"';
+            for (char c : arg) {
+                if (c == '"' || c == '\\' || c == '$' || c == '`') line += '\\';
+                line += c;
+            }
+            line += '"';
+        }
+        return line;
+    }
 
+private:
 #ifdef _WIN32
-        #define popen _popen
-#define pclose _pclose
+    // Only the Linux and macOS relocators run tools, so nothing here needs a Windows spawner yet.
+    // A shell pipe would not be shell-free and would drop the timeout, environment and stderr.
+    static CommandResult spawnAndWait(const std::vector<std::string>& argv, Timeout, const std::optional<Environment>&) {
+        throw std::runtime_error("Cannot start " + argv.front() + ": running external tools is not supported on Windows");
+    }
+#else
+    static void makePipe(int fds[2]) {
+#if defined(__linux__)
+        if (::pipe2(fds, O_CLOEXEC) != 0) {
+#else
+        if (::pipe(fds) != 0) {
 #endif
-
-        FILE* pipe = popen(command.c_str(), "r");
-        if (pipe == nullptr) {
-            throw std::runtime_error("popen() failed for command: " + command);
+            throw std::runtime_error(std::string("pipe() failed: ") + std::strerror(errno));
         }
+#if !defined(__linux__)
+        ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+    }
 
+    static CommandResult spawnAndWait(const std::vector<std::string>& argv, Timeout timeout,
+                                      const std::optional<Environment>& environment) {
+        int out[2], err[2];
+        makePipe(out);
         try {
-            while (fgets(buffer.data(), buffer.size(), pipe) != nullptr) {
-                result += buffer.data();
-            }
+            makePipe(err);
         } catch (...) {
-            pclose(pipe);
+            ::close(out[0]);
+            ::close(out[1]);
             throw;
         }
 
-        exitcode = pclose(pipe);
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+        posix_spawn_file_actions_adddup2(&actions, err[1], 2);
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+#ifdef POSIX_SPAWN_CLOEXEC_DEFAULT
+        // Other threads may be between pipe() and fcntl(); keep their descriptors out of this child.
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_CLOEXEC_DEFAULT);
+#endif
 
-        // Trim trailing newline if it exists
-        if (!result.empty() && result[result.length() - 1] == '\n') {
-            result.erase(result.length() - 1);
+        std::vector<char*> cargv;
+        for (const auto& arg : argv) {
+            cargv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        cargv.push_back(nullptr);
+        std::vector<char*> cenv;
+        if (environment) {
+            for (const auto& entry : *environment) {
+                cenv.push_back(const_cast<char*>(entry.c_str()));
+            }
+            cenv.push_back(nullptr);
+        }
+
+        pid_t pid = 0;
+        const auto spawned = std::chrono::steady_clock::now();
+        const int spawnError = ::posix_spawnp(&pid, cargv[0], &actions, &attr, cargv.data(),
+                                              environment ? cenv.data() : environ);
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attr);
+        ::close(out[1]);
+        ::close(err[1]);
+        if (spawnError != 0) {
+            ::close(out[0]);
+            ::close(err[0]);
+            throw std::runtime_error("Cannot start " + argv.front() + ": " + std::strerror(spawnError));
+        }
+
+        CommandResult result;
+        const auto deadline = spawned + timeout;
+        std::array<pollfd, 2> fds{ { { out[0], POLLIN, 0 }, { err[0], POLLIN, 0 } } };
+        std::array<std::string*, 2> sinks{ &result.output, &result.errorOutput };
+        std::vector<char> buffer(64 * 1024);
+        int open = 2;
+        while (open > 0) {
+            int wait = -1;
+            if (timeout != Timeout::zero()) {
+                const auto left = std::chrono::duration_cast<Timeout>(deadline - std::chrono::steady_clock::now());
+                if (left <= Timeout::zero()) {
+                    ::kill(pid, SIGKILL);
+                    result.timedOut = true;
+                    break;
+                }
+                wait = static_cast<int>(std::min<Timeout::rep>(left.count() + 1, 60 * 1000));
+            }
+            if (::poll(fds.data(), fds.size(), wait) < 0) {
+                if (errno == EINTR) continue;
+                ::kill(pid, SIGKILL);
+                break;
+            }
+            for (std::size_t i = 0; i < fds.size(); ++i) {
+                if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                    continue;
+                }
+                const ssize_t n = ::read(fds[i].fd, buffer.data(), buffer.size());
+                if (n > 0) {
+                    sinks[i]->append(buffer.data(), static_cast<std::size_t>(n));
+                } else if (n == 0 || errno != EINTR) {
+                    ::close(fds[i].fd);
+                    fds[i].fd = -1;     // poll() ignores negative descriptors
+                    --open;
+                }
+            }
+        }
+        for (const auto& fd : fds) {
+            if (fd.fd >= 0) ::close(fd.fd);
         }
 
-        return CommandResult{result, exitcode};
+        int status = 0;
+        struct rusage usage{};
+        while (::wait4(pid, &status, 0, &usage) < 0 && errno == EINTR) {
+        }
+        result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - spawned).count();
+        result.cpuSeconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+                          + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#ifdef __APPLE__
+        result.peakRssBytes = static_cast<std::uint64_t>(usage.ru_maxrss);          // bytes
+#else
+        result.peakRssBytes = static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;   // KiB
+#endif
+        result.exitStatus = WIFEXITED(status) ? WEXITSTATUS(status)
+                          : WIFSIGNALED(status) ? 128 + WTERMSIG(status) : -1;
+        return result;
+    }
+#endif
+};
+
+/**
+ * @class ProcessRunner
+ * @brief Runs many external commands at once, with at most a fixed number alive.
+ *
+ * Commands are queued and started in submission order as slots free up. Worker
+ * threads are only created once work arrives, so an unused runner costs nothing.
+ * The destructor waits for everything already submitted.
+ */
+class ProcessRunner {
+public:
+    /**
+     * @param maxConcurrent Children allowed to run at the same time; 0 means one per hardware thread.
+     */
+    explicit ProcessRunner(unsigned maxConcurrent = 0)
+        : m_limit(maxConcurrent ? maxConcurrent : std::max(1u, std::thread::hardware_concurrency())) {}
+
+    ~ProcessRunner() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (auto& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    ProcessRunner(const ProcessRunner&) = delete;
+    ProcessRunner& operator=(const ProcessRunner&) = delete;
+
+    unsigned limit() const { return m_limit; }
+
+    /**
+     * Queues a command.
+     * @return A future for its result; get() rethrows if the program could not be started.
+     */
+    std::future<CommandResult> submit(std::vector<std::string> argv, Process::Timeout timeout = Process::Timeout::zero()) {
+        auto task = std::make_shared<std::packaged_task<CommandResult()>>(
+            [argv = std::move(argv), timeout] { return Process::run(argv, timeout); });
+        std::future<CommandResult> result = task->get_future();
+        enqueue([task] { (*task)(); });
+        return result;
     }
+
+    /**
+     * Queues a command and calls onExit with its result on a runner thread. A program
+     * that cannot be started is reported as exit status 127 with the reason in errorOutput.
+     * onExit must not throw.
+     */
+    void submit(std::vector<std::string> argv, std::function<void(CommandResult)> onExit,
+                Process::Timeout timeout = Process::Timeout::zero(),
+                std::optional<Process::Environment> environment = std::nullopt) {
+        enqueue([argv = std::move(argv), onExit = std::move(onExit), timeout, environment = std::move(environment)] {
+            CommandResult result;
+            try {
+                result = Process::run(argv, timeout, environment);
+            } catch (const std::exception& e) {
+                result.exitStatus = 127;
+                result.errorOutput = e.what();
+            }
+            onExit(std::move(result));
+        });
+    }
+
+private:
+    void enqueue(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(std::move(job));
+            if (m_jobs.size() > m_idle && m_workers.size() < m_limit) {
+                m_workers.emplace_back([this] { work(); });
+            }
+        }
+        m_wake.notify_one();
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            ++m_idle;
+            m_wake.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            --m_idle;
+            if (m_jobs.empty()) {
+                return;     // Stopping, and the queue has drained
+            }
+            std::function<void()> job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            lock.unlock();
+            job();
+            lock.lock();
+        }
+    }
+
+    const unsigned m_limit;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<std::function<void()>> m_jobs;
+    std::vector<std::thread> m_workers;
+    unsigned m_idle = 0;
+    bool m_stopping = false;
 };
 
 #endif //RELOCATOR_PROCESS_HPP
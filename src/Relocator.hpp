@@ -1,38 +1,261 @@
 #ifndef RELOCATOR_RELOCATOR_HPP
 #define RELOCATOR_RELOCATOR_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
 #include <string>
 #include <vector>
 
+#include "DependencyGraph.hpp"
+#include "ExclusionPolicy.hpp"
+#include "FileCopier.hpp"
+#include "RunStats.hpp"
+
+/**
+ * @enum StripMode
+ * @brief What the copy stage removes from bundled ELF files.
+ */
+enum class StripMode {
+    None,     // Copy files as they are
+    Debug,    // Drop DWARF and other debugging sections, like `strip --strip-debug`
+    All       // Also drop .symtab and its string table, like `strip --strip-all`
+};
+
+/**
+ * @enum PruneMode
+ * @brief What happens to DT_NEEDED entries that satisfy none of an object's imports.
+ */
+enum class PruneMode {
+    Off,      // Bundle every dependency an object names
+    Report,   // List them in the log and BundleResult::unused, and bundle them anyway
+    Drop      // Remove them from the bundled copies, and bundle only what is still needed
+};
+
+/**
+ * @struct RelocatorOptions
+ * @brief Settings that apply to a whole relocation run.
+ */
+struct RelocatorOptions {
+    bool dryRun = false;
+    unsigned jobs = 1;        // Worker threads for dependency discovery; 0 = one per hardware thread
+    unsigned copyJobs = 4;    // Worker threads for the copy stage
+    unsigned fixupJobs = 0;   // Worker threads for each of the fixup and verify stages; 0 = one per hardware thread
+    size_t queueDepth = 64;   // Files a stage may have queued before its producers block
+    CopyMode copyMode = CopyMode::Auto;
+    StripMode strip = StripMode::None;           // ELF bundles only; applied while copying
+    std::filesystem::path splitDebugDir;         // Keep what is stripped here, mirroring the bundle; implies StripMode::Debug
+    PruneMode pruneUnused = PruneMode::Off;      // ELF bundles only; see DependencyPruner
+    std::vector<std::string> keepNeeded;         // Library filename patterns never pruned, on top of the built-in ones
+    bool hwcapVariants = true;                   // ELF bundles only; also bundle the glibc-hwcaps builds of each library
+    std::filesystem::path storeDir;              // ELF bundles only; write each patched file once here and link to it (see LibraryStore)
+    bool scanCache = true;                       // Reuse parsed metadata across runs
+    std::filesystem::path scanCacheDir;          // Empty = $XDG_CACHE_HOME/relocator
+    std::uint64_t scanCacheMaxBytes = 64 << 20;
+    size_t statsSlowest = 5;                     // Slowest files each phase keeps for the statistics
+    bool loadCheck = true;                       // Test-load the bundle once it is built (see BundleResult::loadChecks)
+    unsigned profileLoadRuns = 0;                // Then load the first input this many times and time each library (Linux only)
+    std::ostream* log = nullptr;                 // Progress messages; nullptr = quiet
+    std::ostream* errorLog = nullptr;            // Warnings and failures as they happen; nullptr = quiet
+    TargetPlatform target = TargetPlatform::Host;   // The platform whose binaries are bundled
+};
+
+/**
+ * @struct BundleInput
+ * @brief One root object to bundle and where it goes inside the output directory.
+ */
+struct BundleInput {
+    std::filesystem::path file;          // The object to process
+    std::filesystem::path bundlePath;    // Relative to the output directory, e.g. "plugins/platforms/libqxcb.so"
+};
+
+/**
+ * @struct BundledFile
+ * @brief One file of a finished bundle.
+ */
+struct BundledFile {
+    std::filesystem::path source;        // Canonical path of the original
+    std::filesystem::path bundlePath;    // Relative to the output directory
+    bool root = false;                   // One of the inputs rather than a dependency
+    bool upToDate = false;               // Kept from the previous run without being copied or patched
+};
+
+/**
+ * @struct LoadCheck
+ * @brief How the platform's loader resolved one bundled object when it was test-loaded.
+ */
+struct LoadCheck {
+    std::filesystem::path bundlePath;               // Relative to the output directory
+    bool passed = false;
+    std::vector<std::string> missing;               // Libraries the loader could not find
+    std::vector<std::filesystem::path> outside;     // Found outside the bundle, and not allowed by an exclusion
+    std::string error;                              // Anything else the loader reported
+};
+
+/**
+ * @struct LibraryLoadTime
+ * @brief What loading one bundled object cost, once the objects it needs were loaded.
+ */
+struct LibraryLoadTime {
+    std::filesystem::path bundlePath;               // Relative to the output directory
+    double seconds = 0;                             // Median over the runs, of the three phases below together
+    double mapSeconds = 0;                          // Finding and mapping it, and any system library it brought in
+    double relocateSeconds = 0;
+    double initSeconds = 0;                         // Its constructors; 0 where they could not be told from relocation
+    bool split = false;                             // Relocation and constructors were timed apart
+    std::uint64_t relocations = 0;                  // Entries of its dynamic relocation tables
+    std::uint64_t symbolLookups = 0;                // ... that name a symbol the loader must look up
+    std::vector<std::string> alsoLoaded;            // Libraries from outside the bundle that it brought in
+};
+
+/**
+ * @struct LoadProfile
+ * @brief How the first input loads from the finished bundle (RelocatorOptions::profileLoadRuns).
+ */
+struct LoadProfile {
+    unsigned runs = 0;                              // Completed runs the medians are taken over
+    double seconds = 0;                             // Median time to load everything, and its phases
+    double mapSeconds = 0;
+    double relocateSeconds = 0;
+    double initSeconds = 0;
+    std::uint64_t loaderRelocations = 0;            // As LD_DEBUG=statistics counts them, for the whole probe process
+    std::uint64_t loaderCachedLookups = 0;          // ... and how many lookups its one-entry cache answered
+    std::vector<LibraryLoadTime> libraries;         // Slowest first
+    std::string error;                              // Why profiling failed, if it did
+};
+
+/**
+ * @struct UnusedDependency
+ * @brief A DT_NEEDED entry that none of its object's imports resolve to.
+ */
+struct UnusedDependency {
+    std::filesystem::path object;        // Canonical path of the object naming it
+    std::string soname;                  // The entry
+    std::filesystem::path library;       // Canonical path of the library it resolved to
+    bool dropped = false;                // Removed from the bundled copy (PruneMode::Drop)
+};
+
+/**
+ * @struct BundleResult
+ * @brief What a bundleDependencies call did, for callers that do not parse the log.
+ */
+struct BundleResult {
+    std::vector<BundledFile> files;      // Ordered by source path
+    std::vector<std::string> warnings;   // Every warning the log would show, without the "Warning: " prefix
+    std::vector<std::string> removed;    // Stale files of the previous run, relative to the output directory
+    bool loadChecked = false;            // The bundle was test-loaded (never in a dry run or without loadCheck)
+    std::string loadError;               // The loader's error, or a summary if any object failed
+    std::vector<LoadCheck> loadChecks;   // Per object, where the platform checks every one; ordered by bundle path
+    std::vector<UnusedDependency> unused;   // With PruneMode other than Off; ordered by object, then soname
+    bool loadProfiled = false;           // profileLoadRuns was set and the bundle was profiled
+    LoadProfile loadProfile;
+};
+
+/**
+ * @class RelocatorCache
+ * @brief Metadata a platform relocator keeps warm between runs.
+ *
+ * Each platform derives its own; a relocator given a cache of another type starts a
+ * fresh one. One cache may be shared by relocators running concurrently.
+ */
+class RelocatorCache {
+public:
+    virtual ~RelocatorCache() = default;
+};
+
 /**
  * @class Relocator
  * @brief Abstract base class defining the interface for a platform-specific dependency bundler.
  */
 class Relocator {
 public:
-    explicit Relocator(bool dryRun) : m_dryRun(dryRun) {}
+    explicit Relocator(const RelocatorOptions& options, std::shared_ptr<RelocatorCache> cache = nullptr)
+        : m_options(options), m_dryRun(options.dryRun), m_cache(std::move(cache)), m_stats(options.statsSlowest),
+          m_log(options.log ? *options.log : m_discard),
+          m_errorLog(options.errorLog ? *options.errorLog : m_discard) {}
     virtual ~Relocator() = default;
 
     /**
-     * The main entry point. Analyzes an input file, finds its dependencies,
-     * copies them to an output directory, and fixes their linkage.
-     * @param inputFile The primary executable or library to process.
+     * Per-phase timings and counters of the last bundleDependencies call.
+     */
+    const RunStats& stats() const { return m_stats; }
+
+    /**
+     * The files bundled by the last bundleDependencies call and how they depend on each other.
+     */
+    const DependencyGraph& graph() const { return m_graph; }
+
+    /**
+     * The files, warnings and load check of the last bundleDependencies call.
+     */
+    const BundleResult& result() const { return m_result; }
+
+    /**
+     * The warm metadata this relocator uses; pass it to another relocator to share it.
+     */
+    const std::shared_ptr<RelocatorCache>& cache() const { return m_cache; }
+
+    /**
+     * The main entry point. Analyzes the input files, finds their dependencies,
+     * copies them to an output directory, and fixes their linkage. All roots share
+     * one dependency graph, so a library needed by several of them is handled once.
+     * @param inputs The roots to process; the first one is the primary executable or library.
      * @param outputDir The directory where dependencies will be copied.
      * @param searchPaths A list of additional directories to search for libraries.
-     * @param literalExclusions A user-provided list of library filenames to ignore (exact match).
-     * @param regexExclusions A user-provided list of regex patterns to ignore library filenames.
+     * @param exclusions The compiled rules for libraries to leave out of the bundle.
      */
     virtual void bundleDependencies(
-        const std::filesystem::path& inputFile,
+        const std::vector<BundleInput>& inputs,
         const std::filesystem::path& outputDir,
         const std::vector<std::string>& searchPaths,
-        const std::vector<std::string>& literalExclusions,
-        const std::vector<std::string>& regexExclusions
+        const ExclusionPolicy& exclusions
     ) = 0;
 
 protected:
+    /**
+     * Resets the statistics, graph and result; the first thing each run does.
+     */
+    void beginRun() {
+        m_stats.start();
+        m_graph.clear();
+        m_result = BundleResult();
+    }
+
+    /**
+     * Records a warning in the result. Thread-safe.
+     * @return "Warning: " followed by message, for the log.
+     */
+    std::string warning(const std::string& message) {
+        std::lock_guard<std::mutex> lock(m_resultMutex);
+        m_result.warnings.push_back(message);
+        return "Warning: " + message;
+    }
+
+    RelocatorOptions m_options;
     bool m_dryRun;
+    std::shared_ptr<RelocatorCache> m_cache;   // Of the platform's own type; null where nothing is kept
+    RunStats m_stats;
+    DependencyGraph m_graph;   // Cleared at the start of each run and frozen once discovery ends
+    BundleResult m_result;
+    std::mutex m_resultMutex;
+    std::ostream& m_log;
+    std::ostream& m_errorLog;
+
+private:
+    // Accepts and drops everything, so writing never fails and never changes the stream's state.
+    struct DiscardBuffer : std::streambuf {
+        int overflow(int c) override { return traits_type::not_eof(c); }
+        std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+    };
+
+    // Where m_log and m_errorLog go when the options give them no stream. Each relocator
+    // has its own, so concurrent sessions (e.g. under --serve) never share stream state.
+    DiscardBuffer m_discardBuffer;
+    std::ostream m_discard{ &m_discardBuffer };
 };
 
 #endif //RELOCATOR_RELOCATOR_HPP
\ No newline at end of file
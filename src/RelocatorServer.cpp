@@ -0,0 +1,295 @@
+// src/RelocatorServer.cpp
+#include "RelocatorServer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// The signal handler can only reach the server through a global.
+volatile std::sig_atomic_t g_wakeFd = -1;
+
+extern "C" void onStopSignal(int) {
+    const int saved = errno;
+    if (g_wakeFd >= 0) {
+        const char byte = 0;
+        (void)!::write(g_wakeFd, &byte, 1);
+    }
+    errno = saved;
+}
+
+std::runtime_error socketError(const std::string& what, const std::filesystem::path& socketPath) {
+    return std::runtime_error(what + " " + socketPath.string() + ": " + std::strerror(errno));
+}
+
+sockaddr_un socketAddress(const std::filesystem::path& socketPath) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    const std::string& native = socketPath.native();
+    if (native.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path is too long (at most " + std::to_string(sizeof(address.sun_path) - 1)
+                                 + " bytes): " + native);
+    }
+    std::memcpy(address.sun_path, native.c_str(), native.size() + 1);
+    return address;
+}
+
+int newSocket() {
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0) {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+        const int on = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    }
+    return fd;
+}
+
+// @return A connected socket, or -1 with errno set.
+int connectTo(const std::filesystem::path& socketPath) {
+    const sockaddr_un address = socketAddress(socketPath);
+    const int fd = newSocket();
+    if (fd < 0) {
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        const int saved = errno;
+        ::close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+bool sameUser(int fd) {
+#if defined(SO_PEERCRED)
+    ucred credentials{};
+    socklen_t length = sizeof(credentials);
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 && credentials.uid == ::geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return ::getpeereid(fd, &uid, &gid) == 0 && uid == ::geteuid();
+#endif
+}
+
+} // namespace
+
+RelocatorServer::RelocatorServer(const std::filesystem::path& socketPath, const RelocatorOptions& defaults,
+                                 unsigned workers, std::ostream& log)
+    : m_socketPath(socketPath), m_defaults(defaults),
+      m_workers(workers ? workers : std::max(1u, std::thread::hardware_concurrency())), m_log(log),
+      m_cache(createPlatformRelocator(defaults)->cache()) {
+    const sockaddr_un address = socketAddress(m_socketPath);
+
+    // A socket file nobody answers on was left by a server that died; anything else is not ours to replace.
+    struct stat info;
+    if (::lstat(m_socketPath.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            throw std::runtime_error("Not a socket, refusing to replace it: " + m_socketPath.string());
+        }
+        const int probe = connectTo(m_socketPath);
+        if (probe >= 0) {
+            ::close(probe);
+            throw std::runtime_error("A relocator server is already listening on " + m_socketPath.string());
+        }
+        ::unlink(m_socketPath.c_str());
+    }
+
+    m_listenFd = newSocket();
+    if (m_listenFd < 0) {
+        throw socketError("Cannot create socket", m_socketPath);
+    }
+    // Created private: the server reads and writes anything its user can.
+    const mode_t previous = ::umask(0177);
+    const int bound = ::bind(m_listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    ::umask(previous);
+    if (bound != 0 || ::listen(m_listenFd, 64) != 0) {
+        const int saved = errno;
+        ::close(m_listenFd);
+        errno = saved;
+        throw socketError("Cannot listen on", m_socketPath);
+    }
+    if (::pipe(m_wakeFds) != 0) {
+        ::close(m_listenFd);
+        ::unlink(m_socketPath.c_str());
+        throw std::runtime_error(std::string("Cannot create a pipe: ") + std::strerror(errno));
+    }
+    for (int fd : m_wakeFds) {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+}
+
+RelocatorServer::~RelocatorServer() {
+    ::close(m_listenFd);
+    ::unlink(m_socketPath.c_str());
+    ::close(m_wakeFds[0]);
+    ::close(m_wakeFds[1]);
+}
+
+void RelocatorServer::run() {
+    g_wakeFd = m_wakeFds[1];
+    struct sigaction action{};
+    action.sa_handler = onStopSignal;
+    sigemptyset(&action.sa_mask);
+    struct sigaction previousInt, previousTerm;
+    ::sigaction(SIGINT, &action, &previousInt);
+    ::sigaction(SIGTERM, &action, &previousTerm);
+
+    m_log << "Serving on " << m_socketPath.string() << " with " << m_workers << " workers." << std::endl;
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < m_workers; ++i) {
+        workers.emplace_back(&RelocatorServer::work, this);
+    }
+
+    pollfd fds[2] = { { m_listenFd, POLLIN, 0 }, { m_wakeFds[0], POLLIN, 0 } };
+    while (true) {
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(m_logMutex);
+            m_log << "poll failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+        const int fd = ::accept(m_listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        // A client that connects and never finishes its request must not hold a worker forever.
+        const timeval timeout{ 30, 0 };
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (!sameUser(fd)) {
+            ::close(fd);
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connections.push_back(fd);
+        m_ready.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_ready.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    ::sigaction(SIGINT, &previousInt, nullptr);
+    ::sigaction(SIGTERM, &previousTerm, nullptr);
+    g_wakeFd = -1;
+    m_log << "Server stopped." << std::endl;
+}
+
+void RelocatorServer::stop() {
+    const char byte = 0;
+    (void)!::write(m_wakeFds[1], &byte, 1);
+}
+
+void RelocatorServer::work() {
+    while (true) {
+        int fd;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_ready.wait(lock, [&] { return m_stopping || !m_connections.empty(); });
+            if (m_connections.empty()) {
+                return;
+            }
+            fd = m_connections.front();
+            m_connections.pop_front();
+        }
+        handle(fd);
+    }
+}
+
+void RelocatorServer::handle(int fd) {
+    ServeChannel channel(fd);
+    ServeRequest request;
+    try {
+        request = channel.receiveRequest();
+    } catch (const std::exception& e) {
+        channel.send("err", std::string(e.what()) + "\n");
+        channel.send("exit", "2");
+        return;
+    }
+    if (request.command == ServeRequest::Command::Ping) {
+        channel.send("exit", "0");
+        return;
+    }
+    if (request.command == ServeRequest::Command::Shutdown) {
+        channel.send("out", "Server shutting down.\n");
+        channel.send("exit", "0");
+        stop();
+        return;
+    }
+
+    RelocatorOptions options = request.options;
+#if !defined(__linux__)
+    options.loadCheck = false;
+#endif
+    options.scanCache = options.scanCache && m_defaults.scanCache;
+    options.scanCacheDir = m_defaults.scanCacheDir;
+    options.scanCacheMaxBytes = m_defaults.scanCacheMaxBytes;
+
+    const auto start = std::chrono::steady_clock::now();
+    int code;
+    {
+        ChannelStreamBuf outBuffer(channel, "out"), errBuffer(channel, "err");
+        std::ostream out(&outBuffer), err(&errBuffer);
+        code = runBundleJob(request.job, options, out, err, m_cache);
+    }
+    channel.send("exit", std::to_string(code));
+
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(m_logMutex);
+    m_log << (request.job.request.inputs.empty() ? std::string("(no input)") : request.job.request.inputs.front())
+          << " -> " << request.job.request.outputDir.string() << ": exit " << code << " in "
+          << std::fixed << std::setprecision(1) << milliseconds << " ms" << std::endl;
+}
+
+int RelocatorServer::send(const std::filesystem::path& socketPath, const ServeRequest& request,
+                          std::ostream& out, std::ostream& err) {
+    const int fd = connectTo(socketPath);
+    if (fd < 0) {
+        throw socketError("No relocator server is listening on", socketPath);
+    }
+    ServeChannel channel(fd);
+    channel.sendRequest(request);
+
+    std::string key, value;
+    while (channel.receive(key, value)) {
+        if (key == "out") {
+            out << value << std::flush;
+        } else if (key == "err") {
+            err << value << std::flush;
+        } else if (key == "exit") {
+            return std::stoi(value);
+        }
+    }
+    throw std::runtime_error("The relocator server closed the connection before the request finished");
+}
@@ -0,0 +1,80 @@
+// src/RelocatorServer.hpp
+#ifndef RELOCATOR_RELOCATORSERVER_HPP
+#define RELOCATOR_RELOCATORSERVER_HPP
+
+#include "Relocator.hpp"
+#include "ServeProtocol.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+/**
+ * @class RelocatorServer
+ * @brief The `relocator --serve` daemon: bundles requests from a Unix domain socket.
+ *
+ * Every request runs in its own RelocatorSession, but all sessions share one
+ * RelocatorCache, so the library resolutions, candidate checks and parsed ELF
+ * metadata of one request serve the next. The cache revalidates what it holds at the
+ * start of each request (directory modification times, /etc/ld.so.cache, and each
+ * file's identity in the scan cache), so a warm tree bundles in milliseconds and a
+ * changed one is rescanned where it changed.
+ *
+ * The socket is created with mode 0600 and only peers with this process's user id are
+ * served. Requests are handled by a fixed number of worker threads; further connections
+ * wait for a free one. On Linux bundles are test-loaded in child processes as usual;
+ * elsewhere the load check would dlopen the primary input and run its initializers
+ * inside the server, so it is skipped.
+ */
+class RelocatorServer {
+public:
+    /**
+     * Binds the socket, replacing a stale one left by a server that died.
+     * @param defaults The scan-cache location and size every request uses.
+     * @param workers Requests handled at once; 0 = one per hardware thread.
+     * @throws std::runtime_error if the socket cannot be created or another server is listening on it.
+     */
+    RelocatorServer(const std::filesystem::path& socketPath, const RelocatorOptions& defaults,
+                    unsigned workers, std::ostream& log);
+    ~RelocatorServer();
+    RelocatorServer(const RelocatorServer&) = delete;
+    RelocatorServer& operator=(const RelocatorServer&) = delete;
+
+    /**
+     * Serves until a client sends "shutdown" or the process gets SIGINT or SIGTERM;
+     * requests already accepted are finished first.
+     */
+    void run();
+
+    /**
+     * Sends a request to a server and copies its log to out and err as it arrives.
+     * @return The request's exit code.
+     * @throws std::runtime_error if no server is listening or the connection drops.
+     */
+    static int send(const std::filesystem::path& socketPath, const ServeRequest& request,
+                    std::ostream& out, std::ostream& err);
+
+private:
+    void work();
+    void handle(int fd);
+    void stop();
+
+    std::filesystem::path m_socketPath;
+    RelocatorOptions m_defaults;
+    unsigned m_workers;
+    std::ostream& m_log;
+    std::mutex m_logMutex;
+    std::shared_ptr<RelocatorCache> m_cache;
+    int m_listenFd = -1;
+    int m_wakeFds[2] = { -1, -1 };   // Self-pipe: written by stop() and the signal handler
+
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::deque<int> m_connections;   // Accepted, waiting for a worker
+    bool m_stopping = false;
+};
+
+#endif //RELOCATOR_RELOCATORSERVER_HPP
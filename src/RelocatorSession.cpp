@@ -0,0 +1,134 @@
+// src/RelocatorSession.cpp
+#include "RelocatorSession.hpp"
+#include "InputExpander.hpp"
+
+#include <fstream>
+#include <stdexcept>
+
+RelocatorSession::RelocatorSession(const RelocatorOptions& options, std::shared_ptr<RelocatorCache> cache)
+    : m_relocator(createPlatformRelocator(options, std::move(cache))) {
+    m_exclusions.addPlatformDefaults(options.target);
+}
+
+RelocatorSession::~RelocatorSession() = default;
+
+BundleResult RelocatorSession::bundle(const BundleRequest& request) {
+    return bundle(InputExpander::expand(request.inputs), request.outputDir, request.searchPaths);
+}
+
+BundleResult RelocatorSession::bundle(const std::vector<BundleInput>& inputs,
+                                      const std::filesystem::path& outputDir,
+                                      const std::vector<std::string>& searchPaths) {
+    if (inputs.empty()) {
+        throw std::runtime_error("Nothing to bundle: no inputs were given.");
+    }
+    if (!m_exclusions.compiled()) {
+        m_exclusions.compile();
+    }
+    m_relocator->bundleDependencies(inputs, outputDir, searchPaths, m_exclusions);
+    return m_relocator->result();
+}
+
+void RelocatorSession::report(const RunReport& report, std::ostream& out) const {
+    m_exclusions.report(out);
+
+    if (!report.graphOut.empty()) {
+        std::ofstream file(report.graphOut);
+        const std::string extension = report.graphOut.extension().string();
+        if (extension == ".dot" || extension == ".gv") {
+            graph().writeDot(file);
+        } else {
+            graph().writeJson(file);
+        }
+        if (!file) {
+            throw std::runtime_error("Could not write the dependency graph to " + report.graphOut.string());
+        }
+        out << "Dependency graph written to " << report.graphOut << std::endl;
+    }
+    for (const auto& name : report.why) {
+        graph().explain(out, name);
+    }
+
+    if (report.printStats) {
+        stats().printText(out);
+    }
+    if (report.statsJson == "-") {
+        stats().writeJson(out);
+    } else if (!report.statsJson.empty()) {
+        std::ofstream file(report.statsJson);
+        stats().writeJson(file);
+        if (!file) {
+            throw std::runtime_error("Could not write statistics to " + report.statsJson.string());
+        }
+    }
+}
+
+int runBundleJob(const BundleJob& job, RelocatorOptions options, std::ostream& out, std::ostream& err,
+                 std::shared_ptr<RelocatorCache> cache) {
+    options.log = &out;
+    options.errorLog = &err;
+    try {
+        RelocatorSession session(options, std::move(cache));
+
+        // All exclusion sources are compiled into one policy, once per run.
+        ExclusionPolicy& exclusions = session.exclusions();
+        for (const auto& rule : job.exclusions) {
+            exclusions.add(rule.kind, rule.pattern, rule.origin);
+        }
+        for (const auto& file : job.policyFiles) {
+            exclusions.loadFile(file);
+        }
+        exclusions.compile();
+
+        session.bundle(job.request);
+        session.report(job.report, out);
+    } catch (const std::exception& e) {
+        err << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+    out << "Relocation complete." << std::endl;
+    return 0;
+}
+
+// --- Platform-Specific Factory Implementation ---
+// CMake compiles the relocators for the current OS into the library (on Linux, the macOS one too).
+
+#if defined(__APPLE__)
+#include "MacOS_Relocator.hpp"
+#include "Windows_Relocator.hpp"
+std::unique_ptr<Relocator> createPlatformRelocator(const RelocatorOptions& options, std::shared_ptr<RelocatorCache> cache) {
+    if (options.target == TargetPlatform::Linux) {
+        throw std::runtime_error("This build cannot bundle for Linux.");
+    }
+    if (options.target == TargetPlatform::Windows) {
+        return std::make_unique<Windows_Relocator>(options, std::move(cache));
+    }
+    return std::make_unique<MacOS_Relocator>(options, std::move(cache));
+}
+#elif defined(__linux__)
+#include "Linux_Relocator.hpp"
+#include "MacOS_Relocator.hpp"
+#include "Windows_Relocator.hpp"
+std::unique_ptr<Relocator> createPlatformRelocator(const RelocatorOptions& options, std::shared_ptr<RelocatorCache> cache) {
+    // Mach-O and PE files are read and patched in-process, so macOS and Windows bundles can be built here too.
+    if (options.target == TargetPlatform::MacOS) {
+        return std::make_unique<MacOS_Relocator>(options, std::move(cache));
+    }
+    if (options.target == TargetPlatform::Windows) {
+        return std::make_unique<Windows_Relocator>(options, std::move(cache));
+    }
+    return std::make_unique<Linux_Relocator>(options, std::move(cache));
+}
+#elif defined(_WIN32)
+#include "Windows_Relocator.hpp"
+std::unique_ptr<Relocator> createPlatformRelocator(const RelocatorOptions& options, std::shared_ptr<RelocatorCache> cache) {
+    if (options.target != TargetPlatform::Host && options.target != TargetPlatform::Windows) {
+        throw std::runtime_error("This build can only bundle for Windows.");
+    }
+    return std::make_unique<Windows_Relocator>(options, std::move(cache));
+}
+#else
+std::unique_ptr<Relocator> createPlatformRelocator(const RelocatorOptions& options, std::shared_ptr<RelocatorCache> cache) {
+    throw std::runtime_error("Unsupported platform.");
+}
+#endif
@@ -0,0 +1,132 @@
+// src/RelocatorSession.hpp
+#ifndef RELOCATOR_RELOCATORSESSION_HPP
+#define RELOCATOR_RELOCATORSESSION_HPP
+
+#include "DependencyGraph.hpp"
+#include "ExclusionPolicy.hpp"
+#include "Relocator.hpp"
+#include "RunStats.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @struct BundleRequest
+ * @brief One bundle to produce, described the way the command line describes it.
+ */
+struct BundleRequest {
+    std::vector<std::string> inputs;          // Files, directories or globs, as for -i; the first is the primary input
+    std::filesystem::path outputDir;
+    std::vector<std::string> searchPaths;     // As for -s
+};
+
+/**
+ * @struct RunReport
+ * @brief The optional reports to produce once a bundle is written.
+ */
+struct RunReport {
+    bool printStats = false;                  // As for --stats
+    std::filesystem::path statsJson;          // As for --stats-json; "-" writes to the report stream
+    std::filesystem::path graphOut;           // As for --graph-out; .dot or .gv for Graphviz, JSON otherwise
+    std::vector<std::string> why;             // As for --why
+};
+
+/**
+ * @class RelocatorSession
+ * @brief The in-process entry point of librelocator.
+ *
+ * A session owns the platform relocator and its exclusion policy and can bundle any
+ * number of times. Between calls it keeps the library resolver's memo (revalidated
+ * against directory modification times), the in-memory scan cache and the last run's
+ * graph and statistics, so a build tool bundling many targets pays for system
+ * libraries once. Results come back as a BundleResult; nothing is printed unless
+ * RelocatorOptions::log or errorLog is set.
+ *
+ * A session is not thread-safe: call bundle() from one thread at a time. Each call
+ * still uses the worker threads configured in the options. To bundle concurrently, give
+ * each thread its own session sharing one cache().
+ *
+ *   RelocatorSession session;
+ *   session.exclusions().add(ExclusionKind::Glob, "libcuda*", "build");
+ *   BundleResult result = session.bundle({ { "build/app" }, "dist/lib", {} });
+ */
+class RelocatorSession {
+public:
+    /**
+     * @param cache Warm metadata to share with other sessions, e.g. another session's cache();
+     *              nullptr starts a new one.
+     * @throws std::runtime_error if this platform has no relocator.
+     */
+    explicit RelocatorSession(const RelocatorOptions& options = RelocatorOptions(),
+                              std::shared_ptr<RelocatorCache> cache = nullptr);
+    ~RelocatorSession();
+    RelocatorSession(const RelocatorSession&) = delete;
+    RelocatorSession& operator=(const RelocatorSession&) = delete;
+
+    /**
+     * The rules every bundle() call applies; starts with the platform defaults. Rules
+     * can only be added before the first bundle(), which compiles them.
+     */
+    ExclusionPolicy& exclusions() { return m_exclusions; }
+
+    /**
+     * Expands the request's inputs and bundles them.
+     * @throws std::runtime_error if an input matches nothing or the bundle cannot be written.
+     */
+    BundleResult bundle(const BundleRequest& request);
+
+    /**
+     * Bundles roots that were already expanded.
+     */
+    BundleResult bundle(const std::vector<BundleInput>& inputs,
+                        const std::filesystem::path& outputDir,
+                        const std::vector<std::string>& searchPaths = {});
+
+    /**
+     * The dependency graph and statistics of the last bundle() call.
+     */
+    const DependencyGraph& graph() const { return m_relocator->graph(); }
+    const RunStats& stats() const { return m_relocator->stats(); }
+    const std::shared_ptr<RelocatorCache>& cache() const { return m_relocator->cache(); }
+
+    /**
+     * Writes the exclusion hits and the requested reports of the last bundle() call.
+     * @throws std::runtime_error if a report file cannot be written.
+     */
+    void report(const RunReport& report, std::ostream& out) const;
+
+private:
+    std::unique_ptr<Relocator> m_relocator;
+    ExclusionPolicy m_exclusions;
+};
+
+/**
+ * @struct BundleJob
+ * @brief Everything one command-line run asks for: the bundle, its rules and its reports.
+ */
+struct BundleJob {
+    BundleRequest request;
+    std::vector<ExclusionRule> exclusions;              // Added after the platform defaults, in order
+    std::vector<std::filesystem::path> policyFiles;     // Loaded after the exclusions
+    RunReport report;
+};
+
+/**
+ * Runs a job the way the relocator command does, logging progress to out and failures to err.
+ * @param cache As for RelocatorSession.
+ * @return The exit code: 0 on success, 1 if the job failed (the error has been printed to err).
+ */
+int runBundleJob(const BundleJob& job, RelocatorOptions options, std::ostream& out, std::ostream& err,
+                 std::shared_ptr<RelocatorCache> cache = nullptr);
+
+/**
+ * Creates the relocator for the platform this library was built for.
+ * @throws std::runtime_error on an unsupported platform.
+ */
+std::unique_ptr<Relocator> createPlatformRelocator(const RelocatorOptions& options,
+                                                   std::shared_ptr<RelocatorCache> cache = nullptr);
+
+#endif //RELOCATOR_RELOCATORSESSION_HPP
@@ -0,0 +1,223 @@
+// src/RunStats.cpp
+#include "RunStats.hpp"
+#include "Json.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+namespace {
+    bool slower(const std::pair<std::string, double>& a, const std::pair<std::string, double>& b) {
+        return a.second > b.second;
+    }
+
+    struct CpuUsage {
+        double user = 0;
+        double system = 0;
+        double children = 0;
+    };
+
+    CpuUsage processCpu() {
+        CpuUsage usage;
+#ifndef _WIN32
+        auto seconds = [](const timeval& tv) { return tv.tv_sec + tv.tv_usec / 1e6; };
+        struct rusage self{}, children{};
+        ::getrusage(RUSAGE_SELF, &self);
+        ::getrusage(RUSAGE_CHILDREN, &children);
+        usage.user = seconds(self.ru_utime);
+        usage.system = seconds(self.ru_stime);
+        usage.children = seconds(children.ru_utime) + seconds(children.ru_stime);
+#endif
+        return usage;
+    }
+
+    std::string mib(std::uint64_t bytes) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0) << " MiB";
+        return out.str();
+    }
+}
+
+PhaseStats::Scope::Scope(PhaseStats& phase, std::string file)
+    : m_phase(phase), m_file(std::move(file)), m_start(Clock::now()), m_cpuStart(threadCpuSeconds()) {}
+
+PhaseStats::Scope::~Scope() {
+    if (!m_discarded) {
+        m_phase.record(m_file, m_start, Clock::now(), threadCpuSeconds() - m_cpuStart);
+    }
+}
+
+double PhaseStats::threadCpuSeconds() {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user)) {
+        return 0;
+    }
+    auto ticks = [](const FILETIME& t) { return (static_cast<std::uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime; };
+    return (ticks(kernel) + ticks(user)) / 1e7;
+#else
+    timespec ts{};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+void PhaseStats::record(const std::string& file, Clock::time_point start, Clock::time_point end, double cpuSeconds) {
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_files++ == 0 || start < m_firstStart) {
+        m_firstStart = start;
+    }
+    m_lastEnd = std::max(m_lastEnd, end);
+    m_busySeconds += seconds;
+    m_cpuSeconds += cpuSeconds;
+
+    if (m_slowestKept == 0) {
+        return;
+    }
+    if (m_slowest.size() < m_slowestKept) {
+        m_slowest.emplace_back(file, seconds);
+        std::push_heap(m_slowest.begin(), m_slowest.end(), slower);
+    } else if (seconds > m_slowest.front().second) {
+        std::pop_heap(m_slowest.begin(), m_slowest.end(), slower);
+        m_slowest.back() = { file, seconds };
+        std::push_heap(m_slowest.begin(), m_slowest.end(), slower);
+    }
+}
+
+void PhaseStats::addCacheLookups(std::uint64_t hits, std::uint64_t misses) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cacheHits += hits;
+    m_cacheMisses += misses;
+}
+
+void PhaseStats::addSubprocess(double wallSeconds, double cpuSeconds) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_subprocesses;
+    m_subprocessSeconds += wallSeconds;
+    m_subprocessCpuSeconds += cpuSeconds;
+}
+
+PhaseReport PhaseStats::report() const {
+    PhaseReport report;
+    report.name = m_name;
+    report.bytesRead = m_bytesRead.load();
+    report.bytesCopied = m_bytesCopied.load();
+    report.bytesWritten = m_bytesWritten.load();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    report.files = m_files;
+    if (m_files > 0) {
+        report.wallSeconds = std::chrono::duration<double>(m_lastEnd - m_firstStart).count();
+    }
+    report.busySeconds = m_busySeconds;
+    report.cpuSeconds = m_cpuSeconds;
+    report.subprocesses = m_subprocesses;
+    report.subprocessSeconds = m_subprocessSeconds;
+    report.subprocessCpuSeconds = m_subprocessCpuSeconds;
+    report.cacheHits = m_cacheHits;
+    report.cacheMisses = m_cacheMisses;
+    report.slowest = m_slowest;
+    std::sort(report.slowest.begin(), report.slowest.end(), slower);
+    return report;
+}
+
+RunStats::RunStats(std::size_t slowestKept) : m_slowestKept(slowestKept) {
+    start();
+}
+
+void RunStats::start() {
+    const char* names[] = { "discover", "copy", "fixup", "verify", "load-check" };
+    for (std::size_t i = 0; i < m_phases.size(); ++i) {
+        m_phases[i] = std::make_unique<PhaseStats>(names[i], m_slowestKept);
+    }
+    m_start = PhaseStats::Clock::now();
+    m_wallSeconds = m_userSeconds = m_systemSeconds = m_childSeconds = 0;
+    const CpuUsage usage = processCpu();
+    m_startUser = usage.user;
+    m_startSystem = usage.system;
+    m_startChild = usage.children;
+}
+
+void RunStats::finish() {
+    m_wallSeconds = std::chrono::duration<double>(PhaseStats::Clock::now() - m_start).count();
+    const CpuUsage usage = processCpu();
+    m_userSeconds = usage.user - m_startUser;
+    m_systemSeconds = usage.system - m_startSystem;
+    m_childSeconds = usage.children - m_startChild;
+}
+
+void RunStats::printText(std::ostream& out) const {
+    out << std::fixed << std::setprecision(3)
+        << "\nRun statistics: " << m_wallSeconds << " s wall, " << m_userSeconds << " s user, "
+        << m_systemSeconds << " s system";
+    if (m_childSeconds > 0) {
+        out << ", " << m_childSeconds << " s in child processes";
+    }
+    out << "\n";
+    for (const auto& phase : m_phases) {
+        const PhaseReport report = phase->report();
+        out << "  " << std::left << std::setw(11) << report.name << std::right << report.files << " files, "
+            << report.wallSeconds << " s wall, " << report.busySeconds << " s busy, " << report.cpuSeconds << " s CPU\n";
+        if (report.bytesRead || report.bytesCopied || report.bytesWritten) {
+            out << "               read " << mib(report.bytesRead) << ", copied " << mib(report.bytesCopied)
+                << ", written " << mib(report.bytesWritten) << "\n";
+        }
+        if (report.subprocesses > 0) {
+            out << "               " << report.subprocesses << " subprocesses, " << report.subprocessSeconds
+                << " s wall, " << report.subprocessCpuSeconds << " s CPU\n";
+        }
+        if (report.cacheHits + report.cacheMisses > 0) {
+            out << "               cache " << report.cacheHits << " hits, " << report.cacheMisses << " misses ("
+                << std::setprecision(1) << 100.0 * report.cacheHits / (report.cacheHits + report.cacheMisses)
+                << "%)\n" << std::setprecision(3);
+        }
+        for (const auto& [file, seconds] : report.slowest) {
+            out << "               " << std::setw(8) << seconds << " s  " << file << "\n";
+        }
+    }
+    out << std::defaultfloat << std::setprecision(6);
+}
+
+void RunStats::writeJson(std::ostream& out) const {
+    out << std::setprecision(6) << "{\n"
+        << "  \"version\": 1,\n"
+        << "  \"wallSeconds\": " << m_wallSeconds << ",\n"
+        << "  \"userSeconds\": " << m_userSeconds << ",\n"
+        << "  \"systemSeconds\": " << m_systemSeconds << ",\n"
+        << "  \"childCpuSeconds\": " << m_childSeconds << ",\n"
+        << "  \"phases\": [";
+    for (std::size_t i = 0; i < m_phases.size(); ++i) {
+        const PhaseReport report = m_phases[i]->report();
+        const std::uint64_t lookups = report.cacheHits + report.cacheMisses;
+        out << (i ? "," : "") << "\n    {\n"
+            << "      \"name\": " << Json::quote(report.name) << ",\n"
+            << "      \"files\": " << report.files << ",\n"
+            << "      \"wallSeconds\": " << report.wallSeconds << ",\n"
+            << "      \"busySeconds\": " << report.busySeconds << ",\n"
+            << "      \"cpuSeconds\": " << report.cpuSeconds << ",\n"
+            << "      \"subprocesses\": " << report.subprocesses << ",\n"
+            << "      \"subprocessSeconds\": " << report.subprocessSeconds << ",\n"
+            << "      \"subprocessCpuSeconds\": " << report.subprocessCpuSeconds << ",\n"
+            << "      \"bytesRead\": " << report.bytesRead << ",\n"
+            << "      \"bytesCopied\": " << report.bytesCopied << ",\n"
+            << "      \"bytesWritten\": " << report.bytesWritten << ",\n"
+            << "      \"cacheHits\": " << report.cacheHits << ",\n"
+            << "      \"cacheMisses\": " << report.cacheMisses << ",\n"
+            << "      \"cacheHitRate\": " << (lookups ? static_cast<double>(report.cacheHits) / lookups : 0.0) << ",\n"
+            << "      \"slowest\": [";
+        for (std::size_t j = 0; j < report.slowest.size(); ++j) {
+            out << (j ? ", " : "") << "{\"file\": " << Json::quote(report.slowest[j].first)
+                << ", \"seconds\": " << report.slowest[j].second << "}";
+        }
+        out << "]\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
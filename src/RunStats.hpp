@@ -0,0 +1,161 @@
+// src/RunStats.hpp
+#ifndef RELOCATOR_RUNSTATS_HPP
+#define RELOCATOR_RUNSTATS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @enum Phase
+ * @brief The phases a run is timed in. Verify is the structural check of each patched file;
+ * LoadCheck is test-loading the finished bundle, which runs once per object after it.
+ */
+enum class Phase { Discover, Copy, Fixup, Verify, LoadCheck };
+
+/**
+ * @struct PhaseReport
+ * @brief A snapshot of one phase's counters, as printed by --stats.
+ */
+struct PhaseReport {
+    std::string name;
+    std::uint64_t files = 0;
+    double wallSeconds = 0;         // From the first file starting to the last file finishing
+    double busySeconds = 0;         // Sum of per-file wall time across threads
+    double cpuSeconds = 0;          // Sum of per-file thread CPU time
+    std::uint64_t subprocesses = 0;
+    double subprocessSeconds = 0;   // Wall time of child processes
+    double subprocessCpuSeconds = 0;
+    std::uint64_t bytesRead = 0;    // Read into memory: parsing, hashing, patching
+    std::uint64_t bytesCopied = 0;  // Logical size of files materialized in the output
+    std::uint64_t bytesWritten = 0; // Data actually written; a reflink or hard link writes none
+    std::uint64_t cacheHits = 0;
+    std::uint64_t cacheMisses = 0;
+    std::vector<std::pair<std::string, double>> slowest;   // (file, seconds), slowest first
+};
+
+/**
+ * @class PhaseStats
+ * @brief Thread-safe counters for one phase of a run.
+ *
+ * Work on a file is timed with a Scope, which records wall and thread CPU time and
+ * keeps the slowest files. The byte and subprocess counters may be bumped from any
+ * thread at any time.
+ */
+class PhaseStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Times the work on one file from construction to destruction.
+     */
+    class Scope {
+    public:
+        Scope(PhaseStats& phase, std::string file);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        /**
+         * Drops this file from the statistics, e.g. a visit that turned out to be a duplicate.
+         */
+        void discard() { m_discarded = true; }
+
+    private:
+        PhaseStats& m_phase;
+        std::string m_file;
+        Clock::time_point m_start;
+        double m_cpuStart;
+        bool m_discarded = false;
+    };
+
+    PhaseStats(std::string name, std::size_t slowestKept) : m_name(std::move(name)), m_slowestKept(slowestKept) {}
+
+    /**
+     * Records one file whose work was timed elsewhere, e.g. by a child process.
+     */
+    void record(const std::string& file, Clock::time_point start, Clock::time_point end, double cpuSeconds);
+
+    void addBytesRead(std::uint64_t bytes) { m_bytesRead.fetch_add(bytes, std::memory_order_relaxed); }
+    void addBytesCopied(std::uint64_t bytes) { m_bytesCopied.fetch_add(bytes, std::memory_order_relaxed); }
+    void addBytesWritten(std::uint64_t bytes) { m_bytesWritten.fetch_add(bytes, std::memory_order_relaxed); }
+    void addCacheLookups(std::uint64_t hits, std::uint64_t misses);
+    void addSubprocess(double wallSeconds, double cpuSeconds);
+
+    PhaseReport report() const;
+
+    /**
+     * CPU time consumed so far by the calling thread.
+     */
+    static double threadCpuSeconds();
+
+private:
+    const std::string m_name;
+    const std::size_t m_slowestKept;
+
+    std::atomic<std::uint64_t> m_bytesRead{0};
+    std::atomic<std::uint64_t> m_bytesCopied{0};
+    std::atomic<std::uint64_t> m_bytesWritten{0};
+
+    mutable std::mutex m_mutex;
+    std::uint64_t m_files = 0;
+    Clock::time_point m_firstStart{};
+    Clock::time_point m_lastEnd{};
+    double m_busySeconds = 0;
+    double m_cpuSeconds = 0;
+    std::uint64_t m_subprocesses = 0;
+    double m_subprocessSeconds = 0;
+    double m_subprocessCpuSeconds = 0;
+    std::uint64_t m_cacheHits = 0;
+    std::uint64_t m_cacheMisses = 0;
+    std::vector<std::pair<std::string, double>> m_slowest;   // Min-heap on seconds
+};
+
+/**
+ * @class RunStats
+ * @brief Per-phase instrumentation for one bundleDependencies run.
+ *
+ * Collection is always on and costs a few clock reads per file; --stats prints the
+ * result as text and --stats-json writes it for dashboards.
+ */
+class RunStats {
+public:
+    /**
+     * @param slowestKept How many of the slowest files each phase remembers.
+     */
+    explicit RunStats(std::size_t slowestKept = 5);
+
+    PhaseStats& phase(Phase phase) { return *m_phases[static_cast<std::size_t>(phase)]; }
+
+    /**
+     * Clears all counters and starts the run clock; called at the top of bundleDependencies.
+     */
+    void start();
+
+    /**
+     * Stops the run clock and samples process and child CPU usage.
+     */
+    void finish();
+
+    void printText(std::ostream& out) const;
+    void writeJson(std::ostream& out) const;
+
+private:
+    const std::size_t m_slowestKept;
+    std::array<std::unique_ptr<PhaseStats>, 5> m_phases;
+    PhaseStats::Clock::time_point m_start;
+    double m_wallSeconds = 0;
+    double m_userSeconds = 0;
+    double m_systemSeconds = 0;
+    double m_childSeconds = 0;
+    double m_startUser = 0, m_startSystem = 0, m_startChild = 0;
+};
+
+#endif //RELOCATOR_RUNSTATS_HPP
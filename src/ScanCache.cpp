@@ -0,0 +1,303 @@
+// src/ScanCache.cpp
+#include "ScanCache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace {
+    constexpr std::uint32_t kRecordMagic = 0x31434c52;   // "RLC1"; bump when ElfDynamicInfo changes
+    constexpr const char* kLogName = "scan-cache.v1";
+    constexpr const char* kLockName = "scan-cache.lock";
+
+    struct RecordHeader {
+        std::uint32_t magic;
+        std::uint32_t length;
+        std::uint64_t checksum;
+    };
+
+    template <typename T>
+    void put(std::string& out, const T& value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void putString(std::string& out, const std::string& value) {
+        put(out, static_cast<std::uint32_t>(value.size()));
+        out += value;
+    }
+
+    // Reads fields back out of one record's payload; any overrun marks the record bad.
+    class Reader {
+    public:
+        Reader(const char* data, std::size_t size) : m_data(data), m_size(size) {}
+
+        template <typename T>
+        T get() {
+            T value{};
+            if (m_pos + sizeof(T) > m_size) {
+                m_ok = false;
+                return value;
+            }
+            std::memcpy(&value, m_data + m_pos, sizeof(T));
+            m_pos += sizeof(T);
+            return value;
+        }
+
+        std::string getString() {
+            const auto length = get<std::uint32_t>();
+            if (!m_ok || m_pos + length > m_size) {
+                m_ok = false;
+                return {};
+            }
+            std::string value(m_data + m_pos, length);
+            m_pos += length;
+            return value;
+        }
+
+        bool good() const { return m_ok; }
+        bool ok() const { return m_ok && m_pos == m_size; }
+
+    private:
+        const char* m_data;
+        std::size_t m_size;
+        std::size_t m_pos = 0;
+        bool m_ok = true;
+    };
+
+    std::string readFile(const std::filesystem::path& file) {
+        std::ifstream in(file, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    // Writes all of bytes with one write() where possible, so O_APPEND keeps records whole.
+    bool writeAll(int fd, const std::string& bytes) {
+        std::size_t done = 0;
+        while (done < bytes.size()) {
+            const ssize_t n = ::write(fd, bytes.data() + done, bytes.size() - done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+}
+
+std::filesystem::path ScanCache::defaultDirectory() {
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        return std::filesystem::path(xdg) / "relocator";
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return std::filesystem::path(home) / ".cache" / "relocator";
+    }
+    return {};
+}
+
+ScanCache::ScanCache(std::filesystem::path directory, std::uint64_t maxBytes)
+    : m_directory(std::move(directory)), m_maxBytes(maxBytes) {
+    if (!m_directory.empty()) {
+        parseLog(readFile(m_directory / kLogName), m_entries);
+    }
+}
+
+void ScanCache::parseLog(const std::string& bytes, std::unordered_map<std::string, Entry>& entries) {
+    std::size_t pos = 0;
+    std::uint64_t order = 0;
+    while (pos + sizeof(RecordHeader) <= bytes.size()) {
+        RecordHeader header;
+        std::memcpy(&header, bytes.data() + pos, sizeof(header));
+        const char* payload = bytes.data() + pos + sizeof(header);
+        if (header.magic != kRecordMagic || header.length > bytes.size() - pos - sizeof(header)
+            || BundleManifest::hashBytes(payload, header.length) != header.checksum) {
+            break;  // A torn or foreign tail; everything before it is still good.
+        }
+        pos += sizeof(header) + header.length;
+
+        Reader reader(payload, header.length);
+        std::string path = reader.getString();
+        Entry entry;
+        entry.identity.device = reader.get<std::uint64_t>();
+        entry.identity.inode = reader.get<std::uint64_t>();
+        entry.identity.size = reader.get<std::uint64_t>();
+        entry.identity.mtimeNs = reader.get<std::int64_t>();
+        entry.info.is64Bit = reader.get<std::uint8_t>() != 0;
+        entry.info.machine = reader.get<std::uint16_t>();
+        entry.info.isDynamic = reader.get<std::uint8_t>() != 0;
+        entry.info.hasRpath = reader.get<std::uint8_t>() != 0;
+        entry.info.hasRunpath = reader.get<std::uint8_t>() != 0;
+        entry.info.flags1 = reader.get<std::uint64_t>();
+        entry.info.soname = reader.getString();
+        entry.info.rpath = reader.getString();
+        entry.info.runpath = reader.getString();
+        const auto count = reader.get<std::uint32_t>();
+        for (std::uint32_t i = 0; i < count && reader.good(); ++i) {
+            entry.info.needed.push_back(reader.getString());
+        }
+        if (!reader.ok()) {
+            continue;
+        }
+        entry.order = order++;
+        entries[path] = std::move(entry);
+    }
+}
+
+void ScanCache::appendRecord(std::string& out, const std::string& path, const Entry& entry) {
+    std::string payload;
+    putString(payload, path);
+    put(payload, entry.identity.device);
+    put(payload, entry.identity.inode);
+    put(payload, entry.identity.size);
+    put(payload, entry.identity.mtimeNs);
+    put(payload, static_cast<std::uint8_t>(entry.info.is64Bit));
+    put(payload, entry.info.machine);
+    put(payload, static_cast<std::uint8_t>(entry.info.isDynamic));
+    put(payload, static_cast<std::uint8_t>(entry.info.hasRpath));
+    put(payload, static_cast<std::uint8_t>(entry.info.hasRunpath));
+    put(payload, entry.info.flags1);
+    putString(payload, entry.info.soname);
+    putString(payload, entry.info.rpath);
+    putString(payload, entry.info.runpath);
+    put(payload, static_cast<std::uint32_t>(entry.info.needed.size()));
+    for (const auto& needed : entry.info.needed) {
+        putString(payload, needed);
+    }
+
+    RecordHeader header{kRecordMagic, static_cast<std::uint32_t>(payload.size()),
+                        BundleManifest::hashBytes(payload.data(), payload.size())};
+    put(out, header);
+    out += payload;
+}
+
+std::optional<ElfDynamicInfo> ScanCache::lookup(const std::filesystem::path& file, const FileIdentity& identity) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(file.string());
+    if (it == m_entries.end() || it->second.identity != identity || identity.size == 0) {
+        ++m_misses;
+        return std::nullopt;
+    }
+    ++m_hits;
+    it->second.used = true;
+    return it->second.info;
+}
+
+void ScanCache::insert(const std::filesystem::path& file, const FileIdentity& identity, const ElfDynamicInfo& info) {
+    if (identity.size == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = m_entries[file.string()];
+    entry.identity = identity;
+    entry.info = info;
+    entry.order = UINT64_MAX;
+    entry.used = true;
+    m_inserted.push_back(file.string());
+}
+
+void ScanCache::flush() {
+    if (m_directory.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_inserted.empty()) {
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+
+    const int lockFd = ::open((m_directory / kLockName).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lockFd < 0) {
+        return;
+    }
+
+    // Appends share the lock with each other; only compaction needs it alone.
+    if (::flock(lockFd, LOCK_SH) == 0) {
+        std::string batch;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto& path : m_inserted) {
+                appendRecord(batch, path, m_entries.at(path));
+            }
+            m_inserted.clear();
+        }
+        const int logFd = ::open((m_directory / kLogName).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (logFd >= 0) {
+            writeAll(logFd, batch);
+            ::close(logFd);
+        }
+        ::flock(lockFd, LOCK_UN);
+    }
+
+    if (std::filesystem::file_size(m_directory / kLogName, ec) > m_maxBytes && !ec) {
+        compact(lockFd);
+    }
+    ::close(lockFd);
+}
+
+void ScanCache::compact(int lockFd) {
+    if (::flock(lockFd, LOCK_EX) != 0) {
+        return;
+    }
+    const std::filesystem::path logPath = m_directory / kLogName;
+
+    // Another process may have compacted while we waited; start from what is on disk now.
+    std::unordered_map<std::string, Entry> onDisk;
+    const std::string bytes = readFile(logPath);
+    if (bytes.size() > m_maxBytes) {
+        parseLog(bytes, onDisk);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto& [path, entry] : m_entries) {
+                auto it = onDisk.find(path);
+                if (entry.used && it != onDisk.end() && it->second.identity == entry.identity) {
+                    it->second.used = true;
+                }
+            }
+        }
+
+        // Entries this run used come first, then the rest from newest to oldest.
+        std::vector<std::pair<const std::string*, const Entry*>> ranked;
+        for (const auto& [path, entry] : onDisk) {
+            ranked.emplace_back(&path, &entry);
+        }
+        std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+            if (a.second->used != b.second->used) return a.second->used;
+            return a.second->order > b.second->order;
+        });
+
+        std::string compacted;
+        for (const auto& [path, entry] : ranked) {
+            std::string record;
+            appendRecord(record, *path, *entry);
+            if (compacted.size() + record.size() > m_maxBytes / 2) {
+                break;
+            }
+            compacted += record;
+        }
+
+        std::filesystem::path temp = logPath;
+        temp += ".tmp." + std::to_string(::getpid());
+        const int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd >= 0) {
+            const bool written = writeAll(fd, compacted);
+            ::close(fd);
+            std::error_code ec;
+            if (written) {
+                std::filesystem::rename(temp, logPath, ec);
+            }
+            if (!written || ec) {
+                std::filesystem::remove(temp, ec);
+            }
+        }
+    }
+    ::flock(lockFd, LOCK_UN);
+}
@@ -0,0 +1,83 @@
+// src/ScanCache.hpp
+#ifndef RELOCATOR_SCANCACHE_HPP
+#define RELOCATOR_SCANCACHE_HPP
+
+#include "BundleManifest.hpp"
+#include "ElfFile.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class ScanCache
+ * @brief A persistent, cross-run cache of parsed ELF dynamic metadata.
+ *
+ * Entries are keyed by path and FileIdentity, so a replaced library is simply a miss.
+ * The cache is an append-only log of checksummed records. Readers load it without
+ * locking and ignore a torn record at the end; writers append their new records in
+ * one batch while holding a shared flock(). When the log outgrows its size bound, a
+ * writer takes the lock exclusively, keeps the most recently used entries and
+ * atomically renames a compacted log into place.
+ */
+class ScanCache {
+public:
+    /**
+     * @return $XDG_CACHE_HOME/relocator, falling back to ~/.cache/relocator.
+     */
+    static std::filesystem::path defaultDirectory();
+
+    /**
+     * Loads the cache from directory. A missing or unreadable cache starts empty.
+     * @param maxBytes The log is compacted to about half this size once it grows past it.
+     */
+    ScanCache(std::filesystem::path directory, std::uint64_t maxBytes);
+
+    /**
+     * @return The cached metadata if the file's identity still matches. Thread-safe.
+     */
+    std::optional<ElfDynamicInfo> lookup(const std::filesystem::path& file, const FileIdentity& identity);
+
+    /**
+     * Remembers metadata parsed in this run. Thread-safe.
+     */
+    void insert(const std::filesystem::path& file, const FileIdentity& identity, const ElfDynamicInfo& info);
+
+    /**
+     * Appends this run's new entries and compacts the log if it is over its bound.
+     * Errors are swallowed: the cache is an optimization and never fails a run.
+     * Thread-safe, so runs sharing one cache may flush concurrently.
+     */
+    void flush();
+
+    std::uint64_t hits() const { return m_hits; }
+    std::uint64_t misses() const { return m_misses; }
+
+private:
+    struct Entry {
+        FileIdentity identity;
+        ElfDynamicInfo info;
+        std::uint64_t order = 0;    // Position in the log; later records are newer
+        bool used = false;          // Looked up or inserted by this run
+    };
+
+    static void parseLog(const std::string& bytes, std::unordered_map<std::string, Entry>& entries);
+    static void appendRecord(std::string& out, const std::string& path, const Entry& entry);
+    void compact(int lockFd);
+
+    std::filesystem::path m_directory;
+    std::uint64_t m_maxBytes;
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;
+    std::vector<std::string> m_inserted;
+    std::atomic<std::uint64_t> m_hits{0};
+    std::atomic<std::uint64_t> m_misses{0};
+};
+
+#endif //RELOCATOR_SCANCACHE_HPP
@@ -0,0 +1,307 @@
+// src/ServeProtocol.cpp
+#include "ServeProtocol.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t kMaxLine = 1 << 20;
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;   // A vanished client must not kill the server with SIGPIPE
+#else
+constexpr int kSendFlags = 0;              // macOS: the sockets have SO_NOSIGPIPE set instead
+#endif
+
+std::string escape(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\') {
+            escaped += "\\\\";
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+std::string unescape(const std::string& value) {
+    std::string plain;
+    plain.reserve(value.size());
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '\\' && i + 1 < value.size()) {
+            plain += value[++i] == 'n' ? '\n' : value[i];
+        } else {
+            plain += value[i];
+        }
+    }
+    return plain;
+}
+
+const char* kindName(ExclusionKind kind) {
+    switch (kind) {
+        case ExclusionKind::Literal: return "literal";
+        case ExclusionKind::Glob:    return "glob";
+        case ExclusionKind::Prefix:  return "prefix";
+        case ExclusionKind::Regex:   return "regex";
+    }
+    return "literal";
+}
+
+ExclusionKind parseKind(const std::string& name) {
+    if (name == "literal") return ExclusionKind::Literal;
+    if (name == "glob") return ExclusionKind::Glob;
+    if (name == "prefix") return ExclusionKind::Prefix;
+    if (name == "regex") return ExclusionKind::Regex;
+    throw std::runtime_error("Bad request: unknown exclusion kind '" + name + "'");
+}
+
+unsigned long long parseNumber(const std::string& key, const std::string& value) {
+    try {
+        std::size_t used = 0;
+        const unsigned long long number = std::stoull(value, &used);
+        if (used == value.size()) {
+            return number;
+        }
+    } catch (const std::exception&) {
+    }
+    throw std::runtime_error("Bad request: '" + key + "' needs a number, got '" + value + "'");
+}
+
+} // namespace
+
+ServeChannel::~ServeChannel() {
+    ::close(m_fd);
+}
+
+bool ServeChannel::send(const std::string& key, const std::string& value) {
+    const std::string line = key + " " + escape(value) + "\n";
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    for (std::size_t sent = 0; sent < line.size();) {
+        const ssize_t n = ::send(m_fd, line.data() + sent, line.size() - sent, kSendFlags);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+bool ServeChannel::receive(std::string& key, std::string& value) {
+    std::size_t newline;
+    while ((newline = m_buffer.find('\n', m_scanned)) == std::string::npos) {
+        m_scanned = m_buffer.size();
+        if (m_buffer.size() > kMaxLine) {
+            throw std::runtime_error("Message too long");
+        }
+        char chunk[4096];
+        const ssize_t n = ::read(m_fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error(std::string("Cannot read from the socket: ") + std::strerror(errno));
+        }
+        if (n == 0) {
+            return false;
+        }
+        m_buffer.append(chunk, static_cast<std::size_t>(n));
+    }
+    const std::string line = m_buffer.substr(0, newline);
+    m_buffer.erase(0, newline + 1);
+    m_scanned = 0;
+
+    const std::size_t space = line.find(' ');
+    key = line.substr(0, space);
+    value = space == std::string::npos ? std::string() : unescape(line.substr(space + 1));
+    return true;
+}
+
+void ServeChannel::sendRequest(const ServeRequest& request) {
+    const BundleJob& job = request.job;
+    const RelocatorOptions& options = request.options;
+    const char* command = request.command == ServeRequest::Command::Ping     ? "ping"
+                        : request.command == ServeRequest::Command::Shutdown ? "shutdown"
+                                                                              : "bundle";
+    bool ok = send("version", std::to_string(kVersion)) && send("command", command);
+    for (const auto& input : job.request.inputs) ok = ok && send("input", input);
+    ok = ok && send("output", job.request.outputDir.string());
+    for (const auto& path : job.request.searchPaths) ok = ok && send("search", path);
+    for (const auto& rule : job.exclusions) {
+        // The origin is a flag name and never contains a space; the pattern may.
+        ok = ok && send("exclude", std::string(kindName(rule.kind)) + " " + rule.origin + " " + rule.pattern);
+    }
+    for (const auto& file : job.policyFiles) ok = ok && send("policy", file.string());
+    // Every RelocatorOptions field goes over except the streams and the scan cache's location
+    // and size, which are the server's own.
+    ok = ok && send("dry-run", options.dryRun ? "1" : "0")
+            && send("jobs", std::to_string(options.jobs))
+            && send("copy-jobs", std::to_string(options.copyJobs))
+            && send("fixup-jobs", std::to_string(options.fixupJobs))
+            && send("queue-depth", std::to_string(options.queueDepth))
+            && send("copy-mode", FileCopier::modeName(options.copyMode))
+            && send("strip", options.strip == StripMode::Debug ? "debug"
+                           : options.strip == StripMode::All   ? "all" : "none")
+            && send("prune-unused", options.pruneUnused == PruneMode::Report ? "report"
+                                  : options.pruneUnused == PruneMode::Drop   ? "drop" : "off")
+            && send("target", options.target == TargetPlatform::Linux   ? "linux"
+                            : options.target == TargetPlatform::MacOS   ? "macos"
+                            : options.target == TargetPlatform::Windows ? "windows" : "host")
+            && send("scan-cache", options.scanCache ? "1" : "0")
+            && send("hwcaps", options.hwcapVariants ? "1" : "0")
+            && send("load-check", options.loadCheck ? "1" : "0")
+            && send("profile-load", std::to_string(options.profileLoadRuns))
+            && send("stats-top", std::to_string(options.statsSlowest))
+            && send("stats", job.report.printStats ? "1" : "0");
+    if (!options.splitDebugDir.empty()) ok = ok && send("split-debug", options.splitDebugDir.string());
+    for (const auto& pattern : options.keepNeeded) ok = ok && send("keep-needed", pattern);
+    if (!options.storeDir.empty()) ok = ok && send("store", options.storeDir.string());
+    if (!job.report.statsJson.empty()) ok = ok && send("stats-json", job.report.statsJson.string());
+    if (!job.report.graphOut.empty()) ok = ok && send("graph-out", job.report.graphOut.string());
+    for (const auto& name : job.report.why) ok = ok && send("why", name);
+    if (!(ok && send("end", ""))) {
+        throw std::runtime_error("The server closed the connection");
+    }
+}
+
+ServeRequest ServeChannel::receiveRequest() {
+    ServeRequest request;
+    BundleJob& job = request.job;
+    RelocatorOptions& options = request.options;
+    std::string key, value;
+
+    if (!receive(key, value)) {
+        throw std::runtime_error("Bad request: empty");
+    }
+    if (key != "version" || value != std::to_string(kVersion)) {
+        throw std::runtime_error("Bad request: expected protocol version " + std::to_string(kVersion)
+                                 + "; client and server are different relocator builds");
+    }
+    while (true) {
+        if (!receive(key, value)) {
+            throw std::runtime_error("Bad request: truncated");
+        }
+        if (key == "end") {
+            break;
+        } else if (key == "command") {
+            if (value == "bundle") request.command = ServeRequest::Command::Bundle;
+            else if (value == "ping") request.command = ServeRequest::Command::Ping;
+            else if (value == "shutdown") request.command = ServeRequest::Command::Shutdown;
+            else throw std::runtime_error("Bad request: unknown command '" + value + "'");
+        } else if (key == "input") {
+            job.request.inputs.push_back(value);
+        } else if (key == "output") {
+            job.request.outputDir = value;
+        } else if (key == "search") {
+            job.request.searchPaths.push_back(value);
+        } else if (key == "exclude") {
+            const std::size_t first = value.find(' ');
+            const std::size_t second = first == std::string::npos ? first : value.find(' ', first + 1);
+            if (second == std::string::npos) {
+                throw std::runtime_error("Bad request: malformed exclusion '" + value + "'");
+            }
+            job.exclusions.push_back({ parseKind(value.substr(0, first)), value.substr(second + 1),
+                                       value.substr(first + 1, second - first - 1) });
+        } else if (key == "policy") {
+            job.policyFiles.emplace_back(value);
+        } else if (key == "dry-run") {
+            options.dryRun = value == "1";
+        } else if (key == "jobs") {
+            options.jobs = static_cast<unsigned>(parseNumber(key, value));
+        } else if (key == "copy-jobs") {
+            options.copyJobs = static_cast<unsigned>(parseNumber(key, value));
+        } else if (key == "fixup-jobs") {
+            options.fixupJobs = static_cast<unsigned>(parseNumber(key, value));
+        } else if (key == "queue-depth") {
+            options.queueDepth = static_cast<size_t>(parseNumber(key, value));
+        } else if (key == "copy-mode") {
+            options.copyMode = FileCopier::parseMode(value);
+        } else if (key == "strip") {
+            if (value == "none") options.strip = StripMode::None;
+            else if (value == "debug") options.strip = StripMode::Debug;
+            else if (value == "all") options.strip = StripMode::All;
+            else throw std::runtime_error("Bad request: unknown strip mode '" + value + "'");
+        } else if (key == "split-debug") {
+            options.splitDebugDir = value;
+        } else if (key == "prune-unused") {
+            if (value == "off") options.pruneUnused = PruneMode::Off;
+            else if (value == "report") options.pruneUnused = PruneMode::Report;
+            else if (value == "drop") options.pruneUnused = PruneMode::Drop;
+            else throw std::runtime_error("Bad request: unknown prune mode '" + value + "'");
+        } else if (key == "keep-needed") {
+            options.keepNeeded.push_back(value);
+        } else if (key == "store") {
+            options.storeDir = value;
+        } else if (key == "target") {
+            if (value == "host") options.target = TargetPlatform::Host;
+            else if (value == "linux") options.target = TargetPlatform::Linux;
+            else if (value == "macos") options.target = TargetPlatform::MacOS;
+            else if (value == "windows") options.target = TargetPlatform::Windows;
+            else throw std::runtime_error("Bad request: unknown target '" + value + "'");
+        } else if (key == "scan-cache") {
+            options.scanCache = value == "1";
+        } else if (key == "hwcaps") {
+            options.hwcapVariants = value == "1";
+        } else if (key == "load-check") {
+            options.loadCheck = value == "1";
+        } else if (key == "profile-load") {
+            options.profileLoadRuns = static_cast<unsigned>(parseNumber(key, value));
+        } else if (key == "stats-top") {
+            options.statsSlowest = static_cast<size_t>(parseNumber(key, value));
+        } else if (key == "stats") {
+            job.report.printStats = value == "1";
+        } else if (key == "stats-json") {
+            job.report.statsJson = value;
+        } else if (key == "graph-out") {
+            job.report.graphOut = value;
+        } else if (key == "why") {
+            job.report.why.push_back(value);
+        } else {
+            throw std::runtime_error("Bad request: unknown field '" + key + "'");
+        }
+    }
+    return request;
+}
+
+ChannelStreamBuf::int_type ChannelStreamBuf::overflow(int_type ch) {
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        const char c = traits_type::to_char_type(ch);
+        xsputn(&c, 1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize ChannelStreamBuf::xsputn(const char* data, std::streamsize count) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.append(data, static_cast<std::size_t>(count));
+    flushLines();
+    return count;
+}
+
+int ChannelStreamBuf::sync() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_pending.empty()) {
+        m_channel.send(m_key, m_pending);
+        m_pending.clear();
+    }
+    return 0;
+}
+
+void ChannelStreamBuf::flushLines() {
+    const std::size_t end = m_pending.rfind('\n');
+    if (end != std::string::npos) {
+        m_channel.send(m_key, m_pending.substr(0, end + 1));
+        m_pending.erase(0, end + 1);
+    }
+}
@@ -0,0 +1,104 @@
+// src/ServeProtocol.hpp
+#ifndef RELOCATOR_SERVEPROTOCOL_HPP
+#define RELOCATOR_SERVEPROTOCOL_HPP
+
+#include "Relocator.hpp"
+#include "RelocatorSession.hpp"
+
+#include <cstddef>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <utility>
+
+/**
+ * @struct ServeRequest
+ * @brief One request a client sends to `relocator --serve`.
+ */
+struct ServeRequest {
+    enum class Command { Bundle, Ping, Shutdown };
+
+    Command command = Command::Bundle;
+    BundleJob job;               // Paths must be absolute: the server does not share the client's directory
+    RelocatorOptions options;    // log, errorLog and the scan cache location are the server's own
+};
+
+/**
+ * @class ServeChannel
+ * @brief Line-framed messages over a connected socket.
+ *
+ * Every message is one line "<key> <value>", with backslashes and newlines in the
+ * value escaped. A request is a "version" line, then fields, then "end". The server
+ * answers with "out" and "err" messages carrying the job's log text verbatim as it
+ * runs, then one "exit <code>" message.
+ *
+ * Reading is for one thread; send() may be called from several.
+ */
+class ServeChannel {
+public:
+    static constexpr int kVersion = 2;
+
+    /**
+     * @param fd A connected socket; the channel closes it.
+     */
+    explicit ServeChannel(int fd) : m_fd(fd) {}
+    ~ServeChannel();
+    ServeChannel(const ServeChannel&) = delete;
+    ServeChannel& operator=(const ServeChannel&) = delete;
+
+    /**
+     * Sends one message.
+     * @return false if the peer has gone away.
+     */
+    bool send(const std::string& key, const std::string& value);
+
+    /**
+     * Reads the next message.
+     * @return false at end of stream.
+     * @throws std::runtime_error on a read error or an over-long line.
+     */
+    bool receive(std::string& key, std::string& value);
+
+    void sendRequest(const ServeRequest& request);
+
+    /**
+     * @throws std::runtime_error if the request is truncated, malformed or of another version.
+     */
+    ServeRequest receiveRequest();
+
+private:
+    int m_fd;
+    std::mutex m_sendMutex;
+    std::string m_buffer;     // Received bytes not yet returned
+    std::size_t m_scanned = 0;
+};
+
+/**
+ * @class ChannelStreamBuf
+ * @brief Sends what is written to an ostream as channel messages.
+ *
+ * Lets the relocator's log streams feed a client. Text is sent a line at a time, and
+ * whatever is pending when the stream is flushed, so a client sees progress as it
+ * happens. Writing from several threads is safe as long as each message is written
+ * under one lock, as the relocators do.
+ */
+class ChannelStreamBuf : public std::streambuf {
+public:
+    ChannelStreamBuf(ServeChannel& channel, std::string key) : m_channel(channel), m_key(std::move(key)) {}
+    ~ChannelStreamBuf() override { sync(); }
+
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* data, std::streamsize count) override;
+    int sync() override;
+
+private:
+    void flushLines();
+
+    ServeChannel& m_channel;
+    std::string m_key;
+    std::mutex m_mutex;
+    std::string m_pending;
+};
+
+#endif //RELOCATOR_SERVEPROTOCOL_HPP
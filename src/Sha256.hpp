@@ -0,0 +1,54 @@
+// src/Sha256.hpp
+#ifndef RELOCATOR_SHA256_HPP
+#define RELOCATOR_SHA256_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+/**
+ * @class Sha256
+ * @brief SHA-256 (FIPS 180-4), for names that must not collide even between files
+ * nobody chose, such as the keys of a LibraryStore shared across builds.
+ *
+ * BundleManifest's 64-bit hash is enough to notice that one file changed; this one is
+ * for telling apart every file that will ever be named by its digest.
+ */
+class Sha256 {
+public:
+    using Digest = std::array<std::uint8_t, 32>;
+
+    Sha256();
+
+    void update(const void* data, std::size_t size);
+
+    /**
+     * Pads the message and returns its digest. The object must not be updated afterwards.
+     */
+    Digest finish();
+
+    /**
+     * The digest of a file's contents, in lowercase hex.
+     * @throws std::runtime_error if the file cannot be read.
+     */
+    static std::string hashFile(const std::filesystem::path& file);
+
+    /**
+     * The digest of a byte string, in lowercase hex.
+     */
+    static std::string hashBytes(const void* data, std::size_t size);
+
+    static std::string hex(const Digest& digest);
+
+private:
+    void compress(const std::uint8_t* block);
+
+    std::array<std::uint32_t, 8> m_state;
+    std::array<std::uint8_t, 64> m_buffer{};
+    std::size_t m_buffered = 0;
+    std::uint64_t m_length = 0;       // Bytes hashed so far
+};
+
+#endif //RELOCATOR_SHA256_HPP
@@ -0,0 +1,134 @@
+// src/TarWriter.cpp
+#include "TarWriter.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+
+constexpr std::size_t kBlock = 512;
+
+// An octal field, NUL-terminated; every value written here fits the ustar fields.
+void octal(char* field, std::size_t width, std::uint64_t value) {
+    std::snprintf(field, width, "%0*llo", static_cast<int>(width - 1), static_cast<unsigned long long>(value));
+}
+
+// One "<length> <key>=<value>\n" record; the length counts its own digits.
+std::string paxRecord(const std::string& key, const std::string& value) {
+    const std::size_t body = key.size() + value.size() + 3;   // ' ', '=' and '\n'
+    std::size_t length = body + 1;
+    while (std::to_string(length).size() + body != length) {
+        ++length;
+    }
+    return std::to_string(length) + " " + key + "=" + value + "\n";
+}
+
+} // namespace
+
+TarWriter::TarWriter(const std::filesystem::path& archive)
+    : m_path(archive), m_partial(archive.string() + ".partial") {
+    if (const char* epoch = std::getenv("SOURCE_DATE_EPOCH")) {
+        m_mtime = std::strtoull(epoch, nullptr, 10);
+    }
+    m_file = std::fopen(m_partial.c_str(), "wb");
+    if (m_file == nullptr) {
+        throw std::runtime_error("Cannot create " + m_partial.string() + ": " + std::strerror(errno));
+    }
+}
+
+TarWriter::~TarWriter() {
+    if (m_file != nullptr) {
+        std::fclose(m_file);
+        std::error_code ec;
+        std::filesystem::remove(m_partial, ec);
+    }
+}
+
+bool TarWriter::isArchivePath(const std::filesystem::path& path) {
+    std::error_code ec;
+    return path.extension() == ".tar" && !std::filesystem::is_directory(path, ec);
+}
+
+void TarWriter::addDirectory(const std::string& name, unsigned mode) {
+    writeHeader(name.back() == '/' ? name : name + "/", '5', mode, 0);
+}
+
+void TarWriter::addFile(const std::string& name, unsigned mode, const std::uint8_t* data, std::uint64_t size) {
+    writeHeader(name, '0', mode, size);
+    write(data, size);
+    pad();
+}
+
+void TarWriter::finish() {
+    const char zeros[kBlock * 2] = {};
+    write(zeros, sizeof(zeros));
+    const bool failed = std::fflush(m_file) != 0 || std::ferror(m_file);
+    const int closed = std::fclose(m_file);
+    m_file = nullptr;
+    std::error_code ec;
+    if (failed || closed != 0) {
+        std::filesystem::remove(m_partial, ec);
+        throw std::runtime_error("Cannot write " + m_path.string());
+    }
+    std::filesystem::rename(m_partial, m_path, ec);
+    if (ec) {
+        std::filesystem::remove(m_partial, ec);
+        throw std::runtime_error("Cannot move the archive into place at " + m_path.string() + ": " + ec.message());
+    }
+}
+
+void TarWriter::writeHeader(const std::string& name, char type, unsigned mode, std::uint64_t size) {
+    // ustar holds a name of up to 100 bytes, or 155 + '/' + 100 split at a separator.
+    std::string prefix, last = name;
+    if (name.size() > 100) {
+        const std::size_t split = name.find('/', name.size() - 101);
+        if (split != std::string::npos && split > 0 && split <= 155 && name.size() - split - 1 <= 100
+            && name.size() - split - 1 > 0) {
+            prefix = name.substr(0, split);
+            last = name.substr(split + 1);
+        } else {
+            const std::string record = paxRecord("path", name);
+            writeHeader("PaxHeaders/" + std::to_string(record.size()), 'x', 0644, record.size());
+            write(record.data(), record.size());
+            pad();
+            last = name.substr(name.size() - std::min<std::size_t>(name.size(), 100));
+        }
+    }
+
+    char header[kBlock] = {};
+    std::memcpy(header, last.data(), std::min<std::size_t>(last.size(), 100));
+    octal(header + 100, 8, mode & 07777);
+    octal(header + 108, 8, 0);                   // uid
+    octal(header + 116, 8, 0);                   // gid
+    octal(header + 124, 12, size);
+    octal(header + 136, 12, m_mtime);
+    std::memset(header + 148, ' ', 8);           // The checksum counts its own field as spaces
+    header[156] = type;
+    std::memcpy(header + 257, "ustar", 6);
+    std::memcpy(header + 263, "00", 2);
+    std::memcpy(header + 345, prefix.data(), std::min<std::size_t>(prefix.size(), 155));
+    unsigned checksum = 0;
+    for (unsigned char c : header) {
+        checksum += c;
+    }
+    std::snprintf(header + 148, 8, "%06o", checksum);   // Six digits, NUL, then the space already there
+    write(header, sizeof(header));
+}
+
+void TarWriter::write(const void* data, std::size_t size) {
+    if (size > 0 && std::fwrite(data, 1, size, m_file) != size) {
+        throw std::runtime_error("Cannot write " + m_partial.string() + ": " + std::strerror(errno));
+    }
+    m_size += size;
+}
+
+void TarWriter::pad() {
+    const char zeros[kBlock] = {};
+    if (m_size % kBlock != 0) {
+        write(zeros, kBlock - m_size % kBlock);
+    }
+}
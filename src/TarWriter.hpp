@@ -0,0 +1,80 @@
+// src/TarWriter.hpp
+#ifndef RELOCATOR_TARWRITER_HPP
+#define RELOCATOR_TARWRITER_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+/**
+ * @class TarWriter
+ * @brief Writes a POSIX (ustar) tar archive sequentially, one member after the other.
+ *
+ * Members carry nothing that depends on when or by whom the archive was made: owner and
+ * group are 0 without names, and every timestamp is $SOURCE_DATE_EPOCH, or 0 if it is
+ * not set. The same members added in the same order give the same bytes. Names too long
+ * for the ustar name and prefix fields get a PAX extended header.
+ *
+ * The archive is written under a temporary name and renamed into place by finish(), so
+ * a failed run never leaves a truncated archive where a good one was.
+ */
+class TarWriter {
+public:
+    /**
+     * Starts an archive.
+     * @throws std::runtime_error if it cannot be created.
+     */
+    explicit TarWriter(const std::filesystem::path& archive);
+
+    /**
+     * Removes the unfinished archive unless finish() was called.
+     */
+    ~TarWriter();
+
+    TarWriter(const TarWriter&) = delete;
+    TarWriter& operator=(const TarWriter&) = delete;
+
+    /**
+     * Adds a directory. Names are relative, with '/' separators.
+     * @throws std::runtime_error on write errors.
+     */
+    void addDirectory(const std::string& name, unsigned mode = 0755);
+
+    /**
+     * Adds a regular file with the given contents.
+     * @param mode Permission bits.
+     * @throws std::runtime_error on write errors.
+     */
+    void addFile(const std::string& name, unsigned mode, const std::uint8_t* data, std::uint64_t size);
+
+    /**
+     * Writes the end-of-archive marker and moves the archive into place.
+     * @throws std::runtime_error on write errors.
+     */
+    void finish();
+
+    /**
+     * Bytes written so far, headers and padding included.
+     */
+    std::uint64_t size() const { return m_size; }
+
+    /**
+     * Whether an output path names an archive rather than a bundle directory: it ends in
+     * ".tar" and is not an existing directory.
+     */
+    static bool isArchivePath(const std::filesystem::path& path);
+
+private:
+    void writeHeader(const std::string& name, char type, unsigned mode, std::uint64_t size);
+    void write(const void* data, std::size_t size);
+    void pad();
+
+    std::filesystem::path m_path;
+    std::filesystem::path m_partial;
+    std::FILE* m_file = nullptr;
+    std::uint64_t m_size = 0;
+    std::uint64_t m_mtime = 0;
+};
+
+#endif //RELOCATOR_TARWRITER_HPP
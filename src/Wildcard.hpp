@@ -0,0 +1,64 @@
+// src/Wildcard.hpp
+#ifndef RELOCATOR_WILDCARD_HPP
+#define RELOCATOR_WILDCARD_HPP
+
+#include <string>
+
+namespace Wildcard {
+    inline bool hasWildcard(const std::string& value) {
+        return value.find_first_of("*?[") != std::string::npos;
+    }
+
+    /**
+     * Shell-style matching of one name against '*', '?' and '[...]' (with '!' or '^' negation).
+     */
+    inline bool match(const std::string& pattern, const std::string& name) {
+        size_t p = 0, n = 0;
+        size_t starP = std::string::npos, starN = 0;
+        while (n < name.size()) {
+            if (p < pattern.size() && pattern[p] == '*') {
+                starP = p++;
+                starN = n;
+                continue;
+            }
+            if (p < pattern.size() && pattern[p] == '[') {
+                // Character class: [abc], [a-z], [!abc] or [^abc].
+                size_t q = p + 1;
+                const bool negate = q < pattern.size() && (pattern[q] == '!' || pattern[q] == '^');
+                if (negate) ++q;
+                bool matched = false;
+                bool first = true;
+                while (q < pattern.size() && (first || pattern[q] != ']')) {
+                    first = false;
+                    if (q + 2 < pattern.size() && pattern[q + 1] == '-' && pattern[q + 2] != ']') {
+                        matched |= (name[n] >= pattern[q] && name[n] <= pattern[q + 2]);
+                        q += 3;
+                    } else {
+                        matched |= (name[n] == pattern[q]);
+                        ++q;
+                    }
+                }
+                if (q < pattern.size() && matched != negate) {
+                    p = q + 1;
+                    ++n;
+                    continue;
+                }
+            } else if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+                ++p;
+                ++n;
+                continue;
+            }
+            if (starP == std::string::npos) {
+                return false;
+            }
+            p = starP + 1;
+            n = ++starN;
+        }
+        while (p < pattern.size() && pattern[p] == '*') {
+            ++p;
+        }
+        return p == pattern.size();
+    }
+}
+
+#endif //RELOCATOR_WILDCARD_HPP
@@ -1,14 +1,281 @@
 // src/Windows_Relocator.cpp
 #include "Windows_Relocator.hpp"
+#include "BundleManifest.hpp"
+#include "ConcurrentSet.hpp"
+#include "DependencyGraph.hpp"
+#include "DllResolver.hpp"
+#include "FileCopier.hpp"
+#include "PeFile.hpp"
+#include "PipelineStage.hpp"
+#include "WorkStealingPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+#if defined(_WIN32)
+#include <windows.h>
+#endif
 
 void Windows_Relocator::bundleDependencies(
-    const std::filesystem::path& inputFile,
+    const std::vector<BundleInput>& inputs,
     const std::filesystem::path& outputDir,
     const std::vector<std::string>& searchPaths,
-    const std::vector<std::string>& literalExclusions,
-    const std::vector<std::string>& regexExclusions) {
-    std::cout << "\n--- Windows Relocation Logic (Not Yet Implemented) ---" << std::endl;
-    std::cout << "Would analyze PE header for DLL dependencies." << std::endl;
-    std::cout << "Would copy dependencies to the same directory as the executable." << std::endl;
+    const ExclusionPolicy& exclusions) {
+
+    m_log << "\n=== Starting Windows Relocation ===\n";
+    beginRun();
+    PhaseStats& discoverStats = m_stats.phase(Phase::Discover);
+    PhaseStats& copyStats = m_stats.phase(Phase::Copy);
+
+    using NodeId = DependencyGraph::NodeId;
+    DependencyGraph& graph = m_graph;
+    DllResolver resolver(searchPaths);
+
+    std::mutex logMutex;
+    auto print = [&](const std::ostringstream& log) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        m_log << log.str() << std::flush;
+    };
+
+    // The application directory is the first executable's; a bundle of DLLs uses the primary input's.
+    // Dependencies are copied next to that executable inside the bundle, where the loader looks first.
+    const BundleInput* application = &inputs.front();
+    for (const auto& input : inputs) {
+        if (PeFile::isPe(input.file) && !PeFile(input.file).isDll()) {
+            application = &input;
+            break;
+        }
+    }
+    const std::filesystem::path applicationDir = std::filesystem::canonical(application->file).parent_path();
+    const std::filesystem::path dependencyDir = application->bundlePath.parent_path();
+
+    // Roots keep the place in the bundle they were given.
+    std::unordered_map<NodeId, std::filesystem::path> rootPlacement;
+    std::vector<NodeId> roots;
+    for (const auto& input : inputs) {
+        const NodeId root = graph.addNode(std::filesystem::canonical(input.file));
+        if (rootPlacement.emplace(root, input.bundlePath).second) {
+            graph.markRoot(root);
+            roots.push_back(root);
+        }
+    }
+    auto locationOf = [&](NodeId node) {
+        auto it = rootPlacement.find(node);
+        return it != rootPlacement.end() ? it->second : dependencyDir / graph.path(node).filename();
+    };
+
+    BundleManifest manifest;
+    manifest.load(outputDir);
+
+    // --- Stage 2: copy each file as soon as it is discovered ---
+    // With nothing to patch, the copy is the last step for a file and records it in the manifest.
+    std::atomic<uint64_t> logicalBytes{0};
+    std::atomic<uint64_t> movedBytes{0};
+    std::mutex upToDateMutex;
+    std::set<NodeId> upToDateFiles;
+    PipelineStage<NodeId> copyStage("copy", m_options.copyJobs, m_options.queueDepth,
+        [&](NodeId& node) {
+            const std::filesystem::path& originalPath = graph.path(node);
+            const std::filesystem::path newPath = outputDir / locationOf(node);
+            PhaseStats::Scope timing(copyStats, originalPath.string());
+
+            ManifestEntry entry;
+            entry.name = locationOf(node).generic_string();
+            entry.source = originalPath;
+            entry.sourceId = BundleManifest::identify(originalPath);
+
+            // The previous copy is kept if it is untouched and came from the same bytes.
+            std::optional<ManifestEntry> previous = manifest.find(entry.name);
+            if (previous && previous->source == originalPath && previous->outputId.size != 0
+                && previous->outputId == BundleManifest::identify(newPath)) {
+                if (previous->sourceId == entry.sourceId) {
+                    entry.contentHash = previous->contentHash;
+                } else {
+                    entry.contentHash = BundleManifest::hashFile(originalPath);
+                    copyStats.addBytesRead(entry.sourceId.size);
+                }
+                if (entry.contentHash == previous->contentHash) {
+                    entry.outputId = previous->outputId;
+                    manifest.record(entry);
+                    std::lock_guard<std::mutex> lock(upToDateMutex);
+                    upToDateFiles.insert(node);
+                    return;
+                }
+            }
+
+            std::ostringstream log;
+            log << "  " << (m_dryRun ? "Would copy" : "Copying") << " " << originalPath.filename() << " to " << newPath;
+            if (m_dryRun) {
+                copyStage.addBytes(std::filesystem::file_size(originalPath));
+            } else {
+                std::filesystem::create_directories(newPath.parent_path());
+                CopyResult result = FileCopier::copy(originalPath, newPath, m_options.copyMode);
+                log << " (" << FileCopier::methodName(result.method) << ")";
+                copyStage.addBytes(result.logicalBytes);
+                logicalBytes += result.logicalBytes;
+                movedBytes += result.bytesMoved;
+                copyStats.addBytesCopied(result.logicalBytes);
+                copyStats.addBytesWritten(result.bytesMoved);
+                entry.contentHash = BundleManifest::hashFile(originalPath);
+                copyStats.addBytesRead(entry.sourceId.size);
+                entry.outputId = BundleManifest::identify(newPath);
+                manifest.record(entry);
+            }
+            log << "\n";
+            print(log);
+        });
+
+    // --- Stage 1: discovery ---
+    // Where a DLL is found does not depend on the chain that imported it, so each file is visited once.
+    ConcurrentSet visited;
+    WorkStealingPool pool(m_options.jobs);
+
+    std::function<void(NodeId)> visit = [&](NodeId node) {
+        const std::filesystem::path& currentFile = graph.path(node);
+        if (!visited.insert(currentFile.string())) {
+            return;
+        }
+        PhaseStats::Scope timing(discoverStats, currentFile.string());
+        copyStage.push(node);
+
+        // Each file's messages are buffered and printed together so threads do not interleave lines.
+        std::ostringstream log;
+        log << "  Processing: " << currentFile << "\n";
+        std::optional<PeFile> image;
+        try {
+            image.emplace(currentFile);
+            discoverStats.addBytesRead(image->size());
+        } catch (const std::exception& e) {
+            log << "  " << warning("Could not read the imports of " + currentFile.string() + ": " + e.what()) << "\n";
+        }
+
+        std::vector<DependencyGraph::Edge> edges;
+        std::vector<NodeId> children;
+        for (const PeImport& import : image ? image->imports() : std::vector<PeImport>()) {
+            // User rules match the name as the import spells it; the built-in ones are lowercase.
+            const ExclusionRule* rule = exclusions.matchName(import.name);
+            if (!rule) {
+                rule = exclusions.matchName(DllResolver::lowercase(import.name));
+            }
+            std::optional<std::filesystem::path> depPath;
+            if (!rule) {
+                depPath = resolver.resolve(import.name, image->machine(), applicationDir, currentFile.parent_path());
+                if (depPath) {
+                    rule = exclusions.matchPath(*depPath);
+                }
+            }
+            if (rule) {
+                // The OS DLLs are skipped on every file; only user rules are worth a line.
+                if (rule->origin != "built-in") {
+                    log << "    --> Ignoring library: " << import.name << " [" << rule->describe() << "]\n";
+                }
+                continue;
+            }
+            if (!depPath) {
+                log << "  " << warning("Could not find " + std::string(import.delayed ? "delay-loaded " : "")
+                                       + "dependency " + import.name + " of " + currentFile.string()) << "\n";
+                continue;
+            }
+
+            const NodeId dep = graph.addNode(*depPath);
+            edges.push_back({ graph.addName(import.name), dep });
+            children.push_back(dep);
+        }
+
+        graph.mergeEdges(node, edges);
+        print(log);
+        for (NodeId child : children) {
+            pool.submit([&visit, child] { visit(child); });
+        }
+    };
+
+    const auto started = std::chrono::steady_clock::now();
+    m_log << "Phase 1: Discovering all dependencies";
+    if (pool.size() > 1) {
+        m_log << " using " << pool.size() << " threads";
+    }
+    m_log << ", " << (m_dryRun ? "planning to copy" : "copying") << " each file as it is found..." << std::endl;
+    for (NodeId root : roots) {
+        pool.submit([&visit, root] { visit(root); });
+    }
+    pool.wait();
+    graph.freeze();
+    const double discoverySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    m_log << "\n--- Dependency Analysis Complete ---" << std::endl;
+    m_log << "Found " << graph.size() << " total files to process.\n\n";
+
+    copyStage.close();
+    copyStage.join();
+
+    // --- Phase 3: Nothing to fix up ---
+    m_log << "Phase 3: No fixups needed; Windows looks for DLLs in the application directory first." << std::endl;
+
+    std::set<std::string> bundledNames;
+    for (NodeId node = 0; node < graph.size(); ++node) {
+        bundledNames.insert(locationOf(node).generic_string());
+    }
+    for (const auto& entry : manifest.stale()) {
+        if (bundledNames.count(entry.name)) {
+            continue;
+        }
+        m_log << "  " << (m_dryRun ? "Would remove" : "Removing") << " stale file " << entry.name << std::endl;
+        m_result.removed.push_back(entry.name);
+        if (!m_dryRun) {
+            std::error_code ec;
+            std::filesystem::remove(outputDir / entry.name, ec);
+        }
+    }
+    if (!m_dryRun) {
+        manifest.save(outputDir);
+    }
+    const double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    m_log << "\nPipeline throughput (" << std::fixed << std::setprecision(3) << totalSeconds
+              << " s end to end, discovery " << discoverySeconds << " s):\n" << std::defaultfloat;
+    copyStage.stats().print(m_log);
+    if (!upToDateFiles.empty()) {
+        m_log << "  " << upToDateFiles.size() << " of " << graph.size() << " files were already up to date.\n";
+    }
+    if (!m_dryRun) {
+        m_log << "  " << std::fixed << std::setprecision(1) << logicalBytes / (1024.0 * 1024.0) << " MiB bundled, "
+                  << movedBytes / (1024.0 * 1024.0) << " MiB actually copied.\n" << std::defaultfloat;
+    }
+    for (NodeId node : graph.nodesByPath()) {
+        m_result.files.push_back({ graph.path(node), locationOf(node), graph.isRoot(node), upToDateFiles.count(node) != 0 });
+    }
+
+    // --- Phase 4: Verify the relocated executable ---
+    m_log << "\nPhase 4: " << (m_dryRun ? "Planning to verify" : "Verifying") << " bundled library..." << std::endl;
+    if (!m_dryRun && m_options.loadCheck) {
+#if defined(_WIN32)
+        PhaseStats& loadStats = m_stats.phase(Phase::LoadCheck);
+        const std::filesystem::path primaryInBundle = outputDir / inputs.front().bundlePath;
+        m_log << "  Attempting to load: " << primaryInBundle << std::endl;
+        PhaseStats::Scope timing(loadStats, primaryInBundle.string());
+
+        // Imports resolve from the bundle's directory; an executable's entry point never runs.
+        HMODULE handle = LoadLibraryExW(primaryInBundle.c_str(), nullptr, LOAD_WITH_ALTERED_SEARCH_PATH);
+        m_result.loadChecked = true;
+        if (!handle) {
+            m_result.loadError = "LoadLibraryEx failed with error " + std::to_string(GetLastError());
+            m_errorLog << "\n  VERIFICATION FAILED: " << m_result.loadError << std::endl;
+        } else {
+            m_log << "\n  Verification SUCCESS: Library loaded successfully." << std::endl;
+            FreeLibrary(handle);
+        }
+#else
+        m_log << "  Skipped: Windows binaries cannot be loaded on this host." << std::endl;
+#endif
+    } else if (!m_options.loadCheck) {
+        m_log << "  Skipped: the load check is disabled." << std::endl;
+    } else {
+        m_log << "  Would test loading the main executable or DLL with LoadLibraryEx." << std::endl;
+    }
+    m_stats.finish();
 }
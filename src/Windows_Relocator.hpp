@@ -4,14 +4,22 @@
 
 #include "Relocator.hpp"
 
+/**
+ * @class Windows_Relocator
+ * @brief Bundles PE executables and DLLs. Needs no Windows tools, so it also runs on Linux and macOS.
+ *
+ * Windows looks for a DLL in the application's directory before anywhere else, so
+ * bundling is copying every dependency next to the executable; nothing is patched.
+ */
 class Windows_Relocator : public Relocator {
 public:
     using Relocator::Relocator;
     void bundleDependencies(
-        const std::filesystem::path& inputFile,
+        const std::vector<BundleInput>& inputs,
         const std::filesystem::path& outputDir,
         const std::vector<std::string>& searchPaths,
-        const std::vector<std::string>& literalExclusions,
-        const std::vector<std::string>& regexExclusions
+        const ExclusionPolicy& exclusions
     ) override;
-};
\ No newline at end of file
+};
+
+#endif //RELOCATOR_WINDOWS_RELOCATOR_HPP
@@ -0,0 +1,166 @@
+// src/WorkStealingPool.hpp
+#ifndef RELOCATOR_WORKSTEALINGPOOL_HPP
+#define RELOCATOR_WORKSTEALINGPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class WorkStealingPool
+ * @brief A fixed-size thread pool where each worker owns a task deque.
+ *
+ * Tasks submitted from inside a worker go to that worker's own deque and are
+ * popped LIFO, which keeps a depth-first traversal cache-friendly. Idle workers
+ * steal FIFO from the other end of their peers' deques, so a single root that
+ * fans out quickly spreads across all threads.
+ */
+class WorkStealingPool {
+public:
+    /**
+     * @param threads Number of workers; 0 means one per hardware thread.
+     */
+    explicit WorkStealingPool(unsigned threads) {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        m_queues.reserve(threads);
+        for (unsigned i = 0; i < threads; ++i) {
+            m_queues.push_back(std::make_unique<Queue>());
+        }
+        for (unsigned i = 0; i < threads; ++i) {
+            m_workers.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (auto& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(m_workers.size()); }
+
+    /**
+     * Queues a task. May be called from any thread, including from inside a task.
+     */
+    void submit(std::function<void()> task) {
+        m_pending.fetch_add(1, std::memory_order_relaxed);
+        const std::size_t target = (t_owner == this) ? t_index : m_nextQueue.fetch_add(1) % m_queues.size();
+        {
+            std::lock_guard<std::mutex> lock(m_queues[target]->mutex);
+            m_queues[target]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            ++m_epoch;
+        }
+        m_wake.notify_one();
+    }
+
+    /**
+     * Blocks until every submitted task, including tasks submitted by tasks, has finished.
+     * @throws The first exception thrown by any task.
+     */
+    void wait() {
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_idle.wait(lock, [this] { return m_pending.load() == 0; });
+        if (m_error) {
+            std::exception_ptr error = m_error;
+            m_error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool take(std::size_t self, std::function<void()>& task) {
+        {
+            std::lock_guard<std::mutex> lock(m_queues[self]->mutex);
+            if (!m_queues[self]->tasks.empty()) {
+                task = std::move(m_queues[self]->tasks.back());
+                m_queues[self]->tasks.pop_back();
+                return true;
+            }
+        }
+        for (std::size_t n = 1; n < m_queues.size(); ++n) {
+            Queue& victim = *m_queues[(self + n) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(std::size_t index) {
+        t_owner = this;
+        t_index = index;
+        for (;;) {
+            const std::uint64_t epoch = m_epoch.load();
+
+            std::function<void()> task;
+            if (take(index, task)) {
+                try {
+                    task();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(m_sleepMutex);
+                    if (!m_error) {
+                        m_error = std::current_exception();
+                    }
+                }
+                if (m_pending.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(m_sleepMutex);
+                    m_idle.notify_all();
+                }
+                continue;
+            }
+
+            // Nothing to run or steal: sleep until something is submitted after our last look.
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_wake.wait(lock, [&] { return m_stopping || m_epoch != epoch; });
+            if (m_stopping) {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::atomic<std::size_t> m_nextQueue{0};
+    std::atomic<std::size_t> m_pending{0};
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::atomic<std::uint64_t> m_epoch{0};      // Bumped (under m_sleepMutex) on every submit
+    bool m_stopping = false;
+    std::exception_ptr m_error;
+
+    static inline thread_local WorkStealingPool* t_owner = nullptr;
+    static inline thread_local std::size_t t_index = 0;
+};
+
+#endif //RELOCATOR_WORKSTEALINGPOOL_HPP
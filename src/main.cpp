@@ -1,29 +1,26 @@
+#include <filesystem>
 #include <iostream>
-#include <memory> // For std::unique_ptr
-#include <stdexcept>
 
 #include "CLI/CLI.hpp"
-#include "Relocator.hpp"
-
-// Forward declare the factory function to create the platform-specific relocator
-std::unique_ptr<Relocator> createPlatformRelocator(bool dryRun);
+#include "RelocatorSession.hpp"
+#if !defined(_WIN32)
+#include "RelocatorServer.hpp"
+#endif
 
 int main(int argc, char* argv[]) {
     // --- Command-Line Argument Parsing ---
     CLI::App app{"A tool to bundle shared library dependencies for an executable or library."};
     app.set_version_flag("--version", "1.0.0");
 
-    std::filesystem::path inputFile;
-    app.add_option("-i,--input", inputFile, "The main library or executable to fix up")
-       ->required()
-       ->check(CLI::ExistingFile);
+    BundleJob job;
+    app.add_option("-i,--input", job.request.inputs,
+                   "Libraries or executables to fix up; may be repeated, and accepts directories "
+                   "(searched recursively, e.g. a plugin folder) and globs. The first is the primary input.");
 
-    std::filesystem::path outputDir;
-    app.add_option("-o,--output", outputDir, "The directory to copy dependencies into (e.g., YourApp.app/Contents/Frameworks)")
-       ->required();
+    app.add_option("-o,--output", job.request.outputDir, "The directory to copy dependencies into (e.g., YourApp.app/Contents/Frameworks), "
+                   "or for Linux bundles a .tar archive to stream them into, patched in memory without staging them on disk");
 
-    std::vector<std::string> searchPaths;
-    app.add_option("-s,--search", searchPaths, "Additional directories to search for libraries");
+    app.add_option("-s,--search", job.request.searchPaths, "Additional directories to search for libraries");
 
     std::vector<std::string> literalExclusions;
     app.add_option("-e,--exclude", literalExclusions, "Literal library filenames to exclude (can be used multiple times)");
@@ -32,50 +29,158 @@ int main(int argc, char* argv[]) {
     std::vector<std::string> regexExclusions;
     app.add_option("-r,--regex-exclude", regexExclusions, "Regex patterns to exclude library filenames (e.g., \"libX.*\\.dylib\")");
 
-    bool dryRun = false;
-    app.add_flag("-d,--dry-run", dryRun, "Print commands without executing them");
+    std::vector<std::string> globExclusions;
+    app.add_option("--exclude-glob", globExclusions, "Shell patterns to exclude library filenames, or full paths if they contain '/'");
+
+    std::vector<std::string> prefixExclusions;
+    app.add_option("--exclude-prefix", prefixExclusions, "Directories whose libraries are never bundled (e.g., /opt/vendor/lib)");
+
+    app.add_option("--policy", job.policyFiles, "Exclusion policy files with one 'literal|glob|prefix|regex <pattern>' rule per line")
+       ->check(CLI::ExistingFile);
+
+    RelocatorOptions options;
+    app.add_flag("-d,--dry-run", options.dryRun, "Print commands without executing them");
+
+    app.add_option("-j,--jobs", options.jobs, "Worker threads for dependency discovery (0 = one per CPU)");
+    app.add_option("--copy-jobs", options.copyJobs, "Worker threads for the copy stage")
+       ->check(CLI::PositiveNumber);
+    app.add_option("--fixup-jobs", options.fixupJobs, "Worker threads for the fixup and verify stages (0 = one per CPU)");
+    app.add_option("--queue-depth", options.queueDepth, "Files each stage may queue before upstream stages wait")
+       ->check(CLI::PositiveNumber);
+
+    std::string copyMode = "auto";
+    app.add_option("--copy-mode", copyMode, "How files are materialized: auto, reflink, range, copy or hardlink")
+       ->check(CLI::IsMember({"auto", "reflink", "range", "copy", "hardlink"}));
+
+    std::string strip = "none";
+    app.add_option("--strip", strip, "What to remove from bundled ELF files while copying them: none, debug "
+                   "(DWARF and other debugging sections) or all (also the symbol table)")
+       ->check(CLI::IsMember({"none", "debug", "all"}));
+    app.add_option("--split-debug", options.splitDebugDir,
+                   "Keep the stripped sections in this directory, mirroring the bundle and indexed by build ID, "
+                   "and give each copy a .gnu_debuglink to its debug file (implies --strip=debug)");
+
+    std::string pruneUnused = "off";
+    app.add_option("--prune-unused", pruneUnused, "Find DT_NEEDED entries that satisfy none of an object's imports: "
+                   "off, report (list them) or drop (remove them from the bundled copies and leave their libraries out)")
+       ->check(CLI::IsMember({"off", "report", "drop"}));
+    app.add_option("--keep-needed", options.keepNeeded,
+                   "Never prune libraries whose filename matches this glob, for ones loaded for their initializers; "
+                   "repeatable (sanitizer runtimes, malloc replacements and libpthread are always kept)");
+    app.add_option("--store", options.storeDir,
+                   "Write each patched library once into this content-addressed store, keyed by its source and its edits, "
+                   "and hard-link (or reflink) bundle files to it, so bundles sharing libraries share their disk space");
+
+    std::string target = "host";
+    app.add_option("--target", target, "Platform whose binaries are bundled: host, linux, macos or windows "
+                   "(Mach-O and PE can be bundled from Linux)")
+       ->check(CLI::IsMember({"host", "linux", "macos", "windows"}));
+
+    bool noLoadCheck = false;
+    app.add_flag("--no-load-check", noLoadCheck, "Do not test-load the bundle once it is built (on Linux, every object is traced by ld.so in a clean child process)");
+
+    app.add_option("--profile-load", options.profileLoadRuns,
+                   "Then load the first input from the bundle this many times in a clean child process, and report "
+                   "the median time each library spends mapping, relocating and in its constructors (Linux only)");
+
+    bool noHwcaps = false;
+    app.add_flag("--no-hwcaps", noHwcaps, "Bundle only the baseline build of each library, not the CPU-optimized "
+                 "variants in its glibc-hwcaps (e.g. x86-64-v3) and legacy hwcap subdirectories");
+
+    bool noScanCache = false;
+    app.add_flag("--no-scan-cache", noScanCache, "Do not read or write the persistent dependency scan cache");
+    app.add_option("--scan-cache-dir", options.scanCacheDir, "Directory for the scan cache (default: $XDG_CACHE_HOME/relocator)");
+    std::uint64_t scanCacheSizeMb = options.scanCacheMaxBytes >> 20;
+    app.add_option("--scan-cache-size", scanCacheSizeMb, "Size bound of the scan cache in MiB")
+       ->check(CLI::PositiveNumber);
+
+    app.add_flag("--stats", job.report.printStats, "Print per-phase timings, byte counts and the slowest files");
+    app.add_option("--stats-json", job.report.statsJson, "Write the same statistics as JSON to this file ('-' for stdout)");
+    app.add_option("--stats-top", options.statsSlowest, "How many of the slowest files to list per phase");
+
+    app.add_option("--graph-out", job.report.graphOut, "Write the dependency graph to this file: Graphviz if it ends in .dot or .gv, JSON otherwise");
+    app.add_option("--why", job.report.why, "Explain which files pull in a bundled library (filename or soname)");
+
+    std::filesystem::path serveSocket;
+    app.add_option("--serve", serveSocket,
+                   "Run as a server on this Unix domain socket, keeping library metadata warm between requests. "
+                   "Libraries are resolved with the server's LD_LIBRARY_PATH, and only Linux bundles are test-loaded");
+    unsigned serveWorkers = 0;
+    app.add_option("--serve-jobs", serveWorkers, "Requests the server handles at once (0 = one per CPU)");
+    std::filesystem::path connectSocket;
+    CLI::Option* connectOption = app.add_option("--connect", connectSocket, "Send this bundle request to the server on this socket instead of running it here");
+    bool shutdownServer = false;
+    app.add_flag("--shutdown", shutdownServer, "With --connect, stop the server")->needs(connectOption);
 
     CLI11_PARSE(app, argc, argv);
+    if (serveSocket.empty() && !shutdownServer) {
+        if (job.request.inputs.empty()) {
+            return app.exit(CLI::RequiredError("--input"));
+        }
+        if (job.request.outputDir.empty()) {
+            return app.exit(CLI::RequiredError("--output"));
+        }
+    }
+    options.scanCache = !noScanCache;
+    options.loadCheck = !noLoadCheck;
+    options.hwcapVariants = !noHwcaps;
+    options.scanCacheMaxBytes = scanCacheSizeMb << 20;
+    options.copyMode = FileCopier::parseMode(copyMode);
+    options.strip = strip == "debug" ? StripMode::Debug
+                  : strip == "all"   ? StripMode::All
+                                     : StripMode::None;
+    options.pruneUnused = pruneUnused == "report" ? PruneMode::Report
+                        : pruneUnused == "drop"   ? PruneMode::Drop
+                                                  : PruneMode::Off;
+    options.target = target == "linux"   ? TargetPlatform::Linux
+                   : target == "macos"   ? TargetPlatform::MacOS
+                   : target == "windows" ? TargetPlatform::Windows
+                                         : TargetPlatform::Host;
+
+    // Kept in the order the policy is built in: literal, glob, prefix, regex, then policy files.
+    for (const auto& name : literalExclusions) job.exclusions.push_back({ ExclusionKind::Literal, name, "-e" });
+    for (const auto& pattern : globExclusions) job.exclusions.push_back({ ExclusionKind::Glob, pattern, "--exclude-glob" });
+    for (const auto& prefix : prefixExclusions) job.exclusions.push_back({ ExclusionKind::Prefix, prefix, "--exclude-prefix" });
+    for (const auto& pattern : regexExclusions) job.exclusions.push_back({ ExclusionKind::Regex, pattern, "-r" });
 
     // --- Main Logic ---
+#if !defined(_WIN32)
     try {
-        // Use a factory to get the correct relocator for the current OS
-        std::unique_ptr<Relocator> relocator = createPlatformRelocator(dryRun);
-
-        // Run the relocation process, passing both exclusion lists
-        relocator->bundleDependencies(inputFile, outputDir, searchPaths, literalExclusions, regexExclusions);
-
+        if (!serveSocket.empty()) {
+            RelocatorServer server(serveSocket, options, serveWorkers, std::cout);
+            server.run();
+            return 0;
+        }
+        if (!connectSocket.empty()) {
+            ServeRequest request;
+            request.command = shutdownServer ? ServeRequest::Command::Shutdown : ServeRequest::Command::Bundle;
+            request.options = options;
+            // The server runs in its own working directory, so every path goes over absolute.
+            // Inputs may be globs; making them absolute keeps the pattern intact.
+            request.job = job;
+            for (auto& input : request.job.request.inputs) input = std::filesystem::absolute(input).string();
+            for (auto& path : request.job.request.searchPaths) path = std::filesystem::absolute(path).string();
+            for (auto& file : request.job.policyFiles) file = std::filesystem::absolute(file);
+            if (!job.request.outputDir.empty()) request.job.request.outputDir = std::filesystem::absolute(job.request.outputDir);
+            if (!options.splitDebugDir.empty()) request.options.splitDebugDir = std::filesystem::absolute(options.splitDebugDir);
+            if (!options.storeDir.empty()) request.options.storeDir = std::filesystem::absolute(options.storeDir);
+            if (!job.report.graphOut.empty()) request.job.report.graphOut = std::filesystem::absolute(job.report.graphOut);
+            if (!job.report.statsJson.empty() && job.report.statsJson != "-") {
+                request.job.report.statsJson = std::filesystem::absolute(job.report.statsJson);
+            }
+            return RelocatorServer::send(connectSocket, request, std::cout, std::cerr);
+        }
     } catch (const std::exception& e) {
         std::cerr << "An error occurred: " << e.what() << std::endl;
         return 1;
     }
-
-    std::cout << "Relocation complete." << std::endl;
-
-    return 0;
-}
-
-// --- Platform-Specific Factory Implementation ---
-// This function is the entry point to the platform-specific code.
-// CMake will compile the correct .cpp file based on the OS.
-
-#if defined(__APPLE__)
-#include "MacOS_Relocator.hpp"
-std::unique_ptr<Relocator> createPlatformRelocator(bool dryRun) {
-    return std::make_unique<MacOS_Relocator>(dryRun);
-}
-#elif defined(__linux__)
-#include "Linux_Relocator.hpp"
-std::unique_ptr<Relocator> createPlatformRelocator(bool dryRun) {
-    return std::make_unique<Linux_Relocator>(dryRun);
-}
-#elif defined(_WIN32)
-#include "Windows_Relocator.hpp"
-std::unique_ptr<Relocator> createPlatformRelocator(bool dryRun) {
-    return std::make_unique<Windows_Relocator>(dryRun);
-}
 #else
-std::unique_ptr<Relocator> createPlatformRelocator(bool dryRun) {
-    throw std::runtime_error("Unsupported platform.");
-}
+    if (!serveSocket.empty() || !connectSocket.empty()) {
+        std::cerr << "--serve and --connect need Unix domain sockets, which this build does not support." << std::endl;
+        return 1;
+    }
 #endif
+
+    // The session picks the relocator for the current OS; the CLI is one bundle job.
+    return runBundleJob(job, options, std::cout, std::cerr);
+}
@@ -0,0 +1,145 @@
+// tests/ElfPatcherTest.cpp
+// ElfPatcher against the fixtures in fixtures/elf (see make_fixtures.py there).
+#include "TestSupport.hpp"
+
+#include "ElfFile.hpp"
+#include "ElfPatcher.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+#include <elf.h>
+
+using TestSupport::readFile;
+using TestSupport::ScratchDir;
+
+namespace {
+
+// Every fixture is libfixture.so.1, needing libdep.so.1, with .dynstr at 0x180 and .dynamic at 0x1000.
+constexpr std::uint64_t kDataVaddr = 0x1000;
+
+// Too long for libdep.so.1's slot, so .dynstr has to move to a new PT_LOAD.
+ElfPatchSpec growingSpec() {
+    ElfPatchSpec spec;
+    spec.neededRenames["libdep.so.1"] = "libdep-with-a-much-longer-name.so.1";
+    return spec;
+}
+
+std::uint64_t phoffOf(const std::filesystem::path& file) {
+    const std::vector<std::uint8_t> image = readFile(file);
+    std::uint64_t phoff = 0;
+    std::memcpy(&phoff, image.data() + offsetof(Elf64_Ehdr, e_phoff), sizeof(phoff));
+    return phoff;
+}
+
+std::vector<std::uint32_t> typesOf(const ElfFile& elf) {
+    std::vector<std::uint32_t> types;
+    for (const auto& ph : elf.programHeaders()) {
+        types.push_back(ph.type);
+    }
+    return types;
+}
+
+// The loader sizes its mapping from the first and last PT_LOAD, so they must ascend.
+void checkLoadsAscend(const ElfFile& elf) {
+    std::uint64_t previous = 0;
+    bool first = true;
+    for (const auto& ph : elf.programHeaders()) {
+        if (ph.type != PT_LOAD) {
+            continue;
+        }
+        CHECK(first || ph.vaddr > previous);
+        CHECK_EQ(ph.vaddr % ph.align, ph.offset % ph.align);
+        previous = ph.vaddr;
+        first = false;
+    }
+}
+
+// The grown .dynstr is in a third PT_LOAD past the others, and the object still reads the same.
+void checkRelaidOut(const std::filesystem::path& file, const ElfPatchPlan& plan) {
+    CHECK(plan.relayout);
+    const ElfFile elf(file);
+    checkLoadsAscend(elf);
+    const std::vector<std::uint32_t> types = { PT_LOAD, PT_LOAD, PT_LOAD, PT_DYNAMIC, PT_GNU_STACK };
+    CHECK(typesOf(elf) == types);
+    const ElfProgramHeader& added = elf.programHeaders()[2];
+    CHECK(added.vaddr > kDataVaddr);
+    CHECK(added.offset >= plan.originalSize);
+
+    const ElfDynamicInfo info = elf.dynamicInfo();
+    CHECK_EQ(info.soname, "libfixture.so.1");
+    CHECK_EQ(info.needed.size(), 1u);
+    CHECK_EQ(info.needed.at(0), "libdep-with-a-much-longer-name.so.1");
+}
+
+void nullSlotBeforeLoads() {
+    ScratchDir scratch("elf-null-first");
+    const std::filesystem::path file = scratch.copy("elf/libnullfirst.so.1");
+    const std::uint64_t phoff = phoffOf(file);
+    const ElfPatchPlan plan = ElfPatcher::apply(file, growingSpec());
+    checkRelaidOut(file, plan);
+    // The spare entry made the room, so the table did not move.
+    CHECK_EQ(phoffOf(file), phoff);
+}
+
+void nullSlotAfterLoads() {
+    ScratchDir scratch("elf-null-last");
+    const std::filesystem::path file = scratch.copy("elf/libnulllast.so.1");
+    const std::uint64_t phoff = phoffOf(file);
+    checkRelaidOut(file, ElfPatcher::apply(file, growingSpec()));
+    CHECK_EQ(phoffOf(file), phoff);
+}
+
+void noNullSlot() {
+    ScratchDir scratch("elf-no-null");
+    const std::filesystem::path file = scratch.copy("elf/libnonull.so.1");
+    const std::uint64_t phoff = phoffOf(file);
+    checkRelaidOut(file, ElfPatcher::apply(file, growingSpec()));
+    // The table moved into the new segment, one entry longer.
+    CHECK(phoffOf(file) != phoff);
+    const ElfFile elf(file);
+    const ElfProgramHeader& added = elf.programHeaders()[2];
+    CHECK(phoffOf(file) >= added.offset && phoffOf(file) < added.offset + added.filesz);
+}
+
+void growsDynamicToo() {
+    // A new DT_RUNPATH needs a slot .dynamic does not have, so it moves as well.
+    ScratchDir scratch("elf-dynamic");
+    const std::filesystem::path file = scratch.copy("elf/libnullfirst.so.1");
+    ElfPatchSpec spec = growingSpec();
+    spec.runpath = "$ORIGIN";
+    checkRelaidOut(file, ElfPatcher::apply(file, spec));
+    const ElfFile elf(file);
+    const ElfProgramHeader& added = elf.programHeaders()[2];
+    const ElfProgramHeader& dynamic = elf.programHeaders()[3];
+    CHECK(added.flags & PF_W);
+    CHECK(dynamic.vaddr >= added.vaddr && dynamic.vaddr + dynamic.memsz <= added.vaddr + added.memsz);
+    CHECK_EQ(elf.dynamicInfo().runpath, "$ORIGIN");
+}
+
+void reusesExistingStrings() {
+    // A suffix of a string already in .dynstr needs no new space, so nothing moves.
+    ScratchDir scratch("elf-in-place");
+    const std::filesystem::path file = scratch.copy("elf/libnullfirst.so.1");
+    const std::vector<std::uint8_t> before = readFile(file);
+    ElfPatchSpec spec;
+    spec.neededRenames["libdep.so.1"] = "fixture.so.1";
+    const ElfPatchPlan plan = ElfPatcher::apply(file, spec);
+    CHECK(!plan.relayout);
+    CHECK_EQ(plan.newSize, before.size());
+    const ElfFile elf(file);
+    CHECK_EQ(elf.programHeaders().size(), 5u);
+    CHECK_EQ(elf.programHeaders()[0].type, static_cast<std::uint32_t>(PT_NULL));
+    CHECK_EQ(elf.dynamicInfo().needed.at(0), "fixture.so.1");
+}
+
+} // namespace
+
+int main() {
+    TestSupport::run("PT_NULL slot before the loads", nullSlotBeforeLoads);
+    TestSupport::run("PT_NULL slot after the loads", nullSlotAfterLoads);
+    TestSupport::run("no PT_NULL slot", noNullSlot);
+    TestSupport::run("moves .dynamic too", growsDynamicToo);
+    TestSupport::run("reuses existing strings", reusesExistingStrings);
+    return TestSupport::finish();
+}
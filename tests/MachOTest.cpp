@@ -0,0 +1,270 @@
+// tests/MachOTest.cpp
+// MachOFile and MachOPatcher against the fixtures in fixtures/macho (see make_fixtures.py there).
+#include "TestSupport.hpp"
+
+#include "MachOFile.hpp"
+#include "MachOPatcher.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using TestSupport::fixture;
+using TestSupport::readFile;
+using TestSupport::ScratchDir;
+
+namespace {
+
+constexpr std::uint64_t kDataOffset = 0x400;       // Of each slice's __text, holding kMarker
+const char kMarker[] = "relocator-fixture";
+
+bool markerAt(const std::vector<std::uint8_t>& image, std::uint64_t offset) {
+    return offset + sizeof(kMarker) - 1 <= image.size()
+        && std::memcmp(image.data() + offset, kMarker, sizeof(kMarker) - 1) == 0;
+}
+
+std::vector<std::string> namesOf(const std::vector<MachODylib>& dylibs) {
+    std::vector<std::string> names;
+    for (const auto& dylib : dylibs) {
+        names.push_back(dylib.name);
+    }
+    return names;
+}
+
+// The fixtures' libraries, in load order, before any edits.
+const std::vector<std::string> kDylibs = {
+    "/usr/lib/libSystem.B.dylib", "@rpath/libdep.dylib", "@loader_path/libweak.dylib" };
+const std::vector<std::string> kRpaths = { "@loader_path/../lib", "/opt/build/lib" };
+
+void thinLoadCommands() {
+    CHECK(MachOFile::isMachO(fixture("macho/libthin.dylib")));
+    const MachOFile file(fixture("macho/libthin.dylib"));
+    CHECK(!file.isUniversal());
+    CHECK_EQ(file.slices().size(), 1u);
+
+    const MachOSlice& slice = file.slices()[0];
+    CHECK_EQ(slice.offset, 0u);
+    CHECK_EQ(slice.size, 0x1000u);
+    CHECK(slice.is64Bit);
+    CHECK(!slice.bigEndian);
+    CHECK_EQ(MachOFile::cpuName(slice.cpuType), "x86_64");
+    CHECK_EQ(slice.fileType, MachO::kDylib);
+    CHECK_EQ(slice.headerSize, 32u);
+    CHECK_EQ(slice.commandSpace, kDataOffset - 32);
+    CHECK(!slice.hasCodeSignature);
+
+    const std::vector<std::uint32_t> expected = { MachO::kSegment64, MachO::kIdDylib, MachO::kLoadDylib,
+                                                  MachO::kLoadDylib, MachO::kLoadWeakDylib, MachO::kRpath, MachO::kRpath };
+    CHECK_EQ(slice.commands.size(), expected.size());
+    std::uint64_t at = slice.headerSize;
+    for (std::size_t i = 0; i < std::min(expected.size(), slice.commands.size()); ++i) {
+        CHECK_EQ(slice.commands[i].cmd, expected[i]);
+        CHECK_EQ(slice.commands[i].offset, at);
+        at += slice.commands[i].size;
+    }
+    CHECK_EQ(at, slice.headerSize + std::uint64_t(slice.sizeOfCommands));
+
+    CHECK(slice.installName && *slice.installName == "@rpath/libfixture.dylib");
+    CHECK(namesOf(slice.dylibs) == kDylibs);
+    CHECK(!slice.dylibs[1].weak());
+    CHECK(slice.dylibs[2].weak());
+    CHECK(slice.rpaths == kRpaths);
+}
+
+void rejectsOtherFiles() {
+    CHECK(!MachOFile::isMachO(fixture("macho/make_fixtures.py")));
+    const std::vector<std::uint8_t> image = readFile(fixture("macho/libthin.dylib"));
+    // A header whose load commands run past the end of the file.
+    CHECK_THROWS(MachOFile(image.data(), 64, "truncated"));
+    // A Java class file shares the universal magic but has a version where the slice count would be.
+    const std::uint8_t javaClass[] = { 0xca, 0xfe, 0xba, 0xbe, 0x00, 0x00, 0x00, 0x34 };
+    CHECK_THROWS(MachOFile(javaClass, sizeof(javaClass), "Main.class"));
+}
+
+// A thin x86_64 dylib header followed by one load command that claims only its own 8 bytes.
+std::vector<std::uint8_t> withShortCommand(std::uint32_t cmd) {
+    std::vector<std::uint8_t> image;
+    auto put = [&](std::uint32_t value) {
+        for (int i = 0; i < 4; ++i) image.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    };
+    for (std::uint32_t value : { MachO::kMagic64, 0x01000007u, 3u, 6u, 1u, 8u, 0u, 0u }) put(value);
+    put(cmd);
+    put(8);
+    return image;
+}
+
+void rejectsShortCommands() {
+    // Nothing past the command's 8 bytes may be read: the caller's buffer ends there.
+    for (std::uint32_t cmd : { MachO::kSegment64, MachO::kSegment, MachO::kLoadDylib, MachO::kIdDylib, MachO::kRpath }) {
+        const std::vector<std::uint8_t> image = withShortCommand(cmd);
+        CHECK_THROWS(MachOFile(image.data(), image.size(), "short-command"));
+    }
+}
+
+void fatSliceOffsets() {
+    CHECK(MachOFile::isMachO(fixture("macho/libfat.dylib")));
+    const MachOFile file(fixture("macho/libfat.dylib"));
+    const std::vector<std::uint8_t> image = readFile(fixture("macho/libfat.dylib"));
+    CHECK(file.isUniversal());
+    CHECK_EQ(file.slices().size(), 3u);
+    if (file.slices().size() != 3) {
+        return;
+    }
+
+    const std::uint64_t offsets[] = { 0x1000, 0x4000, 0x8000 };
+    const char* cpus[] = { "x86_64", "arm64", "ppc" };
+    for (std::size_t i = 0; i < 3; ++i) {
+        const MachOSlice& slice = file.slices()[i];
+        CHECK_EQ(slice.offset, offsets[i]);
+        CHECK_EQ(slice.size, 0x1000u);
+        CHECK_EQ(MachOFile::cpuName(slice.cpuType), cpus[i]);
+        CHECK_EQ(slice.commandSpace, kDataOffset - slice.headerSize);
+        // Command offsets are from the start of the file, not of the slice.
+        CHECK_EQ(slice.commands.front().offset, slice.offset + slice.headerSize);
+        CHECK(markerAt(image, slice.offset + kDataOffset));
+        CHECK(slice.rpaths == kRpaths);
+    }
+
+    const MachOSlice& ppc = file.slices()[2];
+    CHECK(ppc.bigEndian);
+    CHECK(!ppc.is64Bit);
+    CHECK_EQ(ppc.headerSize, 28u);
+    CHECK(namesOf(ppc.dylibs) == kDylibs);
+    CHECK(ppc.dylibs[2].weak());
+
+    CHECK(!file.slices()[0].hasCodeSignature);
+    CHECK(file.slices()[1].hasCodeSignature);
+
+    // Each library once, in the first slice's order, then what later slices add.
+    std::vector<std::string> all = kDylibs;
+    all.push_back("@rpath/libarm.dylib");
+    CHECK(namesOf(file.dylibs()) == all);
+    CHECK(file.rpaths() == kRpaths);
+    CHECK(file.installName() && *file.installName() == "@rpath/libfixture.dylib");
+}
+
+void rewritesThinFile() {
+    ScratchDir scratch("macho-thin");
+    const std::filesystem::path copy = scratch.copy("macho/libthin.dylib");
+    const std::vector<std::uint8_t> before = readFile(copy);
+
+    MachOPatchSpec spec;
+    spec.installName = "@rpath/libfixture.1.dylib";
+    spec.dylibRenames["@rpath/libdep.dylib"] = "@loader_path/../Frameworks/libdep.dylib";
+    spec.dylibRenames["@loader_path/libweak.dylib"] = "@rpath/libweak.dylib";
+    spec.rpaths = std::vector<std::string>{ "@loader_path/../Frameworks" };
+    const MachOPatchPlan plan = MachOPatcher::apply(copy, spec);
+    CHECK(plan.changed());
+    CHECK(!plan.signatureInvalidated);
+
+    const std::vector<std::uint8_t> after = readFile(copy);
+    CHECK_EQ(after.size(), before.size());
+    CHECK(std::equal(before.begin() + kDataOffset, before.end(), after.begin() + kDataOffset));
+    for (const auto& [offset, size] : plan.changes) {
+        CHECK(offset + size <= kDataOffset);
+    }
+
+    const MachOFile file(copy);
+    const MachOSlice& slice = file.slices()[0];
+    CHECK(slice.installName && *slice.installName == "@rpath/libfixture.1.dylib");
+    const std::vector<std::string> dylibs = {
+        "/usr/lib/libSystem.B.dylib", "@loader_path/../Frameworks/libdep.dylib", "@rpath/libweak.dylib" };
+    CHECK(namesOf(slice.dylibs) == dylibs);
+    // A renamed load keeps its kind.
+    CHECK(slice.dylibs[2].weak());
+    CHECK(slice.rpaths == std::vector<std::string>{ "@loader_path/../Frameworks" });
+    CHECK_EQ(slice.commands.size(), 6u);
+    CHECK_EQ(slice.commandSpace, kDataOffset - 32);
+
+    // What is left of the old commands is cleared back to padding.
+    const std::uint64_t end = slice.headerSize + slice.sizeOfCommands;
+    CHECK(std::all_of(after.begin() + end, after.begin() + kDataOffset, [](std::uint8_t b) { return b == 0; }));
+
+    // Applying the same edits again changes nothing.
+    CHECK(!MachOPatcher::apply(copy, spec).changed());
+}
+
+void rewritesEverySlice() {
+    ScratchDir scratch("macho-fat");
+    const std::filesystem::path copy = scratch.copy("macho/libfat.dylib");
+    const std::vector<std::uint8_t> before = readFile(copy);
+
+    MachOPatchSpec spec;
+    spec.dylibRenames["@rpath/libdep.dylib"] = "@executable_path/../Frameworks/libdep-with-a-longer-name.dylib";
+    spec.rpaths = std::vector<std::string>{ "@executable_path/../Frameworks", "@loader_path" };
+    const MachOPatchPlan plan = MachOPatcher::apply(copy, spec);
+    CHECK(plan.signatureInvalidated);
+
+    const std::vector<std::uint8_t> after = readFile(copy);
+    CHECK_EQ(after.size(), before.size());
+    // The universal header and everything outside each slice's load commands is untouched.
+    CHECK(std::equal(before.begin(), before.begin() + 0x1000, after.begin()));
+    for (const auto& [offset, size] : plan.changes) {
+        const std::uint64_t slice = offset & ~std::uint64_t(0xfff);
+        CHECK(slice == 0x1000 || slice == 0x4000 || slice == 0x8000);
+        CHECK(offset + size <= slice + kDataOffset);
+    }
+
+    const MachOFile file(copy);
+    CHECK_EQ(file.slices().size(), 3u);
+    for (const MachOSlice& slice : file.slices()) {
+        CHECK(markerAt(after, slice.offset + kDataOffset));
+        CHECK(std::equal(before.begin() + slice.offset + kDataOffset, before.begin() + slice.offset + slice.size,
+                         after.begin() + slice.offset + kDataOffset));
+        CHECK_EQ(slice.dylibs[1].name, "@executable_path/../Frameworks/libdep-with-a-longer-name.dylib");
+        CHECK(slice.rpaths == *spec.rpaths);
+        CHECK(slice.installName && *slice.installName == "@rpath/libfixture.dylib");
+    }
+    CHECK(file.slices()[2].bigEndian);
+    CHECK_EQ(file.slices()[1].dylibs.back().name, "@rpath/libarm.dylib");
+}
+
+void refusesWithoutHeaderRoom() {
+    ScratchDir scratch("macho-full");
+    const std::filesystem::path copy = scratch.copy("macho/libfat.dylib");
+    const std::vector<std::uint8_t> before = readFile(copy);
+
+    MachOPatchSpec spec;
+    spec.installName = "@rpath/" + std::string(kDataOffset, 'x') + ".dylib";
+    CHECK_THROWS(MachOPatcher::apply(copy, spec));
+    CHECK(readFile(copy) == before);
+}
+
+void resolvesInstallNames() {
+    ScratchDir scratch("macho-resolve");
+    const std::filesystem::path lib = scratch.path() / "lib";
+    const std::filesystem::path frameworks = scratch.path() / "Frameworks";
+    std::filesystem::create_directories(lib);
+    std::filesystem::create_directories(frameworks / "Foo.framework" / "Versions" / "A");
+    std::ofstream(lib / "libdep.dylib") << "x";
+    std::ofstream(frameworks / "Foo.framework" / "Versions" / "A" / "Foo") << "x";
+
+    MachOSearchContext context;
+    context.loaderDir = scratch.path() / "bin";
+    context.executableDir = scratch.path() / "bin";
+    const std::filesystem::path expandedRpath = MachOFile::expand("@loader_path/../lib", context);
+    CHECK_EQ(expandedRpath, (scratch.path() / "lib").lexically_normal());
+    context.rpaths = { scratch.path() / "missing", expandedRpath };
+
+    const auto dep = MachOFile::resolve("@rpath/libdep.dylib", context, {});
+    CHECK(dep && *dep == std::filesystem::canonical(lib / "libdep.dylib"));
+    CHECK(MachOFile::resolve("@executable_path/../lib/libdep.dylib", context, {}));
+    CHECK(!MachOFile::resolve("@rpath/libnone.dylib", context, {}));
+
+    // Fallback directories are searched by filename, or by framework tail.
+    CHECK(MachOFile::resolve("/usr/local/lib/libdep.dylib", context, { lib }));
+    CHECK(MachOFile::resolve("/Library/Frameworks/Foo.framework/Versions/A/Foo", context, { frameworks }));
+}
+
+} // namespace
+
+int main() {
+    TestSupport::run("thin load commands", thinLoadCommands);
+    TestSupport::run("rejects other files", rejectsOtherFiles);
+    TestSupport::run("rejects short load commands", rejectsShortCommands);
+    TestSupport::run("fat slice offsets", fatSliceOffsets);
+    TestSupport::run("rewrites a thin file", rewritesThinFile);
+    TestSupport::run("rewrites every slice", rewritesEverySlice);
+    TestSupport::run("refuses without header room", refusesWithoutHeaderRoom);
+    TestSupport::run("resolves install names", resolvesInstallNames);
+    return TestSupport::finish();
+}
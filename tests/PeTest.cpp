@@ -0,0 +1,159 @@
+// tests/PeTest.cpp
+// PeFile and DllResolver against the fixtures in fixtures/pe (see make_fixtures.py there).
+#include "TestSupport.hpp"
+
+#include "DllResolver.hpp"
+#include "PeFile.hpp"
+
+using TestSupport::fixture;
+using TestSupport::readFile;
+using TestSupport::ScratchDir;
+
+namespace {
+
+constexpr std::uint16_t kX86 = 0x014c;
+constexpr std::uint16_t kX64 = 0x8664;
+
+std::string describe(const std::vector<PeImport>& imports) {
+    std::string text;
+    for (const auto& import : imports) {
+        text += (text.empty() ? "" : " ") + import.name + (import.delayed ? "(delayed)" : "");
+    }
+    return text;
+}
+
+void pe32Imports() {
+    CHECK(PeFile::isPe(fixture("pe/app32.exe")));
+    const PeFile file(fixture("pe/app32.exe"));
+    CHECK_EQ(file.machine(), kX86);
+    CHECK_EQ(PeFile::machineName(file.machine()), "x86");
+    CHECK(!file.is64Bit());
+    CHECK(!file.isDll());
+    CHECK_EQ(file.sections().size(), 1u);
+    CHECK_EQ(file.sections()[0].virtualAddress, 0x1000u);
+    CHECK_EQ(file.sections()[0].rawOffset, 0x200u);
+
+    // A DLL delay-imported as well as imported is listed once, as a normal import. The
+    // legacy.dll descriptor holds virtual addresses, as before Visual C++ 7.
+    CHECK_EQ(describe(file.imports()), "KERNEL32.dll libfoo.dll libbar.dll(delayed) legacy.dll(delayed)");
+}
+
+void pe32PlusImports() {
+    const PeFile file(fixture("pe/app64.exe"));
+    CHECK_EQ(file.machine(), kX64);
+    CHECK_EQ(PeFile::machineName(file.machine()), "x64");
+    CHECK(file.is64Bit());
+    CHECK(!file.isDll());
+    CHECK_EQ(describe(file.imports()), "KERNEL32.dll libfoo.dll libbar.dll(delayed)");
+}
+
+void dlls() {
+    const PeFile foo32(fixture("pe/foo32.dll"));
+    CHECK(foo32.isDll());
+    CHECK_EQ(foo32.machine(), kX86);
+    CHECK_EQ(describe(foo32.imports()), "KERNEL32.dll");
+
+    const PeFile foo64(fixture("pe/foo64.dll"));
+    CHECK(foo64.isDll());
+    CHECK(foo64.is64Bit());
+    CHECK_EQ(describe(foo64.imports()), "KERNEL32.dll");
+}
+
+void rejectsMalformedImages() {
+    CHECK(!PeFile::isPe(fixture("pe/make_fixtures.py")));
+
+    std::vector<std::uint8_t> image = readFile(fixture("pe/app64.exe"));
+    CHECK_THROWS(PeFile(image.data(), 64, "truncated"));
+
+    // An import directory outside every section and past the end of the file.
+    const std::size_t importDirectory = 0x40 + 24 + 112 + 8;
+    std::vector<std::uint8_t> outside = image;
+    outside[importDirectory + 1] = 0x90;
+    CHECK_THROWS(PeFile(outside.data(), outside.size(), "outside"));
+
+    // The PE header offset pointing past the end.
+    std::vector<std::uint8_t> header = image;
+    header[0x3d] = 0x40;
+    CHECK_THROWS(PeFile(header.data(), header.size(), "header"));
+}
+
+class SearchDirs {
+public:
+    SearchDirs() : m_scratch("pe-resolve") {
+        for (const char* name : { "app", "loader", "first", "second" }) {
+            std::filesystem::create_directories(dir(name));
+        }
+    }
+    std::filesystem::path dir(const std::string& name) const { return m_scratch.path() / name; }
+
+    // Puts a copy of a fixture DLL in one of the directories under another name.
+    std::filesystem::path put(const std::string& fixtureName, const std::string& directory, const std::string& as) const {
+        const std::filesystem::path target = dir(directory) / as;
+        std::filesystem::copy_file(fixture("pe/" + fixtureName), target, std::filesystem::copy_options::overwrite_existing);
+        return std::filesystem::canonical(target);
+    }
+
+    DllResolver resolver() const {
+        return DllResolver({ dir("first").string(), dir("second").string() });
+    }
+
+private:
+    ScratchDir m_scratch;
+};
+
+void searchOrder() {
+    SearchDirs dirs;
+    const auto app = dirs.put("foo64.dll", "app", "libfoo.dll");
+    const auto loader = dirs.put("foo64.dll", "loader", "libfoo.dll");
+    const auto first = dirs.put("foo64.dll", "first", "libfoo.dll");
+    const auto second = dirs.put("foo64.dll", "second", "libfoo.dll");
+
+    // The application directory, then the importing DLL's, then the search paths in order.
+    auto resolve = [&] { return dirs.resolver().resolve("libfoo.dll", kX64, dirs.dir("app"), dirs.dir("loader")); };
+    CHECK(resolve() == app);
+    std::filesystem::remove(app);
+    CHECK(resolve() == loader);
+    std::filesystem::remove(loader);
+    CHECK(resolve() == first);
+    std::filesystem::remove(first);
+    CHECK(resolve() == second);
+    std::filesystem::remove(second);
+    CHECK(!resolve());
+}
+
+void matchesNamesLikeWindows() {
+    SearchDirs dirs;
+    const auto stored = dirs.put("foo64.dll", "second", "LibFoo.DLL");
+    DllResolver resolver = dirs.resolver();
+    CHECK(resolver.resolve("libfoo.dll", kX64, dirs.dir("app"), dirs.dir("loader")) == stored);
+    CHECK(resolver.resolve("LIBFOO.dll", kX64, dirs.dir("app"), dirs.dir("loader")) == stored);
+    // Only the filename of a name with a directory part is looked up.
+    CHECK(resolver.resolve("C:\\Program Files\\App\\libfoo.dll", kX64, dirs.dir("app"), dirs.dir("loader")) == stored);
+    CHECK_EQ(DllResolver::lowercase("KERNEL32.DLL"), "kernel32.dll");
+}
+
+void skipsOtherMachines() {
+    SearchDirs dirs;
+    dirs.put("foo32.dll", "app", "libfoo.dll");
+    std::ofstream(dirs.dir("loader") / "libfoo.dll") << "not a PE image";
+    const auto x64 = dirs.put("foo64.dll", "first", "libfoo.dll");
+
+    DllResolver resolver = dirs.resolver();
+    CHECK(resolver.resolve("libfoo.dll", kX64, dirs.dir("app"), dirs.dir("loader")) == x64);
+    CHECK(resolver.resolve("libfoo.dll", kX86, dirs.dir("app"), dirs.dir("loader"))
+          == std::filesystem::canonical(dirs.dir("app") / "libfoo.dll"));
+    CHECK(!resolver.resolve("libfoo.dll", 0xaa64, dirs.dir("app"), dirs.dir("loader")));
+}
+
+} // namespace
+
+int main() {
+    TestSupport::run("PE32 imports", pe32Imports);
+    TestSupport::run("PE32+ imports", pe32PlusImports);
+    TestSupport::run("DLLs", dlls);
+    TestSupport::run("rejects malformed images", rejectsMalformedImages);
+    TestSupport::run("DLL search order", searchOrder);
+    TestSupport::run("matches names like Windows", matchesNamesLikeWindows);
+    TestSupport::run("skips other machines", skipsOtherMachines);
+    return TestSupport::finish();
+}
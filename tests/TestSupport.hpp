@@ -0,0 +1,126 @@
+// tests/TestSupport.hpp
+#ifndef RELOCATOR_TESTSUPPORT_HPP
+#define RELOCATOR_TESTSUPPORT_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @namespace TestSupport
+ * @brief The little the tests need: checks that report and carry on, named cases, and
+ * scratch copies of the checked-in fixtures.
+ *
+ * Each test program is one executable registered with ctest; it runs every case and
+ * exits non-zero if any check failed.
+ */
+namespace TestSupport {
+
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+
+    inline void fail(const char* file, int line, const std::string& message) {
+        std::cerr << file << ":" << line << ": " << message << "\n";
+        ++failures();
+    }
+
+    template <typename A, typename B>
+    void checkEqual(const A& actual, const B& expected, const char* text, const char* file, int line) {
+        if (!(actual == expected)) {
+            std::ostringstream message;
+            message << "CHECK_EQ(" << text << ") failed: got " << actual << ", expected " << expected;
+            fail(file, line, message.str());
+        }
+    }
+
+    /**
+     * Runs one case, counting an escaped exception as a failure.
+     */
+    inline void run(const char* name, const std::function<void()>& test) {
+        const int before = failures();
+        try {
+            test();
+        } catch (const std::exception& e) {
+            fail(name, 0, std::string("unexpected exception: ") + e.what());
+        }
+        std::cout << (failures() == before ? "[pass] " : "[FAIL] ") << name << "\n";
+    }
+
+    inline int finish() {
+        if (failures() != 0) {
+            std::cerr << failures() << " check(s) failed.\n";
+        }
+        return failures() == 0 ? 0 : 1;
+    }
+
+    inline std::filesystem::path fixture(const std::string& relative) {
+        return std::filesystem::path(RELOCATOR_FIXTURE_DIR) / relative;
+    }
+
+    inline std::vector<std::uint8_t> readFile(const std::filesystem::path& file) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("Could not open file: " + file.string());
+        }
+        return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    /**
+     * A directory of its own under the system temp directory, removed with the object.
+     */
+    class ScratchDir {
+    public:
+        explicit ScratchDir(const std::string& name) {
+            m_path = std::filesystem::temp_directory_path()
+                   / ("relocator-test-" + name + "-" + std::to_string(std::random_device()()));
+            std::filesystem::remove_all(m_path);
+            std::filesystem::create_directories(m_path);
+        }
+        ~ScratchDir() {
+            std::error_code ec;
+            std::filesystem::remove_all(m_path, ec);
+        }
+        ScratchDir(const ScratchDir&) = delete;
+        ScratchDir& operator=(const ScratchDir&) = delete;
+
+        const std::filesystem::path& path() const { return m_path; }
+
+        /**
+         * Copies a fixture in, so a test can modify it.
+         */
+        std::filesystem::path copy(const std::string& relative) const {
+            const std::filesystem::path target = m_path / std::filesystem::path(relative).filename();
+            std::filesystem::copy_file(fixture(relative), target, std::filesystem::copy_options::overwrite_existing);
+            std::filesystem::permissions(target, std::filesystem::perms::owner_write, std::filesystem::perm_options::add);
+            return target;
+        }
+
+    private:
+        std::filesystem::path m_path;
+    };
+
+} // namespace TestSupport
+
+#define CHECK(condition) \
+    do { if (!(condition)) TestSupport::fail(__FILE__, __LINE__, "CHECK(" #condition ") failed"); } while (0)
+
+#define CHECK_EQ(actual, expected) TestSupport::checkEqual((actual), (expected), #actual ", " #expected, __FILE__, __LINE__)
+
+#define CHECK_THROWS(expression) \
+    do { \
+        bool threw_ = false; \
+        try { expression; } catch (const std::exception&) { threw_ = true; } \
+        if (!threw_) TestSupport::fail(__FILE__, __LINE__, "CHECK_THROWS(" #expression ") did not throw"); \
+    } while (0)
+
+#endif //RELOCATOR_TESTSUPPORT_HPP
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Writes the ELF fixtures the tests read, without needing a toolchain.
+
+    libnullfirst.so.1  A spare PT_NULL entry ahead of every PT_LOAD.
+    libnulllast.so.1   A spare PT_NULL entry at the end of the program header table.
+    libnonull.so.1     No spare entry; a new segment means moving the table.
+
+Each is an x86-64 shared object named libfixture.so.1 that needs libdep.so.1, with
+two PT_LOADs: a read-only one holding the headers and .dynstr, and a writable one
+holding .dynamic, which has no spare slots. There are no section headers and no
+code. The files are checked in; rerun this only to change them.
+"""
+import os
+import struct
+
+PT_NULL, PT_LOAD, PT_DYNAMIC = 0, 1, 2
+PT_GNU_STACK = 0x6474E551
+PF_W, PF_R = 2, 4
+DT_NULL, DT_NEEDED, DT_STRTAB, DT_STRSZ, DT_SONAME = 0, 1, 5, 10, 14
+
+PAGE = 0x1000
+PHDR_OFFSET = 64
+PHDR_SIZE = 56
+DYNSTR_OFFSET = 0x180
+DYNAMIC_OFFSET = PAGE
+
+
+def shared_object(order):
+    """order: the program header types, in table order."""
+    dynstr = b"\0libdep.so.1\0libfixture.so.1\0"
+    dynamic = [(DT_NEEDED, 1), (DT_SONAME, dynstr.index(b"libfixture")), (DT_STRTAB, DYNSTR_OFFSET),
+               (DT_STRSZ, len(dynstr)), (DT_NULL, 0)]
+    dynamic_size = 16 * len(dynamic)
+
+    headers = {
+        PT_NULL: (PT_NULL, 0, 0, 0, 0, 0, 0),
+        "text": (PT_LOAD, PF_R, 0, 0, DYNSTR_OFFSET + len(dynstr), DYNSTR_OFFSET + len(dynstr), PAGE),
+        "data": (PT_LOAD, PF_R | PF_W, DYNAMIC_OFFSET, DYNAMIC_OFFSET, dynamic_size, dynamic_size, PAGE),
+        PT_DYNAMIC: (PT_DYNAMIC, PF_R | PF_W, DYNAMIC_OFFSET, DYNAMIC_OFFSET, dynamic_size, dynamic_size, 8),
+        PT_GNU_STACK: (PT_GNU_STACK, PF_R | PF_W, 0, 0, 0, 0, 16),
+    }
+    assert PHDR_OFFSET + PHDR_SIZE * len(order) <= DYNSTR_OFFSET
+
+    data = bytearray(DYNAMIC_OFFSET + dynamic_size)
+    ident = b"\x7fELF" + bytes([2, 1, 1]) + bytes(9)   # ELFCLASS64, little-endian, EV_CURRENT
+    data[0:64] = ident + struct.pack("<HHIQQQIHHHHHH", 3, 62, 1, 0, PHDR_OFFSET, 0, 0, 64, PHDR_SIZE,
+                                     len(order), 64, 0, 0)   # ET_DYN, EM_X86_64
+    for i, kind in enumerate(order):
+        p_type, flags, offset, vaddr, filesz, memsz, align = headers[kind]
+        struct.pack_into("<IIQQQQQQ", data, PHDR_OFFSET + i * PHDR_SIZE,
+                         p_type, flags, offset, vaddr, vaddr, filesz, memsz, align)
+    data[DYNSTR_OFFSET:DYNSTR_OFFSET + len(dynstr)] = dynstr
+    for i, (tag, value) in enumerate(dynamic):
+        struct.pack_into("<qQ", data, DYNAMIC_OFFSET + 16 * i, tag, value)
+    return bytes(data)
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    fixtures = {
+        "libnullfirst.so.1": shared_object([PT_NULL, "text", "data", PT_DYNAMIC, PT_GNU_STACK]),
+        "libnulllast.so.1": shared_object(["text", "data", PT_DYNAMIC, PT_GNU_STACK, PT_NULL]),
+        "libnonull.so.1": shared_object(["text", "data", PT_DYNAMIC, PT_GNU_STACK]),
+    }
+    for name, contents in fixtures.items():
+        with open(os.path.join(here, name), "wb") as f:
+            f.write(contents)
+
+
+if __name__ == "__main__":
+    main()
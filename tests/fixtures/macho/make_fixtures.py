@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Writes the Mach-O fixtures the tests read, without needing a macOS toolchain.
+
+    libthin.dylib  x86_64 dylib: an install name, three kinds of dylib load, two rpaths
+                   and 0x400 bytes between its header and its first section.
+    libfat.dylib   Universal dylib with x86_64, arm64 and ppc slices at 0x1000, 0x4000
+                   and 0x8000; the arm64 slice is code-signed, the ppc one is big-endian
+                   and 32-bit.
+
+Each section is filled with a marker so tests can check that patching leaves it alone.
+The files are checked in; rerun this only to change them.
+"""
+import os
+import struct
+
+LC_SEGMENT = 0x1
+LC_LOAD_DYLIB = 0xC
+LC_ID_DYLIB = 0xD
+LC_SEGMENT_64 = 0x19
+LC_LOAD_WEAK_DYLIB = 0x80000018
+LC_RPATH = 0x8000001C
+LC_CODE_SIGNATURE = 0x1D
+
+MH_DYLIB = 0x6
+CPU_X86_64 = 0x01000007
+CPU_ARM64 = 0x0100000C
+CPU_PPC = 18
+
+DATA_OFFSET = 0x400     # Of the first section, from the start of the slice
+SLICE_SIZE = 0x1000
+MARKER = b"relocator-fixture"
+
+
+class Slice:
+    def __init__(self, cpu, is64, big):
+        self.cpu, self.is64, self.big = cpu, is64, big
+        self.commands = []
+
+    def pack(self, fmt, *values):
+        return struct.pack((">" if self.big else "<") + fmt, *values)
+
+    def string_command(self, cmd, fixed, text):
+        align = 8 if self.is64 else 4
+        header = 8 + 4 + len(fixed)
+        size = (header + len(text) + 1 + align - 1) // align * align
+        body = self.pack("III", cmd, size, header) + fixed + text.encode()
+        self.commands.append(body + b"\0" * (size - len(body)))
+
+    def dylib(self, cmd, name):
+        self.string_command(cmd, self.pack("III", 2, 0x10000, 0x10000), name)
+
+    def rpath(self, path):
+        self.string_command(LC_RPATH, b"", path)
+
+    def text_segment(self):
+        name = lambda s: s.encode().ljust(16, b"\0")
+        if self.is64:
+            section = name("__text") + name("__TEXT") + self.pack("QQIIIIIIII", DATA_OFFSET, len(MARKER),
+                                                                  DATA_OFFSET, 4, 0, 0, 0x80000400, 0, 0, 0)
+            segment = self.pack("II", LC_SEGMENT_64, 72 + len(section)) + name("__TEXT") \
+                + self.pack("QQQQIIII", 0, SLICE_SIZE, 0, SLICE_SIZE, 5, 5, 1, 0)
+        else:
+            section = name("__text") + name("__TEXT") + self.pack("IIIIIIIII", DATA_OFFSET, len(MARKER),
+                                                                 DATA_OFFSET, 2, 0, 0, 0x80000400, 0, 0)
+            segment = self.pack("II", LC_SEGMENT, 56 + len(section)) + name("__TEXT") \
+                + self.pack("IIIIIIII", 0, SLICE_SIZE, 0, SLICE_SIZE, 5, 5, 1, 0)
+        self.commands.append(segment + section)
+
+    def code_signature(self):
+        self.commands.append(self.pack("IIII", LC_CODE_SIGNATURE, 16, SLICE_SIZE - 0x100, 0x100))
+
+    def build(self):
+        commands = b"".join(self.commands)
+        if self.is64:
+            header = self.pack("IIIIIIII", 0xFEEDFACF, self.cpu, 3 if self.cpu == CPU_X86_64 else 0, MH_DYLIB,
+                               len(self.commands), len(commands), 0x100085, 0)
+        else:
+            header = self.pack("IIIIIII", 0xFEEDFACE, self.cpu, 0, MH_DYLIB, len(self.commands), len(commands), 0x100085)
+        image = bytearray(SLICE_SIZE)
+        image[:len(header) + len(commands)] = header + commands
+        assert len(header) + len(commands) <= DATA_OFFSET
+        image[DATA_OFFSET:DATA_OFFSET + len(MARKER)] = MARKER
+        return bytes(image)
+
+
+def thin_slice(cpu, is64=True, big=False, signed=False, extra_dylib=None):
+    s = Slice(cpu, is64, big)
+    s.text_segment()
+    s.dylib(LC_ID_DYLIB, "@rpath/libfixture.dylib")
+    s.dylib(LC_LOAD_DYLIB, "/usr/lib/libSystem.B.dylib")
+    s.dylib(LC_LOAD_DYLIB, "@rpath/libdep.dylib")
+    s.dylib(LC_LOAD_WEAK_DYLIB, "@loader_path/libweak.dylib")
+    if extra_dylib:
+        s.dylib(LC_LOAD_DYLIB, extra_dylib)
+    s.rpath("@loader_path/../lib")
+    s.rpath("/opt/build/lib")
+    if signed:
+        s.code_signature()
+    return s.build()
+
+
+def fat(slices):
+    # (cpu, subtype, offset, image, align)
+    header = struct.pack(">II", 0xCAFEBABE, len(slices))
+    for cpu, subtype, offset, image, align in slices:
+        header += struct.pack(">IIIII", cpu, subtype, offset, len(image), align)
+    size = max(offset + len(image) for _, _, offset, image, _ in slices)
+    data = bytearray(size)
+    data[:len(header)] = header
+    for _, _, offset, image, _ in slices:
+        data[offset:offset + len(image)] = image
+    return bytes(data)
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    with open(os.path.join(here, "libthin.dylib"), "wb") as f:
+        f.write(thin_slice(CPU_X86_64))
+    with open(os.path.join(here, "libfat.dylib"), "wb") as f:
+        f.write(fat([
+            (CPU_X86_64, 3, 0x1000, thin_slice(CPU_X86_64), 12),
+            (CPU_ARM64, 0, 0x4000, thin_slice(CPU_ARM64, signed=True, extra_dylib="@rpath/libarm.dylib"), 14),
+            (CPU_PPC, 0, 0x8000, thin_slice(CPU_PPC, is64=False, big=True), 12),
+        ]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Writes the PE fixtures the tests read, without needing a Windows toolchain.
+
+    app32.exe  PE32 x86 executable. Imports KERNEL32.dll and libfoo.dll; delay-imports
+               libbar.dll with an RVA-based descriptor, legacy.dll with a pre-VC7
+               VA-based one, and LIBFOO.DLL again, which must not be listed twice.
+    app64.exe  PE32+ x64 executable. Imports KERNEL32.dll and libfoo.dll; delay-imports
+               libbar.dll.
+    foo32.dll  PE32 x86 DLL importing KERNEL32.dll.
+    foo64.dll  PE32+ x64 DLL importing KERNEL32.dll.
+
+Each image has one .idata section holding the tables, one function per DLL, with
+thunks and hint/name entries laid out as a linker would. Nothing in them is meant
+to run. The files are checked in; rerun this only to change them.
+"""
+import os
+import struct
+
+MACHINE_I386 = 0x014C
+MACHINE_AMD64 = 0x8664
+
+FILE_ALIGNMENT = 0x200
+SECTION_ALIGNMENT = 0x1000
+SECTION_RVA = 0x1000
+
+
+def align(value, alignment):
+    return (value + alignment - 1) // alignment * alignment
+
+
+def image(machine, dll, imports, delay_imports):
+    """imports: [(dll, function)]; delay_imports: [(dll, function, rva_based)]."""
+    is64 = machine == MACHINE_AMD64
+    image_base = (0x180000000 if dll else 0x140000000) if is64 else (0x10000000 if dll else 0x400000)
+    thunk = "<Q" if is64 else "<I"
+    thunk_size = 8 if is64 else 4
+
+    # Descriptor tables first, each ending in an all-zero entry, then everything they point at.
+    import_table = 0
+    delay_table = align(import_table + 20 * (len(imports) + 1), 8)
+    data = bytearray(align(delay_table + (32 * (len(delay_imports) + 1) if delay_imports else 0), 8))
+
+    def append(blob, alignment=2):
+        data.extend(b"\0" * (align(len(data), alignment) - len(data)))
+        rva = SECTION_RVA + len(data)
+        data.extend(blob)
+        return rva
+
+    def hint_name(function):
+        return append(struct.pack("<H", 0) + function.encode() + b"\0")
+
+    def thunks(values):
+        return append(b"".join(struct.pack(thunk, v) for v in values) + struct.pack(thunk, 0), thunk_size)
+
+    iat_start = iat_end = None
+    for i, (name, function) in enumerate(imports):
+        name_rva = append(name.encode() + b"\0")
+        entry = hint_name(function)
+        ilt = thunks([entry])
+        iat = thunks([entry])
+        iat_start = iat if iat_start is None else iat_start
+        iat_end = iat + 2 * thunk_size
+        struct.pack_into("<IIIII", data, import_table + 20 * i, ilt, 0, 0, name_rva, iat)
+
+    for i, (name, function, rva_based) in enumerate(delay_imports):
+        name_rva = append(name.encode() + b"\0")
+        entry = hint_name(function)
+        module = append(b"\0" * thunk_size, thunk_size)
+        names = thunks([entry])
+        iat = thunks([SECTION_RVA])      # Would point at the delay-load helper's thunk
+        fields = [name_rva, module, iat, names]
+        if not rva_based:
+            fields = [image_base + rva for rva in fields]
+        struct.pack_into("<IIIIIIII", data, delay_table + 32 * i, 1 if rva_based else 0, *fields, 0, 0, 0)
+
+    raw_size = align(len(data), FILE_ALIGNMENT)
+    size_of_image = SECTION_RVA + align(len(data), SECTION_ALIGNMENT)
+
+    directories = [(0, 0)] * 16
+    directories[1] = (SECTION_RVA + import_table, 20 * (len(imports) + 1))
+    if iat_start is not None:
+        directories[12] = (iat_start, iat_end - iat_start)
+    if delay_imports:
+        directories[13] = (SECTION_RVA + delay_table, 32 * (len(delay_imports) + 1))
+
+    if is64:
+        optional = struct.pack("<HBBIIIII", 0x20B, 14, 0, 0, raw_size, 0, 0, SECTION_RVA)
+        optional += struct.pack("<QIIHHHHHHIIIIHHQQQQII", image_base, SECTION_ALIGNMENT, FILE_ALIGNMENT,
+                                6, 0, 0, 0, 6, 0, 0, size_of_image, FILE_ALIGNMENT, 0, 3, 0x8160,
+                                0x100000, 0x1000, 0x100000, 0x1000, 0, 16)
+    else:
+        optional = struct.pack("<HBBIIIIII", 0x10B, 14, 0, 0, raw_size, 0, 0, SECTION_RVA, SECTION_RVA)
+        optional += struct.pack("<IIIHHHHHHIIIIHHIIIIII", image_base, SECTION_ALIGNMENT, FILE_ALIGNMENT,
+                                6, 0, 0, 0, 6, 0, 0, size_of_image, FILE_ALIGNMENT, 0, 3, 0x8140,
+                                0x100000, 0x1000, 0x100000, 0x1000, 0, 16)
+    optional += b"".join(struct.pack("<II", rva, size) for rva, size in directories)
+
+    characteristics = 0x0002 | (0x0020 if is64 else 0x0100) | (0x2000 if dll else 0)
+    coff = struct.pack("<HHIIIHH", machine, 1, 0, 0, 0, len(optional), characteristics)
+    section = b".idata\0\0" + struct.pack("<IIIIIIHHI", len(data), SECTION_RVA, raw_size, FILE_ALIGNMENT,
+                                          0, 0, 0, 0, 0xC0000040)
+
+    dos = bytearray(64)
+    dos[0:2] = b"MZ"
+    struct.pack_into("<I", dos, 0x3C, 64)
+    headers = bytes(dos) + b"PE\0\0" + coff + optional + section
+    assert len(headers) <= FILE_ALIGNMENT
+    return headers.ljust(FILE_ALIGNMENT, b"\0") + bytes(data).ljust(raw_size, b"\0")
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    fixtures = {
+        "app32.exe": image(MACHINE_I386, False,
+                           [("KERNEL32.dll", "ExitProcess"), ("libfoo.dll", "foo")],
+                           [("libbar.dll", "bar", True), ("legacy.dll", "legacy", False),
+                            ("LIBFOO.DLL", "foo_late", True)]),
+        "app64.exe": image(MACHINE_AMD64, False,
+                           [("KERNEL32.dll", "ExitProcess"), ("libfoo.dll", "foo")],
+                           [("libbar.dll", "bar", True)]),
+        "foo32.dll": image(MACHINE_I386, True, [("KERNEL32.dll", "GetLastError")], []),
+        "foo64.dll": image(MACHINE_AMD64, True, [("KERNEL32.dll", "GetLastError")], []),
+    }
+    for name, contents in fixtures.items():
+        with open(os.path.join(here, name), "wb") as f:
+            f.write(contents)
+
+
+if __name__ == "__main__":
+    main()